@@ -37,6 +37,7 @@
 #include "exec/address-spaces.h"
 #include "qemu/event_notifier.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "trace.h"
 #include "hw/irq.h"
 #include "sysemu/sev.h"
@@ -110,6 +111,11 @@ struct KVMState
     KVMMemoryListener memory_listener;
     QLIST_HEAD(, KVMParkedVcpu) kvm_parked_vcpus;
 
+    /* Memory slot statistics, protected by the BQL */
+    uint64_t memslot_updates;
+    uint64_t memslot_elided;
+    uint64_t memslot_time_ns;
+
     /* memory encryption */
     void *memcrypt_handle;
     int (*memcrypt_encrypt_data)(void *handle, uint8_t *ptr, uint64_t len);
@@ -158,6 +164,17 @@ int kvm_get_max_memslots(void)
     return s->nr_slots;
 }
 
+KvmMemslotStats *kvm_memslot_stats(void)
+{
+    KVMState *s = kvm_state;
+    KvmMemslotStats *stats = g_new0(KvmMemslotStats, 1);
+
+    stats->updates = s->memslot_updates;
+    stats->elided = s->memslot_elided;
+    stats->time_ns = s->memslot_time_ns;
+    return stats;
+}
+
 bool kvm_memcrypt_enabled(void)
 {
     if (kvm_state && kvm_state->memcrypt_handle) {
@@ -229,7 +246,8 @@ static KVMSlot *kvm_lookup_matching_slot(KVMMemoryListener *kml,
     for (i = 0; i < s->nr_slots; i++) {
         KVMSlot *mem = &kml->slots[i];
 
-        if (start_addr == mem->start_addr && size == mem->memory_size) {
+        if (start_addr == mem->start_addr && size == mem->memory_size &&
+            !mem->del_pending) {
             return mem;
         }
     }
@@ -286,6 +304,7 @@ static int kvm_set_user_memory_region(KVMMemoryListener *kml, KVMSlot *slot, boo
 {
     KVMState *s = kvm_state;
     struct kvm_userspace_memory_region mem;
+    int64_t start = get_clock();
     int ret;
 
     mem.slot = slot->slot | (kml->as_id << 16);
@@ -302,6 +321,8 @@ static int kvm_set_user_memory_region(KVMMemoryListener *kml, KVMSlot *slot, boo
     mem.memory_size = slot->memory_size;
     ret = kvm_vm_ioctl(s, KVM_SET_USER_MEMORY_REGION, &mem);
     slot->old_flags = mem.flags;
+    s->memslot_updates++;
+    s->memslot_time_ns += get_clock() - start;
     trace_kvm_set_user_memory(mem.slot, mem.flags, mem.guest_phys_addr,
                               mem.memory_size, mem.userspace_addr, ret);
     return ret;
@@ -953,10 +974,93 @@ kvm_check_extension_list(KVMState *s, const KVMCapabilityInfo *list)
     return NULL;
 }
 
+/* Called with KVMMemoryListener.slots_lock held */
+static void kvm_slot_delete(KVMMemoryListener *kml, KVMSlot *mem)
+{
+    int err;
+
+    g_free(mem->dirty_bmap);
+    mem->dirty_bmap = NULL;
+    mem->memory_size = 0;
+    mem->flags = 0;
+    err = kvm_set_user_memory_region(kml, mem, false);
+    if (err) {
+        fprintf(stderr, "%s: error unregistering slot: %s\n",
+                __func__, strerror(-err));
+        abort();
+    }
+}
+
+/* Called with KVMMemoryListener.slots_lock held */
+static void kvm_slot_flush_pending(KVMMemoryListener *kml, KVMSlot *mem)
+{
+    mem->del_pending = false;
+    kvm_slot_delete(kml, mem);
+    memory_region_unref(mem->del_mr);
+    mem->del_mr = NULL;
+}
+
+/*
+ * Delete the pending slots that overlap [start_addr, start_addr + size),
+ * or all of them if size is zero.
+ *
+ * Called with KVMMemoryListener.slots_lock held
+ */
+static void kvm_flush_pending_slots(KVMMemoryListener *kml,
+                                    hwaddr start_addr, hwaddr size)
+{
+    KVMState *s = kvm_state;
+    int i;
+
+    for (i = 0; i < s->nr_slots; i++) {
+        KVMSlot *mem = &kml->slots[i];
+
+        if (!mem->del_pending) {
+            continue;
+        }
+        if (size && (mem->start_addr >= start_addr + size ||
+                     start_addr >= mem->start_addr + mem->memory_size)) {
+            continue;
+        }
+        kvm_slot_flush_pending(kml, mem);
+    }
+}
+
+/*
+ * Within a memory transaction, a slot is often deleted and then added
+ * back unchanged, for example when a neighbouring section is split or
+ * merged.  Each KVM_SET_USER_MEMORY_REGION waits for an SRCU grace period
+ * in the kernel, so slot deletions are deferred until the transaction
+ * commits and cancelled if the same slot is added back in the meanwhile.
+ *
+ * Called with KVMMemoryListener.slots_lock held
+ */
+static KVMSlot *kvm_lookup_pending_slot(KVMMemoryListener *kml,
+                                        hwaddr start_addr, hwaddr size,
+                                        void *ram, int flags)
+{
+    KVMState *s = kvm_state;
+    int i;
+
+    for (i = 0; i < s->nr_slots; i++) {
+        KVMSlot *mem = &kml->slots[i];
+
+        if (mem->del_pending && mem->start_addr == start_addr &&
+            mem->memory_size == size && mem->ram == ram &&
+            mem->flags == flags) {
+            return mem;
+        }
+    }
+
+    return NULL;
+}
+
 static void kvm_set_phys_mem(KVMMemoryListener *kml,
                              MemoryRegionSection *section, bool add)
 {
+    KVMState *s = kvm_state;
     KVMSlot *mem;
+    int flags;
     int err;
     MemoryRegion *mr = section->mr;
     bool writeable = !mr->readonly && !mr->rom_device;
@@ -990,29 +1094,41 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
             goto out;
         }
         if (mem->flags & KVM_MEM_LOG_DIRTY_PAGES) {
+            /* Sync the dirty bitmap while the section is still valid.  */
             kvm_physical_sync_dirty_bitmap(kml, section);
+            kvm_slot_delete(kml, mem);
+            goto out;
         }
 
-        /* unregister the slot */
-        g_free(mem->dirty_bmap);
-        mem->dirty_bmap = NULL;
-        mem->memory_size = 0;
-        mem->flags = 0;
-        err = kvm_set_user_memory_region(kml, mem, false);
-        if (err) {
-            fprintf(stderr, "%s: error unregistering slot: %s\n",
-                    __func__, strerror(-err));
-            abort();
-        }
+        /* unregister the slot in kvm_commit, unless it comes back */
+        mem->del_pending = true;
+        mem->del_mr = mr;
+        memory_region_ref(mr);
+        goto out;
+    }
+
+    flags = kvm_mem_flags(mr);
+    mem = kvm_lookup_pending_slot(kml, start_addr, size, ram, flags);
+    if (mem) {
+        mem->del_pending = false;
+        memory_region_unref(mem->del_mr);
+        mem->del_mr = NULL;
+        s->memslot_elided++;
         goto out;
     }
 
+    /* KVM rejects overlapping slots */
+    kvm_flush_pending_slots(kml, start_addr, size);
+    if (!kvm_get_free_slot(kml)) {
+        kvm_flush_pending_slots(kml, 0, 0);
+    }
+
     /* register the new slot */
     mem = kvm_alloc_slot(kml);
     mem->memory_size = size;
     mem->start_addr = start_addr;
     mem->ram = ram;
-    mem->flags = kvm_mem_flags(mr);
+    mem->flags = flags;
 
     err = kvm_set_user_memory_region(kml, mem, true);
     if (err) {
@@ -1025,6 +1141,34 @@ out:
     kvm_slots_unlock(kml);
 }
 
+static void kvm_begin(MemoryListener *listener)
+{
+    KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
+    KVMState *s = kvm_state;
+
+    kml->txn_updates = s->memslot_updates;
+    kml->txn_elided = s->memslot_elided;
+    kml->txn_time_ns = s->memslot_time_ns;
+}
+
+static void kvm_commit(MemoryListener *listener)
+{
+    KVMMemoryListener *kml = container_of(listener, KVMMemoryListener, listener);
+    KVMState *s = kvm_state;
+
+    kvm_slots_lock(kml);
+    kvm_flush_pending_slots(kml, 0, 0);
+    kvm_slots_unlock(kml);
+
+    if (s->memslot_updates != kml->txn_updates ||
+        s->memslot_elided != kml->txn_elided) {
+        trace_kvm_memslot_commit(kml->as_id,
+                                 s->memslot_updates - kml->txn_updates,
+                                 s->memslot_elided - kml->txn_elided,
+                                 s->memslot_time_ns - kml->txn_time_ns);
+    }
+}
+
 static void kvm_region_add(MemoryListener *listener,
                            MemoryRegionSection *section)
 {
@@ -1159,6 +1303,8 @@ void kvm_memory_listener_register(KVMState *s, KVMMemoryListener *kml,
         kml->slots[i].slot = i;
     }
 
+    kml->listener.begin = kvm_begin;
+    kml->listener.commit = kvm_commit;
     kml->listener.region_add = kvm_region_add;
     kml->listener.region_del = kvm_region_del;
     kml->listener.log_start = kvm_log_start;
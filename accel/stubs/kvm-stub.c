@@ -160,6 +160,11 @@ bool kvm_has_free_slot(MachineState *ms)
     return false;
 }
 
+KvmMemslotStats *kvm_memslot_stats(void)
+{
+    return NULL;
+}
+
 void kvm_init_cpu_signals(CPUState *cpu)
 {
     abort();
@@ -394,6 +394,26 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
     return;
 }
 
+/*
+ * Replace a hot block with a superblock.  The old block is invalidated
+ * first, so that tb_gen_code does not find it in the hash table and
+ * blocks that jump to it are unlinked and look up the superblock instead.
+ */
+static TranslationBlock *tb_superblock_upgrade(CPUState *cpu,
+                                               TranslationBlock *tb,
+                                               uint32_t cf_mask)
+{
+    target_ulong pc = tb->pc;
+
+    mmap_lock();
+    tb_phys_invalidate(tb, -1);
+    tb = tb_gen_code(cpu, pc, tb->cs_base, tb->flags,
+                     cf_mask | CF_SUPERBLOCK);
+    mmap_unlock();
+    atomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+    return tb;
+}
+
 static inline TranslationBlock *tb_find(CPUState *cpu,
                                         TranslationBlock *last_tb,
                                         int tb_exit, uint32_t cf_mask)
@@ -409,6 +429,9 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
         mmap_unlock();
         /* We add the TB in the virtual pc hash table for the fast lookup */
         atomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+    } else if (unlikely(atomic_read(&tb->sb_countdown) <= 0) &&
+               tb_superblock_candidate(tb)) {
+        tb = tb_superblock_upgrade(cpu, tb, cf_mask);
     }
 #ifndef CONFIG_USER_ONLY
     /* We don't take care of direct jumps when address mapping changes in
@@ -283,11 +283,29 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+void tlb_flush_page_counts(size_t *ppage, size_t *plarge, size_t *plarge_full)
+{
+    CPUState *cpu;
+    size_t page = 0, large = 0, large_full = 0;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+
+        page += atomic_read(&env_tlb(env)->c.page_flush_count);
+        large += atomic_read(&env_tlb(env)->c.large_page_flush_count);
+        large_full += atomic_read(&env_tlb(env)->c.large_page_full_flush_count);
+    }
+    *ppage = page;
+    *plarge = large;
+    *plarge_full = large_full;
+}
+
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx)
 {
     tlb_table_flush_by_mmuidx(env, mmu_idx);
     env_tlb(env)->d[mmu_idx].large_page_addr = -1;
     env_tlb(env)->d[mmu_idx].large_page_mask = -1;
+    env_tlb(env)->d[mmu_idx].n_large_pages = 0;
     env_tlb(env)->d[mmu_idx].vindex = 0;
     memset(env_tlb(env)->d[mmu_idx].vtable, -1,
            sizeof(env_tlb(env)->d[0].vtable));
@@ -423,6 +441,146 @@ static inline void tlb_flush_vtlb_page_locked(CPUArchState *env, int mmu_idx,
     }
 }
 
+static inline bool tlb_hit_page_mask_anyprot(CPUTLBEntry *tlb_entry,
+                                             target_ulong page,
+                                             target_ulong mask)
+{
+    page &= mask;
+    mask |= TLB_INVALID_MASK;
+
+    return (page == (tlb_entry->addr_read & mask) ||
+            page == (tlb_addr_write(tlb_entry) & mask) ||
+            page == (tlb_entry->addr_code & mask));
+}
+
+/* Called with tlb_c.lock held */
+static inline bool tlb_flush_entry_mask_locked(CPUTLBEntry *tlb_entry,
+                                               target_ulong page,
+                                               target_ulong mask)
+{
+    if (tlb_hit_page_mask_anyprot(tlb_entry, page, mask)) {
+        memset(tlb_entry, -1, sizeof(*tlb_entry));
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Evict all the entries within the large page @lp_addr/@lp_mask.
+ * Either probe the entry of each target page of the large page, or
+ * scan the whole table when it has fewer entries than that.
+ * Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_page_locked(CPUArchState *env, int midx,
+                                        target_ulong lp_addr,
+                                        target_ulong lp_mask)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    CPUTLBDescFast *f = &env_tlb(env)->f[midx];
+    size_t n_entries = (f->mask >> CPU_TLB_ENTRY_BITS) + 1;
+    target_ulong n_pages = (~lp_mask >> TARGET_PAGE_BITS) + 1;
+    target_ulong i;
+    int k;
+
+    if (n_pages <= n_entries) {
+        for (i = 0; i < n_pages; i++) {
+            target_ulong page = lp_addr + (i << TARGET_PAGE_BITS);
+
+            if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    } else {
+        for (i = 0; i < n_entries; i++) {
+            if (tlb_flush_entry_mask_locked(&f->table[i], lp_addr, lp_mask)) {
+                tlb_n_used_entries_dec(env, midx);
+            }
+        }
+    }
+
+    for (k = 0; k < CPU_VTLB_SIZE; k++) {
+        if (tlb_flush_entry_mask_locked(&d->vtable[k], lp_addr, lp_mask)) {
+            tlb_n_used_entries_dec(env, midx);
+        }
+    }
+}
+
+/*
+ * Extend the region described by large_page_addr/large_page_mask
+ * to include the large page at @vaddr/@lp_mask.
+ */
+static void tlb_large_page_region_add(CPUTLBDesc *d, target_ulong vaddr,
+                                      target_ulong lp_mask)
+{
+    target_ulong lp_addr = d->large_page_addr;
+
+    if (lp_addr == (target_ulong)-1) {
+        /* No previous large page.  */
+        lp_addr = vaddr;
+    } else {
+        /* Extend the existing region to include the new page.
+           This is a compromise between unnecessary flushes and
+           the cost of maintaining a full variable size TLB.  */
+        lp_mask &= d->large_page_mask;
+        while (((lp_addr ^ vaddr) & lp_mask) != 0) {
+            lp_mask <<= 1;
+        }
+    }
+    d->large_page_addr = lp_addr & lp_mask;
+    d->large_page_mask = lp_mask;
+}
+
+/*
+ * Flush the large pages containing @page, if they are tracked exactly.
+ * Returns false if the whole tlb has to be flushed instead.
+ * Called with tlb_c.lock held.
+ */
+static bool tlb_flush_large_pages_locked(CPUArchState *env, int midx,
+                                         target_ulong page)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    bool flushed = false;
+    int i;
+
+    if (d->n_large_pages < 0) {
+        return false;
+    }
+
+    for (i = 0; i < d->n_large_pages; ) {
+        CPUTLBLargePage *lp = &d->large_pages[i];
+
+        if ((page & lp->mask) == lp->addr) {
+            tlb_debug("flushing large page midx %d ("
+                      TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
+                      midx, lp->addr, lp->mask);
+            tlb_flush_large_page_locked(env, midx, lp->addr, lp->mask);
+            *lp = d->large_pages[--d->n_large_pages];
+            flushed = true;
+        } else {
+            i++;
+        }
+    }
+
+    if (flushed) {
+        /* Shrink the region to the remaining large pages.  */
+        d->large_page_addr = -1;
+        d->large_page_mask = -1;
+        for (i = 0; i < d->n_large_pages; i++) {
+            tlb_large_page_region_add(d, d->large_pages[i].addr,
+                                      d->large_pages[i].mask);
+        }
+        atomic_set(&env_tlb(env)->c.large_page_flush_count,
+                   env_tlb(env)->c.large_page_flush_count + 1);
+    }
+
+    /* @page may be outside of the large pages, within the region.  */
+    tlb_flush_vtlb_page_locked(env, midx, page);
+    if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
+        tlb_n_used_entries_dec(env, midx);
+    }
+    return true;
+}
+
 static void tlb_flush_page_locked(CPUArchState *env, int midx,
                                   target_ulong page)
 {
@@ -431,10 +589,15 @@ static void tlb_flush_page_locked(CPUArchState *env, int midx,
 
     /* Check if we need to flush due to large pages.  */
     if ((page & lp_mask) == lp_addr) {
+        if (tlb_flush_large_pages_locked(env, midx, page)) {
+            return;
+        }
         tlb_debug("forcing full flush midx %d ("
                   TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
                   midx, lp_addr, lp_mask);
         tlb_flush_one_mmuidx_locked(env, midx);
+        atomic_set(&env_tlb(env)->c.large_page_full_flush_count,
+                   env_tlb(env)->c.large_page_full_flush_count + 1);
     } else {
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
@@ -471,6 +634,9 @@ static void tlb_flush_page_by_mmuidx_async_work(CPUState *cpu,
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 
     tb_flush_jmp_cache(cpu, addr);
+
+    atomic_set(&env_tlb(env)->c.page_flush_count,
+               env_tlb(env)->c.page_flush_count + 1);
 }
 
 void tlb_flush_page_by_mmuidx(CPUState *cpu, target_ulong addr, uint16_t idxmap)
@@ -663,28 +829,36 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
+/* Our TLB does not support large pages, so remember the large pages
+   and flush all their entries if one of their pages is invalidated.
+   Past CPU_TLB_LARGE_PAGES of them, only remember the area covered by
    large pages and trigger a full TLB flush if these are invalidated.  */
 static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
                                target_ulong vaddr, target_ulong size)
 {
-    target_ulong lp_addr = env_tlb(env)->d[mmu_idx].large_page_addr;
+    CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
     target_ulong lp_mask = ~(size - 1);
+    target_ulong lp_addr = vaddr & lp_mask;
+    int i;
 
-    if (lp_addr == (target_ulong)-1) {
-        /* No previous large page.  */
-        lp_addr = vaddr;
-    } else {
-        /* Extend the existing region to include the new page.
-           This is a compromise between unnecessary flushes and
-           the cost of maintaining a full variable size TLB.  */
-        lp_mask &= env_tlb(env)->d[mmu_idx].large_page_mask;
-        while (((lp_addr ^ vaddr) & lp_mask) != 0) {
-            lp_mask <<= 1;
+    tlb_large_page_region_add(d, vaddr, lp_mask);
+
+    if (d->n_large_pages < 0) {
+        return;
+    }
+    for (i = 0; i < d->n_large_pages; i++) {
+        if (d->large_pages[i].addr == lp_addr &&
+            d->large_pages[i].mask == lp_mask) {
+            return;
         }
     }
-    env_tlb(env)->d[mmu_idx].large_page_addr = lp_addr & lp_mask;
-    env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
+    if (d->n_large_pages == CPU_TLB_LARGE_PAGES) {
+        d->n_large_pages = -1;
+        return;
+    }
+    d->large_pages[d->n_large_pages].addr = lp_addr;
+    d->large_pages[d->n_large_pages].mask = lp_mask;
+    d->n_large_pages++;
 }
 
 /* Add a new TLB entry. At most one entry for a given virtual address
@@ -916,7 +1090,8 @@ static uint64_t io_readx(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
     cpu->mem_io_vaddr = addr;
     cpu->mem_io_access_type = access_type;
 
-    if (mr->global_locking && !qemu_mutex_iothread_locked()) {
+    if (memory_region_needs_global_locking(mr, false) &&
+        !qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
         locked = true;
     }
@@ -960,7 +1135,8 @@ static void io_writex(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
     cpu->mem_io_vaddr = addr;
     cpu->mem_io_pc = retaddr;
 
-    if (mr->global_locking && !qemu_mutex_iothread_locked()) {
+    if (memory_region_needs_global_locking(mr, true) &&
+        !qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
         locked = true;
     }
@@ -1735,6 +1911,7 @@ void helper_be_stq_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
     HELPER(glue(glue(glue(atomic_ ## X, SUFFIX), END), _mmu))
 #define ATOMIC_MMU_DECLS NotDirtyInfo ndi
 #define ATOMIC_MMU_LOOKUP atomic_mmu_lookup(env, addr, oi, retaddr, &ndi)
+#define ATOMIC_MMU_LOOKUP_RO ATOMIC_MMU_LOOKUP
 #define ATOMIC_MMU_CLEANUP                              \
     do {                                                \
         if (unlikely(ndi.active)) {                     \
@@ -0,0 +1,230 @@
+/*
+ * Per-TB execution and translation statistics
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/tb-hash.h"
+#include "exec/tb-stats.h"
+#include "qemu/qht.h"
+
+#define TB_STATS_HTABLE_SIZE (1 << 12)
+
+bool tb_stats_enabled;
+
+static struct qht tb_stats_htable;
+
+static bool tb_stats_cmp(const void *ap, const void *bp)
+{
+    const TBStatistics *a = ap;
+    const TBStatistics *b = bp;
+
+    return a->phys_pc == b->phys_pc &&
+        a->pc == b->pc &&
+        a->cs_base == b->cs_base &&
+        a->flags == b->flags;
+}
+
+static void __attribute__((constructor)) tb_stats_init(void)
+{
+    qht_init(&tb_stats_htable, tb_stats_cmp, TB_STATS_HTABLE_SIZE,
+             QHT_MODE_AUTO_RESIZE);
+}
+
+static uint32_t tb_stats_hash(tb_page_addr_t phys_pc, target_ulong pc,
+                              uint32_t flags)
+{
+    return tb_hash_func(phys_pc, pc, flags, 0, 0);
+}
+
+/* Called from tb_gen_code, under rcu_read_lock.  */
+TBStatistics *tb_stats_get(tb_page_addr_t phys_pc, target_ulong pc,
+                           target_ulong cs_base, uint32_t flags)
+{
+    TBStatistics *s, *new;
+    uint32_t h = tb_stats_hash(phys_pc, pc, flags);
+    TBStatistics desc = {
+        .phys_pc = phys_pc,
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+    };
+    void *existing = NULL;
+
+    s = qht_lookup(&tb_stats_htable, &desc, h);
+    if (s) {
+        return s;
+    }
+
+    new = g_new0(TBStatistics, 1);
+    *new = desc;
+    /* Another vCPU may have translated the same block concurrently.  */
+    if (!qht_insert(&tb_stats_htable, new, h, &existing)) {
+        g_free(new);
+        return existing;
+    }
+    return new;
+}
+
+/*
+ * Like the CONFIG_PROFILER counters, these are not updated atomically:
+ * concurrent translations of the same block are rare, and the counters
+ * are only read for reporting.
+ */
+#define tb_stats_add(ptr, n) \
+    atomic_set__nocheck(ptr, atomic_read__nocheck(ptr) + (n))
+
+void tb_stats_record(TranslationBlock *tb, int ops, int spills)
+{
+    TBStatistics *s = tb->tb_stats;
+
+    tb_stats_add(&s->translations, 1);
+    tb_stats_add(&s->guest_insns, tb->icount);
+    tb_stats_add(&s->guest_bytes, tb->size);
+    tb_stats_add(&s->host_bytes, tb->tc.size);
+    tb_stats_add(&s->ops, ops);
+    tb_stats_add(&s->spills, spills);
+    atomic_set(&s->tb, tb);
+}
+
+void tb_stats_invalidate(TranslationBlock *tb)
+{
+    TBStatistics *s = tb->tb_stats;
+
+    tb_stats_add(&s->invalidations, 1);
+    atomic_cmpxchg(&s->tb, tb, NULL);
+}
+
+static void tb_stats_flush_iter(void *p, uint32_t hash, void *userp)
+{
+    TBStatistics *s = p;
+
+    atomic_set(&s->tb, NULL);
+}
+
+/* Called from do_tb_flush, with all vCPUs stopped.  */
+void tb_stats_flush(void)
+{
+    qht_iter(&tb_stats_htable, tb_stats_flush_iter, NULL);
+}
+
+/*
+ * Blocks that are already translated keep their counters (or lack thereof)
+ * until they are retranslated, so flush the code cache on every change.
+ */
+void tb_stats_set_enabled(bool enable)
+{
+    if (tb_stats_collection_enabled() == enable) {
+        return;
+    }
+    atomic_set(&tb_stats_enabled, enable);
+    if (first_cpu) {
+        tb_flush(first_cpu);
+    }
+}
+
+static void tb_stats_reset_iter(void *p, uint32_t hash, void *userp)
+{
+    TBStatistics *s = p;
+
+    atomic_set__nocheck(&s->exec_count, 0);
+    atomic_set__nocheck(&s->translations, 0);
+    atomic_set__nocheck(&s->invalidations, 0);
+    atomic_set__nocheck(&s->guest_insns, 0);
+    atomic_set__nocheck(&s->guest_bytes, 0);
+    atomic_set__nocheck(&s->host_bytes, 0);
+    atomic_set__nocheck(&s->ops, 0);
+    atomic_set__nocheck(&s->spills, 0);
+}
+
+void tb_stats_reset(void)
+{
+    qht_iter(&tb_stats_htable, tb_stats_reset_iter, NULL);
+}
+
+static void tb_stats_collect_iter(void *p, uint32_t hash, void *userp)
+{
+    TBStatistics *s = p;
+    GPtrArray *arr = userp;
+
+    if (atomic_read__nocheck(&s->exec_count) ||
+        atomic_read__nocheck(&s->translations)) {
+        g_ptr_array_add(arr, s);
+    }
+}
+
+static uint64_t tb_stats_expansion(const TBStatistics *s)
+{
+    uint64_t guest_bytes = atomic_read__nocheck(&s->guest_bytes);
+    uint64_t host_bytes = atomic_read__nocheck(&s->host_bytes);
+
+    /* Host bytes per guest byte, in hundredths.  */
+    return guest_bytes ? host_bytes * 100 / guest_bytes : 0;
+}
+
+static gint tb_stats_cmp_exec_count(gconstpointer ap, gconstpointer bp)
+{
+    const TBStatistics *a = *(const TBStatistics **)ap;
+    const TBStatistics *b = *(const TBStatistics **)bp;
+    uint64_t ac = atomic_read__nocheck(&a->exec_count);
+    uint64_t bc = atomic_read__nocheck(&b->exec_count);
+
+    return ac < bc ? 1 : ac > bc ? -1 : 0;
+}
+
+static gint tb_stats_cmp_translations(gconstpointer ap, gconstpointer bp)
+{
+    const TBStatistics *a = *(const TBStatistics **)ap;
+    const TBStatistics *b = *(const TBStatistics **)bp;
+    uint64_t ac = atomic_read__nocheck(&a->translations);
+    uint64_t bc = atomic_read__nocheck(&b->translations);
+
+    return ac < bc ? 1 : ac > bc ? -1 : 0;
+}
+
+static gint tb_stats_cmp_expansion(gconstpointer ap, gconstpointer bp)
+{
+    const TBStatistics *a = *(const TBStatistics **)ap;
+    const TBStatistics *b = *(const TBStatistics **)bp;
+    uint64_t ac = tb_stats_expansion(a);
+    uint64_t bc = tb_stats_expansion(b);
+
+    return ac < bc ? 1 : ac > bc ? -1 : 0;
+}
+
+/*
+ * Return up to @max entries, sorted by @sort_by in decreasing order.
+ * The entries are never freed, so they remain valid after the call;
+ * free the array with g_ptr_array_free(arr, true).
+ */
+GPtrArray *tb_stats_sorted(TbStatsSortBy sort_by, int max)
+{
+    GPtrArray *arr = g_ptr_array_new();
+    GCompareFunc cmp;
+
+    switch (sort_by) {
+    case TB_STATS_SORT_BY_EXEC_COUNT:
+        cmp = tb_stats_cmp_exec_count;
+        break;
+    case TB_STATS_SORT_BY_TRANSLATIONS:
+        cmp = tb_stats_cmp_translations;
+        break;
+    case TB_STATS_SORT_BY_EXPANSION:
+        cmp = tb_stats_cmp_expansion;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    qht_iter(&tb_stats_htable, tb_stats_collect_iter, arr);
+
+    g_ptr_array_sort(arr, cmp);
+    if (max > 0 && arr->len > max) {
+        g_ptr_array_set_size(arr, max);
+    }
+    return arr;
+}
@@ -144,7 +144,7 @@ uint64_t HELPER(ctpop_i64)(uint64_t arg)
     return ctpop64(arg);
 }
 
-void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+static TranslationBlock *lookup_tb(CPUArchState *env)
 {
     CPUState *cpu = env_cpu(env);
     TranslationBlock *tb;
@@ -153,13 +153,38 @@ void *HELPER(lookup_tb_ptr)(CPUArchState *env)
 
     tb = tb_lookup__cpu_state(cpu, &pc, &cs_base, &flags, curr_cflags());
     if (tb == NULL) {
-        return tcg_ctx->code_gen_epilogue;
+        return NULL;
     }
     qemu_log_mask_and_addr(CPU_LOG_EXEC, pc,
                            "Chain %d: %p ["
                            TARGET_FMT_lx "/" TARGET_FMT_lx "/%#x] %s\n",
                            cpu->cpu_index, tb->tc.ptr, cs_base, pc, flags,
                            lookup_symbol(pc));
+    return tb;
+}
+
+void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+{
+    TranslationBlock *tb = lookup_tb(env);
+
+    return tb ? tb->tc.ptr : tcg_ctx->code_gen_epilogue;
+}
+
+/*
+ * Slow path of translator_lookup_and_goto_ptr, taken when the block
+ * cached for the branch site in cpu->tb_ibtc[@slot] does not match.
+ */
+void *HELPER(lookup_tb_ptr_ibtc)(CPUArchState *env, uint32_t slot)
+{
+    TranslationBlock *tb = lookup_tb(env);
+
+#ifdef CONFIG_PROFILER
+    atomic_set(&tcg_ctx->prof.ibtc_misses, tcg_ctx->prof.ibtc_misses + 1);
+#endif
+    if (tb == NULL) {
+        return tcg_ctx->code_gen_epilogue;
+    }
+    atomic_set(&env_cpu(env)->tb_ibtc[slot], tb);
     return tb->tc.ptr;
 }
 
@@ -48,6 +48,7 @@
 
 #include "exec/cputlb.h"
 #include "exec/tb-hash.h"
+#include "exec/tb-stats.h"
 #include "translate-all.h"
 #include "qemu/bitmap.h"
 #include "qemu/error-report.h"
@@ -108,6 +109,13 @@ typedef struct PageDesc {
        of lookups we do to a given page to use a bitmap */
     unsigned long *code_bitmap;
     unsigned int code_write_count;
+    /* TBs were removed since the bitmap was built, so it may have
+       stray bits set; it is rebuilt when a write hits one of them */
+    bool code_bitmap_stale;
+    /* writes to the page while it held TBs, and how many of them
+       invalidated code; summed over all pages by "info tb" */
+    unsigned int smc_writes;
+    unsigned int smc_invalidations;
 #else
     unsigned long flags;
 #endif
@@ -1181,6 +1189,23 @@ static inline void invalidate_page_bitmap(PageDesc *p)
     g_free(p->code_bitmap);
     p->code_bitmap = NULL;
     p->code_write_count = 0;
+    p->code_bitmap_stale = false;
+#endif
+}
+
+/*
+ * Like invalidate_page_bitmap, but for when TBs are removed from the page:
+ * the bitmap is kept, because the bits of the remaining TBs are still set.
+ *
+ * call with @p->lock held
+ */
+static inline void page_bitmap_remove_tb(PageDesc *p)
+{
+    assert_page_locked(p);
+#ifdef CONFIG_SOFTMMU
+    if (p->code_bitmap) {
+        p->code_bitmap_stale = true;
+    }
 #endif
 }
 
@@ -1254,6 +1279,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     page_flush_tb();
+    tb_stats_flush();
 
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is
@@ -1447,16 +1473,19 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
         !qht_remove(&tb_ctx.htable, tb, h)) {
         return;
     }
+    if (tb->tb_stats) {
+        tb_stats_invalidate(tb);
+    }
 
     /* remove the TB from the page list */
     if (rm_from_page_list) {
         p = page_find(tb->page_addr[0] >> TARGET_PAGE_BITS);
         tb_page_remove(p, tb);
-        invalidate_page_bitmap(p);
+        page_bitmap_remove_tb(p);
         if (tb->page_addr[1] != -1) {
             p = page_find(tb->page_addr[1] >> TARGET_PAGE_BITS);
             tb_page_remove(p, tb);
-            invalidate_page_bitmap(p);
+            page_bitmap_remove_tb(p);
         }
     }
 
@@ -1500,30 +1529,52 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
 }
 
 #ifdef CONFIG_SOFTMMU
+/* call with @p->lock held */
+static void page_bitmap_set_tb(PageDesc *p, TranslationBlock *tb, int n)
+{
+    int tb_start, tb_end;
+
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    if (n == 0) {
+        /* NOTE: tb_end may be after the end of the page, but
+           it is not a problem */
+        tb_start = tb->pc & ~TARGET_PAGE_MASK;
+        tb_end = tb_start + tb->size;
+        if (tb_end > TARGET_PAGE_SIZE) {
+            tb_end = TARGET_PAGE_SIZE;
+        }
+    } else {
+        tb_start = 0;
+        tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
+    }
+    bitmap_set(p->code_bitmap, tb_start, tb_end - tb_start);
+}
+
+/* call with @p->lock held */
+static inline bool page_bitmap_test(PageDesc *p, unsigned int nr, int len)
+{
+    unsigned long b;
+
+    b = p->code_bitmap[BIT_WORD(nr)] >> (nr & (BITS_PER_LONG - 1));
+    return b & ((1 << len) - 1);
+}
+
 /* call with @p->lock held */
 static void build_page_bitmap(PageDesc *p)
 {
-    int n, tb_start, tb_end;
+    int n;
     TranslationBlock *tb;
 
     assert_page_locked(p);
-    p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+    if (p->code_bitmap) {
+        bitmap_zero(p->code_bitmap, TARGET_PAGE_SIZE);
+    } else {
+        p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+    }
+    p->code_bitmap_stale = false;
 
     PAGE_FOR_EACH_TB(p, tb, n) {
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        if (n == 0) {
-            /* NOTE: tb_end may be after the end of the page, but
-               it is not a problem */
-            tb_start = tb->pc & ~TARGET_PAGE_MASK;
-            tb_end = tb_start + tb->size;
-            if (tb_end > TARGET_PAGE_SIZE) {
-                tb_end = TARGET_PAGE_SIZE;
-             }
-        } else {
-            tb_start = 0;
-            tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
-        }
-        bitmap_set(p->code_bitmap, tb_start, tb_end - tb_start);
+        page_bitmap_set_tb(p, tb, n);
     }
 }
 #endif
@@ -1548,7 +1599,13 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
     page_already_protected = p->first_tb != (uintptr_t)NULL;
 #endif
     p->first_tb = (uintptr_t)tb | n;
-    invalidate_page_bitmap(p);
+#ifdef CONFIG_SOFTMMU
+    /* keep the bitmap across translations, so that writes to data
+       next to the code do not have to walk the TBs again */
+    if (p->code_bitmap) {
+        page_bitmap_set_tb(p, tb, n);
+    }
+#endif
 
 #if defined(CONFIG_USER_ONLY)
     if (p->flags & PAGE_WRITE) {
@@ -1644,10 +1701,10 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
         /* remove TB from the page(s) if we couldn't insert it */
         if (unlikely(existing_tb)) {
             tb_page_remove(p, tb);
-            invalidate_page_bitmap(p);
+            page_bitmap_remove_tb(p);
             if (p2) {
                 tb_page_remove(p2, tb);
-                invalidate_page_bitmap(p2);
+                page_bitmap_remove_tb(p2);
             }
             tb = existing_tb;
         }
@@ -1723,6 +1780,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->flags = flags;
     tb->cflags = cflags;
     tb->trace_vcpu_dstate = *cpu->trace_dstate;
+    tb->sb_countdown = TB_SUPERBLOCK_THRESHOLD;
+    tb->tb_stats = NULL;
+    if (tb_stats_collection_enabled() && !(cflags & CF_NOCACHE)) {
+        tb->tb_stats = tb_stats_get(phys_pc, pc, cs_base, flags);
+    }
     tcg_ctx->tb_cflags = cflags;
  tb_overflow:
 
@@ -1876,6 +1938,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         atomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
         return existing_tb;
     }
+    if (tb->tb_stats) {
+        tb_stats_record(tb, tcg_ctx->nb_ops, tcg_ctx->nb_spills);
+    }
     tcg_tb_insert(tb);
     return tb;
 }
@@ -1893,6 +1958,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
 {
     TranslationBlock *tb;
     tb_page_addr_t tb_start, tb_end;
+    bool removed = false;
     int n;
 #ifdef TARGET_HAS_PRECISE_SMC
     CPUState *cpu = current_cpu;
@@ -1954,12 +2020,25 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
             }
 #endif /* TARGET_HAS_PRECISE_SMC */
             tb_phys_invalidate__locked(tb);
+            removed = true;
         }
     }
+#ifdef CONFIG_SOFTMMU
+    if (removed && is_cpu_write_access) {
+        atomic_set(&p->smc_invalidations, p->smc_invalidations + 1);
+    }
+#endif
 #if !defined(CONFIG_USER_ONLY)
     /* if no code remaining, no need to continue to use slow writes */
     if (!p->first_tb) {
-        invalidate_page_bitmap(p);
+#ifdef CONFIG_SOFTMMU
+        /* keep an empty bitmap: a page that was written to often enough
+           to get one will likely be again once new code is placed there */
+        if (p->code_bitmap) {
+            bitmap_zero(p->code_bitmap, TARGET_PAGE_SIZE);
+            p->code_bitmap_stale = false;
+        }
+#endif
         tlb_unprotect_code(start);
     }
 #endif
@@ -2056,23 +2135,26 @@ void tb_invalidate_phys_page_fast(struct page_collection *pages,
     }
 
     assert_page_locked(p);
+    atomic_set(&p->smc_writes, p->smc_writes + 1);
     if (!p->code_bitmap &&
         ++p->code_write_count >= SMC_BITMAP_USE_THRESHOLD) {
         build_page_bitmap(p);
     }
     if (p->code_bitmap) {
-        unsigned int nr;
-        unsigned long b;
+        unsigned int nr = start & ~TARGET_PAGE_MASK;
 
-        nr = start & ~TARGET_PAGE_MASK;
-        b = p->code_bitmap[BIT_WORD(nr)] >> (nr & (BITS_PER_LONG - 1));
-        if (b & ((1 << len) - 1)) {
-            goto do_invalidate;
+        if (!page_bitmap_test(p, nr, len)) {
+            return;
+        }
+        /* the bits may belong to TBs that are gone; look again */
+        if (p->code_bitmap_stale) {
+            build_page_bitmap(p);
+            if (!page_bitmap_test(p, nr, len)) {
+                return;
+            }
         }
-    } else {
-    do_invalidate:
-        tb_invalidate_phys_page_range__locked(pages, p, start, start + len, 1);
     }
+    tb_invalidate_phys_page_range__locked(pages, p, start, start + len, 1);
 }
 #else
 /* Called with mmap_lock held. If pc is not 0 then it indicates the
@@ -2246,12 +2328,35 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
     }
 }
 
+/*
+ * The indirect branch target cache is indexed by branch site, so look at
+ * the cached blocks themselves.  They are only freed by tb_flush, which
+ * also clears the cache, so they can be dereferenced here.
+ */
+static void tb_ibtc_clear_page(CPUState *cpu, target_ulong page_addr)
+{
+    unsigned int i;
+
+    for (i = 0; i < TB_IBTC_SIZE; i++) {
+        TranslationBlock *tb = atomic_read(&cpu->tb_ibtc[i]);
+        target_ulong page;
+
+        if (tb) {
+            page = tb->pc & TARGET_PAGE_MASK;
+            if (page == page_addr || page == page_addr - TARGET_PAGE_SIZE) {
+                atomic_set(&cpu->tb_ibtc[i], NULL);
+            }
+        }
+    }
+}
+
 void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
 {
     /* Discard jump cache entries for any tb which might potentially
        overlap the flushed page.  */
     tb_jmp_cache_clear_page(cpu, addr - TARGET_PAGE_SIZE);
     tb_jmp_cache_clear_page(cpu, addr);
+    tb_ibtc_clear_page(cpu, addr);
 }
 
 static void print_qht_statistics(struct qht_stats hst)
@@ -2324,11 +2429,98 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     return false;
 }
 
+#define SMC_TOP_PAGES 8
+
+struct smc_page_stats {
+    size_t writes;
+    size_t invalidations;
+    size_t nb_pages;
+    tb_page_addr_t addr[SMC_TOP_PAGES];
+    unsigned int writes[SMC_TOP_PAGES];
+    unsigned int invalidations[SMC_TOP_PAGES];
+};
+
+static void smc_page_stats_add(struct smc_page_stats *st, tb_page_addr_t addr,
+                               unsigned int writes, unsigned int invalidations)
+{
+    int i = MIN(st->nb_pages, SMC_TOP_PAGES);
+
+    st->nb_pages++;
+    /* keep the pages sorted by decreasing number of invalidations */
+    while (i > 0 && st->invalidations[i - 1] < invalidations) {
+        if (i < SMC_TOP_PAGES) {
+            st->addr[i] = st->addr[i - 1];
+            st->writes[i] = st->writes[i - 1];
+            st->invalidations[i] = st->invalidations[i - 1];
+        }
+        i--;
+    }
+    if (i < SMC_TOP_PAGES) {
+        st->addr[i] = addr;
+        st->writes[i] = writes;
+        st->invalidations[i] = invalidations;
+    }
+}
+
+static void smc_page_stats_1(struct smc_page_stats *st, int level, void **lp,
+                             tb_page_addr_t index)
+{
+    int i;
+
+    if (*lp == NULL) {
+        return;
+    }
+    if (level == 0) {
+        PageDesc *pd = *lp;
+
+        for (i = 0; i < V_L2_SIZE; ++i) {
+            unsigned int writes = atomic_read(&pd[i].smc_writes);
+            unsigned int invalidations = atomic_read(&pd[i].smc_invalidations);
+
+            st->writes += writes;
+            st->invalidations += invalidations;
+            if (invalidations) {
+                smc_page_stats_add(st, (index | i) << TARGET_PAGE_BITS,
+                                   writes, invalidations);
+            }
+        }
+    } else {
+        void **pp = *lp;
+
+        for (i = 0; i < V_L2_SIZE; ++i) {
+            tb_page_addr_t idx = (tb_page_addr_t)i << (V_L2_BITS * level);
+
+            smc_page_stats_1(st, level - 1, pp + i, index | idx);
+        }
+    }
+}
+
+static void dump_smc_info(void)
+{
+    struct smc_page_stats st = {};
+    int i;
+
+    for (i = 0; i < v_l1_size; i++) {
+        smc_page_stats_1(&st, v_l2_levels, l1_map + i,
+                         (tb_page_addr_t)i << v_l1_shift);
+    }
+
+    qemu_printf("SMC page writes     %zu\n", st.writes);
+    qemu_printf("SMC invalidations   %zu (%zu pages)\n",
+                st.invalidations, st.nb_pages);
+    for (i = 0; i < MIN(st.nb_pages, SMC_TOP_PAGES); i++) {
+        qemu_printf("  page 0x" RAM_ADDR_FMT " invalidations %u writes %u\n",
+                    st.addr[i], st.invalidations[i],
+                    st.writes[i]);
+    }
+}
+
 void dump_exec_info(void)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t flush_page, flush_large, flush_large_full;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -2370,6 +2562,11 @@ void dump_exec_info(void)
     qemu_printf("TLB full flushes    %zu\n", flush_full);
     qemu_printf("TLB partial flushes %zu\n", flush_part);
     qemu_printf("TLB elided flushes  %zu\n", flush_elide);
+    tlb_flush_page_counts(&flush_page, &flush_large, &flush_large_full);
+    qemu_printf("TLB page flushes    %zu\n", flush_page);
+    qemu_printf("TLB large page flushes %zu (%zu forced full flushes)\n",
+                flush_large, flush_large_full);
+    dump_smc_info();
     tcg_dump_info();
 }
 
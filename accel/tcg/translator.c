@@ -16,6 +16,7 @@
 #include "exec/gen-icount.h"
 #include "exec/log.h"
 #include "exec/translator.h"
+#include "exec/tb-hash.h"
 
 /* Pairs with tcg_clear_temp_count.
    To be called by #TranslatorOps.{translate_insn,tb_stop} if
@@ -30,6 +31,107 @@ void translator_loop_temp_check(DisasContextBase *db)
     }
 }
 
+/* Bound the code duplication caused by following jumps backwards.  */
+#define TB_SUPERBLOCK_MAX_JUMPS 8
+
+bool translator_follow_jump(DisasContextBase *db, target_ulong insn_end,
+                            target_ulong dest)
+{
+    if (!(tb_cflags(db->tb) & CF_SUPERBLOCK)
+        || db->singlestep_enabled
+        || db->sb_jumps >= TB_SUPERBLOCK_MAX_JUMPS
+        || db->num_insns >= db->max_insns
+        || tcg_op_buf_full()) {
+        return false;
+    }
+    if (dest < db->pc_first
+        || (dest & TARGET_PAGE_MASK) != (db->pc_first & TARGET_PAGE_MASK)) {
+        return false;
+    }
+    db->sb_jumps++;
+    db->pc_max = MAX(db->pc_max, insn_end);
+    return true;
+}
+
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv dest)
+{
+    TranslationBlock *tb = db->tb;
+    uint32_t cflags = tb_cflags(tb);
+    unsigned int slot = tb_ibtc_hash_func(db->pc_next);
+    TCGLabel *miss;
+    TCGv_ptr cached;
+    TCGv pc, t;
+    TCGv_i32 t32;
+
+    /*
+     * The blocks found by the probe are checked against the cflags of
+     * this block, which must therefore be those used for lookups.
+     */
+    if (!TCG_TARGET_HAS_goto_ptr
+        || qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)
+        || (cflags & (CF_COUNT_MASK | CF_LAST_IO | CF_NOCACHE))) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+
+    miss = gen_new_label();
+    pc = tcg_temp_local_new();
+    cached = tcg_temp_local_new_ptr();
+    tcg_gen_mov_tl(pc, dest);
+    tcg_gen_ld_ptr(cached, cpu_env,
+                   offsetof(ArchCPU, parent_obj.tb_ibtc[slot]) -
+                   offsetof(ArchCPU, env));
+    tcg_gen_brcondi_ptr(TCG_COND_EQ, cached, 0, miss);
+
+    t = tcg_temp_new();
+    tcg_gen_ld_tl(t, cached, offsetof(TranslationBlock, pc));
+    tcg_gen_brcond_tl(TCG_COND_NE, t, pc, miss);
+    tcg_temp_free(t);
+
+    t = tcg_temp_new();
+    tcg_gen_ld_tl(t, cached, offsetof(TranslationBlock, cs_base));
+    tcg_gen_brcondi_tl(TCG_COND_NE, t, tb->cs_base, miss);
+    tcg_temp_free(t);
+
+    t32 = tcg_temp_new_i32();
+    tcg_gen_ld_i32(t32, cached, offsetof(TranslationBlock, flags));
+    tcg_gen_brcondi_i32(TCG_COND_NE, t32, tb->flags, miss);
+    tcg_temp_free_i32(t32);
+
+    t32 = tcg_temp_new_i32();
+    tcg_gen_ld_i32(t32, cached, offsetof(TranslationBlock, cflags));
+    tcg_gen_andi_i32(t32, t32, CF_HASH_MASK | CF_INVALID);
+    tcg_gen_brcondi_i32(TCG_COND_NE, t32,
+                        cflags & (CF_PARALLEL | CF_USE_ICOUNT |
+                                  CF_CLUSTER_MASK), miss);
+    tcg_temp_free_i32(t32);
+
+#ifdef CONFIG_PROFILER
+    {
+        TCGv_ptr prof = tcg_const_ptr(&tcg_ctx->prof.ibtc_hits);
+        TCGv_i64 hits = tcg_temp_new_i64();
+
+        tcg_gen_ld_i64(hits, prof, 0);
+        tcg_gen_addi_i64(hits, hits, 1);
+        tcg_gen_st_i64(hits, prof, 0);
+        tcg_temp_free_i64(hits);
+        tcg_temp_free_ptr(prof);
+    }
+#endif
+
+    tcg_gen_ld_ptr(cached, cached, offsetof(TranslationBlock, tc.ptr));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(cached));
+
+    gen_set_label(miss);
+    t32 = tcg_const_i32(slot);
+    gen_helper_lookup_tb_ptr_ibtc(cached, cpu_env, t32);
+    tcg_temp_free_i32(t32);
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(cached));
+
+    tcg_temp_free_ptr(cached);
+    tcg_temp_free(pc);
+}
+
 void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
                      CPUState *cpu, TranslationBlock *tb, int max_insns)
 {
@@ -43,6 +145,8 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     db->num_insns = 0;
     db->max_insns = max_insns;
     db->singlestep_enabled = cpu->singlestep_enabled;
+    db->pc_max = db->pc_first;
+    db->sb_jumps = 0;
 
     ops->init_disas_context(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
@@ -112,7 +216,8 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     gen_tb_end(db->tb, db->num_insns - bp_insn);
 
     /* The disas_log hook may use these values rather than recompute.  */
-    db->tb->size = db->pc_next - db->pc_first;
+    db->pc_max = MAX(db->pc_max, db->pc_next);
+    db->tb->size = db->pc_max - db->pc_first;
     db->tb->icount = db->num_insns;
 
 #ifdef DEBUG_DISAS
@@ -747,6 +747,23 @@ static void *atomic_mmu_lookup(CPUArchState *env, target_ulong addr,
     return ret;
 }
 
+#if HAVE_ATOMIC128 || HAVE_CMPXCHG128
+/*
+ * Return the host address for a 16-byte atomic load.  Unless the host
+ * has a true 128-bit atomic load, atomic16_read stores to memory, which
+ * would fault on a page the guest may only read.  Only in that case fall
+ * back to stop-the-world, where the load need not be atomic.
+ */
+static void *atomic_mmu_lookup_ro(CPUArchState *env, target_ulong addr,
+                                  int size, uintptr_t retaddr)
+{
+    if (!HAVE_ATOMIC128_RO && !(page_get_flags(addr) & PAGE_WRITE_ORG)) {
+        cpu_loop_exit_atomic(env_cpu(env), retaddr);
+    }
+    return atomic_mmu_lookup(env, addr, size, retaddr);
+}
+#endif
+
 /* Macro to call the above, with local variables from the use context.  */
 #define ATOMIC_MMU_DECLS do {} while (0)
 #define ATOMIC_MMU_LOOKUP  atomic_mmu_lookup(env, addr, DATA_SIZE, GETPC())
@@ -782,6 +799,8 @@ static void *atomic_mmu_lookup(CPUArchState *env, target_ulong addr,
 #define ATOMIC_NAME(X) \
     HELPER(glue(glue(glue(atomic_ ## X, SUFFIX), END), _mmu))
 #define ATOMIC_MMU_LOOKUP  atomic_mmu_lookup(env, addr, DATA_SIZE, retaddr)
+#define ATOMIC_MMU_LOOKUP_RO \
+    atomic_mmu_lookup_ro(env, addr, DATA_SIZE, retaddr)
 
 #define DATA_SIZE 16
 #include "atomic_template.h"
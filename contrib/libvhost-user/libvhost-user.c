@@ -476,6 +476,169 @@ vu_kick_cb(VuDev *dev, int condition, void *data)
     }
 }
 
+struct VuQueueWorker {
+    VuDev *dev;
+    int qidx;
+    int kick_fd;
+    /* Written by vu_queue_unwatch() to wake the worker up */
+    int stop_fd;
+    bool stop;
+    pthread_t thread;
+    struct VuQueueWorker *next;
+};
+
+static void *
+vu_queue_worker_run(void *opaque)
+{
+    struct VuQueueWorker *w = opaque;
+    VuDev *dev = w->dev;
+    struct pollfd pfd[2] = {
+        { .fd = w->kick_fd, .events = POLLIN },
+        { .fd = w->stop_fd, .events = POLLIN },
+    };
+    eventfd_t kick_data;
+    VuVirtq *vq;
+
+    for (;;) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            vu_panic(dev, "kick poll(): %s", strerror(errno));
+            break;
+        }
+
+        pthread_rwlock_rdlock(&dev->lock);
+        /*
+         * The kick fd is only closed with the write lock held and after
+         * setting w->stop, so it is still ours if w->stop is clear.
+         */
+        if (atomic_read(&w->stop)) {
+            pthread_rwlock_unlock(&dev->lock);
+            break;
+        }
+        if (eventfd_read(w->kick_fd, &kick_data) == -1) {
+            if (errno == EAGAIN) {
+                pthread_rwlock_unlock(&dev->lock);
+                continue;
+            }
+            vu_panic(dev, "kick eventfd_read(): %s", strerror(errno));
+            pthread_rwlock_unlock(&dev->lock);
+            break;
+        }
+
+        vq = &dev->vq[w->qidx];
+        DPRINT("Got kick_data: %016"PRIx64" handler:%p idx:%d\n",
+               kick_data, vq->handler, w->qidx);
+        if (vq->handler) {
+            vq->handler(dev, w->qidx);
+        }
+        pthread_rwlock_unlock(&dev->lock);
+    }
+
+    return NULL;
+}
+
+static void
+vu_queue_worker_start(VuDev *dev, VuVirtq *vq)
+{
+    struct VuQueueWorker *w;
+    int rc;
+
+    w = calloc(1, sizeof(*w));
+    if (!w) {
+        vu_panic(dev, "failed to allocate queue worker");
+        return;
+    }
+
+    w->dev = dev;
+    w->qidx = vq - dev->vq;
+    w->kick_fd = vq->kick_fd;
+    w->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (w->stop_fd == -1) {
+        vu_panic(dev, "worker eventfd(): %s", strerror(errno));
+        free(w);
+        return;
+    }
+
+    rc = pthread_create(&w->thread, NULL, vu_queue_worker_run, w);
+    if (rc) {
+        vu_panic(dev, "pthread_create(): %s", strerror(rc));
+        close(w->stop_fd);
+        free(w);
+        return;
+    }
+
+    vq->worker = w;
+}
+
+/* Wait for stopped workers to exit, must not hold the write lock */
+static void
+vu_queue_workers_reap(VuDev *dev)
+{
+    struct VuQueueWorker *w, *next;
+
+    pthread_mutex_lock(&dev->reap_lock);
+    w = dev->reap_list;
+    dev->reap_list = NULL;
+    pthread_mutex_unlock(&dev->reap_lock);
+
+    for (; w; w = next) {
+        next = w->next;
+        pthread_join(w->thread, NULL);
+        close(w->stop_fd);
+        free(w);
+    }
+}
+
+/* Start waiting for kicks on vq->kick_fd */
+static void
+vu_queue_watch(VuDev *dev, VuVirtq *vq)
+{
+    if (!dev->threaded) {
+        dev->set_watch(dev, vq->kick_fd, VU_WATCH_IN,
+                       vu_kick_cb, (void *)(long)(vq - dev->vq));
+        return;
+    }
+
+    if (vq->worker && vq->worker->kick_fd == vq->kick_fd) {
+        return;
+    }
+    assert(!vq->worker);
+    vu_queue_worker_start(dev, vq);
+}
+
+/*
+ * Stop waiting for kicks on vq->kick_fd.  A worker may still be running
+ * the handler; it won't touch the queue again once it returns, and
+ * exits before the next vu_dispatch() or vu_deinit() returns.
+ */
+static void
+vu_queue_unwatch(VuDev *dev, VuVirtq *vq)
+{
+    struct VuQueueWorker *w = vq->worker;
+
+    if (!dev->threaded) {
+        dev->remove_watch(dev, vq->kick_fd);
+        return;
+    }
+
+    if (!w) {
+        return;
+    }
+    vq->worker = NULL;
+
+    atomic_set(&w->stop, true);
+    if (eventfd_write(w->stop_fd, 1) < 0) {
+        vu_panic(dev, "Error writing eventfd: %s", strerror(errno));
+    }
+
+    pthread_mutex_lock(&dev->reap_lock);
+    w->next = dev->reap_list;
+    dev->reap_list = w;
+    pthread_mutex_unlock(&dev->reap_lock);
+}
+
 static bool
 vu_get_features_exec(VuDev *dev, VhostUserMsg *vmsg)
 {
@@ -908,7 +1071,7 @@ vu_get_vring_base_exec(VuDev *dev, VhostUserMsg *vmsg)
         dev->vq[index].call_fd = -1;
     }
     if (dev->vq[index].kick_fd != -1) {
-        dev->remove_watch(dev, dev->vq[index].kick_fd);
+        vu_queue_unwatch(dev, &dev->vq[index]);
         close(dev->vq[index].kick_fd);
         dev->vq[index].kick_fd = -1;
     }
@@ -1033,7 +1196,7 @@ vu_set_vring_kick_exec(VuDev *dev, VhostUserMsg *vmsg)
     }
 
     if (dev->vq[index].kick_fd != -1) {
-        dev->remove_watch(dev, dev->vq[index].kick_fd);
+        vu_queue_unwatch(dev, &dev->vq[index]);
         close(dev->vq[index].kick_fd);
         dev->vq[index].kick_fd = -1;
     }
@@ -1047,8 +1210,7 @@ vu_set_vring_kick_exec(VuDev *dev, VhostUserMsg *vmsg)
     }
 
     if (dev->vq[index].kick_fd != -1 && dev->vq[index].handler) {
-        dev->set_watch(dev, dev->vq[index].kick_fd, VU_WATCH_IN,
-                       vu_kick_cb, (void *)(long)index);
+        vu_queue_watch(dev, &dev->vq[index]);
 
         DPRINT("Waiting for kicks on fd: %d for vq: %d\n",
                dev->vq[index].kick_fd, index);
@@ -1064,15 +1226,12 @@ vu_set_vring_kick_exec(VuDev *dev, VhostUserMsg *vmsg)
 void vu_set_queue_handler(VuDev *dev, VuVirtq *vq,
                           vu_queue_handler_cb handler)
 {
-    int qidx = vq - dev->vq;
-
     vq->handler = handler;
     if (vq->kick_fd >= 0) {
         if (handler) {
-            dev->set_watch(dev, vq->kick_fd, VU_WATCH_IN,
-                           vu_kick_cb, (void *)(long)qidx);
+            vu_queue_watch(dev, vq);
         } else {
-            dev->remove_watch(dev, vq->kick_fd);
+            vu_queue_unwatch(dev, vq);
         }
     }
 }
@@ -1556,7 +1715,14 @@ vu_dispatch(VuDev *dev)
         goto end;
     }
 
+    if (dev->threaded) {
+        pthread_rwlock_wrlock(&dev->lock);
+    }
     reply_requested = vu_process_message(dev, &vmsg);
+    if (dev->threaded) {
+        pthread_rwlock_unlock(&dev->lock);
+        vu_queue_workers_reap(dev);
+    }
     if (!reply_requested) {
         success = true;
         goto end;
@@ -1578,6 +1744,13 @@ vu_deinit(VuDev *dev)
 {
     int i;
 
+    if (dev->threaded) {
+        for (i = 0; i < dev->max_queues; i++) {
+            vu_queue_unwatch(dev, &dev->vq[i]);
+        }
+    }
+    vu_queue_workers_reap(dev);
+
     for (i = 0; i < dev->nregions; i++) {
         VuDevRegion *r = &dev->regions[i];
         void *m = (void *) (uintptr_t) r->mmap_addr;
@@ -1635,6 +1808,36 @@ vu_deinit(VuDev *dev)
 
     free(dev->vq);
     dev->vq = NULL;
+
+    pthread_rwlock_destroy(&dev->lock);
+    pthread_mutex_destroy(&dev->reap_lock);
+}
+
+void
+vu_set_threaded(VuDev *dev, bool threaded)
+{
+    int i;
+
+    for (i = 0; i < dev->max_queues; i++) {
+        assert(dev->vq[i].kick_fd == -1);
+    }
+    dev->threaded = threaded;
+}
+
+void
+vu_read_lock(VuDev *dev)
+{
+    if (dev->threaded) {
+        pthread_rwlock_rdlock(&dev->lock);
+    }
+}
+
+void
+vu_read_unlock(VuDev *dev)
+{
+    if (dev->threaded) {
+        pthread_rwlock_unlock(&dev->lock);
+    }
 }
 
 bool
@@ -1646,6 +1849,7 @@ vu_init(VuDev *dev,
         vu_remove_watch_cb remove_watch,
         const VuDevIface *iface)
 {
+    pthread_rwlockattr_t attr;
     uint16_t i;
 
     assert(max_queues > 0);
@@ -1665,6 +1869,15 @@ vu_init(VuDev *dev,
     dev->log_call_fd = -1;
     dev->slave_fd = -1;
     dev->max_queues = max_queues;
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    /* Don't let busy queue workers starve vu_dispatch() */
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&dev->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&dev->reap_lock, NULL);
 
     dev->vq = malloc(max_queues * sizeof(dev->vq[0]));
     if (!dev->vq) {
@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <pthread.h>
 #include <sys/poll.h>
 #include <linux/vhost.h>
 #include "standard-headers/linux/virtio_ring.h"
@@ -321,6 +322,9 @@ typedef struct VuVirtq {
 
     vu_queue_handler_cb handler;
 
+    /* Thread servicing kick_fd in threaded mode */
+    struct VuQueueWorker *worker;
+
     int call_fd;
     int kick_fd;
     int err_fd;
@@ -378,6 +382,14 @@ struct VuDev {
     /* Postcopy data */
     int postcopy_ufd;
     bool postcopy_listening;
+
+    /* Threaded mode, see vu_set_threaded() */
+    bool threaded;
+    /* Write-locked by vu_dispatch(), read-locked by queue workers */
+    pthread_rwlock_t lock;
+    /* Stopped workers, joined once the write lock has been dropped */
+    pthread_mutex_t reap_lock;
+    struct VuQueueWorker *reap_list;
 };
 
 typedef struct VuVirtqElement {
@@ -419,6 +431,46 @@ bool vu_init(VuDev *dev,
  */
 void vu_deinit(VuDev *dev);
 
+/**
+ * vu_set_threaded:
+ * @dev: a VuDev context
+ * @threaded: whether to service each virtqueue from its own thread
+ *
+ * In threaded mode, the kick fd of each started virtqueue is not handed
+ * to @set_watch; instead a worker thread waits for kicks and runs the
+ * queue handler, so the queues of a device are processed in parallel.
+ * vu_dispatch() keeps running in the caller's thread, and waits for
+ * running handlers to return before processing a message, so that the
+ * guest memory mappings and the vring addresses never change under a
+ * handler.
+ *
+ * Handlers for different queues then run concurrently: the backend
+ * must protect state they share, and must use vu_read_lock() around
+ * any access to a virtqueue or to guest memory made outside a handler.
+ * The @panic callback may be called from a worker.
+ *
+ * Must be called before the first vu_dispatch().
+ */
+void vu_set_threaded(VuDev *dev, bool threaded);
+
+/**
+ * vu_read_lock:
+ * @dev: a VuDev context
+ *
+ * In threaded mode, prevent vu_dispatch() from changing the guest
+ * memory mappings and the virtqueues until vu_read_unlock().  Queue
+ * handlers already run with the lock held.  Does nothing otherwise.
+ */
+void vu_read_lock(VuDev *dev);
+
+/**
+ * vu_read_unlock:
+ * @dev: a VuDev context
+ *
+ * Release the lock taken by vu_read_lock().
+ */
+void vu_read_unlock(VuDev *dev);
+
 /**
  * vu_dispatch:
  * @dev: a VuDev context
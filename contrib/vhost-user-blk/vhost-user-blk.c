@@ -16,15 +16,22 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu-common.h"
+#include "qapi/error.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/host-utils.h"
+#include "qemu/iov.h"
+#include "qemu/main-loop.h"
+#include "qemu/module.h"
+#include "block/aio.h"
+#include "block/block.h"
+#include "sysemu/block-backend.h"
+#include "qapi/qmp/qdict.h"
+#include "crypto/init.h"
 #include "standard-headers/linux/virtio_blk.h"
-#include "contrib/libvhost-user/libvhost-user-glib.h"
 #include "contrib/libvhost-user/libvhost-user.h"
 
-#if defined(__linux__)
-#include <linux/fs.h>
-#include <sys/ioctl.h>
-#endif
-
 enum {
     VHOST_USER_BLK_MAX_QUEUES = 8,
 };
@@ -35,72 +42,98 @@ struct virtio_blk_inhdr {
 
 /* vhost user block device */
 typedef struct VubDev {
-    VugDev parent;
-    int blk_fd;
+    VuDev parent;
+    BlockBackend *blk;
     struct virtio_blk_config blkcfg;
     bool enable_ro;
     char *blk_name;
-    GMainLoop *loop;
+    uint16_t num_queues;
+    /* fd -> VubWatch, for the fds libvhost-user asked us to poll */
+    GHashTable *watches;
+    /* Requests popped from a virtqueue and not pushed back yet */
+    unsigned int in_flight;
+    bool quit;
 } VubDev;
 
+typedef struct VubWatch {
+    VuDev *vu_dev;
+    vu_watch_cb cb;
+    void *pvt;
+} VubWatch;
+
 typedef struct VubReq {
     VuVirtqElement *elem;
     int64_t sector_num;
     size_t size;
+    QEMUIOVector qiov;
     struct virtio_blk_inhdr *in;
     struct virtio_blk_outhdr *out;
     VubDev *vdev_blk;
     struct VuVirtq *vq;
 } VubReq;
 
-/* refer util/iov.c */
-static size_t vub_iov_size(const struct iovec *iov,
-                              const unsigned int iov_cnt)
+static void vub_panic_cb(VuDev *vu_dev, const char *buf)
 {
-    size_t len;
-    unsigned int i;
+    VubDev *vdev_blk;
+
+    assert(vu_dev);
 
-    len = 0;
-    for (i = 0; i < iov_cnt; i++) {
-        len += iov[i].iov_len;
+    vdev_blk = container_of(vu_dev, VubDev, parent);
+    if (buf) {
+        error_report("vu_panic: %s", buf);
     }
-    return len;
+
+    vdev_blk->quit = true;
 }
 
-static size_t vub_iov_to_buf(const struct iovec *iov,
-                             const unsigned int iov_cnt, void *buf)
+static void vub_watch_read(void *opaque)
 {
-    size_t len;
-    unsigned int i;
+    VubWatch *watch = opaque;
 
-    len = 0;
-    for (i = 0; i < iov_cnt; i++) {
-        memcpy(buf + len,  iov[i].iov_base, iov[i].iov_len);
-        len += iov[i].iov_len;
-    }
-    return len;
+    /* The callback may replace or remove the watch, don't touch it after */
+    watch->cb(watch->vu_dev, VU_WATCH_IN, watch->pvt);
 }
 
-static void vub_panic_cb(VuDev *vu_dev, const char *buf)
+static void vub_set_watch(VuDev *vu_dev, int fd, int condition,
+                          vu_watch_cb cb, void *pvt)
 {
-    VugDev *gdev;
-    VubDev *vdev_blk;
+    VubDev *vdev_blk = container_of(vu_dev, VubDev, parent);
+    VubWatch *watch;
 
-    assert(vu_dev);
+    /* libvhost-user only ever waits for fds to become readable */
+    assert(condition == VU_WATCH_IN);
 
-    gdev = container_of(vu_dev, VugDev, parent);
-    vdev_blk = container_of(gdev, VubDev, parent);
-    if (buf) {
-        g_warning("vu_panic: %s", buf);
-    }
+    watch = g_new0(VubWatch, 1);
+    watch->vu_dev = vu_dev;
+    watch->cb = cb;
+    watch->pvt = pvt;
+
+    /* Kicks are external events, so that blk_drain() holds them back */
+    aio_set_fd_handler(qemu_get_aio_context(), fd, true,
+                       vub_watch_read, NULL, NULL, watch);
+    g_hash_table_replace(vdev_blk->watches, GINT_TO_POINTER(fd), watch);
+}
+
+static void vub_remove_watch(VuDev *vu_dev, int fd)
+{
+    VubDev *vdev_blk = container_of(vu_dev, VubDev, parent);
+
+    aio_set_fd_handler(qemu_get_aio_context(), fd, true,
+                       NULL, NULL, NULL, NULL);
+    g_hash_table_remove(vdev_blk->watches, GINT_TO_POINTER(fd));
+}
 
-    g_main_loop_quit(vdev_blk->loop);
+static gboolean vub_remove_one_watch(gpointer key, gpointer value,
+                                     gpointer opaque)
+{
+    aio_set_fd_handler(qemu_get_aio_context(), GPOINTER_TO_INT(key), true,
+                       NULL, NULL, NULL, NULL);
+    return TRUE;
 }
 
 static void vub_req_complete(VubReq *req)
 {
-    VugDev *gdev = &req->vdev_blk->parent;
-    VuDev *vu_dev = &gdev->parent;
+    VuDev *vu_dev = &req->vdev_blk->parent;
 
     /* IO size with 1 extra status byte */
     vu_queue_push(vu_dev, req->vq, req->elem,
@@ -111,139 +144,140 @@ static void vub_req_complete(VubReq *req)
         free(req->elem);
     }
 
+    qemu_iovec_destroy(&req->qiov);
+    req->vdev_blk->in_flight--;
     g_free(req);
 }
 
-static int vub_open(const char *file_name, bool wce)
+static void vub_req_cb(void *opaque, int ret)
 {
-    int fd;
-    int flags = O_RDWR;
-
-    if (!wce) {
-        flags |= O_DIRECT;
-    }
-
-    fd = open(file_name, flags);
-    if (fd < 0) {
-        fprintf(stderr, "Cannot open file %s, %s\n", file_name,
-                strerror(errno));
-        return -1;
+    VubReq *req = opaque;
+
+    if (ret < 0) {
+        error_report("%s: request type %" PRIu32 ", sector %" PRId64
+                     " failed: %s", req->vdev_blk->blk_name,
+                     le32toh(req->out->type), req->sector_num,
+                     strerror(-ret));
+        req->in->status = VIRTIO_BLK_S_IOERR;
+        /* Don't tell the guest that a failed read filled its buffers */
+        req->size = 0;
+    } else {
+        req->in->status = VIRTIO_BLK_S_OK;
     }
-
-    return fd;
+    vub_req_complete(req);
 }
 
-static ssize_t
-vub_readv(VubReq *req, struct iovec *iov, uint32_t iovcnt)
+static bool vub_req_in_range(VubReq *req, uint64_t sector, uint64_t bytes)
 {
-    VubDev *vdev_blk = req->vdev_blk;
-    ssize_t rc;
+    uint64_t capacity = req->vdev_blk->blkcfg.capacity;
 
-    if (!iovcnt) {
-        fprintf(stderr, "Invalid Read IOV count\n");
-        return -1;
-    }
-
-    req->size = vub_iov_size(iov, iovcnt);
-    rc = preadv(vdev_blk->blk_fd, iov, iovcnt, req->sector_num * 512);
-    if (rc < 0) {
-        fprintf(stderr, "%s, Sector %"PRIu64", Size %lu failed with %s\n",
-                vdev_blk->blk_name, req->sector_num, req->size,
-                strerror(errno));
-        return -1;
-    }
-
-    return rc;
+    return bytes % BDRV_SECTOR_SIZE == 0 &&
+           sector <= capacity &&
+           bytes / BDRV_SECTOR_SIZE <= capacity - sector;
 }
 
-static ssize_t
-vub_writev(VubReq *req, struct iovec *iov, uint32_t iovcnt)
+static int
+vub_rw(VubReq *req, struct iovec *iov, uint32_t iovcnt, bool is_write)
 {
     VubDev *vdev_blk = req->vdev_blk;
-    ssize_t rc;
 
     if (!iovcnt) {
-        fprintf(stderr, "Invalid Write IOV count\n");
+        error_report("Invalid %s IOV count", is_write ? "Write" : "Read");
         return -1;
     }
 
-    req->size = vub_iov_size(iov, iovcnt);
-    rc = pwritev(vdev_blk->blk_fd, iov, iovcnt, req->sector_num * 512);
-    if (rc < 0) {
-        fprintf(stderr, "%s, Sector %"PRIu64", Size %lu failed with %s\n",
-                vdev_blk->blk_name, req->sector_num, req->size,
-                strerror(errno));
+    qemu_iovec_init_external(&req->qiov, iov, iovcnt);
+    if (!vub_req_in_range(req, req->sector_num, req->qiov.size)) {
+        error_report("%s: sector %" PRId64 ", size %zu out of range",
+                     vdev_blk->blk_name, req->sector_num, req->qiov.size);
         return -1;
     }
 
-    return rc;
+    if (is_write) {
+        blk_aio_pwritev(vdev_blk->blk, req->sector_num << BDRV_SECTOR_BITS,
+                        &req->qiov, 0, vub_req_cb, req);
+    } else {
+        /* Only reads fill the guest's in buffers */
+        req->size = req->qiov.size;
+        blk_aio_preadv(vdev_blk->blk, req->sector_num << BDRV_SECTOR_BITS,
+                       &req->qiov, 0, vub_req_cb, req);
+    }
+
+    return 0;
 }
 
 static int
 vub_discard_write_zeroes(VubReq *req, struct iovec *iov, uint32_t iovcnt,
                          uint32_t type)
 {
-    struct virtio_blk_discard_write_zeroes *desc;
-    ssize_t size;
-    void *buf;
+    VubDev *vdev_blk = req->vdev_blk;
+    struct virtio_blk_discard_write_zeroes desc;
+    uint32_t num_sectors, flags, max_sectors;
+    uint64_t sector;
 
-    size = vub_iov_size(iov, iovcnt);
-    if (size != sizeof(*desc)) {
-        fprintf(stderr, "Invalid size %ld, expect %ld\n", size, sizeof(*desc));
+    if (iov_size(iov, iovcnt) != sizeof(desc)) {
+        error_report("Invalid size %zu, expect %zu",
+                     iov_size(iov, iovcnt), sizeof(desc));
         return -1;
     }
-    buf = g_new0(char, size);
-    vub_iov_to_buf(iov, iovcnt, buf);
+    iov_to_buf(iov, iovcnt, 0, &desc, sizeof(desc));
+
+    sector = le64toh(desc.sector);
+    num_sectors = le32toh(desc.num_sectors);
+    flags = le32toh(desc.flags);
+    req->sector_num = sector;
 
-    #if defined(__linux__) && defined(BLKDISCARD) && defined(BLKZEROOUT)
-    VubDev *vdev_blk = req->vdev_blk;
-    desc = (struct virtio_blk_discard_write_zeroes *)buf;
-    uint64_t range[2] = { le64toh(desc->sector) << 9,
-                          le32toh(desc->num_sectors) << 9 };
     if (type == VIRTIO_BLK_T_DISCARD) {
-        if (ioctl(vdev_blk->blk_fd, BLKDISCARD, range) == 0) {
-            g_free(buf);
-            return 0;
+        max_sectors = vdev_blk->blkcfg.max_discard_sectors;
+        /* The unmap flag is reserved for discard requests */
+        if (flags) {
+            return -1;
         }
-    } else if (type == VIRTIO_BLK_T_WRITE_ZEROES) {
-        if (ioctl(vdev_blk->blk_fd, BLKZEROOUT, range) == 0) {
-            g_free(buf);
-            return 0;
+    } else {
+        max_sectors = vdev_blk->blkcfg.max_write_zeroes_sectors;
+        if (flags & ~VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP) {
+            return -1;
         }
     }
-    #endif
 
-    g_free(buf);
-    return -1;
-}
+    if (num_sectors > max_sectors ||
+        !vub_req_in_range(req, sector,
+                          (uint64_t)num_sectors << BDRV_SECTOR_BITS)) {
+        return -1;
+    }
 
-static void
-vub_flush(VubReq *req)
-{
-    VubDev *vdev_blk = req->vdev_blk;
+    if (type == VIRTIO_BLK_T_DISCARD) {
+        blk_aio_pdiscard(vdev_blk->blk, sector << BDRV_SECTOR_BITS,
+                         num_sectors << BDRV_SECTOR_BITS, vub_req_cb, req);
+    } else {
+        blk_aio_pwrite_zeroes(vdev_blk->blk, sector << BDRV_SECTOR_BITS,
+                              num_sectors << BDRV_SECTOR_BITS,
+                              flags & VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP ?
+                              BDRV_REQ_MAY_UNMAP : 0,
+                              vub_req_cb, req);
+    }
 
-    fdatasync(vdev_blk->blk_fd);
+    return 0;
 }
 
 static int vub_virtio_process_req(VubDev *vdev_blk,
                                      VuVirtq *vq)
 {
-    VugDev *gdev = &vdev_blk->parent;
-    VuDev *vu_dev = &gdev->parent;
+    VuDev *vu_dev = &vdev_blk->parent;
     VuVirtqElement *elem;
     uint32_t type;
     unsigned in_num;
     unsigned out_num;
     VubReq *req;
 
-    elem = vu_queue_pop(vu_dev, vq, sizeof(VuVirtqElement) + sizeof(VubReq));
+    elem = vu_queue_pop(vu_dev, vq, sizeof(VuVirtqElement));
     if (!elem) {
         return -1;
     }
 
     /* refer to hw/block/virtio_blk.c */
     if (elem->out_num < 1 || elem->in_num < 1) {
-        fprintf(stderr, "virtio-blk request missing headers\n");
+        error_report("virtio-blk request missing headers");
         free(elem);
         return -1;
     }
@@ -258,46 +292,45 @@ static int vub_virtio_process_req(VubDev *vdev_blk,
 
     /* don't support VIRTIO_F_ANY_LAYOUT and virtio 1.0 only */
     if (elem->out_sg[0].iov_len < sizeof(struct virtio_blk_outhdr)) {
-        fprintf(stderr, "Invalid outhdr size\n");
+        error_report("Invalid outhdr size");
         goto err;
     }
     req->out = (struct virtio_blk_outhdr *)elem->out_sg[0].iov_base;
     out_num--;
 
     if (elem->in_sg[in_num - 1].iov_len < sizeof(struct virtio_blk_inhdr)) {
-        fprintf(stderr, "Invalid inhdr size\n");
+        error_report("Invalid inhdr size");
         goto err;
     }
     req->in = (struct virtio_blk_inhdr *)elem->in_sg[in_num - 1].iov_base;
     in_num--;
 
+    vdev_blk->in_flight++;
     type = le32toh(req->out->type);
     switch (type & ~VIRTIO_BLK_T_BARRIER) {
     case VIRTIO_BLK_T_IN:
     case VIRTIO_BLK_T_OUT: {
-        ssize_t ret = 0;
         bool is_write = type & VIRTIO_BLK_T_OUT;
+        int ret;
+
         req->sector_num = le64toh(req->out->sector);
         if (is_write) {
-            ret  = vub_writev(req, &elem->out_sg[1], out_num);
+            ret = vub_rw(req, &elem->out_sg[1], out_num, true);
         } else {
-            ret = vub_readv(req, &elem->in_sg[0], in_num);
+            ret = vub_rw(req, &elem->in_sg[0], in_num, false);
         }
-        if (ret >= 0) {
-            req->in->status = VIRTIO_BLK_S_OK;
-        } else {
+        if (ret < 0) {
+            req->size = 0;
             req->in->status = VIRTIO_BLK_S_IOERR;
+            vub_req_complete(req);
         }
-        vub_req_complete(req);
         break;
     }
     case VIRTIO_BLK_T_FLUSH:
-        vub_flush(req);
-        req->in->status = VIRTIO_BLK_S_OK;
-        vub_req_complete(req);
+        blk_aio_flush(vdev_blk->blk, vub_req_cb, req);
         break;
     case VIRTIO_BLK_T_GET_ID: {
-        size_t size = MIN(vub_iov_size(&elem->in_sg[0], in_num),
+        size_t size = MIN(iov_size(&elem->in_sg[0], in_num),
                           VIRTIO_BLK_ID_BYTES);
         snprintf(elem->in_sg[0].iov_base, size, "%s", "vhost_user_blk");
         req->in->status = VIRTIO_BLK_S_OK;
@@ -309,12 +342,10 @@ static int vub_virtio_process_req(VubDev *vdev_blk,
     case VIRTIO_BLK_T_WRITE_ZEROES: {
         int rc;
         rc = vub_discard_write_zeroes(req, &elem->out_sg[1], out_num, type);
-        if (rc == 0) {
-            req->in->status = VIRTIO_BLK_S_OK;
-        } else {
+        if (rc < 0) {
             req->in->status = VIRTIO_BLK_S_IOERR;
+            vub_req_complete(req);
         }
-        vub_req_complete(req);
         break;
     }
     default:
@@ -333,24 +364,25 @@ err:
 
 static void vub_process_vq(VuDev *vu_dev, int idx)
 {
-    VugDev *gdev;
     VubDev *vdev_blk;
     VuVirtq *vq;
     int ret;
 
-    gdev = container_of(vu_dev, VugDev, parent);
-    vdev_blk = container_of(gdev, VubDev, parent);
+    vdev_blk = container_of(vu_dev, VubDev, parent);
     assert(vdev_blk);
 
     vq = vu_get_queue(vu_dev, idx);
     assert(vq);
 
+    /* Submit everything the guest queued up in one go */
+    blk_io_plug(vdev_blk->blk);
     while (1) {
         ret = vub_virtio_process_req(vdev_blk, vq);
         if (ret) {
             break;
         }
     }
+    blk_io_unplug(vdev_blk->blk);
 }
 
 static void vub_queue_set_started(VuDev *vu_dev, int idx, bool started)
@@ -367,25 +399,25 @@ static uint64_t
 vub_get_features(VuDev *dev)
 {
     uint64_t features;
-    VugDev *gdev;
     VubDev *vdev_blk;
 
-    gdev = container_of(dev, VugDev, parent);
-    vdev_blk = container_of(gdev, VubDev, parent);
+    vdev_blk = container_of(dev, VubDev, parent);
 
     features = 1ull << VIRTIO_BLK_F_SIZE_MAX |
                1ull << VIRTIO_BLK_F_SEG_MAX |
                1ull << VIRTIO_BLK_F_TOPOLOGY |
                1ull << VIRTIO_BLK_F_BLK_SIZE |
                1ull << VIRTIO_BLK_F_FLUSH |
-               #if defined(__linux__) && defined(BLKDISCARD) && defined(BLKZEROOUT)
                1ull << VIRTIO_BLK_F_DISCARD |
                1ull << VIRTIO_BLK_F_WRITE_ZEROES |
-               #endif
                1ull << VIRTIO_BLK_F_CONFIG_WCE |
                1ull << VIRTIO_F_VERSION_1 |
                1ull << VHOST_USER_F_PROTOCOL_FEATURES;
 
+    if (vdev_blk->num_queues > 1) {
+        features |= 1ull << VIRTIO_BLK_F_MQ;
+    }
+
     if (vdev_blk->enable_ro) {
         features |= 1ull << VIRTIO_BLK_F_RO;
     }
@@ -396,19 +428,18 @@ vub_get_features(VuDev *dev)
 static uint64_t
 vub_get_protocol_features(VuDev *dev)
 {
-    return 1ull << VHOST_USER_PROTOCOL_F_CONFIG |
+    return 1ull << VHOST_USER_PROTOCOL_F_MQ |
+           1ull << VHOST_USER_PROTOCOL_F_CONFIG |
            1ull << VHOST_USER_PROTOCOL_F_INFLIGHT_SHMFD;
 }
 
 static int
 vub_get_config(VuDev *vu_dev, uint8_t *config, uint32_t len)
 {
-    VugDev *gdev;
     VubDev *vdev_blk;
 
-    gdev = container_of(vu_dev, VugDev, parent);
-    vdev_blk = container_of(gdev, VubDev, parent);
-    memcpy(config, &vdev_blk->blkcfg, len);
+    vdev_blk = container_of(vu_dev, VubDev, parent);
+    memcpy(config, &vdev_blk->blkcfg, MIN(len, sizeof(vdev_blk->blkcfg)));
 
     return 0;
 }
@@ -417,18 +448,15 @@ static int
 vub_set_config(VuDev *vu_dev, const uint8_t *data,
                uint32_t offset, uint32_t size, uint32_t flags)
 {
-    VugDev *gdev;
     VubDev *vdev_blk;
     uint8_t wce;
-    int fd;
 
     /* don't support live migration */
     if (flags != VHOST_SET_CONFIG_TYPE_MASTER) {
         return -1;
     }
 
-    gdev = container_of(vu_dev, VugDev, parent);
-    vdev_blk = container_of(gdev, VubDev, parent);
+    vdev_blk = container_of(vu_dev, VubDev, parent);
 
     if (offset != offsetof(struct virtio_blk_config, wce) ||
         size != 1) {
@@ -442,19 +470,8 @@ vub_set_config(VuDev *vu_dev, const uint8_t *data,
     }
 
     vdev_blk->blkcfg.wce = wce;
-    fprintf(stdout, "Write Cache Policy Changed\n");
-    if (vdev_blk->blk_fd >= 0) {
-        close(vdev_blk->blk_fd);
-        vdev_blk->blk_fd = -1;
-    }
-
-    fd = vub_open(vdev_blk->blk_name, wce);
-    if (fd < 0) {
-        fprintf(stderr, "Error to open block device %s\n", vdev_blk->blk_name);
-        vdev_blk->blk_fd = -1;
-        return -1;
-    }
-    vdev_blk->blk_fd = fd;
+    blk_set_enable_write_cache(vdev_blk->blk, wce);
+    info_report("Write Cache Policy Changed");
 
     return 0;
 }
@@ -467,6 +484,26 @@ static const VuDevIface vub_iface = {
     .set_config = vub_set_config,
 };
 
+static void vub_sock_read(void *opaque)
+{
+    VubDev *vdev_blk = opaque;
+
+    /*
+     * Messages such as SET_MEM_TABLE, GET_VRING_BASE or RESET_OWNER
+     * unmap guest memory or report the queue position to the master:
+     * no request may still be writing to guest memory or be missing
+     * from the used ring when they are processed.
+     */
+    if (vdev_blk->in_flight) {
+        blk_drain(vdev_blk->blk);
+        assert(!vdev_blk->in_flight);
+    }
+
+    if (!vu_dispatch(&vdev_blk->parent)) {
+        vdev_blk->quit = true;
+    }
+}
+
 static int unix_sock_new(char *unix_fn)
 {
     int sock;
@@ -510,106 +547,155 @@ static void vub_free(struct VubDev *vdev_blk)
         return;
     }
 
-    g_main_loop_unref(vdev_blk->loop);
-    if (vdev_blk->blk_fd >= 0) {
-        close(vdev_blk->blk_fd);
+    if (vdev_blk->blk) {
+        blk_unref(vdev_blk->blk);
     }
+    g_hash_table_destroy(vdev_blk->watches);
     g_free(vdev_blk);
 }
 
-static uint32_t
-vub_get_blocksize(int fd)
-{
-    uint32_t blocksize = 512;
-
-#if defined(__linux__) && defined(BLKSSZGET)
-    if (ioctl(fd, BLKSSZGET, &blocksize) == 0) {
-        return blocksize;
-    }
-#endif
-
-    return blocksize;
-}
-
 static void
-vub_initialize_config(int fd, struct virtio_blk_config *config)
+vub_initialize_config(BlockBackend *blk, uint16_t num_queues,
+                      struct virtio_blk_config *config)
 {
-    off64_t capacity;
+    BlockSizes bsz = {
+        .log = BDRV_SECTOR_SIZE,
+        .phys = BDRV_SECTOR_SIZE,
+    };
 
-    capacity = lseek64(fd, 0, SEEK_END);
-    config->capacity = capacity >> 9;
-    config->blk_size = vub_get_blocksize(fd);
+    blk_probe_blocksizes(blk, &bsz);
+
+    config->capacity = blk_getlength(blk) >> BDRV_SECTOR_BITS;
+    config->blk_size = bsz.log;
     config->size_max = 65536;
     config->seg_max = 128 - 2;
+    config->physical_block_exp = ctz32(bsz.phys / bsz.log);
     config->min_io_size = 1;
     config->opt_io_size = 1;
-    config->num_queues = 1;
-    #if defined(__linux__) && defined(BLKDISCARD) && defined(BLKZEROOUT)
+    config->num_queues = num_queues;
     config->max_discard_sectors = 32768;
     config->max_discard_seg = 1;
-    config->discard_sector_alignment = config->blk_size >> 9;
+    config->discard_sector_alignment = config->blk_size >> BDRV_SECTOR_BITS;
     config->max_write_zeroes_sectors = 32768;
     config->max_write_zeroes_seg = 1;
-    #endif
+    config->write_zeroes_may_unmap = 1;
 }
 
 static VubDev *
-vub_new(char *blk_file)
+vub_new(char *blk_file, const char *fmt, int flags, bool writethrough,
+        uint16_t num_queues)
 {
     VubDev *vdev_blk;
+    QDict *options = NULL;
+    Error *local_err = NULL;
 
     vdev_blk = g_new0(VubDev, 1);
-    vdev_blk->loop = g_main_loop_new(NULL, FALSE);
-    vdev_blk->blk_fd = vub_open(blk_file, 0);
-    if (vdev_blk->blk_fd  < 0) {
-        fprintf(stderr, "Error to open block device %s\n", blk_file);
+    vdev_blk->watches = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+
+    if (fmt) {
+        options = qdict_new();
+        qdict_put_str(options, "driver", fmt);
+    }
+    vdev_blk->blk = blk_new_open(blk_file, NULL, options, flags, &local_err);
+    if (!vdev_blk->blk) {
+        error_reportf_err(local_err, "Error to open block device %s: ",
+                          blk_file);
         vub_free(vdev_blk);
         return NULL;
     }
-    vdev_blk->enable_ro = false;
-    vdev_blk->blkcfg.wce = 0;
+    blk_set_enable_write_cache(vdev_blk->blk, !writethrough);
+
+    vdev_blk->enable_ro = !(flags & BDRV_O_RDWR);
+    vdev_blk->blkcfg.wce = !writethrough;
     vdev_blk->blk_name = blk_file;
+    vdev_blk->num_queues = num_queues;
 
     /* fill virtio_blk_config with block parameters */
-    vub_initialize_config(vdev_blk->blk_fd, &vdev_blk->blkcfg);
+    vub_initialize_config(vdev_blk->blk, num_queues, &vdev_blk->blkcfg);
 
     return vdev_blk;
 }
 
+static void usage(const char *name)
+{
+    printf("Usage: %s [ -b block device or file, -s UNIX domain socket"
+           " | -f image format | -q number of queues (default 1)"
+           " | -c cache mode (default none) | -a aio mode (native or threads)"
+           " | -r Enable read-only ] | [ -h ]\n", name);
+}
+
 int main(int argc, char **argv)
 {
     int opt;
     char *unix_socket = NULL;
     char *blk_file = NULL;
-    bool enable_ro = false;
+    const char *fmt = NULL;
+    const char *cache = "none";
+    bool writethrough;
+    int flags = BDRV_O_RDWR | BDRV_O_UNMAP;
+    unsigned long num_queues = 1;
     int lsock = -1, csock = -1;
     VubDev *vdev_blk = NULL;
 
-    while ((opt = getopt(argc, argv, "b:rs:h")) != -1) {
+    error_init(argv[0]);
+    module_call_init(MODULE_INIT_TRACE);
+    qcrypto_init(&error_fatal);
+    module_call_init(MODULE_INIT_QOM);
+    qemu_init_exec_dir(argv[0]);
+
+    while ((opt = getopt(argc, argv, "a:b:c:f:q:rs:h")) != -1) {
         switch (opt) {
+        case 'a':
+            if (!strcmp(optarg, "native")) {
+                flags |= BDRV_O_NATIVE_AIO;
+            } else if (strcmp(optarg, "threads")) {
+                error_report("Invalid aio mode '%s'", optarg);
+                return -1;
+            }
+            break;
         case 'b':
             blk_file = g_strdup(optarg);
             break;
+        case 'c':
+            cache = optarg;
+            break;
+        case 'f':
+            fmt = optarg;
+            break;
+        case 'q':
+            if (qemu_strtoul(optarg, NULL, 0, &num_queues) < 0 ||
+                num_queues < 1 || num_queues > VHOST_USER_BLK_MAX_QUEUES) {
+                error_report("Number of queues must be between 1 and %d",
+                             VHOST_USER_BLK_MAX_QUEUES);
+                return -1;
+            }
+            break;
         case 's':
             unix_socket = g_strdup(optarg);
             break;
         case 'r':
-            enable_ro = true;
+            flags &= ~BDRV_O_RDWR;
             break;
         case 'h':
         default:
-            printf("Usage: %s [ -b block device or file, -s UNIX domain socket"
-                   " | -r Enable read-only ] | [ -h ]\n", argv[0]);
+            usage(argv[0]);
             return 0;
         }
     }
 
     if (!unix_socket || !blk_file) {
-        printf("Usage: %s [ -b block device or file, -s UNIX domain socket"
-               " | -r Enable read-only ] | [ -h ]\n", argv[0]);
+        usage(argv[0]);
         return -1;
     }
 
+    if (bdrv_parse_cache_mode(cache, &flags, &writethrough) < 0) {
+        error_report("Invalid cache mode '%s'", cache);
+        return -1;
+    }
+
+    qemu_init_main_loop(&error_fatal);
+    bdrv_init();
+
     lsock = unix_sock_new(unix_socket);
     if (lsock < 0) {
         goto err;
@@ -617,27 +703,34 @@ int main(int argc, char **argv)
 
     csock = accept(lsock, (void *)0, (void *)0);
     if (csock < 0) {
-        fprintf(stderr, "Accept error %s\n", strerror(errno));
+        error_report("Accept error %s", strerror(errno));
         goto err;
     }
 
-    vdev_blk = vub_new(blk_file);
+    vdev_blk = vub_new(blk_file, fmt, flags, writethrough, num_queues);
     if (!vdev_blk) {
         goto err;
     }
-    if (enable_ro) {
-        vdev_blk->enable_ro = true;
-    }
 
-    if (!vug_init(&vdev_blk->parent, VHOST_USER_BLK_MAX_QUEUES, csock,
-                  vub_panic_cb, &vub_iface)) {
-        fprintf(stderr, "Failed to initialized libvhost-user-glib\n");
+    if (!vu_init(&vdev_blk->parent, num_queues, csock, vub_panic_cb,
+                 vub_set_watch, vub_remove_watch, &vub_iface)) {
+        error_report("Failed to initialize libvhost-user");
         goto err;
     }
+    aio_set_fd_handler(qemu_get_aio_context(), csock, false,
+                       vub_sock_read, NULL, NULL, vdev_blk);
 
-    g_main_loop_run(vdev_blk->loop);
+    while (!vdev_blk->quit) {
+        main_loop_wait(false);
+    }
 
-    vug_deinit(&vdev_blk->parent);
+    aio_set_fd_handler(qemu_get_aio_context(), csock, false,
+                       NULL, NULL, NULL, NULL);
+    g_hash_table_foreach_remove(vdev_blk->watches, vub_remove_one_watch,
+                                NULL);
+    /* In-flight requests point into guest memory, let them finish first */
+    blk_drain(vdev_blk->blk);
+    vu_deinit(&vdev_blk->parent);
 
 err:
     vub_free(vdev_blk);
@@ -212,8 +212,9 @@ void qemu_tcg_configure(QemuOpts *opts, Error **errp)
         if (strcmp(t, "multi") == 0) {
             if (TCG_OVERSIZED_GUEST) {
                 error_setg(errp, "No MTTCG when guest word size > hosts");
-            } else if (use_icount) {
-                error_setg(errp, "No MTTCG when icount is enabled");
+            } else if (use_icount && replay_mode == REPLAY_MODE_NONE) {
+                error_setg(errp, "No MTTCG when icount is enabled "
+                           "without record/replay");
             } else {
 #ifndef TARGET_SUPPORTS_MTTCG
                 warn_report("Guest not yet converted to MTTCG - "
@@ -778,19 +779,23 @@ static const VMStateDescription vmstate_timers = {
     }
 };
 
+/*
+ * The timer period is stretched for the most throttled vCPU, so that it
+ * runs for CPU_THROTTLE_TIMESLICE_NS in each period.  Every vCPU then
+ * sleeps for its own percentage of the period.
+ */
 static void cpu_throttle_thread(CPUState *cpu, run_on_cpu_data opaque)
 {
     double pct;
-    double throttle_ratio;
     long sleeptime_ns;
 
-    if (!cpu_throttle_get_percentage()) {
+    pct = (double)cpu_throttle_get_vcpu_percentage(cpu) / 100;
+    if (!pct) {
+        atomic_set(&cpu->throttle_thread_scheduled, 0);
         return;
     }
 
-    pct = (double)cpu_throttle_get_percentage()/100;
-    throttle_ratio = pct / (1 - pct);
-    sleeptime_ns = (long)(throttle_ratio * CPU_THROTTLE_TIMESLICE_NS);
+    sleeptime_ns = (long)(pct * opaque.host_ulong);
 
     qemu_mutex_unlock_iothread();
     g_usleep(sleeptime_ns / 1000); /* Convert ns to us for usleep call */
@@ -801,22 +806,29 @@ static void cpu_throttle_thread(CPUState *cpu, run_on_cpu_data opaque)
 static void cpu_throttle_timer_tick(void *opaque)
 {
     CPUState *cpu;
-    double pct;
+    int max_pct = 0;
+    unsigned long period_ns;
+
+    CPU_FOREACH(cpu) {
+        max_pct = MAX(max_pct, cpu_throttle_get_vcpu_percentage(cpu));
+    }
 
     /* Stop the timer if needed */
-    if (!cpu_throttle_get_percentage()) {
+    if (!max_pct) {
         return;
     }
+
+    period_ns = CPU_THROTTLE_TIMESLICE_NS / (1 - (double)max_pct / 100);
     CPU_FOREACH(cpu) {
-        if (!atomic_xchg(&cpu->throttle_thread_scheduled, 1)) {
+        if (cpu_throttle_get_vcpu_percentage(cpu) &&
+            !atomic_xchg(&cpu->throttle_thread_scheduled, 1)) {
             async_run_on_cpu(cpu, cpu_throttle_thread,
-                             RUN_ON_CPU_NULL);
+                             RUN_ON_CPU_HOST_ULONG(period_ns));
         }
     }
 
-    pct = (double)cpu_throttle_get_percentage()/100;
     timer_mod(throttle_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL_RT) +
-                                   CPU_THROTTLE_TIMESLICE_NS / (1-pct));
+                              period_ns);
 }
 
 void cpu_throttle_set(int new_throttle_pct)
@@ -833,7 +845,15 @@ void cpu_throttle_set(int new_throttle_pct)
 
 void cpu_throttle_stop(void)
 {
+    CPUState *cpu;
+
     atomic_set(&throttle_percentage, 0);
+
+    rcu_read_lock();
+    CPU_FOREACH(cpu) {
+        atomic_set(&cpu->throttle_percentage, 0);
+    }
+    rcu_read_unlock();
 }
 
 bool cpu_throttle_active(void)
@@ -846,6 +866,27 @@ int cpu_throttle_get_percentage(void)
     return atomic_read(&throttle_percentage);
 }
 
+void cpu_throttle_set_vcpu(CPUState *cpu, int new_throttle_pct)
+{
+    if (new_throttle_pct) {
+        new_throttle_pct = MIN(new_throttle_pct, CPU_THROTTLE_PCT_MAX);
+        new_throttle_pct = MAX(new_throttle_pct, CPU_THROTTLE_PCT_MIN);
+    }
+
+    atomic_set(&cpu->throttle_percentage, new_throttle_pct);
+
+    if (new_throttle_pct && !timer_pending(throttle_timer)) {
+        timer_mod(throttle_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL_RT) +
+                                  CPU_THROTTLE_TIMESLICE_NS);
+    }
+}
+
+int cpu_throttle_get_vcpu_percentage(CPUState *cpu)
+{
+    return MAX(cpu_throttle_get_percentage(),
+               atomic_read(&cpu->throttle_percentage));
+}
+
 void cpu_ticks_init(void)
 {
     seqlock_init(&timers_state.vm_clock_seqlock);
@@ -976,6 +1017,15 @@ void qemu_timer_notify_cb(void *opaque, QEMUClockType type)
          * need to do anything.
          */
         async_run_on_cpu(first_cpu, do_nothing, RUN_ON_CPU_NULL);
+
+        /* With MTTCG, the vCPU that holds the turn may be another one.  */
+        if (qemu_tcg_mttcg_enabled()) {
+            CPUState *cpu;
+
+            CPU_FOREACH(cpu) {
+                qemu_cpu_kick(cpu);
+            }
+        }
     }
 }
 
@@ -1370,6 +1420,13 @@ static int64_t tcg_get_icount_limit(void)
             deadline = INT32_MAX;
         }
 
+        /* With a thread per vCPU, give the other vCPUs a turn as often
+         * as the round-robin kick timer would.
+         */
+        if (qemu_tcg_mttcg_enabled()) {
+            deadline = MIN(deadline, TCG_KICK_PERIOD);
+        }
+
         return qemu_icount_round(deadline);
     } else {
         return replay_get_instructions();
@@ -1403,12 +1460,15 @@ static void prepare_icount_for_run(CPUState *cpu)
         g_assert(cpu_neg(cpu)->icount_decr.u16.low == 0);
         g_assert(cpu->icount_extra == 0);
 
+        /* With MTTCG the lock is already held for the vCPU's turn.  */
+        if (!qemu_tcg_mttcg_enabled()) {
+            replay_mutex_lock();
+        }
+
         cpu->icount_budget = tcg_get_icount_limit();
         insns_left = MIN(0xffff, cpu->icount_budget);
         cpu_neg(cpu)->icount_decr.u16.low = insns_left;
         cpu->icount_extra = cpu->icount_budget - insns_left;
-
-        replay_mutex_lock();
     }
 }
 
@@ -1425,8 +1485,44 @@ static void process_icount_data(CPUState *cpu)
 
         replay_account_executed_instructions();
 
-        replay_mutex_unlock();
+        if (qemu_tcg_mttcg_enabled()) {
+            replay_vcpu_turn_end();
+        } else {
+            replay_mutex_unlock();
+        }
+    }
+}
+
+/*
+ * Multi-threaded TCG with icount is only allowed for record/replay.  The
+ * vCPUs take turns executing guest code, in an order that the replay log
+ * records, so that the execution is deterministic.  Returns true with
+ * the replay mutex held if @cpu may run.
+ */
+static bool tcg_icount_turn_begin(CPUState *cpu)
+{
+    bool idle;
+
+    if (!replay_vcpu_turn_begin(cpu)) {
+        return false;
     }
+
+    /* Check again now that no other vCPU can change our state.  */
+    qemu_mutex_lock_iothread();
+    idle = !cpu_can_run(cpu) || (cpu->halted && !cpu_has_work(cpu));
+    qemu_mutex_unlock_iothread();
+    if (idle) {
+        replay_vcpu_turn_end();
+        return false;
+    }
+
+    replay_vcpu_turn_claim(cpu);
+
+    qemu_mutex_lock_iothread();
+    qemu_account_warp_timer();
+    handle_icount_deadline();
+    qemu_mutex_unlock_iothread();
+    return true;
 }
 
 
@@ -1451,6 +1547,19 @@ static int tcg_cpu_exec(CPUState *cpu)
     return ret;
 }
 
+static int tcg_icount_cpu_exec(CPUState *cpu)
+{
+    int r;
+
+    if (!tcg_icount_turn_begin(cpu)) {
+        return EXCP_INTERRUPT;
+    }
+    prepare_icount_for_run(cpu);
+    r = tcg_cpu_exec(cpu);
+    process_icount_data(cpu);
+    return r;
+}
+
 /* Destroy any remaining vCPUs which have been unplugged and have
  * finished running
  */
@@ -1728,7 +1837,7 @@ static void *qemu_tcg_cpu_thread_fn(void *arg)
     CPUState *cpu = arg;
 
     assert(tcg_enabled());
-    g_assert(!use_icount);
+    g_assert(!use_icount || replay_mode != REPLAY_MODE_NONE);
 
     rcu_register_thread();
     tcg_register_thread();
@@ -1747,10 +1856,15 @@ static void *qemu_tcg_cpu_thread_fn(void *arg)
     cpu->exit_request = 1;
 
     do {
-        if (cpu_can_run(cpu)) {
+        /* A halted vCPU would only wait for a turn that it cannot use.  */
+        if (cpu_can_run(cpu) && !(use_icount && cpu_thread_is_idle(cpu))) {
             int r;
             qemu_mutex_unlock_iothread();
-            r = tcg_cpu_exec(cpu);
+            if (use_icount) {
+                r = tcg_icount_cpu_exec(cpu);
+            } else {
+                r = tcg_cpu_exec(cpu);
+            }
             qemu_mutex_lock_iothread();
             switch (r) {
             case EXCP_DEBUG:
@@ -1777,6 +1891,10 @@ static void *qemu_tcg_cpu_thread_fn(void *arg)
         }
 
         atomic_mb_set(&cpu->exit_request, 0);
+        if (use_icount && all_cpu_threads_idle()) {
+            /* Let the main loop warp the clock, as in the RR case.  */
+            qemu_notify_event();
+        }
         qemu_wait_io_event(cpu);
     } while (!cpu->unplug || cpu_can_run(cpu));
 
@@ -1907,6 +2025,9 @@ void pause_all_vcpus(void)
     /* We need to drop the replay_lock so any vCPU threads woken up
      * can finish their replay tasks
      */
+    if (qemu_tcg_mttcg_enabled() && use_icount) {
+        replay_vcpu_kick();
+    }
     replay_mutex_unlock();
 
     while (!all_vcpus_paused()) {
@@ -1976,8 +2097,11 @@ static void qemu_tcg_init_vcpu(CPUState *cpu)
         qemu_cond_init(cpu->halt_cond);
 
         if (qemu_tcg_mttcg_enabled()) {
-            /* create a thread per vCPU with TCG (MTTCG) */
-            parallel_cpus = true;
+            /* create a thread per vCPU with TCG (MTTCG); under
+             * record/replay the vCPUs take turns and never run in
+             * parallel.
+             */
+            parallel_cpus = !use_icount;
             snprintf(thread_name, VCPU_THREAD_NAME_SIZE, "CPU %d/TCG",
                  cpu->cpu_index);
 
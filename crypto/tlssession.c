@@ -32,6 +32,18 @@
 
 #include <gnutls/x509.h>
 
+#ifdef CONFIG_KTLS
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
 
 struct QCryptoTLSSession {
     QCryptoTLSCreds *creds;
@@ -548,6 +560,225 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *session)
 }
 
 
+#ifdef CONFIG_KTLS
+#if defined(TLS_1_3_VERSION) && GNUTLS_VERSION_NUMBER >= 0x030605
+#define QCRYPTO_TLS_KTLS_1_3_VERSION TLS_1_3_VERSION
+#else
+/* never matched, the version check below refuses TLS 1.3 sessions */
+#define QCRYPTO_TLS_KTLS_1_3_VERSION 0
+#endif
+
+typedef union {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+#ifdef TLS_CIPHER_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#endif
+} QCryptoTLSSessionKTLSInfo;
+
+#define QCRYPTO_TLS_KTLS_FILL(ci, cipher, tls13, keyd, ivd, seqno)          \
+    do {                                                                    \
+        (ci)->info.cipher_type = TLS_CIPHER_ ## cipher;                     \
+        memcpy((ci)->key, (keyd).data,                                      \
+               TLS_CIPHER_ ## cipher ## _KEY_SIZE);                         \
+        memcpy((ci)->salt, (ivd).data,                                      \
+               TLS_CIPHER_ ## cipher ## _SALT_SIZE);                        \
+        if (tls13) {                                                        \
+            /* the nonce is the whole static IV xor the sequence number */  \
+            (ci)->info.version = QCRYPTO_TLS_KTLS_1_3_VERSION;              \
+            memcpy((ci)->iv,                                                \
+                   (ivd).data + TLS_CIPHER_ ## cipher ## _SALT_SIZE,        \
+                   TLS_CIPHER_ ## cipher ## _IV_SIZE);                      \
+        } else {                                                            \
+            /* GnuTLS uses the record sequence number as explicit nonce */  \
+            (ci)->info.version = TLS_1_2_VERSION;                           \
+            memcpy((ci)->iv, (seqno),                                       \
+                   TLS_CIPHER_ ## cipher ## _IV_SIZE);                      \
+        }                                                                   \
+        memcpy((ci)->rec_seq, (seqno),                                      \
+               TLS_CIPHER_ ## cipher ## _REC_SEQ_SIZE);                     \
+    } while (0)
+
+#define QCRYPTO_TLS_KTLS_IV_SIZE(cipher, tls13)                             \
+    (TLS_CIPHER_ ## cipher ## _SALT_SIZE +                                  \
+     ((tls13) ? TLS_CIPHER_ ## cipher ## _IV_SIZE : 0))
+
+static int
+qcrypto_tls_session_get_ktls_info(QCryptoTLSSession *session,
+                                  bool read,
+                                  bool tls13,
+                                  QCryptoTLSSessionKTLSInfo *info,
+                                  socklen_t *len,
+                                  Error **errp)
+{
+    gnutls_cipher_algorithm_t cipher = gnutls_cipher_get(session->handle);
+    gnutls_datum_t iv, key;
+    unsigned char seq[8];
+    int ret;
+
+    ret = gnutls_record_get_state(session->handle, read, NULL,
+                                  &iv, &key, seq);
+    if (ret < 0) {
+        error_setg(errp, "Cannot get TLS record state: %s",
+                   gnutls_strerror(ret));
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    switch (cipher) {
+    case GNUTLS_CIPHER_AES_128_GCM:
+        if (key.size != TLS_CIPHER_AES_GCM_128_KEY_SIZE ||
+            iv.size < QCRYPTO_TLS_KTLS_IV_SIZE(AES_GCM_128, tls13)) {
+            break;
+        }
+        QCRYPTO_TLS_KTLS_FILL(&info->aes_gcm_128, AES_GCM_128, tls13,
+                              key, iv, seq);
+        *len = sizeof(info->aes_gcm_128);
+        return 0;
+#ifdef TLS_CIPHER_AES_GCM_256
+    case GNUTLS_CIPHER_AES_256_GCM:
+        if (key.size != TLS_CIPHER_AES_GCM_256_KEY_SIZE ||
+            iv.size < QCRYPTO_TLS_KTLS_IV_SIZE(AES_GCM_256, tls13)) {
+            break;
+        }
+        QCRYPTO_TLS_KTLS_FILL(&info->aes_gcm_256, AES_GCM_256, tls13,
+                              key, iv, seq);
+        *len = sizeof(info->aes_gcm_256);
+        return 0;
+#endif
+    default:
+        break;
+    }
+
+    error_setg(errp, "TLS cipher %s cannot be offloaded to the kernel",
+               gnutls_cipher_get_name(cipher));
+    return -1;
+}
+
+
+#if QCRYPTO_TLS_KTLS_1_3_VERSION
+/*
+ * Once the kernel encrypts outgoing records, GnuTLS can no longer
+ * answer a TLS 1.3 KeyUpdate that asks us to update our own keys:
+ * fail the session rather than send a record the peer cannot decrypt.
+ */
+static int
+qcrypto_tls_session_key_update_hook(gnutls_session_t handle,
+                                    unsigned int htype,
+                                    unsigned int when,
+                                    unsigned int incoming,
+                                    const gnutls_datum_t *msg)
+{
+    /* KeyUpdateRequest update_requested(1) */
+    if (incoming && msg->size >= 1 && msg->data[0] == 1) {
+        return GNUTLS_E_UNEXPECTED_HANDSHAKE_PACKET;
+    }
+    return 0;
+}
+#endif
+
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session,
+                                int fd,
+                                Error **errp)
+{
+    gnutls_protocol_t version = gnutls_protocol_get_version(session->handle);
+    QCryptoTLSSessionKTLSInfo tx, rx;
+    socklen_t txlen, rxlen;
+    bool tls13;
+    int ret = -1;
+
+    if (!session->handshakeComplete) {
+        error_setg(errp, "TLS handshake is not complete");
+        return -1;
+    }
+
+    switch (version) {
+    case GNUTLS_TLS1_2:
+        tls13 = false;
+        break;
+#if QCRYPTO_TLS_KTLS_1_3_VERSION
+    case GNUTLS_TLS1_3:
+        tls13 = true;
+        break;
+#endif
+    default:
+        error_setg(errp, "TLS version %s cannot be offloaded to the kernel",
+                   gnutls_protocol_get_name(version));
+        return -1;
+    }
+
+    if (gnutls_record_check_pending(session->handle)) {
+        error_setg(errp, "TLS session has pending data");
+        return -1;
+    }
+
+    if (qcrypto_tls_session_get_ktls_info(session, false, tls13, &tx, &txlen,
+                                          errp) < 0 ||
+        qcrypto_tls_session_get_ktls_info(session, true, tls13, &rx, &rxlen,
+                                          errp) < 0) {
+        goto cleanup;
+    }
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+        error_setg_errno(errp, errno, "Cannot attach kernel TLS to socket");
+        goto cleanup;
+    }
+
+    if (setsockopt(fd, SOL_TLS, TLS_TX, &tx, txlen) < 0) {
+        error_setg_errno(errp, errno, "Cannot set kernel TLS transmit keys");
+        goto cleanup;
+    }
+    ret = QCRYPTO_TLS_KTLS_TX;
+
+#if QCRYPTO_TLS_KTLS_1_3_VERSION
+    if (tls13) {
+        /*
+         * TLS 1.3 peers can send post-handshake messages (session
+         * tickets, key updates) at any time, which kernel receive
+         * offload would hand back to us as errors, so records keep
+         * being decrypted by GnuTLS
+         */
+        gnutls_handshake_set_hook_function(session->handle,
+                                           GNUTLS_HANDSHAKE_KEY_UPDATE,
+                                           GNUTLS_HOOK_PRE,
+                                           qcrypto_tls_session_key_update_hook);
+    }
+#endif
+
+#ifdef TLS_RX
+    /*
+     * Receive offload needs a newer kernel than transmit, without
+     * it records keep being decrypted by GnuTLS
+     */
+    if (!tls13 && setsockopt(fd, SOL_TLS, TLS_RX, &rx, rxlen) == 0) {
+        ret |= QCRYPTO_TLS_KTLS_RX;
+    }
+#endif
+
+    trace_qcrypto_tls_session_enable_ktls(session, fd, ret);
+
+ cleanup:
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    return ret;
+}
+
+#else /* ! CONFIG_KTLS */
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *session G_GNUC_UNUSED,
+                                int fd G_GNUC_UNUSED,
+                                Error **errp)
+{
+    error_setg(errp, "Kernel TLS offload is not supported in this build");
+    return -1;
+}
+
+#endif /* ! CONFIG_KTLS */
+
+
 #else /* ! CONFIG_GNUTLS */
 
 
@@ -639,4 +870,14 @@ qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess)
     return NULL;
 }
 
+
+int
+qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess G_GNUC_UNUSED,
+                                int fd G_GNUC_UNUSED,
+                                Error **errp)
+{
+    error_setg(errp, "TLS requires GNUTLS support");
+    return -1;
+}
+
 #endif
@@ -475,7 +475,10 @@ void target_disas(FILE *out, CPUState *cpu, target_ulong code,
     }
 }
 
-/* Disassemble this for me please... (debugging). */
+/*
+ * Disassemble this for me please... (debugging).
+ * A NULL @out prints to the current monitor.
+ */
 void disas(FILE *out, void *code, unsigned long size)
 {
     uintptr_t pc;
@@ -483,7 +486,7 @@ void disas(FILE *out, void *code, unsigned long size)
     CPUDebug s;
     int (*print_insn)(bfd_vma pc, disassemble_info *info) = NULL;
 
-    INIT_DISASSEMBLE_INFO(s.info, out, fprintf);
+    INIT_DISASSEMBLE_INFO(s.info, out, qemu_fprintf);
     s.info.print_address_func = generic_print_host_address;
 
     s.info.buffer = code;
@@ -562,9 +565,9 @@ void disas(FILE *out, void *code, unsigned long size)
         print_insn = print_insn_od_host;
     }
     for (pc = (uintptr_t)code; size > 0; pc += count, size -= count) {
-        fprintf(out, "0x%08" PRIxPTR ":  ", pc);
+        qemu_fprintf(out, "0x%08" PRIxPTR ":  ", pc);
         count = print_insn(pc, &s.info);
-	fprintf(out, "\n");
+        qemu_fprintf(out, "\n");
 	if (count < 0)
 	    break;
     }
@@ -1460,6 +1460,21 @@ bool cpu_physical_memory_snapshot_get_dirty(DirtyBitmapSnapshot *snap,
     return false;
 }
 
+uint64_t cpu_physical_memory_snapshot_count_dirty(DirtyBitmapSnapshot *snap,
+                                                  ram_addr_t start,
+                                                  ram_addr_t length)
+{
+    unsigned long page, end;
+
+    assert(start >= snap->start);
+    assert(start + length <= snap->end);
+
+    end = TARGET_PAGE_ALIGN(start + length - snap->start) >> TARGET_PAGE_BITS;
+    page = (start - snap->start) >> TARGET_PAGE_BITS;
+
+    return bitmap_count_one_with_offset(snap->dirty, page, end - page);
+}
+
 /* Called from RCU critical section */
 hwaddr memory_region_section_get_iotlb(CPUState *cpu,
                                        MemoryRegionSection *section,
@@ -2739,6 +2754,16 @@ void memory_notdirty_write_complete(NotDirtyInfo *ndi)
         ndi->pages = NULL;
     }
 
+    /* Account the page to the writing vCPU for dirty rate measurement
+     * and dirty-limit throttling.  Only this vCPU updates the counter.
+     */
+    if (global_dirty_log &&
+        !cpu_physical_memory_get_dirty_flag(ndi->ram_addr,
+                                            DIRTY_MEMORY_MIGRATION)) {
+        atomic_set__nocheck(&ndi->cpu->dirty_pages,
+                            ndi->cpu->dirty_pages + 1);
+    }
+
     /* Set both VGA and migration bits for simplicity and to remove
      * the notdirty callback faster.
      */
@@ -3226,12 +3251,12 @@ static int memory_access_size(MemoryRegion *mr, unsigned l, hwaddr addr)
     return l;
 }
 
-static bool prepare_mmio_access(MemoryRegion *mr)
+static bool prepare_mmio_access(MemoryRegion *mr, bool is_write)
 {
     bool unlocked = !qemu_mutex_iothread_locked();
     bool release_lock = false;
 
-    if (unlocked && mr->global_locking) {
+    if (unlocked && memory_region_needs_global_locking(mr, is_write)) {
         qemu_mutex_lock_iothread();
         unlocked = false;
         release_lock = true;
@@ -3263,7 +3288,7 @@ static MemTxResult flatview_write_continue(FlatView *fv, hwaddr addr,
 
     for (;;) {
         if (!memory_access_is_direct(mr, true)) {
-            release_lock |= prepare_mmio_access(mr);
+            release_lock |= prepare_mmio_access(mr, true);
             l = memory_access_size(mr, l, addr1);
             /* XXX: could force current_cpu to NULL to avoid
                potential bugs */
@@ -3328,7 +3353,7 @@ MemTxResult flatview_read_continue(FlatView *fv, hwaddr addr,
     for (;;) {
         if (!memory_access_is_direct(mr, false)) {
             /* I/O case */
-            release_lock |= prepare_mmio_access(mr);
+            release_lock |= prepare_mmio_access(mr, false);
             l = memory_access_size(mr, l, addr1);
             result |= memory_region_dispatch_read(mr, addr1, &val,
                                                   size_memop(l), attrs);
@@ -84,6 +84,7 @@ this code that are retained.
  */
 #include "qemu/osdep.h"
 #include <math.h>
+#include <float.h>
 #include "qemu/bitops.h"
 #include "fpu/softfloat.h"
 
@@ -414,6 +415,97 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * floatx80 hardfloat needs a host long double that is the very same
+ * format, i.e. x87 extended precision on an x86 host. The x87 precision
+ * control is checked at startup (see softfloat_init); results are only
+ * correct as is when the guest rounds to the full 64-bit significand.
+ *
+ * Infinite results are left to soft-fp too, since some targets encode
+ * floatx80 infinities differently from the host.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && LDBL_MANT_DIG == 64
+# define QEMU_HARDFLOAT_FLOATX80 1
+#else
+# define QEMU_HARDFLOAT_FLOATX80 0
+#endif
+
+static bool force_soft_floatx80;
+
+typedef union {
+    floatx80 s;
+    long double h;
+} union_floatx80;
+
+typedef bool (*fx80_check_fn)(union_floatx80 a, union_floatx80 b);
+typedef floatx80 (*soft_fx80_op2_fn)(floatx80 a, floatx80 b, float_status *s);
+typedef long double (*hard_fx80_op2_fn)(long double a, long double b);
+
+static inline bool can_use_fpu_floatx80(const float_status *s)
+{
+    if (!QEMU_HARDFLOAT_FLOATX80 || unlikely(force_soft_floatx80)) {
+        return false;
+    }
+    /* as in roundAndPackFloatx80, anything but 32 and 64 means 80 bits */
+    return can_use_fpu(s) && s->floatx80_rounding_precision != 32 &&
+           s->floatx80_rounding_precision != 64;
+}
+
+static inline bool fx80_is_zero(union_floatx80 a)
+{
+    return (a.s.high & 0x7fff) == 0 && a.s.low == 0;
+}
+
+/* Normal numbers must have the integer bit set; unnormals are invalid */
+static inline bool fx80_is_normal(union_floatx80 a)
+{
+    uint32_t exp = a.s.high & 0x7fff;
+
+    return exp != 0 && exp != 0x7fff && (a.s.low >> 63);
+}
+
+static inline bool fx80_is_zon(union_floatx80 a)
+{
+    return fx80_is_zero(a) || fx80_is_normal(a);
+}
+
+static inline bool fx80_is_zon2(union_floatx80 a, union_floatx80 b)
+{
+    return fx80_is_zon(a) && fx80_is_zon(b);
+}
+
+/* Note: @post can be NULL */
+static inline floatx80
+floatx80_gen2(floatx80 xa, floatx80 xb, float_status *s,
+              hard_fx80_op2_fn hard, soft_fx80_op2_fn soft,
+              fx80_check_fn pre, fx80_check_fn post)
+{
+    union_floatx80 ua, ub, ur;
+
+    ua.s = xa;
+    ub.s = xb;
+
+    if (unlikely(!can_use_fpu_floatx80(s))) {
+        goto soft;
+    }
+    if (unlikely(!pre(ua, ub))) {
+        goto soft;
+    }
+
+    ur.h = hard(ua.h, ub.h);
+    if (unlikely(isinf(ur.h))) {
+        goto soft;
+    } else if (unlikely(fabsl(ur.h) <= LDBL_MIN)) {
+        if (post == NULL || post(ua, ub)) {
+            goto soft;
+        }
+    }
+    return ur.s;
+
+ soft:
+    return soft(ua.s, ub.s, s);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the fraction bits of the single-precision floating-point value `a'.
 *----------------------------------------------------------------------------*/
@@ -1920,13 +2012,38 @@ float16 float32_to_float16(float32 a, bool ieee, float_status *s)
     return float16a_round_pack_canonical(pr, s, fmt16);
 }
 
-float64 float32_to_float64(float32 a, float_status *s)
+static float64 QEMU_SOFTFLOAT_ATTR
+soft_float32_to_float64(float32 a, float_status *s)
 {
     FloatParts p = float32_unpack_canonical(a, s);
     FloatParts pr = float_to_float(p, &float64_params, s);
     return float64_round_pack_canonical(pr, s);
 }
 
+float64 float32_to_float64(float32 a, float_status *s)
+{
+    union_float32 ua;
+    union_float64 ur;
+
+    ua.s = a;
+    if (QEMU_NO_HARDFLOAT) {
+        goto soft;
+    }
+    /*
+     * Widening is exact and raises no flags, regardless of the rounding
+     * mode; only NaNs need the target-specific handling of soft-fp.
+     */
+    float32_input_flush1(&ua.s, s);
+    if (unlikely(float32_is_any_nan(ua.s))) {
+        goto soft;
+    }
+    ur.h = ua.h;
+    return ur.s;
+
+ soft:
+    return soft_float32_to_float64(ua.s, s);
+}
+
 float16 float64_to_float16(float64 a, bool ieee, float_status *s)
 {
     const FloatFmt *fmt16 = ieee ? &float16_params : &float16_params_ahp;
@@ -1935,13 +2052,42 @@ float16 float64_to_float16(float64 a, bool ieee, float_status *s)
     return float16a_round_pack_canonical(pr, s, fmt16);
 }
 
-float32 float64_to_float32(float64 a, float_status *s)
+static float32 QEMU_SOFTFLOAT_ATTR
+soft_float64_to_float32(float64 a, float_status *s)
 {
     FloatParts p = float64_unpack_canonical(a, s);
     FloatParts pr = float_to_float(p, &float32_params, s);
     return float32_round_pack_canonical(pr, s);
 }
 
+float32 float64_to_float32(float64 a, float_status *s)
+{
+    union_float64 ua;
+    union_float32 ur;
+
+    ua.s = a;
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float64_input_flush1(&ua.s, s);
+    if (unlikely(!float64_is_zero_or_normal(ua.s))) {
+        goto soft;
+    }
+
+    ur.h = ua.h;
+    if (unlikely(f32_is_inf(ur))) {
+        s->float_exception_flags |= float_flag_overflow;
+    } else if (unlikely(fabsf(ur.h) <= FLT_MIN) &&
+               !float64_is_zero(ua.s)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft_float64_to_float32(ua.s, s);
+}
+
 /*
  * Rounds the floating-point value `a' to an integer, and returns the
  * result as a floating-point value. The operation is performed
@@ -2191,6 +2337,69 @@ int64_t float64_to_int64_scalbn(float64 a, int rmode, int scale,
                                  rmode, scale, INT64_MIN, INT64_MAX, s);
 }
 
+/*
+ * Hardfloat conversions to signed integers, for round-to-zero and for
+ * the current rounding mode when that is nearest-even. The exactness of
+ * the conversion is checked on the host, so the inexact flag need not be
+ * set beforehand. Out-of-range and NaN inputs fail the range check and
+ * are left to soft-fp, which raises invalid and saturates.
+ *
+ * @limit is 2**(N-1) for an N-bit result; it is exact as a double.
+ */
+static inline bool f32_to_int_hard(float32 a, bool round_to_zero,
+                                   double limit, int64_t *ret,
+                                   float_status *s)
+{
+    union_float32 ua;
+    double r;
+
+    if (QEMU_NO_HARDFLOAT) {
+        return false;
+    }
+    if (!round_to_zero &&
+        s->float_rounding_mode != float_round_nearest_even) {
+        return false;
+    }
+    ua.s = a;
+    float32_input_flush1(&ua.s, s);
+    r = round_to_zero ? trunc(ua.h) : rint(ua.h);
+    if (unlikely(!(r >= -limit && r < limit))) {
+        return false;
+    }
+    if (r != ua.h) {
+        s->float_exception_flags |= float_flag_inexact;
+    }
+    *ret = r;
+    return true;
+}
+
+static inline bool f64_to_int_hard(float64 a, bool round_to_zero,
+                                   double limit, int64_t *ret,
+                                   float_status *s)
+{
+    union_float64 ua;
+    double r;
+
+    if (QEMU_NO_HARDFLOAT) {
+        return false;
+    }
+    if (!round_to_zero &&
+        s->float_rounding_mode != float_round_nearest_even) {
+        return false;
+    }
+    ua.s = a;
+    float64_input_flush1(&ua.s, s);
+    r = round_to_zero ? trunc(ua.h) : rint(ua.h);
+    if (unlikely(!(r >= -limit && r < limit))) {
+        return false;
+    }
+    if (r != ua.h) {
+        s->float_exception_flags |= float_flag_inexact;
+    }
+    *ret = r;
+    return true;
+}
+
 int16_t float16_to_int16(float16 a, float_status *s)
 {
     return float16_to_int16_scalbn(a, s->float_rounding_mode, 0, s);
@@ -2213,11 +2422,21 @@ int16_t float32_to_int16(float32 a, float_status *s)
 
 int32_t float32_to_int32(float32 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f32_to_int_hard(a, false, 2147483648.0, &r, s))) {
+        return r;
+    }
     return float32_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
 int64_t float32_to_int64(float32 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f32_to_int_hard(a, false, 9223372036854775808.0, &r, s))) {
+        return r;
+    }
     return float32_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
@@ -2228,11 +2447,21 @@ int16_t float64_to_int16(float64 a, float_status *s)
 
 int32_t float64_to_int32(float64 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f64_to_int_hard(a, false, 2147483648.0, &r, s))) {
+        return r;
+    }
     return float64_to_int32_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
 int64_t float64_to_int64(float64 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f64_to_int_hard(a, false, 9223372036854775808.0, &r, s))) {
+        return r;
+    }
     return float64_to_int64_scalbn(a, s->float_rounding_mode, 0, s);
 }
 
@@ -2258,11 +2487,21 @@ int16_t float32_to_int16_round_to_zero(float32 a, float_status *s)
 
 int32_t float32_to_int32_round_to_zero(float32 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f32_to_int_hard(a, true, 2147483648.0, &r, s))) {
+        return r;
+    }
     return float32_to_int32_scalbn(a, float_round_to_zero, 0, s);
 }
 
 int64_t float32_to_int64_round_to_zero(float32 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f32_to_int_hard(a, true, 9223372036854775808.0, &r, s))) {
+        return r;
+    }
     return float32_to_int64_scalbn(a, float_round_to_zero, 0, s);
 }
 
@@ -2273,11 +2512,21 @@ int16_t float64_to_int16_round_to_zero(float64 a, float_status *s)
 
 int32_t float64_to_int32_round_to_zero(float64 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f64_to_int_hard(a, true, 2147483648.0, &r, s))) {
+        return r;
+    }
     return float64_to_int32_scalbn(a, float_round_to_zero, 0, s);
 }
 
 int64_t float64_to_int64_round_to_zero(float64 a, float_status *s)
 {
+    int64_t r;
+
+    if (likely(f64_to_int_hard(a, true, 9223372036854775808.0, &r, s))) {
+        return r;
+    }
     return float64_to_int64_scalbn(a, float_round_to_zero, 0, s);
 }
 
@@ -2575,16 +2824,37 @@ float32 int16_to_float32_scalbn(int16_t a, int scale, float_status *status)
 
 float32 int64_to_float32(int64_t a, float_status *status)
 {
+    union_float32 ur;
+
+    /* no overflow or underflow; the inexact flag is already set */
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float32_scalbn(a, 0, status);
 }
 
 float32 int32_to_float32(int32_t a, float_status *status)
 {
+    union_float32 ur;
+
+    /* no overflow or underflow; the inexact flag is already set */
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float32_scalbn(a, 0, status);
 }
 
 float32 int16_to_float32(int16_t a, float_status *status)
 {
+    union_float32 ur;
+
+    /* exact, no flags are raised */
+    if (likely(!QEMU_NO_HARDFLOAT)) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float32_scalbn(a, 0, status);
 }
 
@@ -2606,16 +2876,37 @@ float64 int16_to_float64_scalbn(int16_t a, int scale, float_status *status)
 
 float64 int64_to_float64(int64_t a, float_status *status)
 {
+    union_float64 ur;
+
+    /* no overflow or underflow; the inexact flag is already set */
+    if (likely(can_use_fpu(status))) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float64_scalbn(a, 0, status);
 }
 
 float64 int32_to_float64(int32_t a, float_status *status)
 {
+    union_float64 ur;
+
+    /* exact, no flags are raised */
+    if (likely(!QEMU_NO_HARDFLOAT)) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float64_scalbn(a, 0, status);
 }
 
 float64 int16_to_float64(int16_t a, float_status *status)
 {
+    union_float64 ur;
+
+    /* exact, no flags are raised */
+    if (likely(!QEMU_NO_HARDFLOAT)) {
+        ur.h = a;
+        return ur.s;
+    }
     return int64_to_float64_scalbn(a, 0, status);
 }
 
@@ -4764,6 +5055,54 @@ float32 float32_log2(float32 a, float_status *status)
     return normalizeRoundAndPackFloat32(zSign, 0x85, zSig, status);
 }
 
+/*
+ * Hardfloat predicates. Ordered operands, including denormals when inputs
+ * are not flushed, compare on the host without raising any flag; NaNs are
+ * left to soft-fp, which tells signaling from quiet ones.
+ *
+ * Returns the result of the predicate, or -1 if soft-fp must compute it.
+ * Input denormals are squashed in place either way.
+ */
+typedef bool (*hard_f32_pred_fn)(float a, float b);
+
+static inline bool f32_eq_hard(float a, float b)
+{
+    return a == b;
+}
+
+static inline bool f32_le_hard(float a, float b)
+{
+    return islessequal(a, b);
+}
+
+static inline bool f32_lt_hard(float a, float b)
+{
+    return isless(a, b);
+}
+
+static inline bool f32_unordered_hard(float a, float b)
+{
+    return isunordered(a, b);
+}
+
+static inline int f32_pred(float32 *a, float32 *b, float_status *s,
+                           hard_f32_pred_fn hard)
+{
+    union_float32 ua, ub;
+
+    *a = float32_squash_input_denormal(*a, s);
+    *b = float32_squash_input_denormal(*b, s);
+    if (QEMU_NO_HARDFLOAT) {
+        return -1;
+    }
+    ua.s = *a;
+    ub.s = *b;
+    if (unlikely(isunordered(ua.h, ub.h))) {
+        return -1;
+    }
+    return hard(ua.h, ub.h);
+}
+
 /*----------------------------------------------------------------------------
 | Returns 1 if the single-precision floating-point value `a' is equal to
 | the corresponding value `b', and 0 otherwise.  The invalid exception is
@@ -4774,8 +5113,11 @@ float32 float32_log2(float32 a, float_status *status)
 int float32_eq(float32 a, float32 b, float_status *status)
 {
     uint32_t av, bv;
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4799,8 +5141,11 @@ int float32_le(float32 a, float32 b, float_status *status)
 {
     flag aSign, bSign;
     uint32_t av, bv;
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4828,8 +5173,11 @@ int float32_lt(float32 a, float32 b, float_status *status)
 {
     flag aSign, bSign;
     uint32_t av, bv;
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4855,8 +5203,11 @@ int float32_lt(float32 a, float32 b, float_status *status)
 
 int float32_unordered(float32 a, float32 b, float_status *status)
 {
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_unordered_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4876,8 +5227,11 @@ int float32_unordered(float32 a, float32 b, float_status *status)
 
 int float32_eq_quiet(float32 a, float32 b, float_status *status)
 {
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4903,8 +5257,11 @@ int float32_le_quiet(float32 a, float32 b, float_status *status)
 {
     flag aSign, bSign;
     uint32_t av, bv;
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4935,8 +5292,11 @@ int float32_lt_quiet(float32 a, float32 b, float_status *status)
 {
     flag aSign, bSign;
     uint32_t av, bv;
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4965,8 +5325,11 @@ int float32_lt_quiet(float32 a, float32 b, float_status *status)
 
 int float32_unordered_quiet(float32 a, float32 b, float_status *status)
 {
-    a = float32_squash_input_denormal(a, status);
-    b = float32_squash_input_denormal(b, status);
+    int r = f32_pred(&a, &b, status, f32_unordered_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat32Exp( a ) == 0xFF ) && extractFloat32Frac( a ) )
          || ( ( extractFloat32Exp( b ) == 0xFF ) && extractFloat32Frac( b ) )
@@ -4987,7 +5350,8 @@ int float32_unordered_quiet(float32 a, float32 b, float_status *status)
 | Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 float64_to_floatx80(float64 a, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_float64_to_floatx80(float64 a, float_status *status)
 {
     flag aSign;
     int aExp;
@@ -5015,6 +5379,27 @@ floatx80 float64_to_floatx80(float64 a, float_status *status)
 
 }
 
+floatx80 float64_to_floatx80(float64 a, float_status *s)
+{
+    union_float64 ua;
+    union_floatx80 ur;
+
+    ua.s = a;
+    if (!QEMU_HARDFLOAT_FLOATX80 || QEMU_NO_HARDFLOAT) {
+        goto soft;
+    }
+    /* exact and flag-free; inf and NaN encodings are target-specific */
+    float64_input_flush1(&ua.s, s);
+    if (unlikely(!float64_is_zero_or_normal(ua.s))) {
+        goto soft;
+    }
+    ur.h = ua.h;
+    return ur.s;
+
+ soft:
+    return soft_float64_to_floatx80(ua.s, s);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the result of converting the double-precision floating-point value
 | `a' to the quadruple-precision floating-point format.  The conversion is
@@ -5186,6 +5571,54 @@ float64 float64_log2(float64 a, float_status *status)
     return normalizeRoundAndPackFloat64(zSign, 0x408, zSig, status);
 }
 
+/*
+ * Hardfloat predicates. Ordered operands, including denormals when inputs
+ * are not flushed, compare on the host without raising any flag; NaNs are
+ * left to soft-fp, which tells signaling from quiet ones.
+ *
+ * Returns the result of the predicate, or -1 if soft-fp must compute it.
+ * Input denormals are squashed in place either way.
+ */
+typedef bool (*hard_f64_pred_fn)(double a, double b);
+
+static inline bool f64_eq_hard(double a, double b)
+{
+    return a == b;
+}
+
+static inline bool f64_le_hard(double a, double b)
+{
+    return islessequal(a, b);
+}
+
+static inline bool f64_lt_hard(double a, double b)
+{
+    return isless(a, b);
+}
+
+static inline bool f64_unordered_hard(double a, double b)
+{
+    return isunordered(a, b);
+}
+
+static inline int f64_pred(float64 *a, float64 *b, float_status *s,
+                           hard_f64_pred_fn hard)
+{
+    union_float64 ua, ub;
+
+    *a = float64_squash_input_denormal(*a, s);
+    *b = float64_squash_input_denormal(*b, s);
+    if (QEMU_NO_HARDFLOAT) {
+        return -1;
+    }
+    ua.s = *a;
+    ub.s = *b;
+    if (unlikely(isunordered(ua.h, ub.h))) {
+        return -1;
+    }
+    return hard(ua.h, ub.h);
+}
+
 /*----------------------------------------------------------------------------
 | Returns 1 if the double-precision floating-point value `a' is equal to the
 | corresponding value `b', and 0 otherwise.  The invalid exception is raised
@@ -5196,8 +5629,11 @@ float64 float64_log2(float64 a, float_status *status)
 int float64_eq(float64 a, float64 b, float_status *status)
 {
     uint64_t av, bv;
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5222,8 +5658,11 @@ int float64_le(float64 a, float64 b, float_status *status)
 {
     flag aSign, bSign;
     uint64_t av, bv;
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5252,8 +5691,11 @@ int float64_lt(float64 a, float64 b, float_status *status)
     flag aSign, bSign;
     uint64_t av, bv;
 
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
        ) {
@@ -5278,8 +5720,11 @@ int float64_lt(float64 a, float64 b, float_status *status)
 
 int float64_unordered(float64 a, float64 b, float_status *status)
 {
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_unordered_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5300,8 +5745,11 @@ int float64_unordered(float64 a, float64 b, float_status *status)
 int float64_eq_quiet(float64 a, float64 b, float_status *status)
 {
     uint64_t av, bv;
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5329,8 +5777,11 @@ int float64_le_quiet(float64 a, float64 b, float_status *status)
 {
     flag aSign, bSign;
     uint64_t av, bv;
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5361,8 +5812,11 @@ int float64_lt_quiet(float64 a, float64 b, float_status *status)
 {
     flag aSign, bSign;
     uint64_t av, bv;
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5391,8 +5845,11 @@ int float64_lt_quiet(float64 a, float64 b, float_status *status)
 
 int float64_unordered_quiet(float64 a, float64 b, float_status *status)
 {
-    a = float64_squash_input_denormal(a, status);
-    b = float64_squash_input_denormal(b, status);
+    int r = f64_pred(&a, &b, status, f64_unordered_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (    ( ( extractFloat64Exp( a ) == 0x7FF ) && extractFloat64Frac( a ) )
          || ( ( extractFloat64Exp( b ) == 0x7FF ) && extractFloat64Frac( b ) )
@@ -5618,7 +6075,8 @@ float32 floatx80_to_float32(floatx80 a, float_status *status)
 | Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-float64 floatx80_to_float64(floatx80 a, float_status *status)
+static float64 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_to_float64(floatx80 a, float_status *status)
 {
     flag aSign;
     int32_t aExp;
@@ -5643,6 +6101,31 @@ float64 floatx80_to_float64(floatx80 a, float_status *status)
 
 }
 
+float64 floatx80_to_float64(floatx80 a, float_status *s)
+{
+    union_floatx80 ua;
+    union_float64 ur;
+
+    ua.s = a;
+    if (!QEMU_HARDFLOAT_FLOATX80 || unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+    if (unlikely(!fx80_is_zon(ua))) {
+        goto soft;
+    }
+
+    ur.h = ua.h;
+    if (unlikely(f64_is_inf(ur))) {
+        s->float_exception_flags |= float_flag_overflow;
+    } else if (unlikely(fabs(ur.h) <= DBL_MIN) && !fx80_is_zero(ua)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft_floatx80_to_float64(ua.s, s);
+}
+
 /*----------------------------------------------------------------------------
 | Returns the result of converting the extended double-precision floating-
 | point value `a' to the quadruple-precision floating-point format.  The
@@ -5931,7 +6414,8 @@ static floatx80 subFloatx80Sigs(floatx80 a, floatx80 b, flag zSign,
 | Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_add(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_add(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
 
@@ -5956,7 +6440,8 @@ floatx80 floatx80_add(floatx80 a, floatx80 b, float_status *status)
 | IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_sub(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
 
@@ -5981,7 +6466,8 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
 | IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_mul(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign, zSign;
     int32_t aExp, bExp, zExp;
@@ -6043,7 +6529,8 @@ floatx80 floatx80_mul(floatx80 a, floatx80 b, float_status *status)
 | according to the IEC/IEEE Standard for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_div(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign, zSign;
     int32_t aExp, bExp, zExp;
@@ -6229,7 +6716,8 @@ floatx80 floatx80_rem(floatx80 a, floatx80 b, float_status *status)
 | for Binary Floating-Point Arithmetic.
 *----------------------------------------------------------------------------*/
 
-floatx80 floatx80_sqrt(floatx80 a, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_floatx80_sqrt(floatx80 a, float_status *status)
 {
     flag aSign;
     int32_t aExp, zExp;
@@ -6294,6 +6782,131 @@ floatx80 floatx80_sqrt(floatx80 a, float_status *status)
                                 0, zExp, zSig0, zSig1, status);
 }
 
+static long double hard_floatx80_add(long double a, long double b)
+{
+    return a + b;
+}
+
+static long double hard_floatx80_sub(long double a, long double b)
+{
+    return a - b;
+}
+
+static long double hard_floatx80_mul(long double a, long double b)
+{
+    return a * b;
+}
+
+static long double hard_floatx80_div(long double a, long double b)
+{
+    return a / b;
+}
+
+static bool fx80_addsub_post(union_floatx80 a, union_floatx80 b)
+{
+    return !(fx80_is_zero(a) && fx80_is_zero(b));
+}
+
+static bool fx80_mul_post(union_floatx80 a, union_floatx80 b)
+{
+    return !(fx80_is_zero(a) || fx80_is_zero(b));
+}
+
+static bool fx80_div_pre(union_floatx80 a, union_floatx80 b)
+{
+    return fx80_is_zon(a) && fx80_is_normal(b);
+}
+
+static bool fx80_div_post(union_floatx80 a, union_floatx80 b)
+{
+    return !fx80_is_zero(a);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_add(floatx80 a, floatx80 b, float_status *s)
+{
+    return floatx80_gen2(a, b, s, hard_floatx80_add, soft_floatx80_add,
+                         fx80_is_zon2, fx80_addsub_post);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_sub(floatx80 a, floatx80 b, float_status *s)
+{
+    return floatx80_gen2(a, b, s, hard_floatx80_sub, soft_floatx80_sub,
+                         fx80_is_zon2, fx80_addsub_post);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_mul(floatx80 a, floatx80 b, float_status *s)
+{
+    return floatx80_gen2(a, b, s, hard_floatx80_mul, soft_floatx80_mul,
+                         fx80_is_zon2, fx80_mul_post);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_div(floatx80 a, floatx80 b, float_status *s)
+{
+    return floatx80_gen2(a, b, s, hard_floatx80_div, soft_floatx80_div,
+                         fx80_div_pre, fx80_div_post);
+}
+
+floatx80 QEMU_FLATTEN floatx80_sqrt(floatx80 xa, float_status *s)
+{
+    union_floatx80 ua, ur;
+
+    ua.s = xa;
+    if (unlikely(!can_use_fpu_floatx80(s))) {
+        goto soft;
+    }
+    /* the square root of a positive normal number is normal */
+    if (unlikely(!fx80_is_zon(ua) ||
+                 (floatx80_is_neg(ua.s) && !fx80_is_zero(ua)))) {
+        goto soft;
+    }
+    ur.h = sqrtl(ua.h);
+    return ur.s;
+
+ soft:
+    return soft_floatx80_sqrt(ua.s, s);
+}
+
+/*
+ * Predicates on zero or normal floatx80 operands are computed on the host,
+ * where they raise no flags; everything else is left to soft-fp. Returns
+ * the result of the predicate, or -1 if soft-fp must compute it.
+ */
+typedef bool (*hard_fx80_pred_fn)(long double a, long double b);
+
+static inline bool fx80_eq_hard(long double a, long double b)
+{
+    return a == b;
+}
+
+static inline bool fx80_le_hard(long double a, long double b)
+{
+    return islessequal(a, b);
+}
+
+static inline bool fx80_lt_hard(long double a, long double b)
+{
+    return isless(a, b);
+}
+
+static inline int fx80_pred(floatx80 a, floatx80 b, hard_fx80_pred_fn hard)
+{
+    union_floatx80 ua, ub;
+
+    if (!QEMU_HARDFLOAT_FLOATX80 || QEMU_NO_HARDFLOAT) {
+        return -1;
+    }
+    ua.s = a;
+    ub.s = b;
+    if (unlikely(!fx80_is_zon2(ua, ub))) {
+        return -1;
+    }
+    return hard(ua.h, ub.h);
+}
+
 /*----------------------------------------------------------------------------
 | Returns 1 if the extended double-precision floating-point value `a' is equal
 | to the corresponding value `b', and 0 otherwise.  The invalid exception is
@@ -6303,6 +6916,11 @@ floatx80 floatx80_sqrt(floatx80 a, float_status *status)
 
 int floatx80_eq(floatx80 a, floatx80 b, float_status *status)
 {
+    int r = fx80_pred(a, b, fx80_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)
         || (extractFloatx80Exp(a) == 0x7FFF
@@ -6333,6 +6951,11 @@ int floatx80_eq(floatx80 a, floatx80 b, float_status *status)
 int floatx80_le(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+    int r = fx80_pred(a, b, fx80_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)
         || (extractFloatx80Exp(a) == 0x7FFF
@@ -6367,6 +6990,11 @@ int floatx80_le(floatx80 a, floatx80 b, float_status *status)
 int floatx80_lt(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+    int r = fx80_pred(a, b, fx80_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)
         || (extractFloatx80Exp(a) == 0x7FFF
@@ -6420,6 +7048,11 @@ int floatx80_unordered(floatx80 a, floatx80 b, float_status *status)
 
 int floatx80_eq_quiet(floatx80 a, floatx80 b, float_status *status)
 {
+    int r = fx80_pred(a, b, fx80_eq_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -6455,6 +7088,11 @@ int floatx80_eq_quiet(floatx80 a, floatx80 b, float_status *status)
 int floatx80_le_quiet(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+    int r = fx80_pred(a, b, fx80_le_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -6495,6 +7133,11 @@ int floatx80_le_quiet(floatx80 a, floatx80 b, float_status *status)
 int floatx80_lt_quiet(floatx80 a, floatx80 b, float_status *status)
 {
     flag aSign, bSign;
+    int r = fx80_pred(a, b, fx80_lt_hard);
+
+    if (likely(r >= 0)) {
+        return r;
+    }
 
     if (floatx80_invalid_encoding(a) || floatx80_invalid_encoding(b)) {
         float_raise(float_flag_invalid, status);
@@ -8084,4 +8727,16 @@ static void __attribute__((constructor)) softfloat_init(void)
     if (ur.s != 0x0020000000000001ULL) {
         force_soft_fma = true;
     }
+
+    /*
+     * floatx80 hardfloat relies on the x87 precision control being set
+     * to 64-bit significands, which is the default on Linux and BSD hosts.
+     */
+    if (QEMU_HARDFLOAT_FLOATX80) {
+        volatile long double one = 1.0L;
+
+        if (one + LDBL_EPSILON == one) {
+            force_soft_floatx80 = true;
+        }
+    }
 }
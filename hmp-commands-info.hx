@@ -311,6 +311,47 @@ STEXI
 @item info opcount
 @findex info opcount
 Show dynamic compiler opcode counters
+ETEXI
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-stats",
+        .args_type  = "translations:-t,expansion:-e,max:i?",
+        .params     = "[-t] [-e] [max]",
+        .help       = "show the most executed translation blocks, up to max "
+                      "entries (default: 10); "
+                      "-t: sort by translation count; "
+                      "-e: sort by host code expansion",
+        .cmd        = hmp_info_tb_stats,
+    },
+#endif
+
+STEXI
+@item info tb-stats [-t|-e] [@var{max}]
+@findex info tb-stats
+Show per-translation-block statistics, up to @var{max} entries (default: 10),
+sorted by execution count. Collection must be enabled with @code{tb-stats on}.
+        -t: sort by number of translations
+        -e: sort by host bytes per guest byte
+ETEXI
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb",
+        .args_type  = "id:i",
+        .params     = "id",
+        .help       = "show details and disassembly of a translation block "
+                      "from the last 'info tb-stats' report",
+        .cmd        = hmp_info_tb,
+    },
+#endif
+
+STEXI
+@item info tb @var{id}
+@findex info tb
+Show the statistics of entry @var{id} of the last @code{info tb-stats}
+report, followed by the guest code disassembled with the current CPU's
+mappings and the host code of its most recent translation.
 ETEXI
 
     {
@@ -608,6 +649,35 @@ STEXI
 @item info migrate_cache_size
 @findex info migrate_cache_size
 Show current migration xbzrle cache size.
+ETEXI
+
+    {
+        .name       = "dirty_rate",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show the result of the last dirty rate measurement",
+        .cmd        = hmp_info_dirty_rate,
+    },
+
+STEXI
+@item info dirty_rate
+@findex info dirty_rate
+Show the result of the last guest dirty page rate measurement.
+ETEXI
+
+    {
+        .name       = "vmstate_timing",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show the time spent saving and loading each device",
+        .cmd        = hmp_info_vmstate_timing,
+    },
+
+STEXI
+@item info vmstate_timing
+@findex info vmstate_timing
+Show the time spent saving and loading the state of each device section
+during the last migration or snapshot.
 ETEXI
 
     {
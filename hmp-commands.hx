@@ -681,6 +681,25 @@ STEXI
 @findex sync-profile
 Enable, disable or reset synchronization profiling. With no arguments, prints
 whether profiling is on or off.
+ETEXI
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-stats",
+        .args_type  = "op:s?",
+        .params     = "[on|off|reset]",
+        .help       = "enable, disable or reset per-TB statistics. "
+                      "With no arguments, prints whether they are on or off.",
+        .cmd        = hmp_tb_stats,
+    },
+#endif
+
+STEXI
+@item tb-stats [on|off|reset]
+@findex tb-stats
+Enable, disable or reset the collection of per-translation-block statistics.
+Turning collection on or off flushes the translation cache. With no
+arguments, prints whether collection is on or off.
 ETEXI
 
     {
@@ -1141,6 +1160,21 @@ STEXI
 @item migrate_set_parameter @var{parameter} @var{value}
 @findex migrate_set_parameter
 Set the parameter @var{parameter} for migration.
+ETEXI
+
+    {
+        .name       = "calc_dirty_rate",
+        .args_type  = "second:l",
+        .params     = "second",
+        .help       = "measure the guest dirty page rate over 'second' seconds",
+        .cmd        = hmp_calc_dirty_rate,
+    },
+
+STEXI
+@item calc_dirty_rate @var{second}
+@findex calc_dirty_rate
+Measure the rate at which the guest dirties its memory during @var{second}
+seconds, without migrating it.  Use @code{info dirty_rate} to see the result.
 ETEXI
 
     {
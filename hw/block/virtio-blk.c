@@ -1172,7 +1172,10 @@ static void virtio_blk_device_realize(DeviceState *dev, Error **errp)
     s->sector_mask = (s->conf.conf.logical_block_size / BDRV_SECTOR_SIZE) - 1;
 
     for (i = 0; i < conf->num_queues; i++) {
-        virtio_add_queue(vdev, conf->queue_size, virtio_blk_handle_output);
+        VirtQueue *vq = virtio_add_queue(vdev, conf->queue_size,
+                                         virtio_blk_handle_output);
+
+        virtio_queue_set_coalesce(vq, &conf->coalesce);
     }
     virtio_blk_data_plane_create(vdev, conf, &s->dataplane, &err);
     if (err != NULL) {
@@ -1244,6 +1247,10 @@ static Property virtio_blk_properties[] = {
                        conf.max_discard_sectors, BDRV_REQUEST_MAX_SECTORS),
     DEFINE_PROP_UINT32("max-write-zeroes-sectors", VirtIOBlock,
                        conf.max_write_zeroes_sectors, BDRV_REQUEST_MAX_SECTORS),
+    DEFINE_PROP_VIRTIO_COALESCE("coalesce-usecs", VirtIOBlock,
+                                conf.coalesce.usecs),
+    DEFINE_PROP_VIRTIO_COALESCE("coalesce-max-reqs", VirtIOBlock,
+                                conf.coalesce.max_used),
     DEFINE_PROP_END_OF_LIST(),
 };
 
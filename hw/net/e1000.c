@@ -31,6 +31,8 @@
 #include "migration/vmstate.h"
 #include "net/net.h"
 #include "net/checksum.h"
+#include "net/eth.h"
+#include "net/tap.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/dma.h"
 #include "qemu/iov.h"
@@ -124,6 +126,9 @@ typedef struct E1000State_st {
 
     QEMUTimer *flush_queue_timer;
 
+    bool disable_vnet;
+    bool has_vnet;             /* Peer takes frames with a virtio-net header */
+
 /* Compatibility flags for migration to/from qemu 1.3.0 and older */
 #define E1000_FLAG_AUTONEG_BIT 0
 #define E1000_FLAG_MIT_BIT 1
@@ -539,15 +544,31 @@ inc_tx_bcast_or_mcast_count(E1000State *s, const unsigned char *arr)
     }
 }
 
+static ssize_t
+e1000_receive_frame(E1000State *s, const struct iovec *iov, int iovcnt);
+
 static void
-e1000_send_packet(E1000State *s, const uint8_t *buf, int size)
+e1000_send_packet(E1000State *s, const uint8_t *buf, int size,
+                  struct virtio_net_hdr *vhdr)
 {
     static const int PTCregs[6] = { PTC64, PTC127, PTC255, PTC511,
                                     PTC1023, PTC1522 };
 
     NetClientState *nc = qemu_get_queue(s->nic);
+    struct iovec iov[2];
+    struct virtio_net_hdr zero_hdr = {
+        .flags = 0,
+        .gso_type = VIRTIO_NET_HDR_GSO_NONE
+    };
+
+    iov[1].iov_base = (uint8_t *)buf;
+    iov[1].iov_len = size;
     if (s->phy_reg[PHY_CTRL] & MII_CR_LOOPBACK) {
-        nc->info->receive(nc, buf, size);
+        e1000_receive_frame(s, &iov[1], 1);
+    } else if (s->has_vnet) {
+        iov[0].iov_base = vhdr ? vhdr : &zero_hdr;
+        iov[0].iov_len = sizeof(struct virtio_net_hdr);
+        qemu_sendv_packet(nc, iov, 2);
     } else {
         qemu_send_packet(nc, buf, size);
     }
@@ -555,6 +576,95 @@ e1000_send_packet(E1000State *s, const uint8_t *buf, int size)
     e1000x_increase_size_stats(s->mac_reg, PTCregs, size);
 }
 
+/*
+ * Whether the frame being assembled can go to the peer in one piece, with
+ * the segmentation and checksum work described in a virtio-net header.
+ */
+static bool
+e1000_tx_offload_ok(E1000State *s)
+{
+    struct e1000_tx *tp = &s->tx;
+    NetClientState *nc = qemu_get_queue(s->nic);
+
+    if (!s->has_vnet || (s->phy_reg[PHY_CTRL] & MII_CR_LOOPBACK)) {
+        return false;
+    }
+    if (!tp->cptse) {
+        return true;
+    }
+    return (tp->sum_needed & E1000_TXD_POPTS_TXSM) && tp->tso_props.mss &&
+           tp->tso_props.hdr_len + tp->tso_props.paylen < sizeof(tp->data) &&
+           (tp->tso_props.tcp || qemu_has_ufo(nc->peer));
+}
+
+static void
+xmit_offload(E1000State *s)
+{
+    struct e1000_tx *tp = &s->tx;
+    struct e1000x_txd_props *props = tp->cptse ? &tp->tso_props : &tp->props;
+    struct virtio_net_hdr vhdr = {
+        .flags = 0,
+        .gso_type = VIRTIO_NET_HDR_GSO_NONE
+    };
+    unsigned int css, len, phsum;
+    unsigned int vlan_len = tp->vlan_needed ? 4 : 0;
+
+    if (tp->cptse) {
+        css = props->ipcss;
+        if (props->ip) {    /* IPv4 */
+            stw_be_p(tp->data + css + 2, tp->size - css);
+            vhdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+        } else {            /* IPv6 */
+            stw_be_p(tp->data + css + 4,
+                     tp->size - css - sizeof(struct ip6_header));
+            vhdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+        }
+        css = props->tucss;
+        len = tp->size - css;
+        if (!props->tcp) {
+            stw_be_p(tp->data + css + 4, len);
+            vhdr.gso_type = VIRTIO_NET_HDR_GSO_UDP;
+        }
+        /* the peer expects the pseudo-header sum to include the length */
+        phsum = lduw_be_p(tp->data + props->tucso) + len;
+        phsum = (phsum >> 16) + (phsum & 0xffff);
+        stw_be_p(tp->data + props->tucso, phsum);
+
+        vhdr.gso_size = props->mss;
+        vhdr.hdr_len = props->hdr_len + vlan_len;
+        e1000x_inc_reg_if_not_full(s->mac_reg, TSCTC);
+    }
+
+    if (tp->sum_needed & E1000_TXD_POPTS_TXSM) {
+        if (tp->cptse || !props->tucse || props->tucse + 1 >= tp->size) {
+            vhdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+            vhdr.csum_start = props->tucss + vlan_len;
+            vhdr.csum_offset = props->tucso - props->tucss;
+        } else {
+            /* the sum stops short of the end of the frame */
+            putsum(tp->data, tp->size, props->tucso, props->tucss,
+                   props->tucse);
+        }
+    }
+    if (tp->sum_needed & E1000_TXD_POPTS_IXSM) {
+        putsum(tp->data, tp->size, props->ipcso, props->ipcss, props->ipcse);
+    }
+    if (tp->vlan_needed) {
+        memmove(tp->vlan, tp->data, 4);
+        memmove(tp->data, tp->data + 4, 8);
+        memcpy(tp->data + 8, tp->vlan_header, 4);
+        e1000_send_packet(s, tp->vlan, tp->size + 4, &vhdr);
+    } else {
+        e1000_send_packet(s, tp->data, tp->size, &vhdr);
+    }
+
+    e1000x_inc_reg_if_not_full(s->mac_reg, TPT);
+    e1000x_grow_8reg_if_not_full(s->mac_reg, TOTL, s->tx.size);
+    s->mac_reg[GPTC] = s->mac_reg[TPT];
+    s->mac_reg[GOTCL] = s->mac_reg[TOTL];
+    s->mac_reg[GOTCH] = s->mac_reg[TOTH];
+}
+
 static void
 xmit_seg(E1000State *s)
 {
@@ -563,6 +673,11 @@ xmit_seg(E1000State *s)
     struct e1000_tx *tp = &s->tx;
     struct e1000x_txd_props *props = tp->cptse ? &tp->tso_props : &tp->props;
 
+    if (e1000_tx_offload_ok(s)) {
+        xmit_offload(s);
+        return;
+    }
+
     if (tp->cptse) {
         css = props->ipcss;
         DBGOUT(TXSUM, "frames %d size %d ipcss %d\n",
@@ -610,9 +725,9 @@ xmit_seg(E1000State *s)
         memmove(tp->vlan, tp->data, 4);
         memmove(tp->data, tp->data + 4, 8);
         memcpy(tp->data + 8, tp->vlan_header, 4);
-        e1000_send_packet(s, tp->vlan, tp->size + 4);
+        e1000_send_packet(s, tp->vlan, tp->size + 4, NULL);
     } else {
-        e1000_send_packet(s, tp->data, tp->size);
+        e1000_send_packet(s, tp->data, tp->size, NULL);
     }
 
     e1000x_inc_reg_if_not_full(s->mac_reg, TPT);
@@ -668,7 +783,10 @@ process_tx_desc(E1000State *s, struct e1000_tx_desc *dp)
 
     addr = le64_to_cpu(dp->buffer_addr);
     if (tp->cptse) {
-        msh = tp->tso_props.hdr_len + tp->tso_props.mss;
+        /* with offload to the peer, the frame is not split here */
+        if (!e1000_tx_offload_ok(s)) {
+            msh = tp->tso_props.hdr_len + tp->tso_props.mss;
+        }
         do {
             bytes = split_size;
             if (tp->size + bytes > msh)
@@ -872,9 +990,8 @@ e1000_receiver_overrun(E1000State *s, size_t size)
 }
 
 static ssize_t
-e1000_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
+e1000_receive_frame(E1000State *s, const struct iovec *iov, int iovcnt)
 {
-    E1000State *s = qemu_get_nic_opaque(nc);
     PCIDevice *d = PCI_DEVICE(s);
     struct e1000_rx_desc desc;
     dma_addr_t base;
@@ -1015,6 +1132,31 @@ e1000_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return size;
 }
 
+static ssize_t
+e1000_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
+{
+    E1000State *s = qemu_get_nic_opaque(nc);
+    struct iovec frame_iov[iovcnt];
+    size_t size;
+
+    if (!s->has_vnet) {
+        return e1000_receive_frame(s, iov, iovcnt);
+    }
+
+    /*
+     * Receive offloads are never enabled on the peer, so the header
+     * carries nothing the device could use.
+     */
+    size = iov_size(iov, iovcnt);
+    if (size < sizeof(struct virtio_net_hdr)) {
+        return size;
+    }
+    iovcnt = iov_copy(frame_iov, iovcnt, iov, iovcnt,
+                      sizeof(struct virtio_net_hdr),
+                      size - sizeof(struct virtio_net_hdr));
+    return e1000_receive_frame(s, frame_iov, iovcnt);
+}
+
 static ssize_t
 e1000_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
@@ -1677,6 +1819,18 @@ static void e1000_write_config(PCIDevice *pci_dev, uint32_t address,
     }
 }
 
+static void e1000_init_vnet(E1000State *s)
+{
+    NetClientState *nc = qemu_get_queue(s->nic);
+
+    s->has_vnet = !s->disable_vnet && qemu_has_vnet_hdr(nc->peer);
+    trace_e1000_cfg_support_virtio(s->has_vnet);
+    if (s->has_vnet) {
+        qemu_set_vnet_hdr_len(nc->peer, sizeof(struct virtio_net_hdr));
+        qemu_using_vnet_hdr(nc->peer, true);
+    }
+}
+
 static void pci_e1000_realize(PCIDevice *pci_dev, Error **errp)
 {
     DeviceState *dev = DEVICE(pci_dev);
@@ -1712,6 +1866,7 @@ static void pci_e1000_realize(PCIDevice *pci_dev, Error **errp)
                           object_get_typename(OBJECT(d)), dev->id, d);
 
     qemu_format_nic_info_str(qemu_get_queue(d->nic), macaddr);
+    e1000_init_vnet(d);
 
     d->autoneg_timer = timer_new_ms(QEMU_CLOCK_VIRTUAL, e1000_autoneg_timer, d);
     d->mit_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, e1000_mit_timer, d);
@@ -1735,6 +1890,7 @@ static Property e1000_properties[] = {
                     compat_flags, E1000_FLAG_MAC_BIT, true),
     DEFINE_PROP_BIT("migrate_tso_props", E1000State,
                     compat_flags, E1000_FLAG_TSO_BIT, true),
+    DEFINE_PROP_BOOL("disable_vnet_hdr", E1000State, disable_vnet, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
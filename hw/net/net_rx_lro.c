@@ -0,0 +1,180 @@
+/*
+ * QEMU software LRO for RX packets
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "net/checksum.h"
+#include "net_rx_lro.h"
+
+struct NetRxLro {
+    NetRxLroIndicate indicate;
+    void *opaque;
+
+    uint8_t *buf;
+    size_t len;             /* frame being coalesced, 0 if none */
+    uint32_t segs;
+    uint32_t csum;          /* partial sum of the coalesced payload */
+    uint32_t next_seq;
+};
+
+/* Headers of a frame that can be coalesced */
+typedef struct NetRxLroSeg {
+    struct ip_header *ip;
+    uint8_t *tcp;
+    size_t tcp_hlen;
+    size_t payload_len;
+    uint32_t payload_csum;
+} NetRxLroSeg;
+
+void net_rx_lro_init(struct NetRxLro **lro, NetRxLroIndicate indicate,
+                     void *opaque)
+{
+    struct NetRxLro *p = g_new0(struct NetRxLro, 1);
+
+    p->indicate = indicate;
+    p->opaque = opaque;
+    p->buf = g_malloc(NET_RX_LRO_MAX_LEN);
+    *lro = p;
+}
+
+void net_rx_lro_uninit(struct NetRxLro *lro)
+{
+    g_free(lro->buf);
+    g_free(lro);
+}
+
+static bool
+net_rx_lro_parse(const uint8_t *buf, size_t size, NetRxLroSeg *seg)
+{
+    size_t ip_len;
+    uint32_t sum, cso;
+
+    if (size < ETH_HLEN + sizeof(struct ip_header) +
+               sizeof(struct tcp_header) ||
+        be16_to_cpu(PKT_GET_ETH_HDR(buf)->h_proto) != ETH_P_IP) {
+        return false;
+    }
+
+    /* plain IPv4 without options, TCP, not fragmented */
+    seg->ip = (struct ip_header *)(buf + ETH_HLEN);
+    ip_len = be16_to_cpu(seg->ip->ip_len);
+    if (seg->ip->ip_ver_len != 0x45 || seg->ip->ip_p != IP_PROTO_TCP ||
+        IP4_IS_FRAGMENT(seg->ip) || ip_len > size - ETH_HLEN ||
+        ip_len < sizeof(struct ip_header) + sizeof(struct tcp_header)) {
+        return false;
+    }
+
+    /* in-sequence data: ACK, possibly PSH, nothing else */
+    seg->tcp = (uint8_t *)(seg->ip + 1);
+    seg->tcp_hlen = TCP_HEADER_DATA_OFFSET((struct tcp_header *)seg->tcp);
+    if (seg->tcp_hlen < sizeof(struct tcp_header) ||
+        seg->tcp_hlen >= ip_len - sizeof(struct ip_header) ||
+        (seg->tcp[13] & ~TCP_FLAG_PSH) != TCP_FLAG_ACK) {
+        return false;
+    }
+    seg->payload_len = ip_len - sizeof(struct ip_header) - seg->tcp_hlen;
+
+    /* only frames whose checksums verify are coalesced */
+    if (net_raw_checksum((uint8_t *)seg->ip, sizeof(struct ip_header))) {
+        return false;
+    }
+    seg->payload_csum = net_checksum_add(seg->payload_len,
+                                         seg->tcp + seg->tcp_hlen);
+    sum = eth_calc_ip4_pseudo_hdr_csum(seg->ip, ip_len - sizeof(*seg->ip),
+                                       &cso) +
+          net_checksum_add(seg->tcp_hlen, seg->tcp) + seg->payload_csum;
+    return net_checksum_finish(sum) == 0;
+}
+
+void net_rx_lro_flush(struct NetRxLro *lro)
+{
+    struct ip_header *ip = (struct ip_header *)(lro->buf + ETH_HLEN);
+    uint8_t *tcp = (uint8_t *)(ip + 1);
+    size_t len = lro->len;
+    size_t ip_len, tcp_len, tcp_hlen;
+    uint32_t sum, cso;
+
+    if (!len) {
+        return;
+    }
+
+    if (lro->segs > 1) {
+        ip_len = len - ETH_HLEN;
+        tcp_len = ip_len - sizeof(*ip);
+        tcp_hlen = TCP_HEADER_DATA_OFFSET((struct tcp_header *)tcp);
+
+        stw_be_p(&ip->ip_len, ip_len);
+        ip->ip_sum = 0;
+        ip->ip_sum = cpu_to_be16(net_raw_checksum((uint8_t *)ip,
+                                                  sizeof(*ip)));
+
+        stw_be_p(tcp + 16, 0);
+        sum = eth_calc_ip4_pseudo_hdr_csum(ip, tcp_len, &cso) +
+              net_checksum_add(tcp_hlen, tcp) + lro->csum;
+        stw_be_p(tcp + 16, net_checksum_finish(sum));
+    }
+
+    lro->len = 0;
+    lro->indicate(lro->opaque, lro->buf, len);
+}
+
+size_t net_rx_lro_pending_len(struct NetRxLro *lro)
+{
+    return lro->len;
+}
+
+bool net_rx_lro_add(struct NetRxLro *lro, const uint8_t *buf, size_t size)
+{
+    struct ip_header *ip = (struct ip_header *)(lro->buf + ETH_HLEN);
+    uint8_t *tcp = (uint8_t *)(ip + 1);
+    size_t tcp_hlen = TCP_HEADER_DATA_OFFSET((struct tcp_header *)tcp);
+    size_t offset;
+    NetRxLroSeg seg;
+
+    if (!net_rx_lro_parse(buf, size, &seg)) {
+        net_rx_lro_flush(lro);
+        return false;
+    }
+
+    if (lro->len &&
+        /* same flow and addressing */
+        !memcmp(lro->buf, buf, ETH_HLEN) &&
+        ip->ip_tos == seg.ip->ip_tos && ip->ip_ttl == seg.ip->ip_ttl &&
+        ip->ip_src == seg.ip->ip_src && ip->ip_dst == seg.ip->ip_dst &&
+        !memcmp(tcp, seg.tcp, 4) &&
+        /* next in sequence, same ACK, window and options */
+        ldl_be_p(seg.tcp + 4) == lro->next_seq &&
+        !memcmp(tcp + 8, seg.tcp + 8, 5) &&
+        !memcmp(tcp + 14, seg.tcp + 14, 2) &&
+        tcp_hlen == seg.tcp_hlen &&
+        !memcmp(tcp + 20, seg.tcp + 20, tcp_hlen - 20) &&
+        lro->len + seg.payload_len <= NET_RX_LRO_MAX_LEN) {
+        offset = lro->len - ETH_HLEN - sizeof(*ip) - tcp_hlen;
+        memcpy(lro->buf + lro->len, seg.tcp + seg.tcp_hlen, seg.payload_len);
+        lro->csum += net_checksum_add_cont(seg.payload_len,
+                                           seg.tcp + seg.tcp_hlen, offset);
+        lro->csum = (lro->csum & 0xffff) + (lro->csum >> 16);
+        lro->len += seg.payload_len;
+        lro->next_seq += seg.payload_len;
+        lro->segs++;
+        tcp[13] |= seg.tcp[13];
+    } else {
+        net_rx_lro_flush(lro);
+        lro->len = ETH_HLEN + be16_to_cpu(seg.ip->ip_len);
+        memcpy(lro->buf, buf, lro->len);
+        lro->csum = seg.payload_csum;
+        lro->next_seq = ldl_be_p(seg.tcp + 4) + seg.payload_len;
+        lro->segs = 1;
+    }
+
+    /* a pushed segment ends the run */
+    if (tcp[13] & TCP_FLAG_PSH) {
+        net_rx_lro_flush(lro);
+    }
+    return true;
+}
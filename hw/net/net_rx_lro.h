@@ -0,0 +1,84 @@
+/*
+ * QEMU software LRO for RX packets
+ *
+ * Coalesces in-sequence IPv4 TCP segments of one flow into a single
+ * frame, for devices whose peer cannot hand over coalesced frames.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+
+#ifndef NET_RX_LRO_H
+#define NET_RX_LRO_H
+
+#include "net/eth.h"
+
+/* Largest frame built by coalescing */
+#define NET_RX_LRO_MAX_LEN (ETH_HLEN + 0xffff)
+
+/**
+ * Hands a frame over to the device, coalesced or not
+ *
+ * @opaque:         opaque given to net_rx_lro_init
+ * @buf:            frame
+ * @size:           frame length
+ *
+ */
+typedef void (*NetRxLroIndicate)(void *opaque, const uint8_t *buf,
+                                 size_t size);
+
+struct NetRxLro;
+
+/**
+ * Init function for software LRO
+ *
+ * @lro:            LRO context pointer
+ * @indicate:       called with every frame leaving the context
+ * @opaque:         passed to @indicate
+ *
+ */
+void net_rx_lro_init(struct NetRxLro **lro, NetRxLroIndicate indicate,
+                     void *opaque);
+
+/**
+ * Clean all software LRO resources, dropping the pending frame
+ *
+ * @lro:            LRO context
+ *
+ */
+void net_rx_lro_uninit(struct NetRxLro *lro);
+
+/**
+ * Try to coalesce a frame with the pending one.  Only segments that carry
+ * data, have just ACK and possibly PSH set and whose checksums verify are
+ * coalesced; a segment with PSH ends the run.
+ *
+ * @lro:            LRO context
+ * @buf:            frame
+ * @size:           frame length
+ *
+ * Return:  false if the frame was not taken and must be indicated on its
+ *          own; the pending frame has then been indicated already
+ *
+ */
+bool net_rx_lro_add(struct NetRxLro *lro, const uint8_t *buf, size_t size);
+
+/**
+ * Indicate the pending frame, if any, with its IP length and checksums
+ * rebuilt when several segments were coalesced into it
+ *
+ * @lro:            LRO context
+ *
+ */
+void net_rx_lro_flush(struct NetRxLro *lro);
+
+/**
+ * returns the length of the pending frame, 0 if there is none
+ *
+ * @lro:            LRO context
+ *
+ */
+size_t net_rx_lro_pending_len(struct NetRxLro *lro);
+
+#endif
@@ -133,7 +133,11 @@ typedef enum {
     NetPktRssIpV4Tcp,
     NetPktRssIpV6Tcp,
     NetPktRssIpV6,
-    NetPktRssIpV6Ex
+    NetPktRssIpV6Ex,
+    NetPktRssIpV6TcpEx,
+    NetPktRssIpV4Udp,
+    NetPktRssIpV6Udp,
+    NetPktRssIpV6UdpEx,
 } NetRxPktRssType;
 
 /**
@@ -150,6 +154,23 @@ net_rx_pkt_calc_rss_hash(struct NetRxPkt *pkt,
                          NetRxPktRssType type,
                          uint8_t *key);
 
+/**
+* looks up an RSS hash in an indirection table
+*
+* @table:          indirection table
+* @table_len:      number of entries, a power of 2
+* @hash:           RSS hash
+*
+* Return:  table entry selected by the low bits of the hash.
+*
+*/
+static inline uint16_t
+net_rx_pkt_rss_lookup(const uint16_t *table, uint16_t table_len,
+                      uint32_t hash)
+{
+    return table[hash & (table_len - 1)];
+}
+
 /**
 * fetches IP identification for the packet
 *
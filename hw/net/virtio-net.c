@@ -33,6 +33,7 @@
 #include "standard-headers/linux/ethtool.h"
 #include "sysemu/sysemu.h"
 #include "trace.h"
+#include "net_rx_pkt.h"
 
 #define VIRTIO_NET_VM_VERSION    11
 
@@ -88,6 +89,16 @@ static inline __virtio16 *virtio_net_rsc_ext_num_dupacks(
 
 #endif
 
+#define VIRTIO_NET_RSS_SUPPORTED_HASHES (VIRTIO_NET_RSS_HASH_TYPE_IPv4 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_TCPv4 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_UDPv4 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_IPv6 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_TCPv6 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_UDPv6 | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_IP_EX | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_TCP_EX | \
+                                         VIRTIO_NET_RSS_HASH_TYPE_UDP_EX)
+
 static VirtIOFeature feature_sizes[] = {
     {.flags = 1ULL << VIRTIO_NET_F_MAC,
      .end = virtio_endof(struct virtio_net_config, mac)},
@@ -99,6 +110,8 @@ static VirtIOFeature feature_sizes[] = {
      .end = virtio_endof(struct virtio_net_config, mtu)},
     {.flags = 1ULL << VIRTIO_NET_F_SPEED_DUPLEX,
      .end = virtio_endof(struct virtio_net_config, duplex)},
+    {.flags = (1ULL << VIRTIO_NET_F_RSS) | (1ULL << VIRTIO_NET_F_HASH_REPORT),
+     .end = virtio_endof(struct virtio_net_config, supported_hash_types)},
     {}
 };
 
@@ -129,6 +142,11 @@ static void virtio_net_get_config(VirtIODevice *vdev, uint8_t *config)
     memcpy(netcfg.mac, n->mac, ETH_ALEN);
     virtio_stl_p(vdev, &netcfg.speed, n->net_conf.speed);
     netcfg.duplex = n->net_conf.duplex;
+    netcfg.rss_max_key_size = VIRTIO_NET_RSS_MAX_KEY_SIZE;
+    virtio_stw_p(vdev, &netcfg.rss_max_indirection_table_length,
+                 VIRTIO_NET_RSS_MAX_TABLE_LEN);
+    virtio_stl_p(vdev, &netcfg.supported_hash_types,
+                 VIRTIO_NET_RSS_SUPPORTED_HASHES);
     memcpy(config, &netcfg, n->config_size);
 }
 
@@ -487,6 +505,15 @@ static RxFilterInfo *virtio_net_query_rxfilter(NetClientState *nc)
     return info;
 }
 
+static void virtio_net_disable_rss(VirtIONet *n)
+{
+    if (n->rss_data.enabled) {
+        trace_virtio_net_rss_disable();
+    }
+    n->rss_data.enabled = false;
+    n->rss_data.redirect = false;
+}
+
 static void virtio_net_reset(VirtIODevice *vdev)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
@@ -514,6 +541,7 @@ static void virtio_net_reset(VirtIODevice *vdev)
     memcpy(&n->mac[0], &n->nic->conf->macaddr, sizeof(n->mac));
     qemu_format_nic_info_str(qemu_get_queue(n->nic), n->mac);
     memset(n->vlans, 0, MAX_VLAN >> 3);
+    virtio_net_disable_rss(n);
 
     /* Flush any async TX */
     for (i = 0;  i < n->max_queues; i++) {
@@ -552,15 +580,18 @@ static int peer_has_ufo(VirtIONet *n)
 }
 
 static void virtio_net_set_mrg_rx_bufs(VirtIONet *n, int mergeable_rx_bufs,
-                                       int version_1)
+                                       int version_1, int hash_report)
 {
     int i;
     NetClientState *nc;
 
     n->mergeable_rx_bufs = mergeable_rx_bufs;
+    n->rss_data.populate_hash = version_1 && hash_report;
 
     if (version_1) {
-        n->guest_hdr_len = sizeof(struct virtio_net_hdr_mrg_rxbuf);
+        n->guest_hdr_len = hash_report ?
+            sizeof(struct virtio_net_hdr_v1_hash) :
+            sizeof(struct virtio_net_hdr_mrg_rxbuf);
     } else {
         n->guest_hdr_len = n->mergeable_rx_bufs ?
             sizeof(struct virtio_net_hdr_mrg_rxbuf) :
@@ -688,10 +719,20 @@ static uint64_t virtio_net_get_features(VirtIODevice *vdev, uint64_t features,
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_UFO);
     }
 
+    /* RSS and hash reporting are configured through the control queue */
+    if (!virtio_has_feature(features, VIRTIO_NET_F_CTRL_VQ)) {
+        virtio_clear_feature(&features, VIRTIO_NET_F_RSS);
+        virtio_clear_feature(&features, VIRTIO_NET_F_HASH_REPORT);
+    }
+
     if (!get_vhost_net(nc->peer)) {
         return features;
     }
 
+    /* vhost steers packets on its own, out of sight of this device */
+    virtio_clear_feature(&features, VIRTIO_NET_F_RSS);
+    virtio_clear_feature(&features, VIRTIO_NET_F_HASH_REPORT);
+
     features = vhost_net_get_features(get_vhost_net(nc->peer), features);
     vdev->backend_features = features;
 
@@ -763,7 +804,9 @@ static void virtio_net_set_features(VirtIODevice *vdev, uint64_t features)
                                virtio_has_feature(features,
                                                   VIRTIO_NET_F_MRG_RXBUF),
                                virtio_has_feature(features,
-                                                  VIRTIO_F_VERSION_1));
+                                                  VIRTIO_F_VERSION_1),
+                               virtio_has_feature(features,
+                                                  VIRTIO_NET_F_HASH_REPORT));
 
     n->rsc4_enabled = virtio_has_feature(features, VIRTIO_NET_F_RSC_EXT) &&
         virtio_has_feature(features, VIRTIO_NET_F_GUEST_TSO4);
@@ -790,6 +833,11 @@ static void virtio_net_set_features(VirtIODevice *vdev, uint64_t features)
     } else {
         memset(n->vlans, 0xff, MAX_VLAN >> 3);
     }
+
+    if (!virtio_has_feature(features, VIRTIO_NET_F_RSS) &&
+        !virtio_has_feature(features, VIRTIO_NET_F_HASH_REPORT)) {
+        virtio_net_disable_rss(n);
+    }
 }
 
 static int virtio_net_handle_rx_mode(VirtIONet *n, uint8_t cmd,
@@ -1011,6 +1059,119 @@ static int virtio_net_handle_announce(VirtIONet *n, uint8_t cmd,
     }
 }
 
+/*
+ * Parse a VIRTIO_NET_CTRL_MQ_RSS_CONFIG (@do_rss) or
+ * VIRTIO_NET_CTRL_MQ_HASH_CONFIG command.  Returns the number of queue
+ * pairs to use, or 0 if the command is invalid.
+ */
+static uint16_t virtio_net_handle_rss(VirtIONet *n,
+                                      struct iovec *iov, unsigned int iov_cnt,
+                                      bool do_rss)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    VirtioNetRssData *rss = &n->rss_data;
+    struct virtio_net_rss_config cfg;
+    struct {
+        uint16_t max_tx_vq;
+        uint8_t hash_key_length;
+    } QEMU_PACKED tail;
+    size_t s, offset, len;
+    uint16_t queues, i;
+
+    if (!virtio_vdev_has_feature(vdev, do_rss ? VIRTIO_NET_F_RSS :
+                                               VIRTIO_NET_F_HASH_REPORT)) {
+        goto error;
+    }
+
+    len = offsetof(struct virtio_net_rss_config, indirection_table);
+    s = iov_to_buf(iov, iov_cnt, 0, &cfg, len);
+    if (s != len) {
+        goto error;
+    }
+    offset = len;
+
+    rss->hash_types = virtio_ldl_p(vdev, &cfg.hash_types);
+    if (do_rss) {
+        rss->indirections_len =
+            virtio_lduw_p(vdev, &cfg.indirection_table_mask) + 1;
+        rss->default_queue = virtio_lduw_p(vdev, &cfg.unclassified_queue);
+    } else {
+        /* the hash configuration has a reserved field instead */
+        rss->indirections_len = 1;
+        rss->default_queue = 0;
+    }
+    if (!is_power_of_2(rss->indirections_len) ||
+        rss->indirections_len > VIRTIO_NET_RSS_MAX_TABLE_LEN) {
+        goto error;
+    }
+
+    len = rss->indirections_len * sizeof(uint16_t);
+    g_free(rss->indirections_table);
+    rss->indirections_table = g_malloc(len);
+    s = iov_to_buf(iov, iov_cnt, offset, rss->indirections_table, len);
+    if (s != len) {
+        goto error;
+    }
+    offset += len;
+    if (do_rss) {
+        for (i = 0; i < rss->indirections_len; i++) {
+            rss->indirections_table[i] =
+                virtio_lduw_p(vdev, &rss->indirections_table[i]);
+        }
+    } else {
+        /* the reserved field is not a queue index; never steer with it */
+        rss->indirections_table[0] = 0;
+    }
+
+    s = iov_to_buf(iov, iov_cnt, offset, &tail, sizeof(tail));
+    if (s != sizeof(tail)) {
+        goto error;
+    }
+    offset += sizeof(tail);
+
+    queues = do_rss ? virtio_lduw_p(vdev, &tail.max_tx_vq) : n->curr_queues;
+    if (queues == 0 || queues > n->max_queues) {
+        goto error;
+    }
+    if (do_rss) {
+        if (rss->default_queue >= queues) {
+            goto error;
+        }
+        for (i = 0; i < rss->indirections_len; i++) {
+            if (rss->indirections_table[i] >= queues) {
+                goto error;
+            }
+        }
+    }
+
+    if (tail.hash_key_length > VIRTIO_NET_RSS_MAX_KEY_SIZE ||
+        (!tail.hash_key_length && rss->hash_types)) {
+        goto error;
+    }
+    if (!tail.hash_key_length) {
+        /* no hash types: steering and reporting are turned off */
+        virtio_net_disable_rss(n);
+        return queues;
+    }
+
+    memset(rss->key, 0, sizeof(rss->key));
+    s = iov_to_buf(iov, iov_cnt, offset, rss->key, tail.hash_key_length);
+    if (s != tail.hash_key_length) {
+        goto error;
+    }
+
+    rss->enabled = true;
+    rss->redirect = do_rss;
+    trace_virtio_net_rss_enable(do_rss, rss->hash_types,
+                                rss->indirections_len, tail.hash_key_length);
+    return queues;
+
+error:
+    trace_virtio_net_rss_error(do_rss);
+    virtio_net_disable_rss(n);
+    return 0;
+}
+
 static int virtio_net_handle_mq(VirtIONet *n, uint8_t cmd,
                                 struct iovec *iov, unsigned int iov_cnt)
 {
@@ -1019,17 +1180,24 @@ static int virtio_net_handle_mq(VirtIONet *n, uint8_t cmd,
     size_t s;
     uint16_t queues;
 
-    s = iov_to_buf(iov, iov_cnt, 0, &mq, sizeof(mq));
-    if (s != sizeof(mq)) {
-        return VIRTIO_NET_ERR;
-    }
-
-    if (cmd != VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET) {
+    if (cmd == VIRTIO_NET_CTRL_MQ_HASH_CONFIG) {
+        /* only the hash reporting changes, not the queues */
+        return virtio_net_handle_rss(n, iov, iov_cnt, false) ?
+               VIRTIO_NET_OK : VIRTIO_NET_ERR;
+    } else if (cmd == VIRTIO_NET_CTRL_MQ_RSS_CONFIG) {
+        queues = virtio_net_handle_rss(n, iov, iov_cnt, true);
+    } else if (cmd == VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET) {
+        s = iov_to_buf(iov, iov_cnt, 0, &mq, sizeof(mq));
+        if (s != sizeof(mq)) {
+            return VIRTIO_NET_ERR;
+        }
+        queues = virtio_lduw_p(vdev, &mq.virtqueue_pairs);
+        /* back to steering by the backend, but keep reporting hashes */
+        n->rss_data.redirect = false;
+    } else {
         return VIRTIO_NET_ERR;
     }
 
-    queues = virtio_lduw_p(vdev, &mq.virtqueue_pairs);
-
     if (queues < VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN ||
         queues > VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX ||
         queues > n->max_queues ||
@@ -1262,6 +1430,105 @@ static int receive_filter(VirtIONet *n, const uint8_t *buf, int size)
     return 0;
 }
 
+static NetRxPktRssType virtio_net_get_hash_type(bool isip4, bool isip6,
+                                                bool isudp, bool istcp,
+                                                bool fragment,
+                                                uint32_t types)
+{
+    /* the ports of a fragment are not known, hash on the addresses only */
+    if (fragment) {
+        isudp = istcp = false;
+    }
+
+    if (isip4) {
+        if (istcp && (types & VIRTIO_NET_RSS_HASH_TYPE_TCPv4)) {
+            return NetPktRssIpV4Tcp;
+        }
+        if (isudp && (types & VIRTIO_NET_RSS_HASH_TYPE_UDPv4)) {
+            return NetPktRssIpV4Udp;
+        }
+        if (types & VIRTIO_NET_RSS_HASH_TYPE_IPv4) {
+            return NetPktRssIpV4;
+        }
+    } else if (isip6) {
+        if (istcp && (types & VIRTIO_NET_RSS_HASH_TYPE_TCP_EX)) {
+            return NetPktRssIpV6TcpEx;
+        }
+        if (istcp && (types & VIRTIO_NET_RSS_HASH_TYPE_TCPv6)) {
+            return NetPktRssIpV6Tcp;
+        }
+        if (isudp && (types & VIRTIO_NET_RSS_HASH_TYPE_UDP_EX)) {
+            return NetPktRssIpV6UdpEx;
+        }
+        if (isudp && (types & VIRTIO_NET_RSS_HASH_TYPE_UDPv6)) {
+            return NetPktRssIpV6Udp;
+        }
+        if (types & VIRTIO_NET_RSS_HASH_TYPE_IP_EX) {
+            return NetPktRssIpV6Ex;
+        }
+        if (types & VIRTIO_NET_RSS_HASH_TYPE_IPv6) {
+            return NetPktRssIpV6;
+        }
+    }
+    return 0xff;
+}
+
+/*
+ * Compute the RSS hash of a packet.  Returns the index of the queue the
+ * packet should go to, or -1 if it should stay on the queue it came in on.
+ */
+static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
+                                  size_t size, uint32_t *hash_value,
+                                  uint16_t *hash_report)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    VirtioNetRssData *rss = &n->rss_data;
+    /* indexed by NetRxPktRssType */
+    static const uint8_t reports[] = {
+        VIRTIO_NET_HASH_REPORT_IPv4,
+        VIRTIO_NET_HASH_REPORT_TCPv4,
+        VIRTIO_NET_HASH_REPORT_TCPv6,
+        VIRTIO_NET_HASH_REPORT_IPv6,
+        VIRTIO_NET_HASH_REPORT_IPv6_EX,
+        VIRTIO_NET_HASH_REPORT_TCPv6_EX,
+        VIRTIO_NET_HASH_REPORT_UDPv4,
+        VIRTIO_NET_HASH_REPORT_UDPv6,
+        VIRTIO_NET_HASH_REPORT_UDPv6_EX,
+    };
+    NetRxPktRssType type;
+    bool isip4, isip6, isudp, istcp, fragment = false;
+    uint32_t hash;
+    uint16_t index;
+
+    net_rx_pkt_set_protocols(n->rx_pkt, buf + n->host_hdr_len,
+                             size - n->host_hdr_len);
+    net_rx_pkt_get_protocols(n->rx_pkt, &isip4, &isip6, &isudp, &istcp);
+    if (isip4) {
+        fragment = net_rx_pkt_get_ip4_info(n->rx_pkt)->fragment;
+    } else if (isip6) {
+        fragment = net_rx_pkt_get_ip6_info(n->rx_pkt)->fragment;
+    }
+
+    type = virtio_net_get_hash_type(isip4, isip6, isudp, istcp, fragment,
+                                    rss->hash_types);
+    if (type > NetPktRssIpV6UdpEx) {
+        index = rss->default_queue;
+        goto out;
+    }
+
+    hash = net_rx_pkt_calc_rss_hash(n->rx_pkt, type, rss->key);
+    *hash_value = hash;
+    *hash_report = reports[type];
+    index = net_rx_pkt_rss_lookup(rss->indirections_table,
+                                  rss->indirections_len, hash);
+
+out:
+    if (!rss->redirect || index == nc->queue_index) {
+        return -1;
+    }
+    return index;
+}
+
 static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
                                       size_t size)
 {
@@ -1272,14 +1539,35 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
     struct virtio_net_hdr_mrg_rxbuf mhdr;
     unsigned mhdr_cnt = 0;
     size_t offset, i, guest_offset;
+    uint32_t hash_value = 0;
+    uint16_t hash_report = VIRTIO_NET_HASH_REPORT_NONE;
+    bool redirected = false;
 
     if (!virtio_net_can_receive(nc)) {
         return -1;
     }
 
+    if (n->rss_data.enabled) {
+        int index = virtio_net_process_rss(nc, buf, size, &hash_value,
+                                           &hash_report);
+        if (index >= 0) {
+            NetClientState *target = qemu_get_subqueue(n->nic, index);
+
+            /*
+             * The packet cannot wait in the incoming queue of @nc: only
+             * new buffers on @nc's ring would flush it.  Drop it instead.
+             */
+            if (!virtio_net_can_receive(target)) {
+                return size;
+            }
+            q = virtio_net_get_subqueue(target);
+            redirected = true;
+        }
+    }
+
     /* hdr_len refers to the header we supply to the guest */
     if (!virtio_net_has_buffers(q, size + n->guest_hdr_len - n->host_hdr_len)) {
-        return 0;
+        return redirected ? size : 0;
     }
 
     if (!receive_filter(n, buf, size))
@@ -1327,6 +1615,17 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
             }
 
             receive_header(n, sg, elem->in_num, buf, size);
+            if (n->rss_data.populate_hash) {
+                struct virtio_net_hdr_v1_hash hash;
+
+                virtio_stl_p(vdev, &hash.hash_value, hash_value);
+                virtio_stw_p(vdev, &hash.hash_report, hash_report);
+                iov_from_buf(sg, elem->in_num,
+                             offsetof(typeof(hash), hash_value),
+                             &hash.hash_value,
+                             sizeof(hash.hash_value) +
+                             sizeof(hash.hash_report));
+            }
             offset = n->host_hdr_len;
             total += n->guest_hdr_len;
             guest_offset = n->guest_hdr_len;
@@ -1361,11 +1660,32 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
     }
 
     virtqueue_flush(q->rx_vq, i);
-    virtio_notify(vdev, q->rx_vq);
+    /* interrupt the guest once for a burst of packets */
+    if (qemu_receive_batching(nc)) {
+        q->rx_notify_pending = true;
+    } else {
+        virtio_notify(vdev, q->rx_vq);
+    }
 
     return size;
 }
 
+static void virtio_net_receive_batch_end(NetClientState *nc)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    int i;
+
+    /* RSS may have placed part of the burst on other queues */
+    for (i = 0; i < n->max_queues; i++) {
+        VirtIONetQueue *q = &n->vqs[i];
+
+        if (q->rx_notify_pending) {
+            q->rx_notify_pending = false;
+            virtio_notify(VIRTIO_DEVICE(n), q->rx_vq);
+        }
+    }
+}
+
 static ssize_t virtio_net_do_receive(NetClientState *nc, const uint8_t *buf,
                                   size_t size)
 {
@@ -2243,6 +2563,9 @@ static void virtio_net_add_queue(VirtIONet *n, int index)
         n->vqs[index].tx_bh = qemu_bh_new(virtio_net_tx_bh, &n->vqs[index]);
     }
 
+    virtio_queue_set_coalesce(n->vqs[index].rx_vq, &n->net_conf.rx_coalesce);
+    virtio_queue_set_coalesce(n->vqs[index].tx_vq, &n->net_conf.tx_coalesce);
+
     n->vqs[index].tx_waiting = 0;
     n->vqs[index].n = n;
 }
@@ -2322,7 +2645,9 @@ static int virtio_net_post_load_device(void *opaque, int version_id)
     trace_virtio_net_post_load_device();
     virtio_net_set_mrg_rx_bufs(n, n->mergeable_rx_bufs,
                                virtio_vdev_has_feature(vdev,
-                                                       VIRTIO_F_VERSION_1));
+                                                       VIRTIO_F_VERSION_1),
+                               virtio_vdev_has_feature(vdev,
+                                               VIRTIO_NET_F_HASH_REPORT));
 
     /* MAC_TABLE_ENTRIES may be different from the saved image */
     if (n->mac_table.in_use > MAC_TABLE_ENTRIES) {
@@ -2528,6 +2853,57 @@ static const VMStateDescription vmstate_virtio_net_has_vnet = {
     },
 };
 
+static bool virtio_net_rss_needed(void *opaque)
+{
+    return VIRTIO_NET(opaque)->rss_data.enabled;
+}
+
+static int virtio_net_rss_post_load(void *opaque, int version_id)
+{
+    VirtIONet *n = opaque;
+    VirtioNetRssData *rss = &n->rss_data;
+    int i;
+
+    if (!is_power_of_2(rss->indirections_len) ||
+        rss->indirections_len > VIRTIO_NET_RSS_MAX_TABLE_LEN) {
+        return -EINVAL;
+    }
+    if (!rss->redirect) {
+        /* hash reporting only, the table is never used for steering */
+        return 0;
+    }
+    if (rss->default_queue >= n->max_queues) {
+        return -EINVAL;
+    }
+    for (i = 0; i < rss->indirections_len; i++) {
+        if (rss->indirections_table[i] >= n->max_queues) {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+static const VMStateDescription vmstate_virtio_net_rss = {
+    .name      = "virtio-net-device/rss",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = virtio_net_rss_needed,
+    .post_load = virtio_net_rss_post_load,
+    .fields = (VMStateField[]) {
+        VMSTATE_BOOL(rss_data.enabled, VirtIONet),
+        VMSTATE_BOOL(rss_data.redirect, VirtIONet),
+        VMSTATE_UINT32(rss_data.hash_types, VirtIONet),
+        VMSTATE_UINT16(rss_data.indirections_len, VirtIONet),
+        VMSTATE_UINT16(rss_data.default_queue, VirtIONet),
+        VMSTATE_UINT8_ARRAY(rss_data.key, VirtIONet,
+                            VIRTIO_NET_RSS_MAX_KEY_SIZE),
+        VMSTATE_VARRAY_UINT16_ALLOC(rss_data.indirections_table, VirtIONet,
+                                    rss_data.indirections_len, 0,
+                                    vmstate_info_uint16, uint16_t),
+        VMSTATE_END_OF_LIST()
+    },
+};
+
 static const VMStateDescription vmstate_virtio_net_device = {
     .name = "virtio-net-device",
     .version_id = VIRTIO_NET_VM_VERSION,
@@ -2578,6 +2954,10 @@ static const VMStateDescription vmstate_virtio_net_device = {
                             has_ctrl_guest_offloads),
         VMSTATE_END_OF_LIST()
    },
+    .subsections = (const VMStateDescription * []) {
+        &vmstate_virtio_net_rss,
+        NULL
+    }
 };
 
 static NetClientInfo net_virtio_info = {
@@ -2585,6 +2965,7 @@ static NetClientInfo net_virtio_info = {
     .size = sizeof(NICState),
     .can_receive = virtio_net_can_receive,
     .receive = virtio_net_receive,
+    .receive_batch_end = virtio_net_receive_batch_end,
     .link_status_changed = virtio_net_set_link_status,
     .query_rx_filter = virtio_net_query_rxfilter,
     .announce = virtio_net_announce,
@@ -2751,7 +3132,7 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
 
     n->vqs[0].tx_waiting = 0;
     n->tx_burst = n->net_conf.txburst;
-    virtio_net_set_mrg_rx_bufs(n, 0, 0);
+    virtio_net_set_mrg_rx_bufs(n, 0, 0, 0);
     n->promisc = 1; /* for compatibility */
 
     n->mac_table.macs = g_malloc0(MAC_TABLE_ENTRIES * ETH_ALEN);
@@ -2763,6 +3144,8 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
 
     QTAILQ_INIT(&n->rsc_chains);
     n->qdev = dev;
+
+    net_rx_pkt_init(&n->rx_pkt, false);
 }
 
 static void virtio_net_device_unrealize(DeviceState *dev, Error **errp)
@@ -2791,6 +3174,8 @@ static void virtio_net_device_unrealize(DeviceState *dev, Error **errp)
     g_free(n->vqs);
     qemu_del_nic(n->nic);
     virtio_net_rsc_cleanup(n);
+    g_free(n->rss_data.indirections_table);
+    net_rx_pkt_uninit(n->rx_pkt);
     virtio_cleanup(vdev);
 }
 
@@ -2871,6 +3256,10 @@ static Property virtio_net_properties[] = {
     DEFINE_PROP_BIT64("ctrl_guest_offloads", VirtIONet, host_features,
                     VIRTIO_NET_F_CTRL_GUEST_OFFLOADS, true),
     DEFINE_PROP_BIT64("mq", VirtIONet, host_features, VIRTIO_NET_F_MQ, false),
+    DEFINE_PROP_BIT64("rss", VirtIONet, host_features,
+                    VIRTIO_NET_F_RSS, false),
+    DEFINE_PROP_BIT64("hash", VirtIONet, host_features,
+                    VIRTIO_NET_F_HASH_REPORT, false),
     DEFINE_PROP_BIT64("guest_rsc_ext", VirtIONet, host_features,
                     VIRTIO_NET_F_RSC_EXT, false),
     DEFINE_PROP_UINT32("rsc_interval", VirtIONet, rsc_timeout,
@@ -2889,6 +3278,14 @@ static Property virtio_net_properties[] = {
                      true),
     DEFINE_PROP_INT32("speed", VirtIONet, net_conf.speed, SPEED_UNKNOWN),
     DEFINE_PROP_STRING("duplex", VirtIONet, net_conf.duplex_str),
+    DEFINE_PROP_VIRTIO_COALESCE("rx-coalesce-usecs", VirtIONet,
+                                net_conf.rx_coalesce.usecs),
+    DEFINE_PROP_VIRTIO_COALESCE("rx-coalesce-max-frames", VirtIONet,
+                                net_conf.rx_coalesce.max_used),
+    DEFINE_PROP_VIRTIO_COALESCE("tx-coalesce-usecs", VirtIONet,
+                                net_conf.tx_coalesce.usecs),
+    DEFINE_PROP_VIRTIO_COALESCE("tx-coalesce-max-frames", VirtIONet,
+                                net_conf.tx_coalesce.max_used),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -35,6 +35,7 @@
 #include "vmware_utils.h"
 #include "net_tx_pkt.h"
 #include "net_rx_pkt.h"
+#include "net_rx_lro.h"
 
 #define PCI_DEVICE_ID_VMWARE_VMXNET3_REVISION 0x1
 #define VMXNET3_MSIX_BAR_SIZE 0x2000
@@ -1947,23 +1948,11 @@ vmxnet3_rx_filter_may_indicate(VMXNET3State *s, const void *data,
 }
 
 static ssize_t
-vmxnet3_receive(NetClientState *nc, const uint8_t *buf, size_t size)
+vmxnet3_rx_indicate(VMXNET3State *s, const uint8_t *buf, size_t size)
 {
-    VMXNET3State *s = qemu_get_nic_opaque(nc);
     size_t bytes_indicated;
     uint8_t min_buf[MIN_BUF_SIZE];
 
-    if (!vmxnet3_can_receive(nc)) {
-        VMW_PKPRN("Cannot receive now");
-        return -1;
-    }
-
-    if (s->peer_has_vhdr) {
-        net_rx_pkt_set_vhdr(s->rx_pkt, (struct virtio_net_hdr *)buf);
-        buf += sizeof(struct virtio_net_hdr);
-        size -= sizeof(struct virtio_net_hdr);
-    }
-
     /* Pad to minimum Ethernet frame length */
     if (size < sizeof(min_buf)) {
         memcpy(min_buf, buf, size);
@@ -1993,6 +1982,117 @@ vmxnet3_receive(NetClientState *nc, const uint8_t *buf, size_t size)
     return bytes_indicated;
 }
 
+/*
+ * Check, without consuming anything, that the RX rings can take frames of
+ * the given sizes one after the other, the way vmxnet3_indicate_packet()
+ * would lay them out.
+ */
+static bool
+vmxnet3_rx_has_room(VMXNET3State *s, const size_t *sizes, int n)
+{
+    Vmxnet3RxqDescr *rxq = &s->rxq_descr[RXQ_IDX];
+    Vmxnet3Ring rings[VMXNET3_RX_RINGS_PER_QUEUE];
+    Vmxnet3Ring comp_ring = rxq->comp_ring;
+    struct Vmxnet3_RxDesc rxd;
+    uint32_t rxd_idx, rx_ridx, gen;
+    bool ok = true;
+    int i;
+
+    memcpy(rings, rxq->rx_ring, sizeof(rings));
+    for (i = 0; i < n && ok; i++) {
+        size_t bytes_left = MAX(sizes[i], MIN_BUF_SIZE);
+        uint16_t num_frags = 0;
+        bool is_head = true;
+
+        while (bytes_left > 0) {
+            if (num_frags == s->max_rx_frags ||
+                !vmxnet3_pop_rxc_descr(s, RXQ_IDX, &gen) ||
+                !vmxnet3_get_next_rx_descr(s, is_head, &rxd, &rxd_idx,
+                                           &rx_ridx)) {
+                ok = false;
+                break;
+            }
+            bytes_left -= MIN(bytes_left, rxd.len);
+            is_head = false;
+            num_frags++;
+        }
+    }
+    memcpy(rxq->rx_ring, rings, sizeof(rings));
+    rxq->comp_ring = comp_ring;
+    return ok;
+}
+
+/*
+ * Software LRO reports a segment as received as soon as it takes it, so
+ * the frame it ends up in must not be dropped later.  Take a segment only
+ * if the rings have room for whatever it can turn into: the pending frame
+ * grown by the segment, or the pending frame followed by the segment.
+ */
+static bool
+vmxnet3_lro_has_room(VMXNET3State *s, size_t size)
+{
+    size_t pending = net_rx_lro_pending_len(s->rx_lro);
+    size_t merged = pending + size;
+    size_t split[] = { pending, size };
+
+    if (!pending) {
+        return vmxnet3_rx_has_room(s, &size, 1);
+    }
+    return vmxnet3_rx_has_room(s, &merged, 1) &&
+           vmxnet3_rx_has_room(s, split, ARRAY_SIZE(split));
+}
+
+static void
+vmxnet3_lro_indicate(void *opaque, const uint8_t *buf, size_t size)
+{
+    VMXNET3State *s = opaque;
+
+    if (vmxnet3_can_receive(qemu_get_queue(s->nic))) {
+        vmxnet3_rx_indicate(s, buf, size);
+    }
+}
+
+static ssize_t
+vmxnet3_receive(NetClientState *nc, const uint8_t *buf, size_t size)
+{
+    VMXNET3State *s = qemu_get_nic_opaque(nc);
+
+    if (!vmxnet3_can_receive(nc)) {
+        VMW_PKPRN("Cannot receive now");
+        return -1;
+    }
+
+    if (s->peer_has_vhdr) {
+        net_rx_pkt_set_vhdr(s->rx_pkt, (struct virtio_net_hdr *)buf);
+        buf += sizeof(struct virtio_net_hdr);
+        size -= sizeof(struct virtio_net_hdr);
+    } else if (s->lro_supported && qemu_receive_batching(nc)) {
+        /*
+         * The peer cannot hand over coalesced frames, do it here for the
+         * duration of the burst it is delivering.  The pending frame always
+         * fits in the rings, see vmxnet3_lro_has_room().
+         */
+        if (vmxnet3_lro_has_room(s, size)) {
+            if (net_rx_lro_add(s->rx_lro, buf, size)) {
+                return size;
+            }
+        } else {
+            net_rx_lro_flush(s->rx_lro);
+        }
+    } else {
+        net_rx_lro_flush(s->rx_lro);
+    }
+
+    return vmxnet3_rx_indicate(s, buf, size);
+}
+
+static void vmxnet3_receive_batch_end(NetClientState *nc)
+{
+    VMXNET3State *s = qemu_get_nic_opaque(nc);
+
+    net_rx_lro_flush(s->rx_lro);
+}
+
 static void vmxnet3_set_link_status(NetClientState *nc)
 {
     VMXNET3State *s = qemu_get_nic_opaque(nc);
@@ -2011,6 +2111,7 @@ static NetClientInfo net_vmxnet3_info = {
         .type = NET_CLIENT_DRIVER_NIC,
         .size = sizeof(NICState),
         .receive = vmxnet3_receive,
+        .receive_batch_end = vmxnet3_receive_batch_end,
         .link_status_changed = vmxnet3_set_link_status,
 };
 
@@ -2028,6 +2129,7 @@ static bool vmxnet3_peer_has_vnet_hdr(VMXNET3State *s)
 static void vmxnet3_net_uninit(VMXNET3State *s)
 {
     g_free(s->mcast_list);
+    net_rx_lro_uninit(s->rx_lro);
     vmxnet3_deactivate_device(s);
     qemu_del_nic(s->nic);
 }
@@ -2061,6 +2163,7 @@ static void vmxnet3_net_init(VMXNET3State *s)
     s->rx_pkt = NULL;
     s->rx_vlan_stripping = false;
     s->lro_supported = false;
+    net_rx_lro_init(&s->rx_lro, vmxnet3_lro_indicate, s);
 
     if (s->peer_has_vhdr) {
         qemu_set_vnet_hdr_len(qemu_get_queue(s->nic)->peer,
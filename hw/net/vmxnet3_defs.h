@@ -111,6 +111,9 @@ typedef struct {
 
         struct NetRxPkt *rx_pkt;
 
+        /* Software LRO for peers that cannot coalesce on their own */
+        struct NetRxLro *rx_lro;
+
         bool tx_sop;
         bool skip_current_tx_pkt;
 
@@ -22,6 +22,7 @@
 #include "migration/qemu-file-types.h"
 #include "migration/vmstate.h"
 #include "qemu/range.h"
+#include "qemu/rcu.h"
 #include "qapi/error.h"
 #include "trace.h"
 
@@ -173,12 +174,29 @@ void msix_write_config(PCIDevice *dev, uint32_t addr,
     }
 }
 
+/*
+ * Reads of the table are dispatched without the BQL (guests read back
+ * the vector control word after every mask and unmask), so they can race
+ * with msix_uninit.  The table is freed only after an RCU grace period.
+ */
+typedef struct MSIXTableRCU {
+    struct rcu_head rcu;
+    uint8_t *table;
+} MSIXTableRCU;
+
+static void msix_table_free_rcu(MSIXTableRCU *t)
+{
+    g_free(t->table);
+    g_free(t);
+}
+
 static uint64_t msix_table_mmio_read(void *opaque, hwaddr addr,
                                      unsigned size)
 {
     PCIDevice *dev = opaque;
+    uint8_t *table = atomic_rcu_read(&dev->msix_table);
 
-    return pci_get_long(dev->msix_table + addr);
+    return table ? pci_get_long(table + addr) : 0;
 }
 
 static void msix_table_mmio_write(void *opaque, hwaddr addr,
@@ -329,6 +347,7 @@ int msix_init(struct PCIDevice *dev, unsigned short nentries,
 
     memory_region_init_io(&dev->msix_table_mmio, OBJECT(dev), &msix_table_mmio_ops, dev,
                           "msix-table", table_size);
+    memory_region_clear_global_locking_reads(&dev->msix_table_mmio);
     memory_region_add_subregion(table_bar, table_offset, &dev->msix_table_mmio);
     memory_region_init_io(&dev->msix_pba_mmio, OBJECT(dev), &msix_pba_mmio_ops, dev,
                           "msix-pba", pba_size);
@@ -403,6 +422,8 @@ static void msix_clear_all_vectors(PCIDevice *dev)
 /* Clean up resources for the device. */
 void msix_uninit(PCIDevice *dev, MemoryRegion *table_bar, MemoryRegion *pba_bar)
 {
+    MSIXTableRCU *table;
+
     if (!msix_present(dev)) {
         return;
     }
@@ -414,8 +435,10 @@ void msix_uninit(PCIDevice *dev, MemoryRegion *table_bar, MemoryRegion *pba_bar)
     g_free(dev->msix_pba);
     dev->msix_pba = NULL;
     memory_region_del_subregion(table_bar, &dev->msix_table_mmio);
-    g_free(dev->msix_table);
-    dev->msix_table = NULL;
+    table = g_new0(MSIXTableRCU, 1);
+    table->table = dev->msix_table;
+    atomic_rcu_set(&dev->msix_table, NULL);
+    call_rcu(table, msix_table_free_rcu, rcu);
     g_free(dev->msix_entry_used);
     dev->msix_entry_used = NULL;
     dev->cap_present &= ~QEMU_PCI_CAP_MSIX;
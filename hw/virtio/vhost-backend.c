@@ -191,24 +191,46 @@ static int vhost_kernel_vsock_set_running(struct vhost_dev *dev, int start)
 }
 #endif /* CONFIG_VHOST_VSOCK */
 
+/* Number of messages read from the vhost fd before handling them */
+#define VHOST_KERNEL_IOTLB_BATCH 32
+
 static void vhost_kernel_iotlb_read(void *opaque)
 {
     struct vhost_dev *dev = opaque;
-    struct vhost_msg msg;
+    struct vhost_msg msg[VHOST_KERNEL_IOTLB_BATCH];
     ssize_t len;
-
-    while ((len = read((uintptr_t)dev->opaque, &msg, sizeof msg)) > 0) {
-        if (len < sizeof msg) {
-            error_report("Wrong vhost message len: %d", (int)len);
-            break;
+    int i, n;
+
+    /*
+     * Drain the pending misses first and handle them as one batch: misses
+     * for pages that an earlier update of the batch already covered (for
+     * example by prefetching) are then answered without a new update.
+     */
+    do {
+        n = 0;
+        while (n < ARRAY_SIZE(msg) &&
+               (len = read((uintptr_t)dev->opaque, &msg[n],
+                           sizeof msg[n])) > 0) {
+            if (len < sizeof msg[n]) {
+                error_report("Wrong vhost message len: %d", (int)len);
+                break;
+            }
+            if (msg[n].type != VHOST_IOTLB_MSG) {
+                error_report("Unknown vhost iotlb message type");
+                break;
+            }
+            n++;
         }
-        if (msg.type != VHOST_IOTLB_MSG) {
-            error_report("Unknown vhost iotlb message type");
+        if (!n) {
             break;
         }
 
-        vhost_backend_handle_iotlb_msg(dev, &msg.iotlb);
-    }
+        vhost_device_iotlb_batch_begin(dev);
+        for (i = 0; i < n; i++) {
+            vhost_backend_handle_iotlb_msg(dev, &msg[i].iotlb);
+        }
+        vhost_device_iotlb_batch_end(dev);
+    } while (n == ARRAY_SIZE(msg));
 }
 
 static int vhost_kernel_send_device_iotlb_msg(struct vhost_dev *dev,
@@ -24,6 +24,7 @@
 #include "exec/address-spaces.h"
 #include "hw/virtio/virtio-bus.h"
 #include "hw/virtio/virtio-access.h"
+#include "qapi/qapi-commands-misc.h"
 #include "migration/blocker.h"
 #include "migration/qemu-file-types.h"
 #include "sysemu/dma.h"
@@ -659,6 +660,9 @@ static void vhost_iommu_unmap_notify(IOMMUNotifier *n, IOMMUTLBEntry *iotlb)
     struct vhost_dev *hdev = iommu->hdev;
     hwaddr iova = iotlb->iova + iommu->iommu_offset;
 
+    /* Whatever was sent in the current batch may be stale now */
+    hdev->n_iotlb_sent = 0;
+    hdev->iotlb_stats.invalidations++;
     if (vhost_backend_invalidate_device_iotlb(hdev, iova,
                                               iotlb->addr_mask + 1)) {
         error_report("Fail to invalidate device iotlb");
@@ -908,12 +912,150 @@ static int vhost_memory_region_lookup(struct vhost_dev *hdev,
     return -EFAULT;
 }
 
+void vhost_device_iotlb_batch_begin(struct vhost_dev *dev)
+{
+    dev->iotlb_batching = true;
+    dev->n_iotlb_sent = 0;
+    dev->iotlb_stats.batches++;
+}
+
+void vhost_device_iotlb_batch_end(struct vhost_dev *dev)
+{
+    dev->iotlb_batching = false;
+    dev->n_iotlb_sent = 0;
+}
+
+static bool vhost_iotlb_sent_covers(struct vhost_dev *dev, uint64_t iova,
+                                    int write)
+{
+    IOMMUAccessFlags perm = write ? IOMMU_WO : IOMMU_RO;
+    int i;
+
+    for (i = 0; i < dev->n_iotlb_sent; i++) {
+        VhostIOTLBRange *r = &dev->iotlb_sent[i];
+
+        if (iova >= r->iova && iova - r->iova < r->len &&
+            (r->perm & perm) == perm) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int vhost_iotlb_update(struct vhost_dev *dev, VhostIOTLBRange *r)
+{
+    int ret;
+
+    ret = vhost_backend_update_device_iotlb(dev, r->iova, r->uaddr,
+                                            r->len, r->perm);
+    if (ret) {
+        return ret;
+    }
+
+    trace_vhost_iotlb_update(dev, r->iova, r->uaddr, r->len, r->perm);
+    dev->iotlb_stats.updates++;
+    if (dev->iotlb_batching && dev->n_iotlb_sent < VHOST_IOTLB_BATCH_MAX) {
+        dev->iotlb_sent[dev->n_iotlb_sent++] = *r;
+    }
+    return 0;
+}
+
+/*
+ * Send an array of ranges that are adjacent in IOVA space, merging those
+ * that are also adjacent in the process address space and have the same
+ * permissions, so that the backend gets as few updates as possible.
+ */
+static int vhost_iotlb_update_ranges(struct vhost_dev *dev,
+                                     VhostIOTLBRange *r, int n)
+{
+    VhostIOTLBRange run = r[0];
+    int i, ret;
+
+    for (i = 1; i < n; i++) {
+        if (r[i].iova == run.iova + run.len &&
+            r[i].uaddr == run.uaddr + run.len &&
+            r[i].perm == run.perm) {
+            run.len += r[i].len;
+            continue;
+        }
+        ret = vhost_iotlb_update(dev, &run);
+        if (ret) {
+            return ret;
+        }
+        run = r[i];
+    }
+    return vhost_iotlb_update(dev, &run);
+}
+
+static struct vhost_iommu *vhost_iommu_find(struct vhost_dev *dev,
+                                            uint64_t iova)
+{
+    struct vhost_iommu *iommu;
+
+    QLIST_FOREACH(iommu, &dev->iommu_list, iommu_next) {
+        hwaddr addr = iova - iommu->iommu_offset;
+
+        if (iova >= iommu->iommu_offset &&
+            addr >= iommu->n.start && addr <= iommu->n.end) {
+            return iommu;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Look up the page containing @iova without faulting the guest if it is
+ * not mapped, for prefetching around a miss.
+ */
+static bool vhost_iotlb_probe(struct vhost_dev *dev, struct vhost_iommu *iommu,
+                              uint64_t iova, int write, VhostIOTLBRange *r)
+{
+    IOMMUTLBEntry iotlb;
+    IOMMUAccessFlags perm = write ? IOMMU_WO : IOMMU_RO;
+    hwaddr addr = iova - iommu->iommu_offset;
+    uint64_t len;
+
+    if (iova < iommu->iommu_offset ||
+        addr < iommu->n.start || addr > iommu->n.end) {
+        return false;
+    }
+
+    iotlb = memory_region_iommu_probe(IOMMU_MEMORY_REGION(iommu->mr), addr,
+                                      perm, iommu->n.iommu_idx);
+    if ((iotlb.perm & perm) != perm ||
+        iotlb.target_as != &address_space_memory) {
+        return false;
+    }
+    if (vhost_memory_region_lookup(dev, iotlb.translated_addr,
+                                   &r->uaddr, &len)) {
+        return false;
+    }
+
+    r->iova = (addr & ~iotlb.addr_mask) + iommu->iommu_offset;
+    r->len = MIN(iotlb.addr_mask + 1, len);
+    r->perm = iotlb.perm;
+    return true;
+}
+
+/* Number of pages looked up on each side of a miss */
+#define VHOST_IOTLB_PREFETCH_PAGES 16
+
 int vhost_device_iotlb_miss(struct vhost_dev *dev, uint64_t iova, int write)
 {
+    VhostIOTLBRange r[2 * VHOST_IOTLB_PREFETCH_PAGES + 1];
+    struct vhost_iommu *iommu;
     IOMMUTLBEntry iotlb;
     uint64_t uaddr, len;
+    int first, last;
     int ret = -EFAULT;
 
+    dev->iotlb_stats.misses++;
+    if (vhost_iotlb_sent_covers(dev, iova, write)) {
+        dev->iotlb_stats.covered++;
+        trace_vhost_iotlb_miss(dev, 5);
+        return 0;
+    }
+
     rcu_read_lock();
 
     trace_vhost_iotlb_miss(dev, 1);
@@ -934,8 +1076,34 @@ int vhost_device_iotlb_miss(struct vhost_dev *dev, uint64_t iova, int write)
         len = MIN(iotlb.addr_mask + 1, len);
         iova = iova & ~iotlb.addr_mask;
 
-        ret = vhost_backend_update_device_iotlb(dev, iova, uaddr,
-                                                len, iotlb.perm);
+        /*
+         * The backend will most likely touch the neighbouring pages soon,
+         * e.g. the rest of a ring or of a large buffer.  Send those that
+         * are already mapped together with the missing one.
+         */
+        first = last = VHOST_IOTLB_PREFETCH_PAGES;
+        r[first] = (VhostIOTLBRange) {
+            .iova = iova, .uaddr = uaddr, .len = len, .perm = iotlb.perm,
+        };
+        iommu = vhost_iommu_find(dev, iova);
+        if (iommu) {
+            while (first > 0 && r[first].iova &&
+                   vhost_iotlb_probe(dev, iommu, r[first].iova - 1, write,
+                                     &r[first - 1]) &&
+                   r[first - 1].iova + r[first - 1].len == r[first].iova) {
+                first--;
+            }
+            while (last < ARRAY_SIZE(r) - 1 &&
+                   r[last].iova + r[last].len &&
+                   vhost_iotlb_probe(dev, iommu, r[last].iova + r[last].len,
+                                     write, &r[last + 1]) &&
+                   r[last + 1].iova == r[last].iova + r[last].len) {
+                last++;
+            }
+        }
+        dev->iotlb_stats.prefetched += last - first;
+
+        ret = vhost_iotlb_update_ranges(dev, r + first, last - first + 1);
         if (ret) {
             trace_vhost_iotlb_miss(dev, 4);
             error_report("Fail to update device iotlb");
@@ -1701,3 +1869,35 @@ int vhost_net_set_backend(struct vhost_dev *hdev,
 
     return -1;
 }
+
+VhostIOTLBStatsList *qmp_x_query_vhost_iotlb(Error **errp)
+{
+    VhostIOTLBStatsList *head = NULL, **tail = &head;
+    struct vhost_dev *hdev;
+
+    QLIST_FOREACH(hdev, &vhost_devices, entry) {
+        VhostIOTLBStatsList *elem;
+        VhostIOTLBStats *info;
+
+        if (!hdev->vdev || !vhost_dev_has_iommu(hdev)) {
+            continue;
+        }
+
+        info = g_new0(VhostIOTLBStats, 1);
+        info->device = object_get_canonical_path(OBJECT(hdev->vdev));
+        info->vq_index = hdev->vq_index;
+        info->misses = hdev->iotlb_stats.misses;
+        info->covered = hdev->iotlb_stats.covered;
+        info->batches = hdev->iotlb_stats.batches;
+        info->updates = hdev->iotlb_stats.updates;
+        info->prefetched = hdev->iotlb_stats.prefetched;
+        info->invalidations = hdev->iotlb_stats.invalidations;
+
+        elem = g_new0(VhostIOTLBStatsList, 1);
+        elem->value = info;
+        *tail = elem;
+        tail = &elem->next;
+    }
+
+    return head;
+}
@@ -1462,6 +1462,15 @@ static void virtio_pci_modern_regions_init(VirtIOPCIProxy *proxy)
                           virtio_bus_get_device(&proxy->bus),
                           "virtio-pci-notify-pio",
                           proxy->notify_pio.size);
+
+    /*
+     * Notify reads touch no state.  Writes keep the BQL: without an
+     * ioeventfd they run the virtqueue handler of the device, and with
+     * one memory_region_dispatch_write() walks mr->ioeventfds, which
+     * memory_region_add_eventfd() reallocates under the BQL.
+     */
+    memory_region_clear_global_locking_reads(&proxy->notify.mr);
+    memory_region_clear_global_locking_reads(&proxy->notify_pio.mr);
 }
 
 static void virtio_pci_modern_region_map(VirtIOPCIProxy *proxy,
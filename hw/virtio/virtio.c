@@ -13,6 +13,7 @@
 
 #include "qemu/osdep.h"
 #include "qapi/error.h"
+#include "qapi/visitor.h"
 #include "cpu.h"
 #include "trace.h"
 #include "exec/address-spaces.h"
@@ -112,9 +113,29 @@ struct VirtQueue
     VirtIODevice *vdev;
     EventNotifier guest_notifier;
     EventNotifier host_notifier;
+
+    /* Notification coalescing, see virtio_coalesce_defer() */
+    VirtIOCoalesce *coalesce;
+    QEMUTimer *coalesce_timer;
+    AioContext *coalesce_ctx;
+    /* used_idx at the time of the last notification */
+    uint16_t coalesce_used_idx;
+    /* Deferred notification goes through virtio_notify_irqfd() */
+    bool coalesce_irqfd;
+
     QLIST_ENTRY(VirtQueue) node;
 };
 
+static void virtio_coalesce_release(VirtQueue *vq)
+{
+    if (vq->coalesce_timer) {
+        timer_del(vq->coalesce_timer);
+        timer_free(vq->coalesce_timer);
+        vq->coalesce_timer = NULL;
+        vq->coalesce_ctx = NULL;
+    }
+}
+
 static void virtio_free_region_cache(VRingMemoryRegionCaches *caches)
 {
     if (!caches) {
@@ -1242,6 +1263,8 @@ void virtio_reset(void *opaque)
         vdev->vq[i].notification = true;
         vdev->vq[i].vring.num = vdev->vq[i].vring.num_default;
         vdev->vq[i].inuse = 0;
+        vdev->vq[i].coalesce_used_idx = 0;
+        virtio_coalesce_release(&vdev->vq[i]);
         virtio_virtqueue_reset_region_cache(&vdev->vq[i]);
     }
 }
@@ -1640,6 +1663,8 @@ void virtio_del_queue(VirtIODevice *vdev, int n)
     vdev->vq[n].vring.num_default = 0;
     vdev->vq[n].handle_output = NULL;
     vdev->vq[n].handle_aio_output = NULL;
+    vdev->vq[n].coalesce = NULL;
+    virtio_coalesce_release(&vdev->vq[n]);
 }
 
 static void virtio_set_isr(VirtIODevice *vdev, int value)
@@ -1678,9 +1703,19 @@ static bool virtio_should_notify(VirtIODevice *vdev, VirtQueue *vq)
     return !v || vring_need_event(vring_get_used_event(vq), new, old);
 }
 
-void virtio_notify_irqfd(VirtIODevice *vdev, VirtQueue *vq)
+static void virtio_coalesce_done(VirtQueue *vq)
+{
+    vq->coalesce_used_idx = vq->used_idx;
+    if (vq->coalesce_timer) {
+        timer_del(vq->coalesce_timer);
+    }
+}
+
+static void virtio_notify_irqfd_now(VirtIODevice *vdev, VirtQueue *vq)
 {
     bool should_notify;
+
+    virtio_coalesce_done(vq);
     rcu_read_lock();
     should_notify = virtio_should_notify(vdev, vq);
     rcu_read_unlock();
@@ -1716,9 +1751,11 @@ static void virtio_irq(VirtQueue *vq)
     virtio_notify_vector(vq->vdev, vq->vector);
 }
 
-void virtio_notify(VirtIODevice *vdev, VirtQueue *vq)
+static void virtio_notify_now(VirtIODevice *vdev, VirtQueue *vq)
 {
     bool should_notify;
+
+    virtio_coalesce_done(vq);
     rcu_read_lock();
     should_notify = virtio_should_notify(vdev, vq);
     rcu_read_unlock();
@@ -1731,6 +1768,145 @@ void virtio_notify(VirtIODevice *vdev, VirtQueue *vq)
     virtio_irq(vq);
 }
 
+static void virtio_coalesce_timer_cb(void *opaque)
+{
+    VirtQueue *vq = opaque;
+
+    trace_virtio_coalesce_fire(vq->vdev, vq,
+                               (uint16_t)(vq->used_idx -
+                                          vq->coalesce_used_idx));
+    if (vq->coalesce_irqfd) {
+        virtio_notify_irqfd_now(vq->vdev, vq);
+    } else {
+        virtio_notify_now(vq->vdev, vq);
+    }
+}
+
+/*
+ * Device-side notification coalescing: hold back the notification for
+ * up to coalesce->usecs, or until coalesce->max_used buffers have been
+ * completed since the last one.  This runs before virtio_should_notify()
+ * so that, with VIRTIO_RING_F_EVENT_IDX, the used event index is checked
+ * against the whole range of buffers completed while the notification
+ * was held back, and the guest's own suppression is still honoured.
+ *
+ * The timer lives in the AioContext of the thread completing requests;
+ * if the queue moves to a different one, the pending notification is
+ * sent right away and the timer is recreated on the next completion.
+ *
+ * Returns true if the notification has been deferred.
+ */
+static bool virtio_coalesce_defer(VirtQueue *vq, bool irqfd)
+{
+    VirtIOCoalesce *c = vq->coalesce;
+    uint32_t usecs, max_used;
+    uint16_t pending;
+    AioContext *ctx;
+
+    if (!c) {
+        return false;
+    }
+    usecs = atomic_read(&c->usecs);
+    if (!usecs) {
+        return false;
+    }
+
+    pending = vq->used_idx - vq->coalesce_used_idx;
+    max_used = atomic_read(&c->max_used);
+    if (!pending || (max_used && pending >= max_used)) {
+        return false;
+    }
+
+    ctx = qemu_get_current_aio_context();
+    if (vq->coalesce_timer && vq->coalesce_ctx != ctx) {
+        virtio_coalesce_release(vq);
+        return false;
+    }
+    if (!vq->coalesce_timer) {
+        vq->coalesce_timer = aio_timer_new(ctx, QEMU_CLOCK_VIRTUAL, SCALE_NS,
+                                           virtio_coalesce_timer_cb, vq);
+        vq->coalesce_ctx = ctx;
+    }
+
+    vq->coalesce_irqfd = irqfd;
+    if (!timer_pending(vq->coalesce_timer)) {
+        timer_mod(vq->coalesce_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                  (int64_t)usecs * SCALE_US);
+    }
+    trace_virtio_coalesce_defer(vq->vdev, vq, pending);
+    return true;
+}
+
+/* Send a notification held back by virtio_coalesce_defer(), if any */
+static void virtio_coalesce_flush(VirtQueue *vq)
+{
+    if (vq->coalesce_timer && timer_pending(vq->coalesce_timer)) {
+        virtio_coalesce_timer_cb(vq);
+    }
+}
+
+void virtio_notify_irqfd(VirtIODevice *vdev, VirtQueue *vq)
+{
+    if (!virtio_coalesce_defer(vq, true)) {
+        virtio_notify_irqfd_now(vdev, vq);
+    }
+}
+
+void virtio_notify(VirtIODevice *vdev, VirtQueue *vq)
+{
+    if (!virtio_coalesce_defer(vq, false)) {
+        virtio_notify_now(vdev, vq);
+    }
+}
+
+void virtio_queue_set_coalesce(VirtQueue *vq, VirtIOCoalesce *coalesce)
+{
+    vq->coalesce = coalesce;
+    vq->coalesce_used_idx = vq->used_idx;
+}
+
+/*
+ * Coalescing parameters are plain uint32 values that, unlike the
+ * generic ones, may be changed after realize; they are read afresh on
+ * every completion.
+ */
+static void virtio_get_coalesce_param(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    DeviceState *dev = DEVICE(obj);
+    Property *prop = opaque;
+    uint32_t *ptr = qdev_get_prop_ptr(dev, prop);
+
+    visit_type_uint32(v, name, ptr, errp);
+}
+
+static void virtio_set_coalesce_param(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    DeviceState *dev = DEVICE(obj);
+    Property *prop = opaque;
+    uint32_t *ptr = qdev_get_prop_ptr(dev, prop);
+    Error *local_err = NULL;
+    uint32_t value;
+
+    visit_type_uint32(v, name, &value, &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return;
+    }
+    atomic_set(ptr, value);
+}
+
+const PropertyInfo virtio_prop_coalesce_param = {
+    .name  = "uint32",
+    .description = "Notification coalescing parameter, 0 to disable",
+    .get = virtio_get_coalesce_param,
+    .set = virtio_set_coalesce_param,
+};
+
 void virtio_notify_config(VirtIODevice *vdev)
 {
     if (!(vdev->status & VIRTIO_CONFIG_S_DRIVER_OK))
@@ -1971,6 +2147,10 @@ int virtio_save(VirtIODevice *vdev, QEMUFile *f)
     uint32_t guest_features_lo = (vdev->guest_features & 0xffffffff);
     int i;
 
+    for (i = 0; i < VIRTIO_QUEUE_MAX; i++) {
+        virtio_coalesce_flush(&vdev->vq[i]);
+    }
+
     if (k->save_config) {
         k->save_config(qbus->parent, f);
     }
@@ -2269,6 +2449,7 @@ int virtio_load(VirtIODevice *vdev, QEMUFile *f, int version_id)
                 return -1;
             }
             vdev->vq[i].used_idx = vring_used_idx(&vdev->vq[i]);
+            vdev->vq[i].coalesce_used_idx = vdev->vq[i].used_idx;
             vdev->vq[i].shadow_avail_idx = vring_avail_idx(&vdev->vq[i]);
 
             /*
@@ -2540,6 +2721,9 @@ void virtio_queue_aio_set_host_notifier_handler(VirtQueue *vq, AioContext *ctx,
          * in case poll callback didn't have time to run. */
         virtio_queue_host_notifier_aio_read(&vq->host_notifier);
         vq->handle_aio_output = NULL;
+        /* The queue leaves @ctx, don't leave a notification behind in it */
+        virtio_coalesce_flush(vq);
+        virtio_coalesce_release(vq);
     }
 }
 
@@ -2663,6 +2847,7 @@ static void virtio_device_free_virtqueues(VirtIODevice *vdev)
         if (vdev->vq[i].vring.num == 0) {
             break;
         }
+        virtio_coalesce_release(&vdev->vq[i]);
         virtio_virtqueue_reset_region_cache(&vdev->vq[i]);
     }
     g_free(vdev->vq);
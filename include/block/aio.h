@@ -46,6 +46,12 @@ typedef void QEMUBHFunc(void *opaque);
 typedef bool AioPollFn(void *opaque);
 typedef void IOHandler(void *opaque);
 
+typedef struct AioPollStats {
+    uint64_t hits;          /* busy polling found an event */
+    uint64_t misses;        /* busy polling ended without an event */
+    uint64_t time_ns;       /* total time spent busy polling */
+} AioPollStats;
+
 struct Coroutine;
 struct ThreadPool;
 struct LinuxAioState;
@@ -139,6 +145,15 @@ struct AioContext {
     int64_t poll_grow;      /* polling time growth factor */
     int64_t poll_shrink;    /* polling time shrink factor */
 
+    /* Adaptive polling, enabled if either of these is non-zero */
+    int64_t poll_latency_ns; /* poll for events expected this soon */
+    int64_t poll_cpu_budget; /* max percentage of time spent polling */
+    int64_t poll_period_start; /* start of the CPU budget period */
+    int64_t poll_period_ns;    /* time spent polling in the period */
+
+    /* Written by the home thread only, may be read approximately by others */
+    AioPollStats poll_stats;
+
     /* Are we in polling mode or monitoring file descriptors? */
     bool poll_started;
 
@@ -622,4 +637,20 @@ void aio_context_set_poll_params(AioContext *ctx, int64_t max_ns,
                                  int64_t grow, int64_t shrink,
                                  Error **errp);
 
+/**
+ * aio_context_set_poll_target:
+ * @ctx: the aio context
+ * @latency_ns: busy poll only for handlers whose events are on average
+ *              closer than this, in nanoseconds
+ * @cpu_budget: maximum percentage of time spent busy polling
+ *
+ * Setting either value to non-zero replaces the grow/shrink heuristic with
+ * an adaptive one: the time between events is tracked for each handler and
+ * the context polls until just after the next event that it predicts, but
+ * never longer than the max_ns set with aio_context_set_poll_params().  A
+ * zero @latency_ns stands for max_ns, a zero @cpu_budget for no limit.
+ */
+void aio_context_set_poll_target(AioContext *ctx, int64_t latency_ns,
+                                 int64_t cpu_budget, Error **errp);
+
 #endif
@@ -321,4 +321,42 @@ int qcrypto_tls_session_get_key_size(QCryptoTLSSession *sess,
  */
 char *qcrypto_tls_session_get_peer_name(QCryptoTLSSession *sess);
 
+typedef enum {
+    QCRYPTO_TLS_KTLS_TX = (1 << 0),
+    QCRYPTO_TLS_KTLS_RX = (1 << 1),
+} QCryptoTLSSessionKTLS;
+
+/**
+ * qcrypto_tls_session_enable_ktls:
+ * @sess: the TLS session object
+ * @fd: the TCP socket the session is running over
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Hand the record layer keys of the session over to the
+ * kernel TLS implementation attached to @fd, so that payload
+ * data can then be sent and received with plain socket I/O
+ * on @fd, bypassing qcrypto_tls_session_write() and
+ * qcrypto_tls_session_read().
+ *
+ * It is an error to call this before
+ * qcrypto_tls_session_get_handshake_status() returns
+ * QCRYPTO_TLS_HANDSHAKE_COMPLETE, or once any payload
+ * data has been exchanged through the session.
+ *
+ * Only sessions using AES-GCM can be offloaded. With TLS
+ * 1.2 both directions are, kernel permitting; with TLS 1.3
+ * only transmit is, and a peer asking for a key update
+ * then makes qcrypto_tls_session_read() fail. An error is
+ * reported if the session, the build or the running kernel
+ * does not allow offload; the session can then still be
+ * used as before.
+ *
+ * Returns: a mask of QCRYPTO_TLS_KTLS_TX and
+ * QCRYPTO_TLS_KTLS_RX for the directions now handled
+ * by the kernel, or -1 on error
+ */
+int qcrypto_tls_session_enable_ktls(QCryptoTLSSession *sess,
+                                    int fd,
+                                    Error **errp);
+
 #endif /* QCRYPTO_TLSSESSION_H */
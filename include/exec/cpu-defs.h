@@ -81,6 +81,8 @@ typedef uint64_t target_ulong;
 
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
+/* Number of large pages tracked exactly per mmu_idx.  */
+#define CPU_TLB_LARGE_PAGES 8
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -152,15 +154,28 @@ typedef struct CPUIOTLBEntry {
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
  */
+typedef struct CPUTLBLargePage {
+    target_ulong addr;
+    target_ulong mask;
+} CPUTLBLargePage;
+
 typedef struct CPUTLBDesc {
     /*
      * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
+     * into the tlb.  The region is matched if
      * (addr & large_page_mask) == large_page_addr.
      */
     target_ulong large_page_addr;
     target_ulong large_page_mask;
+    /*
+     * The large pages themselves, as long as there are no more than
+     * CPU_TLB_LARGE_PAGES of them.  Flushing a page within one of
+     * these only evicts the entries of that large page.  When more
+     * large pages were added, n_large_pages is -1 and flushing any
+     * page within the region above flushes the entire tlb.
+     */
+    int n_large_pages;
+    CPUTLBLargePage large_pages[CPU_TLB_LARGE_PAGES];
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -206,6 +221,10 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    size_t page_flush_count;
+    /* Page flushes that evicted a whole large page, or the whole tlb.  */
+    size_t large_page_flush_count;
+    size_t large_page_full_flush_count;
 } CPUTLBCommon;
 
 /*
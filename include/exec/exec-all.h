@@ -357,6 +357,7 @@ struct TranslationBlock {
 #define CF_USE_ICOUNT  0x00020000
 #define CF_INVALID     0x00040000 /* TB is stale. Set with @jmp_lock held */
 #define CF_PARALLEL    0x00080000 /* Generate code for a parallel context */
+#define CF_SUPERBLOCK  0x00100000 /* Hot block, may follow direct jumps */
 #define CF_CLUSTER_MASK 0xff000000 /* Top 8 bits are cluster ID */
 #define CF_CLUSTER_SHIFT 24
 /* cflags' mask for hashing/comparison */
@@ -410,6 +411,15 @@ struct TranslationBlock {
     uintptr_t jmp_list_head;
     uintptr_t jmp_list_next[2];
     uintptr_t jmp_dest[2];
+
+    /* Execution statistics, NULL unless enabled at translation time */
+    struct TBStatistics *tb_stats;
+
+    /*
+     * Executions left before the block is retranslated as a superblock,
+     * see tb_superblock_candidate().  Decremented by generated code.
+     */
+    int32_t sb_countdown;
 };
 
 extern bool parallel_cpus;
@@ -420,6 +430,26 @@ static inline uint32_t tb_cflags(const TranslationBlock *tb)
     return atomic_read(&tb->cflags);
 }
 
+/*
+ * Number of executions after which a block is retranslated with
+ * CF_SUPERBLOCK, on targets that define TARGET_HAS_SUPERBLOCKS.
+ */
+#define TB_SUPERBLOCK_THRESHOLD 1000
+
+/*
+ * Superblocks are only formed out of plain, cacheable blocks; the
+ * execution count of other blocks is not maintained.
+ */
+static inline bool tb_superblock_candidate(const TranslationBlock *tb)
+{
+#ifdef TARGET_HAS_SUPERBLOCKS
+    return !(tb_cflags(tb) & (CF_COUNT_MASK | CF_LAST_IO | CF_NOCACHE |
+                              CF_USE_ICOUNT | CF_SUPERBLOCK));
+#else
+    return false;
+#endif
+}
+
 /* current cflags for hashing/comparison */
 static inline uint32_t curr_cflags(void)
 {
@@ -2,6 +2,7 @@
 #define GEN_ICOUNT_H
 
 #include "qemu/timer.h"
+#include "exec/tb-stats.h"
 
 /* Helpers for instruction counting code generation.  */
 
@@ -32,10 +33,53 @@ static inline void gen_io_end(void)
     tcg_temp_free_i32(tmp);
 }
 
+/*
+ * Count executions of the TB for "info tb-stats".  The increment is not
+ * atomic, so that it costs no more than a load and a store.
+ */
+static inline void gen_tb_exec_count(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_const_ptr(&tb->tb_stats->exec_count);
+    TCGv_i64 count = tcg_temp_new_i64();
+
+    tcg_gen_ld_i64(count, ptr, 0);
+    tcg_gen_addi_i64(count, count, 1);
+    tcg_gen_st_i64(count, ptr, 0);
+    tcg_temp_free_i64(count);
+    tcg_temp_free_ptr(ptr);
+}
+
+/*
+ * Count down the executions of a superblock candidate.  When the count
+ * reaches zero, request an exit so that tb_find retranslates the block.
+ */
+static inline void gen_tb_sb_countdown(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_const_ptr(&tb->sb_countdown);
+    TCGv_i32 count = tcg_temp_new_i32();
+    TCGLabel *l = gen_new_label();
+
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_subi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+    tcg_gen_brcondi_i32(TCG_COND_NE, count, 0, l);
+    tcg_gen_movi_i32(count, -1);
+    tcg_gen_st16_i32(count, cpu_env,
+                     offsetof(ArchCPU, neg.icount_decr.u16.high) -
+                     offsetof(ArchCPU, env));
+    gen_set_label(l);
+    tcg_temp_free_i32(count);
+    tcg_temp_free_ptr(ptr);
+}
+
 static inline void gen_tb_start(TranslationBlock *tb)
 {
     TCGv_i32 count, imm;
 
+    if (tb_superblock_candidate(tb)) {
+        gen_tb_sb_countdown(tb);
+    }
+
     tcg_ctx->exitreq_label = gen_new_label();
     if (tb_cflags(tb) & CF_USE_ICOUNT) {
         count = tcg_temp_local_new_i32();
@@ -69,6 +113,10 @@ static inline void gen_tb_start(TranslationBlock *tb)
     }
 
     tcg_temp_free_i32(count);
+
+    if (tb->tb_stats) {
+        gen_tb_exec_count(tb);
+    }
 }
 
 static inline void gen_tb_end(TranslationBlock *tb, int num_insns)
@@ -273,6 +273,23 @@ typedef struct IOMMUMemoryRegionClass {
      */
     IOMMUTLBEntry (*translate)(IOMMUMemoryRegion *iommu, hwaddr addr,
                                IOMMUAccessFlags flag, int iommu_idx);
+    /*
+     * Look up the mapping that contains a given address, like translate,
+     * but without any side effect visible to the guest: a missing or
+     * non-permitted mapping must not be reported as a fault.  Callers use
+     * this to speculatively look at mappings that no device has accessed
+     * yet, for example to prefetch neighbouring translations.
+     *
+     * Optional method -- if it is not provided, such lookups always
+     * report that nothing is mapped.
+     *
+     * @iommu: the IOMMUMemoryRegion
+     * @hwaddr: address to be looked up within the memory region
+     * @flag: requested access permissions
+     * @iommu_idx: IOMMU index for the lookup
+     */
+    IOMMUTLBEntry (*translate_probe)(IOMMUMemoryRegion *iommu, hwaddr addr,
+                                     IOMMUAccessFlags flag, int iommu_idx);
     /* Returns minimum supported page size in bytes.
      * If this method is not provided then the minimum is assumed to
      * be TARGET_PAGE_SIZE.
@@ -368,6 +385,7 @@ struct MemoryRegion {
     bool rom_device;
     bool flush_coalesced_mmio;
     bool global_locking;
+    bool global_locking_reads;
     uint8_t dirty_log_mask;
     bool is_iommu;
     RAMBlock *ram_block;
@@ -1026,6 +1044,23 @@ static inline IOMMUMemoryRegionClass *memory_region_get_iommu_class_nocheck(
  */
 uint64_t memory_region_iommu_get_min_page_size(IOMMUMemoryRegion *iommu_mr);
 
+/**
+ * memory_region_iommu_probe: look up an IOMMU mapping without faulting
+ *
+ * Returns the mapping that contains @addr, as the translate method
+ * would, but never raises a fault in the guest.  The returned entry has
+ * perm == IOMMU_NONE if nothing is mapped at @addr with the requested
+ * permissions, or if the IOMMU does not support quiet lookups.
+ *
+ * @iommu_mr: the memory region being queried
+ * @addr: address to be looked up within the memory region
+ * @flag: requested access permissions
+ * @iommu_idx: IOMMU index for the lookup
+ */
+IOMMUTLBEntry memory_region_iommu_probe(IOMMUMemoryRegion *iommu_mr,
+                                        hwaddr addr, IOMMUAccessFlags flag,
+                                        int iommu_idx);
+
 /**
  * memory_region_notify_iommu: notify a change in an IOMMU translation entry.
  *
@@ -1473,6 +1508,35 @@ void memory_region_clear_flush_coalesced(MemoryRegion *mr);
  */
 void memory_region_clear_global_locking(MemoryRegion *mr);
 
+/**
+ * memory_region_clear_global_locking_reads: Declares that reads from the
+ *                                           region do not depend on the QEMU
+ *                                           global lock.
+ *
+ * Like memory_region_clear_global_locking(), but writes to the region are
+ * still processed under the global lock.  This suits registers that are
+ * read often but only change as a result of a write, such as configuration
+ * space or interrupt vector tables: the read handler only needs to cope
+ * with concurrent writers, not with other readers.
+ *
+ * @mr: the memory region to be updated.
+ */
+void memory_region_clear_global_locking_reads(MemoryRegion *mr);
+
+/**
+ * memory_region_needs_global_locking: Returns whether an access to the
+ *                                     region must be processed under the
+ *                                     QEMU global lock.
+ *
+ * @mr: the memory region being accessed.
+ * @is_write: whether the access is a write.
+ */
+static inline bool memory_region_needs_global_locking(MemoryRegion *mr,
+                                                      bool is_write)
+{
+    return is_write ? mr->global_locking : mr->global_locking_reads;
+}
+
 /**
  * memory_region_add_eventfd: Request an eventfd to be triggered when a word
  *                            is written to a location.
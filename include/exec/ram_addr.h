@@ -68,6 +68,15 @@ struct RAMBlock {
      */
     unsigned long *clear_bmap;
     uint8_t clear_bmap_shift;
+
+    /*
+     * With the fixed-ram migration capability: bitmap of the pages
+     * present in the migration stream, and the offsets of that bitmap
+     * and of the pages of this block in the stream.
+     */
+    unsigned long *file_bmap;
+    off_t bitmap_offset;
+    off_t pages_offset;
 };
 
 /**
@@ -473,6 +482,10 @@ bool cpu_physical_memory_snapshot_get_dirty(DirtyBitmapSnapshot *snap,
                                             ram_addr_t start,
                                             ram_addr_t length);
 
+uint64_t cpu_physical_memory_snapshot_count_dirty(DirtyBitmapSnapshot *snap,
+                                                  ram_addr_t start,
+                                                  ram_addr_t length);
+
 static inline void cpu_physical_memory_clear_dirty_range(ram_addr_t start,
                                                          ram_addr_t length)
 {
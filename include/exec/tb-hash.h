@@ -59,6 +59,12 @@ static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc)
 
 #endif /* CONFIG_SOFTMMU */
 
+/* Slot of cpu->tb_ibtc used by the indirect branch at guest address @pc */
+static inline unsigned int tb_ibtc_hash_func(target_ulong pc)
+{
+    return (pc ^ (pc >> TB_IBTC_BITS)) & (TB_IBTC_SIZE - 1);
+}
+
 static inline
 uint32_t tb_hash_func(tb_page_addr_t phys_pc, target_ulong pc, uint32_t flags,
                       uint32_t cf_mask, uint32_t trace_vcpu_dstate)
@@ -0,0 +1,62 @@
+/*
+ * Per-TB execution and translation statistics
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef EXEC_TB_STATS_H
+#define EXEC_TB_STATS_H
+
+#include "exec/exec-all.h"
+#include "qapi/qapi-types-misc-target.h"
+
+/*
+ * Statistics are kept per guest block, i.e. per (phys_pc, pc, cs_base,
+ * flags), so that they survive retranslation and tb_flush.  Entries are
+ * never freed; "reset" only clears the counters, because generated code
+ * points directly at @exec_count.
+ */
+typedef struct TBStatistics {
+    tb_page_addr_t phys_pc;
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+
+    /*
+     * Incremented by generated code on every entry to the block, without
+     * atomics.  Concurrent vCPUs may lose counts under MTTCG.
+     */
+    uint64_t exec_count;
+
+    /* Updated at translation and invalidation time */
+    uint64_t translations;
+    uint64_t invalidations;
+    uint64_t guest_insns;
+    uint64_t guest_bytes;
+    uint64_t host_bytes;
+    uint64_t ops;
+    uint64_t spills;
+
+    /* Most recent translation, NULL once invalidated or flushed */
+    TranslationBlock *tb;
+} TBStatistics;
+
+extern bool tb_stats_enabled;
+
+static inline bool tb_stats_collection_enabled(void)
+{
+    return atomic_read(&tb_stats_enabled);
+}
+
+TBStatistics *tb_stats_get(tb_page_addr_t phys_pc, target_ulong pc,
+                           target_ulong cs_base, uint32_t flags);
+void tb_stats_record(TranslationBlock *tb, int ops, int spills);
+void tb_stats_invalidate(TranslationBlock *tb);
+void tb_stats_flush(void);
+
+void tb_stats_set_enabled(bool enable);
+void tb_stats_reset(void);
+GPtrArray *tb_stats_sorted(TbStatsSortBy sort_by, int max);
+
+#endif /* EXEC_TB_STATS_H */
@@ -60,6 +60,9 @@ typedef enum DisasJumpType {
  * @num_insns: Number of translated instructions (including current).
  * @max_insns: Maximum number of instructions to be translated in this TB.
  * @singlestep_enabled: "Hardware" single stepping enabled.
+ * @pc_max: End of the guest code translated so far, when this TB is a
+ *          superblock and @pc_next may have moved backwards.
+ * @sb_jumps: Number of direct jumps followed in this superblock.
  *
  * Architecture-agnostic disassembly context.
  */
@@ -71,6 +74,8 @@ typedef struct DisasContextBase {
     int num_insns;
     int max_insns;
     bool singlestep_enabled;
+    target_ulong pc_max;
+    int sb_jumps;
 } DisasContextBase;
 
 /**
@@ -142,4 +147,34 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
 
 void translator_loop_temp_check(DisasContextBase *db);
 
+/**
+ * translator_follow_jump:
+ * @db: Disassembly context.
+ * @insn_end: Address following the jump instruction.
+ * @dest: Destination of the jump.
+ *
+ * Called by #TranslatorOps::translate_insn for a direct jump to @dest.
+ * Returns true if the TB is a superblock (CF_SUPERBLOCK) and translation
+ * may continue at @dest instead of ending the TB; the caller then emits
+ * no exit and sets the next pc to @dest.  The destination must lie at or
+ * above the entry point and on the same page, so that the TB still covers
+ * a contiguous range of guest code for invalidation purposes.
+ */
+bool translator_follow_jump(DisasContextBase *db, target_ulong insn_end,
+                            target_ulong dest);
+
+/**
+ * translator_lookup_and_goto_ptr:
+ * @db: Disassembly context.
+ * @dest: Guest address of the target, also already stored in the CPU state.
+ *
+ * Like tcg_gen_lookup_and_goto_ptr(), for an indirect branch that leaves
+ * the TB flags and cs_base unchanged, so that the next TB will have the
+ * same ones as @db->tb.  The generated code first probes the block that
+ * was last found for this branch site in CPUState.tb_ibtc and jumps to it
+ * directly if it matches @dest; otherwise it calls the lookup helper,
+ * which also updates the cache.
+ */
+void translator_lookup_and_goto_ptr(DisasContextBase *db, TCGv dest);
+
 #endif /* EXEC__TRANSLATOR_H */
@@ -275,6 +275,9 @@ struct hax_vcpu_state;
 #define TB_JMP_CACHE_BITS 12
 #define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
 
+#define TB_IBTC_BITS 9
+#define TB_IBTC_SIZE (1 << TB_IBTC_BITS)
+
 /* work queue */
 
 /* The union type allows passing of 64 bit target pointers on 32 bit
@@ -395,6 +398,12 @@ struct CPUState {
 
     /* Accessed in parallel; all accesses must be atomic */
     struct TranslationBlock *tb_jmp_cache[TB_JMP_CACHE_SIZE];
+    /*
+     * Last target of the indirect branches, indexed by a hash of the
+     * branch's guest address and probed by generated code.  Cleared
+     * together with tb_jmp_cache.
+     */
+    struct TranslationBlock *tb_ibtc[TB_IBTC_SIZE];
 
     struct GDBRegisterState *gdb_regs;
     int gdb_num_regs;
@@ -444,6 +453,14 @@ struct CPUState {
      */
     bool throttle_thread_scheduled;
 
+    /* Throttle percentage set for this vCPU only, on top of the global one */
+    int throttle_percentage;
+
+    /* Guest pages this vCPU moved from clean to dirty while dirty logging
+     * was enabled.  Only maintained by TCG.
+     */
+    uint64_t dirty_pages;
+
     bool ignore_memory_transaction_failures;
 
     struct hax_vcpu_state *hax_vcpu;
@@ -472,6 +489,9 @@ static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
     for (i = 0; i < TB_JMP_CACHE_SIZE; i++) {
         atomic_set(&cpu->tb_jmp_cache[i], NULL);
     }
+    for (i = 0; i < TB_IBTC_SIZE; i++) {
+        atomic_set(&cpu->tb_ibtc[i], NULL);
+    }
 }
 
 /**
@@ -852,6 +872,26 @@ bool cpu_throttle_active(void);
  */
 int cpu_throttle_get_percentage(void);
 
+/**
+ * cpu_throttle_set_vcpu:
+ * @cpu: The vCPU to throttle.
+ * @new_throttle_pct: Percent of sleep time, 0 to stop throttling @cpu.
+ *
+ * Throttles a single vcpu like cpu_throttle_set does for all of them.  The
+ * vcpu sleeps for the larger of this percentage and the global one.  The
+ * per-vcpu percentage is cleared by cpu_throttle_stop.
+ */
+void cpu_throttle_set_vcpu(CPUState *cpu, int new_throttle_pct);
+
+/**
+ * cpu_throttle_get_vcpu_percentage:
+ * @cpu: The vCPU to query.
+ *
+ * Returns: The throttle percentage in effect for @cpu, 0 if it is not
+ * throttled.
+ */
+int cpu_throttle_get_vcpu_percentage(CPUState *cpu);
+
 #ifndef CONFIG_USER_ONLY
 
 typedef void (*CPUInterruptHandler)(CPUState *, int);
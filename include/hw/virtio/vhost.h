@@ -54,6 +54,26 @@ struct vhost_iommu {
     QLIST_ENTRY(vhost_iommu) iommu_next;
 };
 
+/* A range of IOVA sent to the backend's device IOTLB */
+typedef struct VhostIOTLBRange {
+    uint64_t iova;
+    uint64_t uaddr;
+    uint64_t len;
+    IOMMUAccessFlags perm;
+} VhostIOTLBRange;
+
+/* Maximum number of updates remembered while handling a batch of misses */
+#define VHOST_IOTLB_BATCH_MAX 32
+
+struct vhost_iotlb_stats {
+    uint64_t misses;
+    uint64_t covered;
+    uint64_t batches;
+    uint64_t updates;
+    uint64_t prefetched;
+    uint64_t invalidations;
+};
+
 typedef struct VhostDevConfigOps {
     /* Vhost device config space changed callback
      */
@@ -90,6 +110,10 @@ struct vhost_dev {
     QLIST_HEAD(, vhost_iommu) iommu_list;
     IOMMUNotifier n;
     const VhostDevConfigOps *config_ops;
+    bool iotlb_batching;
+    int n_iotlb_sent;
+    VhostIOTLBRange iotlb_sent[VHOST_IOTLB_BATCH_MAX];
+    struct vhost_iotlb_stats iotlb_stats;
 };
 
 int vhost_dev_init(struct vhost_dev *hdev, void *opaque,
@@ -120,6 +144,12 @@ int vhost_net_set_backend(struct vhost_dev *hdev,
                           struct vhost_vring_file *file);
 
 int vhost_device_iotlb_miss(struct vhost_dev *dev, uint64_t iova, int write);
+/*
+ * Bracket the handling of several IOTLB messages read at once, so that
+ * misses already served by an earlier update of the batch are skipped.
+ */
+void vhost_device_iotlb_batch_begin(struct vhost_dev *dev);
+void vhost_device_iotlb_batch_end(struct vhost_dev *dev);
 int vhost_dev_get_config(struct vhost_dev *dev, uint8_t *config,
                          uint32_t config_len);
 int vhost_dev_set_config(struct vhost_dev *dev, const uint8_t *data,
@@ -40,6 +40,7 @@ struct VirtIOBlkConf
     uint16_t queue_size;
     uint32_t max_discard_sectors;
     uint32_t max_write_zeroes_sectors;
+    VirtIOCoalesce coalesce;
 };
 
 struct VirtIOBlockDataPlane;
@@ -43,6 +43,8 @@ typedef struct virtio_net_conf
     int32_t speed;
     char *duplex_str;
     uint8_t duplex;
+    VirtIOCoalesce rx_coalesce;
+    VirtIOCoalesce tx_coalesce;
 } virtio_net_conf;
 
 /* Coalesced packets type & status */
@@ -121,6 +123,21 @@ typedef struct VirtioNetRscChain {
     VirtioNetRscStat stat;
 } VirtioNetRscChain;
 
+#define VIRTIO_NET_RSS_MAX_KEY_SIZE     40
+#define VIRTIO_NET_RSS_MAX_TABLE_LEN    128
+
+/* Receive side scaling and hash reporting state, set by the guest */
+typedef struct VirtioNetRssData {
+    bool enabled;
+    bool redirect;          /* steer packets by hash (RSS) */
+    bool populate_hash;     /* report the hash in the virtio-net header */
+    uint32_t hash_types;
+    uint8_t key[VIRTIO_NET_RSS_MAX_KEY_SIZE];
+    uint16_t indirections_len;
+    uint16_t *indirections_table;
+    uint16_t default_queue;
+} VirtioNetRssData;
+
 /* Maximum packet size we can receive from tap device: header + 64k */
 #define VIRTIO_NET_MAX_BUFSIZE (sizeof(struct virtio_net_hdr) + (64 * KiB))
 
@@ -130,6 +147,7 @@ typedef struct VirtIONetQueue {
     QEMUTimer *tx_timer;
     QEMUBH *tx_bh;
     uint32_t tx_waiting;
+    bool rx_notify_pending;
     struct {
         VirtQueueElement *elem;
     } async_tx;
@@ -185,6 +203,8 @@ struct VirtIONet {
     AnnounceTimer announce_timer;
     bool needs_vnet_hdr_swap;
     bool mtu_bypass_backend;
+    VirtioNetRssData rss_data;
+    struct NetRxPkt *rx_pkt;
 };
 
 void virtio_net_set_netclient_name(VirtIONet *n, const char *name,
@@ -206,6 +206,24 @@ void virtqueue_get_avail_bytes(VirtQueue *vq, unsigned int *in_bytes,
 void virtio_notify_irqfd(VirtIODevice *vdev, VirtQueue *vq);
 void virtio_notify(VirtIODevice *vdev, VirtQueue *vq);
 
+/*
+ * Used buffer notification coalescing.  With a non-zero @usecs, a
+ * notification is held back until @max_used buffers have been completed
+ * or @usecs microseconds have passed, whichever comes first.  Both may
+ * be changed at any time, see DEFINE_PROP_VIRTIO_COALESCE.
+ */
+typedef struct VirtIOCoalesce {
+    uint32_t max_used;
+    uint32_t usecs;
+} VirtIOCoalesce;
+
+void virtio_queue_set_coalesce(VirtQueue *vq, VirtIOCoalesce *coalesce);
+
+extern const PropertyInfo virtio_prop_coalesce_param;
+
+#define DEFINE_PROP_VIRTIO_COALESCE(_name, _state, _field) \
+    DEFINE_PROP(_name, _state, _field, virtio_prop_coalesce_param, uint32_t)
+
 int virtio_save(VirtIODevice *vdev, QEMUFile *f);
 
 extern const VMStateInfo virtio_vmstate_info;
@@ -42,6 +42,12 @@ typedef struct QIOChannelTLS QIOChannelTLS;
  *
  * This channel object is capable of running as either a
  * TLS server or TLS client.
+ *
+ * When the master channel is a TCP socket and the host
+ * kernel supports it, the record encryption is handed to
+ * the kernel once the handshake completes, and payload
+ * data is then sent and received directly on the master
+ * channel.
  */
 
 struct QIOChannelTLS {
@@ -49,6 +55,7 @@ struct QIOChannelTLS {
     QIOChannel *master;
     QCryptoTLSSession *session;
     QIOChannelShutdown shutdown;
+    int ktls; /* QCryptoTLSSessionKTLS directions handled by the kernel */
 };
 
 /**
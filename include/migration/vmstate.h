@@ -186,6 +186,16 @@ struct VMStateDescription {
     int (*pre_save)(void *opaque);
     int (*post_save)(void *opaque);
     bool (*needed)(void *opaque);
+    /*
+     * The section neither reads nor writes the state of other sections
+     * in its save and load paths, so it can be processed concurrently
+     * with them, on a thread that does not own the BQL (the BQL is held
+     * by the migration thread meanwhile).  On load, post_load hooks of the
+     * section and of its subsections still run with the BQL, from the
+     * migration thread, once the fields are parsed.  See
+     * device-state-threads.
+     */
+    bool independent;
     const VMStateField *fields;
     const VMStateDescription **subsections;
 };
@@ -426,6 +436,16 @@ extern const VMStateInfo vmstate_info_qtailq;
     .offset     = vmstate_offset_pointer(_state, _field, _type),     \
 }
 
+#define VMSTATE_VARRAY_UINT16_ALLOC(_field, _state, _field_num, _version, _info, _type) {\
+    .name       = (stringify(_field)),                               \
+    .version_id = (_version),                                        \
+    .num_offset = vmstate_offset_value(_state, _field_num, uint16_t),\
+    .info       = &(_info),                                          \
+    .size       = sizeof(_type),                                     \
+    .flags      = VMS_VARRAY_UINT16|VMS_POINTER|VMS_ALLOC,           \
+    .offset     = vmstate_offset_pointer(_state, _field, _type),     \
+}
+
 #define VMSTATE_VARRAY_UINT16_UNSAFE(_field, _state, _field_num, _version, _info, _type) {\
     .name       = (stringify(_field)),                               \
     .version_id = (_version),                                        \
@@ -1106,6 +1126,9 @@ extern const VMStateInfo vmstate_info_qtailq;
 
 int vmstate_load_state(QEMUFile *f, const VMStateDescription *vmsd,
                        void *opaque, int version_id);
+GArray *vmstate_defer_post_load_begin(void);
+void vmstate_defer_post_load_end(void);
+int vmstate_run_post_loads(GArray *post_loads);
 int vmstate_save_state(QEMUFile *f, const VMStateDescription *vmsd,
                        void *opaque, QJSON *vmdesc);
 int vmstate_save_state_v(QEMUFile *f, const VMStateDescription *vmsd,
@@ -44,7 +44,12 @@ typedef ssize_t (NetQueueDeliverFunc)(NetClientState *sender,
                                       int iovcnt,
                                       void *opaque);
 
+/* Called once the outermost batch in which packets were delivered ends */
+typedef void (NetQueueBatchEndFunc)(void *opaque);
+
 NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque);
+void qemu_net_queue_set_batch_end(NetQueue *queue,
+                                  NetQueueBatchEndFunc *batch_end);
 
 void qemu_net_queue_append_iov(NetQueue *queue,
                                NetClientState *sender,
@@ -72,4 +77,8 @@ ssize_t qemu_net_queue_send_iov(NetQueue *queue,
 void qemu_net_queue_purge(NetQueue *queue, NetClientState *from);
 bool qemu_net_queue_flush(NetQueue *queue);
 
+void qemu_net_queue_batch_begin(NetQueue *queue);
+void qemu_net_queue_batch_end(NetQueue *queue);
+bool qemu_net_queue_batching(NetQueue *queue);
+
 #endif /* QEMU_NET_QUEUE_H */
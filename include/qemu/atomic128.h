@@ -47,6 +47,24 @@ static inline Int128 atomic16_cmpxchg(Int128 *ptr, Int128 cmp, Int128 new)
     return atomic_cmpxchg__nocheck(ptr, cmp, new);
 }
 # define HAVE_CMPXCHG128 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_ATOMICS)
+/* With ARMv8.1-LSE, avoid the exclusive loop and its retries under load.  */
+static inline Int128 atomic16_cmpxchg(Int128 *ptr, Int128 cmp, Int128 new)
+{
+    /* CASP requires even/odd consecutive register pairs.  */
+    register uint64_t oldl asm("x0") = int128_getlo(cmp);
+    register uint64_t oldh asm("x1") = int128_gethi(cmp);
+    register uint64_t newl asm("x2") = int128_getlo(new);
+    register uint64_t newh asm("x3") = int128_gethi(new);
+
+    asm("caspal %[oldl], %[oldh], %[newl], %[newh], %[mem]"
+        : [mem] "+Q"(*ptr), [oldl] "+r"(oldl), [oldh] "+r"(oldh)
+        : [newl] "r"(newl), [newh] "r"(newh)
+        : "memory");
+
+    return int128_make128(oldl, oldh);
+}
+# define HAVE_CMPXCHG128 1
 #elif defined(CONFIG_CMPXCHG128)
 static inline Int128 atomic16_cmpxchg(Int128 *ptr, Int128 cmp, Int128 new)
 {
@@ -85,7 +103,12 @@ Int128 QEMU_ERROR("unsupported atomic")
 # define HAVE_CMPXCHG128 0
 #endif /* Some definition for HAVE_CMPXCHG128 */
 
-
+/*
+ * HAVE_ATOMIC128_RO is true if atomic16_read does not need write access.
+ * Otherwise the read is implemented with a store, which is fine for
+ * softmmu where all RAM is writable from the host, but user-only must
+ * check that the guest page is writable before using it.
+ */
 #if defined(CONFIG_ATOMIC128)
 static inline Int128 atomic16_read(Int128 *ptr)
 {
@@ -98,7 +121,8 @@ static inline void atomic16_set(Int128 *ptr, Int128 val)
 }
 
 # define HAVE_ATOMIC128 1
-#elif !defined(CONFIG_USER_ONLY) && defined(__aarch64__)
+# define HAVE_ATOMIC128_RO 1
+#elif defined(__aarch64__)
 /* We can do better than cmpxchg for AArch64.  */
 static inline Int128 atomic16_read(Int128 *ptr)
 {
@@ -128,7 +152,8 @@ static inline void atomic16_set(Int128 *ptr, Int128 val)
 }
 
 # define HAVE_ATOMIC128 1
-#elif !defined(CONFIG_USER_ONLY) && HAVE_CMPXCHG128
+# define HAVE_ATOMIC128_RO 0
+#elif HAVE_CMPXCHG128
 static inline Int128 atomic16_read(Int128 *ptr)
 {
     /* Maybe replace 0 with 0, returning the old value.  */
@@ -145,11 +170,13 @@ static inline void atomic16_set(Int128 *ptr, Int128 val)
 }
 
 # define HAVE_ATOMIC128 1
+# define HAVE_ATOMIC128_RO 0
 #else
 /* Fallback definitions that must be optimized away, or error.  */
 Int128 QEMU_ERROR("unsupported atomic") atomic16_read(Int128 *ptr);
 void QEMU_ERROR("unsupported atomic") atomic16_set(Int128 *ptr, Int128 val);
 # define HAVE_ATOMIC128 0
+# define HAVE_ATOMIC128_RO 0
 #endif /* Some definition for HAVE_ATOMIC128 */
 
 #endif /* QEMU_ATOMIC128_H */
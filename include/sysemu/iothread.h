@@ -37,6 +37,8 @@ typedef struct {
     int64_t poll_max_ns;
     int64_t poll_grow;
     int64_t poll_shrink;
+    int64_t poll_latency_ns;
+    int64_t poll_cpu_budget;
 } IOThread;
 
 #define IOTHREAD(obj) \
@@ -17,6 +17,7 @@
 #include "qemu/queue.h"
 #include "hw/core/cpu.h"
 #include "exec/memattrs.h"
+#include "qapi/qapi-types-misc.h"
 
 #ifdef NEED_CPU_H
 # ifdef CONFIG_KVM
@@ -205,6 +206,7 @@ extern KVMState *kvm_state;
 /* external API */
 
 bool kvm_has_free_slot(MachineState *ms);
+KvmMemslotStats *kvm_memslot_stats(void);
 bool kvm_has_sync_mmu(void);
 int kvm_has_vcpu_events(void);
 int kvm_has_robust_singlestep(void);
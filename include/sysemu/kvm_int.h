@@ -23,6 +23,12 @@ typedef struct KVMSlot
     int old_flags;
     /* Dirty bitmap cache for the slot */
     unsigned long *dirty_bmap;
+    /*
+     * Deletion deferred to the end of the memory transaction, and the
+     * region that keeps the slot's memory alive until then.
+     */
+    bool del_pending;
+    MemoryRegion *del_mr;
 } KVMSlot;
 
 typedef struct KVMMemoryListener {
@@ -31,6 +37,10 @@ typedef struct KVMMemoryListener {
     QemuMutex slots_lock;
     KVMSlot *slots;
     int as_id;
+    /* Statistics at the start of the current memory transaction */
+    uint64_t txn_updates;
+    uint64_t txn_elided;
+    uint64_t txn_time_ns;
 } KVMMemoryListener;
 
 #define TYPE_KVM_ACCEL ACCEL_CLASS_NAME("kvm")
@@ -76,11 +76,32 @@ void replay_add_blocker(Error *reason);
 
 /*! Returns number of executed instructions. */
 uint64_t replay_get_current_icount(void);
-/*! Returns number of instructions to execute in replay mode. */
+/*! Returns number of instructions to execute in replay mode.
+    Called with the replay mutex held. */
 int replay_get_instructions(void);
 /*! Updates instructions counter in replay mode. */
 void replay_account_executed_instructions(void);
 
+/* vCPU turns for multi-threaded TCG
+ *
+ * With one thread per vCPU, only one vCPU executes guest code at a time,
+ * during a turn that is entered with the replay mutex held.  The order
+ * of the turns is written to the log when recording and enforced when
+ * replaying.
+ */
+
+/*! Waits until @cpu may execute guest code and takes the replay mutex.
+    Returns false, without the mutex, if the vCPU thread has to process
+    a stop request, queued work or an exit request first. */
+bool replay_vcpu_turn_begin(CPUState *cpu);
+/*! Records that @cpu executes guest code in the current turn. */
+void replay_vcpu_turn_claim(CPUState *cpu);
+/*! Ends the current turn and releases the replay mutex. */
+void replay_vcpu_turn_end(void);
+/*! Wakes up the vCPU threads that wait for their turn, so that they
+    can notice stop requests.  Called with the replay mutex held. */
+void replay_vcpu_kick(void);
+
 /* Interrupts and exceptions */
 
 /*! Called by exception handler to write or read
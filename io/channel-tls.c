@@ -22,6 +22,7 @@
 #include "qapi/error.h"
 #include "qemu/module.h"
 #include "io/channel-tls.h"
+#include "io/channel-socket.h"
 #include "trace.h"
 
 
@@ -151,6 +152,34 @@ static gboolean qio_channel_tls_handshake_io(QIOChannel *ioc,
                                              GIOCondition condition,
                                              gpointer user_data);
 
+/*
+ * Let the kernel handle the record layer when the master is a socket,
+ * so that payload data no longer goes through GnuTLS. This is purely
+ * an optimization, the session keeps working in user space if the
+ * kernel cannot take it over.
+ */
+static void qio_channel_tls_enable_ktls(QIOChannelTLS *ioc)
+{
+    Error *err = NULL;
+    int ret;
+
+    if (!object_dynamic_cast(OBJECT(ioc->master), TYPE_QIO_CHANNEL_SOCKET)) {
+        return;
+    }
+
+    ret = qcrypto_tls_session_enable_ktls(ioc->session,
+                                          QIO_CHANNEL_SOCKET(ioc->master)->fd,
+                                          &err);
+    if (ret < 0) {
+        trace_qio_channel_tls_ktls_unavailable(ioc, error_get_pretty(err));
+        error_free(err);
+        return;
+    }
+
+    trace_qio_channel_tls_ktls_enabled(ioc, ret);
+    ioc->ktls = ret;
+}
+
 static void qio_channel_tls_handshake_task(QIOChannelTLS *ioc,
                                            QIOTask *task,
                                            GMainContext *context)
@@ -174,6 +203,7 @@ static void qio_channel_tls_handshake_task(QIOChannelTLS *ioc,
             qio_task_set_error(task, err);
         } else {
             trace_qio_channel_tls_credentials_allow(ioc);
+            qio_channel_tls_enable_ktls(ioc);
         }
         qio_task_complete(task);
     } else {
@@ -265,6 +295,11 @@ static ssize_t qio_channel_tls_readv(QIOChannel *ioc,
     size_t i;
     ssize_t got = 0;
 
+    if (tioc->ktls & QCRYPTO_TLS_KTLS_RX) {
+        return qio_channel_readv_full(tioc->master, iov, niov,
+                                      fds, nfds, errp);
+    }
+
     for (i = 0 ; i < niov ; i++) {
         ssize_t ret = qcrypto_tls_session_read(tioc->session,
                                                iov[i].iov_base,
@@ -305,6 +340,11 @@ static ssize_t qio_channel_tls_writev(QIOChannel *ioc,
     size_t i;
     ssize_t done = 0;
 
+    if (tioc->ktls & QCRYPTO_TLS_KTLS_TX) {
+        return qio_channel_writev_full(tioc->master, iov, niov,
+                                       fds, nfds, errp);
+    }
+
     for (i = 0 ; i < niov ; i++) {
         ssize_t ret = qcrypto_tls_session_write(tioc->session,
                                                 iov[i].iov_base,
@@ -401,6 +401,91 @@ off_t qio_channel_io_seek(QIOChannel *ioc,
 }
 
 
+ssize_t qio_channel_pwritev(QIOChannel *ioc,
+                            const struct iovec *iov,
+                            size_t niov,
+                            off_t offset,
+                            Error **errp)
+{
+    QIOChannelClass *klass = QIO_CHANNEL_GET_CLASS(ioc);
+
+    if (!klass->io_pwritev ||
+        !qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        error_setg(errp, "Channel does not support positioned writes");
+        return -1;
+    }
+
+    return klass->io_pwritev(ioc, iov, niov, offset, errp);
+}
+
+
+int qio_channel_pwrite_all(QIOChannel *ioc,
+                           const char *buf,
+                           size_t buflen,
+                           off_t offset,
+                           Error **errp)
+{
+    while (buflen > 0) {
+        struct iovec iov = { .iov_base = (char *)buf, .iov_len = buflen };
+        ssize_t len = qio_channel_pwritev(ioc, &iov, 1, offset, errp);
+
+        if (len < 0) {
+            return -1;
+        }
+        buf += len;
+        buflen -= len;
+        offset += len;
+    }
+
+    return 0;
+}
+
+
+ssize_t qio_channel_preadv(QIOChannel *ioc,
+                           const struct iovec *iov,
+                           size_t niov,
+                           off_t offset,
+                           Error **errp)
+{
+    QIOChannelClass *klass = QIO_CHANNEL_GET_CLASS(ioc);
+
+    if (!klass->io_preadv ||
+        !qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        error_setg(errp, "Channel does not support positioned reads");
+        return -1;
+    }
+
+    return klass->io_preadv(ioc, iov, niov, offset, errp);
+}
+
+
+int qio_channel_pread_all(QIOChannel *ioc,
+                          char *buf,
+                          size_t buflen,
+                          off_t offset,
+                          Error **errp)
+{
+    while (buflen > 0) {
+        struct iovec iov = { .iov_base = buf, .iov_len = buflen };
+        ssize_t len = qio_channel_preadv(ioc, &iov, 1, offset, errp);
+
+        if (len < 0) {
+            return -1;
+        }
+        if (len == 0) {
+            error_setg(errp,
+                       "Unexpected end-of-file before all bytes were read");
+            return -1;
+        }
+        buf += len;
+        buflen -= len;
+        offset += len;
+    }
+
+    return 0;
+}
+
+
 static void qio_channel_restart_read(void *opaque)
 {
     QIOChannel *ioc = opaque;
@@ -186,6 +186,12 @@ static void iothread_complete(UserCreatable *obj, Error **errp)
                                 iothread->poll_grow,
                                 iothread->poll_shrink,
                                 &local_error);
+    if (!local_error) {
+        aio_context_set_poll_target(iothread->ctx,
+                                    iothread->poll_latency_ns,
+                                    iothread->poll_cpu_budget,
+                                    &local_error);
+    }
     if (local_error) {
         error_propagate(errp, local_error);
         aio_context_unref(iothread->ctx);
@@ -223,6 +229,12 @@ static PollParamInfo poll_grow_info = {
 static PollParamInfo poll_shrink_info = {
     "poll-shrink", offsetof(IOThread, poll_shrink),
 };
+static PollParamInfo poll_latency_ns_info = {
+    "poll-latency-ns", offsetof(IOThread, poll_latency_ns),
+};
+static PollParamInfo poll_cpu_budget_info = {
+    "poll-cpu-budget", offsetof(IOThread, poll_cpu_budget),
+};
 
 static void iothread_get_poll_param(Object *obj, Visitor *v,
         const char *name, void *opaque, Error **errp)
@@ -254,6 +266,12 @@ static void iothread_set_poll_param(Object *obj, Visitor *v,
         goto out;
     }
 
+    if (info == &poll_cpu_budget_info && value > 100) {
+        error_setg(&local_err, "%s value must be in range [0, 100]",
+                   info->name);
+        goto out;
+    }
+
     *field = value;
 
     if (iothread->ctx) {
@@ -262,6 +280,13 @@ static void iothread_set_poll_param(Object *obj, Visitor *v,
                                     iothread->poll_grow,
                                     iothread->poll_shrink,
                                     &local_err);
+        if (local_err) {
+            goto out;
+        }
+        aio_context_set_poll_target(iothread->ctx,
+                                    iothread->poll_latency_ns,
+                                    iothread->poll_cpu_budget,
+                                    &local_err);
     }
 
 out:
@@ -285,6 +310,14 @@ static void iothread_class_init(ObjectClass *klass, void *class_data)
                               iothread_get_poll_param,
                               iothread_set_poll_param,
                               NULL, &poll_shrink_info, &error_abort);
+    object_class_property_add(klass, "poll-latency-ns", "int",
+                              iothread_get_poll_param,
+                              iothread_set_poll_param,
+                              NULL, &poll_latency_ns_info, &error_abort);
+    object_class_property_add(klass, "poll-cpu-budget", "int",
+                              iothread_get_poll_param,
+                              iothread_set_poll_param,
+                              NULL, &poll_cpu_budget_info, &error_abort);
 }
 
 static const TypeInfo iothread_info = {
@@ -335,6 +368,13 @@ static int query_one_iothread(Object *object, void *opaque)
     info->poll_max_ns = iothread->poll_max_ns;
     info->poll_grow = iothread->poll_grow;
     info->poll_shrink = iothread->poll_shrink;
+    info->poll_latency_ns = iothread->poll_latency_ns;
+    info->poll_cpu_budget = iothread->poll_cpu_budget;
+    if (iothread->ctx) {
+        info->poll_hits = iothread->ctx->poll_stats.hits;
+        info->poll_misses = iothread->ctx->poll_stats.misses;
+        info->poll_time_ns = iothread->ctx->poll_stats.time_ns;
+    }
 
     elem = g_new0(IOThreadInfoList, 1);
     elem->value = info;
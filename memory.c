@@ -1240,6 +1240,7 @@ static void memory_region_initfn(Object *obj)
     mr->enabled = true;
     mr->romd_mode = true;
     mr->global_locking = true;
+    mr->global_locking_reads = true;
     mr->destructor = memory_region_destructor_none;
     QTAILQ_INIT(&mr->subregions);
     QTAILQ_INIT(&mr->coalesced);
@@ -1887,6 +1888,23 @@ uint64_t memory_region_iommu_get_min_page_size(IOMMUMemoryRegion *iommu_mr)
     return TARGET_PAGE_SIZE;
 }
 
+IOMMUTLBEntry memory_region_iommu_probe(IOMMUMemoryRegion *iommu_mr,
+                                        hwaddr addr, IOMMUAccessFlags flag,
+                                        int iommu_idx)
+{
+    IOMMUMemoryRegionClass *imrc = IOMMU_MEMORY_REGION_GET_CLASS(iommu_mr);
+    IOMMUTLBEntry iotlb = {
+        .target_as = &address_space_memory,
+        .iova = addr,
+        .perm = IOMMU_NONE,
+    };
+
+    if (imrc->translate_probe) {
+        iotlb = imrc->translate_probe(iommu_mr, addr, flag, iommu_idx);
+    }
+    return iotlb;
+}
+
 void memory_region_iommu_replay(IOMMUMemoryRegion *iommu_mr, IOMMUNotifier *n)
 {
     MemoryRegion *mr = MEMORY_REGION(iommu_mr);
@@ -2304,6 +2322,12 @@ void memory_region_clear_flush_coalesced(MemoryRegion *mr)
 void memory_region_clear_global_locking(MemoryRegion *mr)
 {
     mr->global_locking = false;
+    mr->global_locking_reads = false;
+}
+
+void memory_region_clear_global_locking_reads(MemoryRegion *mr)
+{
+    mr->global_locking_reads = false;
 }
 
 static bool userspace_eventfd_warning;
@@ -0,0 +1,241 @@
+/*
+ * Guest dirty page rate measurement
+ *
+ * calc-dirty-rate enables dirty logging for a few seconds, without
+ * migrating anything, and counts the guest pages that got dirtied in the
+ * meantime.  With TCG every write is also accounted to the vCPU that made
+ * it, which gives a per-vCPU dirty rate.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-migration.h"
+#include "qapi/qmp/qerror.h"
+#include "qemu/main-loop.h"
+#include "qemu/rcu.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "exec/memory.h"
+#include "exec/ram_addr.h"
+#include "exec/target_page.h"
+#include "hw/boards.h"
+#include "hw/core/cpu.h"
+#include "sysemu/tcg.h"
+#include "migration.h"
+#include "dirtyrate.h"
+#include "trace.h"
+
+/* Result of the last measurement, protected by the BQL */
+static struct {
+    DirtyRateStatus status;
+    int64_t start_time;
+    int64_t calc_time;
+    int64_t end_ms;
+    int64_t dirty_rate;
+    int nr_vcpus;
+    int64_t *vcpu_dirty_rate;
+} dirtyrate_stat;
+
+bool dirtyrate_measuring(void)
+{
+    return dirtyrate_stat.status == DIRTY_RATE_STATUS_MEASURING;
+}
+
+int vcpu_dirty_pages_nr(void)
+{
+    return current_machine->smp.max_cpus;
+}
+
+void vcpu_dirty_pages_snapshot(uint64_t *pages)
+{
+    int nr = vcpu_dirty_pages_nr();
+    CPUState *cpu;
+
+    rcu_read_lock();
+    CPU_FOREACH(cpu) {
+        if (cpu->cpu_index < nr) {
+            pages[cpu->cpu_index] = atomic_read__nocheck(&cpu->dirty_pages);
+        }
+    }
+    rcu_read_unlock();
+}
+
+int64_t dirtyrate_vcpu_last(int cpu_index, int64_t max_age_ms)
+{
+    if (dirtyrate_stat.status != DIRTY_RATE_STATUS_MEASURED ||
+        cpu_index >= dirtyrate_stat.nr_vcpus ||
+        qemu_clock_get_ms(QEMU_CLOCK_REALTIME) - dirtyrate_stat.end_ms >=
+        max_age_ms) {
+        return -1;
+    }
+    return dirtyrate_stat.vcpu_dirty_rate[cpu_index];
+}
+
+static int64_t dirtyrate_pages_to_mibps(uint64_t pages, int64_t msec)
+{
+    return (pages * TARGET_PAGE_SIZE * 1000 / MAX(msec, 1)) >> 20;
+}
+
+/*
+ * Sync the dirty log and count, then clear, the dirty guest pages.
+ * Called with the BQL held.
+ */
+static uint64_t dirtyrate_sync_and_count(void)
+{
+    DirtyBitmapSnapshot *snap;
+    RAMBlock *block;
+    uint64_t pages = 0;
+
+    memory_global_dirty_log_sync();
+
+    rcu_read_lock();
+    RAMBLOCK_FOREACH(block) {
+        if (!qemu_ram_is_migratable(block)) {
+            continue;
+        }
+        snap = cpu_physical_memory_snapshot_and_clear_dirty(block->mr, 0,
+                                                            block->used_length,
+                                                            DIRTY_MEMORY_MIGRATION);
+        pages += cpu_physical_memory_snapshot_count_dirty(snap, block->offset,
+                                                          block->used_length);
+        g_free(snap);
+    }
+    rcu_read_unlock();
+
+    memory_global_after_dirty_log_sync();
+
+    return pages;
+}
+
+static void *dirtyrate_thread(void *opaque)
+{
+    int nr_vcpus = vcpu_dirty_pages_nr();
+    uint64_t *vcpu_start = NULL, *vcpu_end = NULL;
+    int64_t *vcpu_rate = NULL;
+    int64_t start_ms, end_ms;
+    uint64_t pages;
+    int i;
+
+    rcu_register_thread();
+
+    qemu_mutex_lock_iothread();
+    memory_global_dirty_log_start();
+    qemu_mutex_unlock_iothread();
+
+    /* Forget whatever was marked dirty before the log was enabled */
+    qemu_mutex_lock_iothread();
+    dirtyrate_sync_and_count();
+    qemu_mutex_unlock_iothread();
+    if (tcg_enabled()) {
+        vcpu_start = g_new0(uint64_t, nr_vcpus);
+        vcpu_end = g_new0(uint64_t, nr_vcpus);
+        vcpu_dirty_pages_snapshot(vcpu_start);
+    }
+    start_ms = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+
+    g_usleep(dirtyrate_stat.calc_time * G_USEC_PER_SEC);
+
+    qemu_mutex_lock_iothread();
+    pages = dirtyrate_sync_and_count();
+    qemu_mutex_unlock_iothread();
+    end_ms = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+    if (tcg_enabled()) {
+        vcpu_dirty_pages_snapshot(vcpu_end);
+        vcpu_rate = g_new0(int64_t, nr_vcpus);
+        for (i = 0; i < nr_vcpus; i++) {
+            vcpu_rate[i] = dirtyrate_pages_to_mibps(vcpu_end[i] - vcpu_start[i],
+                                                   end_ms - start_ms);
+        }
+    }
+
+    qemu_mutex_lock_iothread();
+    memory_global_dirty_log_stop();
+    dirtyrate_stat.dirty_rate = dirtyrate_pages_to_mibps(pages,
+                                                        end_ms - start_ms);
+    dirtyrate_stat.nr_vcpus = vcpu_rate ? nr_vcpus : 0;
+    dirtyrate_stat.vcpu_dirty_rate = vcpu_rate;
+    dirtyrate_stat.end_ms = end_ms;
+    dirtyrate_stat.status = DIRTY_RATE_STATUS_MEASURED;
+    trace_dirtyrate_calc(end_ms - start_ms, pages, dirtyrate_stat.dirty_rate);
+    qemu_mutex_unlock_iothread();
+
+    g_free(vcpu_start);
+    g_free(vcpu_end);
+    rcu_unregister_thread();
+    return NULL;
+}
+
+void qmp_calc_dirty_rate(int64_t calc_time, Error **errp)
+{
+    static QemuThread thread;
+
+    if (calc_time < 1 || calc_time > DIRTYRATE_MAX_CALC_TIME) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE, "calc-time",
+                   "a value between 1 and 60");
+        return;
+    }
+    if (dirtyrate_measuring()) {
+        error_setg(errp, "A dirty rate measurement is already in progress");
+        return;
+    }
+    if (migration_is_setup_or_active(migrate_get_current()->state) ||
+        global_dirty_log) {
+        error_setg(errp, "Dirty logging is in use, cannot measure the "
+                   "dirty rate during migration");
+        return;
+    }
+
+    g_free(dirtyrate_stat.vcpu_dirty_rate);
+    dirtyrate_stat.vcpu_dirty_rate = NULL;
+    dirtyrate_stat.nr_vcpus = 0;
+    dirtyrate_stat.dirty_rate = 0;
+    dirtyrate_stat.start_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME) / 1000;
+    dirtyrate_stat.calc_time = calc_time;
+    dirtyrate_stat.status = DIRTY_RATE_STATUS_MEASURING;
+
+    qemu_thread_create(&thread, "dirtyrate", dirtyrate_thread, NULL,
+                       QEMU_THREAD_DETACHED);
+}
+
+DirtyRateInfo *qmp_query_dirty_rate(Error **errp)
+{
+    DirtyRateInfo *info = g_new0(DirtyRateInfo, 1);
+    DirtyRateVcpuList **tail = &info->vcpu_dirty_rate;
+    CPUState *cpu;
+
+    info->status = dirtyrate_stat.status;
+    info->start_time = dirtyrate_stat.start_time;
+    info->calc_time = dirtyrate_stat.calc_time;
+
+    if (dirtyrate_stat.status != DIRTY_RATE_STATUS_MEASURED) {
+        return info;
+    }
+
+    info->has_dirty_rate = true;
+    info->dirty_rate = dirtyrate_stat.dirty_rate;
+
+    if (!dirtyrate_stat.vcpu_dirty_rate) {
+        return info;
+    }
+
+    info->has_vcpu_dirty_rate = true;
+    CPU_FOREACH(cpu) {
+        DirtyRateVcpuList *entry;
+
+        if (cpu->cpu_index >= dirtyrate_stat.nr_vcpus) {
+            continue;
+        }
+        entry = g_new0(DirtyRateVcpuList, 1);
+        entry->value = g_new0(DirtyRateVcpu, 1);
+        entry->value->id = cpu->cpu_index;
+        entry->value->dirty_rate =
+            dirtyrate_stat.vcpu_dirty_rate[cpu->cpu_index];
+        *tail = entry;
+        tail = &entry->next;
+    }
+
+    return info;
+}
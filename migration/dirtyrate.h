@@ -0,0 +1,33 @@
+/*
+ * Guest dirty page rate measurement
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_MIGRATION_DIRTYRATE_H
+#define QEMU_MIGRATION_DIRTYRATE_H
+
+/* Longest measurement accepted by calc-dirty-rate, in seconds */
+#define DIRTYRATE_MAX_CALC_TIME 60
+
+bool dirtyrate_measuring(void);
+
+/*
+ * Per-vCPU dirty page counters are only maintained by TCG.  Arrays of them
+ * are indexed by cpu_index and hold vcpu_dirty_pages_nr() entries.
+ */
+int vcpu_dirty_pages_nr(void);
+void vcpu_dirty_pages_snapshot(uint64_t *pages);
+
+/* How recent a measurement must be to seed the dirty-limit throttle */
+#define DIRTY_LIMIT_SEED_MAX_AGE_MS (60 * 1000)
+
+/*
+ * Dirty rate of vCPU @cpu_index, in MiB/s, from the last calc-dirty-rate
+ * if it finished less than @max_age_ms ago and measured that vCPU, or -1.
+ * Called with the BQL held.
+ */
+int64_t dirtyrate_vcpu_last(int cpu_index, int64_t max_age_ms);
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * QEMU live migration to and from a plain file
+ *
+ * The main migration stream is written to (or read from) the file
+ * sequentially like with the fd: and exec: transports.  In addition,
+ * when the fixed-ram capability is enabled, guest RAM is placed at
+ * fixed offsets in the same file using positioned I/O; the helper
+ * threads doing that I/O get their own channels on the file through
+ * file_open_aux_channel(), so they can use O_DIRECT independently of
+ * the buffered main stream.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "channel.h"
+#include "file.h"
+#include "migration.h"
+#include "io/channel-file.h"
+#include "trace.h"
+
+static char *outgoing_filename;
+static char *incoming_filename;
+
+void file_start_outgoing_migration(MigrationState *s, const char *filename,
+                                   Error **errp)
+{
+    QIOChannelFile *fioc;
+
+    trace_migration_file_outgoing(filename);
+    fioc = qio_channel_file_new_path(filename, O_CREAT | O_WRONLY | O_TRUNC,
+                                     0600, errp);
+    if (!fioc) {
+        return;
+    }
+
+    g_free(outgoing_filename);
+    outgoing_filename = g_strdup(filename);
+
+    qio_channel_set_name(QIO_CHANNEL(fioc), "migration-file-outgoing");
+    migration_channel_connect(s, QIO_CHANNEL(fioc), NULL, NULL);
+    object_unref(OBJECT(fioc));
+}
+
+static gboolean file_accept_incoming_migration(QIOChannel *ioc,
+                                               GIOCondition condition,
+                                               gpointer opaque)
+{
+    migration_channel_process_incoming(ioc);
+    object_unref(OBJECT(ioc));
+    return G_SOURCE_REMOVE;
+}
+
+void file_start_incoming_migration(const char *filename, Error **errp)
+{
+    QIOChannelFile *fioc;
+
+    trace_migration_file_incoming(filename);
+    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+    if (!fioc) {
+        return;
+    }
+
+    g_free(incoming_filename);
+    incoming_filename = g_strdup(filename);
+
+    qio_channel_set_name(QIO_CHANNEL(fioc), "migration-file-incoming");
+    qio_channel_add_watch_full(QIO_CHANNEL(fioc), G_IO_IN,
+                               file_accept_incoming_migration,
+                               NULL, NULL,
+                               g_main_context_get_thread_default());
+}
+
+void file_cleanup_outgoing_migration(void)
+{
+    g_free(outgoing_filename);
+    outgoing_filename = NULL;
+}
+
+void file_cleanup_incoming_migration(void)
+{
+    g_free(incoming_filename);
+    incoming_filename = NULL;
+}
+
+/**
+ * file_open_aux_channel: open another channel on the migration file
+ *
+ * Returns a new seekable channel on the file of the current file:
+ * migration, or NULL if there is none.  @errp is only set when the
+ * file could not be opened.
+ *
+ * @outgoing: whether this is for the source or the destination side
+ * @direct_io: open the file with O_DIRECT, bypassing the page cache.
+ *             All I/O on the returned channel must then be aligned
+ *             to the logical block size of the underlying storage.
+ * @errp: pointer to a NULL-initialized error object
+ */
+QIOChannel *file_open_aux_channel(bool outgoing, bool direct_io,
+                                  Error **errp)
+{
+    const char *filename = outgoing ? outgoing_filename : incoming_filename;
+    int flags = outgoing ? O_WRONLY : O_RDONLY;
+    QIOChannelFile *fioc;
+
+    if (!filename) {
+        return NULL;
+    }
+
+    if (direct_io) {
+#ifdef O_DIRECT
+        flags |= O_DIRECT;
+#else
+        error_setg(errp, "O_DIRECT is not supported on this host");
+        return NULL;
+#endif
+    }
+
+    fioc = qio_channel_file_new_path(filename, flags, 0, errp);
+    if (!fioc) {
+        return NULL;
+    }
+    trace_migration_file_aux_channel(filename, outgoing, direct_io);
+
+    qio_channel_set_name(QIO_CHANNEL(fioc), outgoing ?
+                         "migration-file-aux-outgoing" :
+                         "migration-file-aux-incoming");
+    return QIO_CHANNEL(fioc);
+}
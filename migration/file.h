@@ -0,0 +1,23 @@
+/*
+ * QEMU live migration to and from a plain file
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_MIGRATION_FILE_H
+#define QEMU_MIGRATION_FILE_H
+
+#include "io/channel.h"
+
+void file_start_incoming_migration(const char *filename, Error **errp);
+
+void file_start_outgoing_migration(MigrationState *s, const char *filename,
+                                   Error **errp);
+
+void file_cleanup_incoming_migration(void);
+void file_cleanup_outgoing_migration(void);
+
+QIOChannel *file_open_aux_channel(bool outgoing, bool direct_io,
+                                  Error **errp);
+#endif
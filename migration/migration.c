@@ -20,9 +20,12 @@
 #include "migration/blocker.h"
 #include "exec.h"
 #include "fd.h"
+#include "file.h"
+#include "dirtyrate.h"
 #include "socket.h"
 #include "sysemu/runstate.h"
 #include "sysemu/sysemu.h"
+#include "sysemu/tcg.h"
 #include "rdma.h"
 #include "ram.h"
 #include "migration/global_state.h"
@@ -49,6 +52,7 @@
 #include "io/channel-buffer.h"
 #include "migration/colo.h"
 #include "hw/boards.h"
+#include "hw/core/cpu.h"
 #include "hw/qdev-properties.h"
 #include "monitor/monitor.h"
 #include "net/announce.h"
@@ -86,6 +90,11 @@
 /* The delay time (in ms) between two COLO checkpoints */
 #define DEFAULT_MIGRATE_X_CHECKPOINT_DELAY (200 * 100)
 #define DEFAULT_MIGRATE_MULTIFD_CHANNELS 2
+#define DEFAULT_MIGRATE_FIXED_RAM_THREADS 4
+
+/* Per-vCPU dirty page rate target for dirty-limit, in MiB/s */
+#define DEFAULT_MIGRATE_VCPU_DIRTY_LIMIT 1
+#define DEFAULT_MIGRATE_DEVICE_STATE_THREADS 4
 
 /* Background transfer rate for postcopy, 0 means unlimited, note
  * that page requests can still exceed this limit.
@@ -218,6 +227,7 @@ void migration_incoming_state_destroy(void)
     }
 
     qemu_event_reset(&mis->main_thread_load_event);
+    file_cleanup_incoming_migration();
 
     if (mis->socket_address_list) {
         qapi_free_SocketAddressList(mis->socket_address_list);
@@ -368,6 +378,8 @@ void qemu_start_incoming_migration(const char *uri, Error **errp)
         unix_start_incoming_migration(p, errp);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_incoming_migration(p, errp);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_incoming_migration(p, errp);
     } else {
         error_setg(errp, "unknown migration protocol: %s", uri);
     }
@@ -787,6 +799,14 @@ MigrationParameters *qmp_query_migrate_parameters(Error **errp)
     params->announce_rounds = s->parameters.announce_rounds;
     params->has_announce_step = true;
     params->announce_step = s->parameters.announce_step;
+    params->has_fixed_ram_threads = true;
+    params->fixed_ram_threads = s->parameters.fixed_ram_threads;
+    params->has_direct_io = true;
+    params->direct_io = s->parameters.direct_io;
+    params->has_vcpu_dirty_limit = true;
+    params->vcpu_dirty_limit = s->parameters.vcpu_dirty_limit;
+    params->has_device_state_threads = true;
+    params->device_state_threads = s->parameters.device_state_threads;
 
     return params;
 }
@@ -891,6 +911,19 @@ static void populate_ram_info(MigrationInfo *info, MigrationState *s)
     if (cpu_throttle_active()) {
         info->has_cpu_throttle_percentage = true;
         info->cpu_throttle_percentage = cpu_throttle_get_percentage();
+    } else if (migrate_dirty_limit()) {
+        CPUState *cpu;
+        int pct = 0;
+
+        rcu_read_lock();
+        CPU_FOREACH(cpu) {
+            pct = MAX(pct, cpu_throttle_get_vcpu_percentage(cpu));
+        }
+        rcu_read_unlock();
+        if (pct) {
+            info->has_cpu_throttle_percentage = true;
+            info->cpu_throttle_percentage = pct;
+        }
     }
 
     if (s->state != MIGRATION_STATUS_COMPLETED) {
@@ -1030,6 +1063,34 @@ static bool migrate_caps_check(bool *cap_list,
         }
     }
 
+    if (cap_list[MIGRATION_CAPABILITY_FIXED_RAM]) {
+        if (cap_list[MIGRATION_CAPABILITY_XBZRLE] ||
+            cap_list[MIGRATION_CAPABILITY_COMPRESS] ||
+            cap_list[MIGRATION_CAPABILITY_POSTCOPY_RAM] ||
+            cap_list[MIGRATION_CAPABILITY_MULTIFD] ||
+            cap_list[MIGRATION_CAPABILITY_RELEASE_RAM]) {
+            error_setg(errp, "Fixed-ram is not compatible with xbzrle, "
+                       "compress, postcopy-ram, multifd or release-ram");
+            return false;
+        }
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_DIRTY_LIMIT] &&
+        cap_list[MIGRATION_CAPABILITY_AUTO_CONVERGE]) {
+        /* Both would fight over the throttle of every vCPU */
+        error_setg(errp, "Dirty-limit is not compatible with auto-converge");
+        return false;
+    }
+
+    if (cap_list[MIGRATION_CAPABILITY_DIRTY_LIMIT] && !tcg_enabled()) {
+        /*
+         * Other accelerators only have a guest-wide dirty log, which
+         * cannot tell which vCPU to throttle
+         */
+        error_setg(errp, "Dirty-limit requires the TCG accelerator");
+        return false;
+    }
+
     return true;
 }
 
@@ -1214,6 +1275,28 @@ static bool migrate_params_check(MigrationParameters *params, Error **errp)
                    "is invalid, it must be in the range of 1 to 10000 ms");
        return false;
     }
+
+    if (params->has_fixed_ram_threads && (params->fixed_ram_threads < 1)) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE,
+                   "fixed_ram_threads",
+                   "is invalid, it should be in the range of 1 to 255");
+        return false;
+    }
+
+    if (params->has_vcpu_dirty_limit && (params->vcpu_dirty_limit < 1)) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE,
+                   "vcpu_dirty_limit",
+                   "is invalid, it must be at least 1 MB/s");
+        return false;
+    }
+
+    if (params->has_device_state_threads &&
+        (params->device_state_threads < 1)) {
+        error_setg(errp, QERR_INVALID_PARAMETER_VALUE,
+                   "device_state_threads",
+                   "is invalid, it should be in the range of 1 to 255");
+        return false;
+    }
     return true;
 }
 
@@ -1297,6 +1380,18 @@ static void migrate_params_test_apply(MigrateSetParameters *params,
     if (params->has_announce_step) {
         dest->announce_step = params->announce_step;
     }
+    if (params->has_fixed_ram_threads) {
+        dest->fixed_ram_threads = params->fixed_ram_threads;
+    }
+    if (params->has_direct_io) {
+        dest->direct_io = params->direct_io;
+    }
+    if (params->has_vcpu_dirty_limit) {
+        dest->vcpu_dirty_limit = params->vcpu_dirty_limit;
+    }
+    if (params->has_device_state_threads) {
+        dest->device_state_threads = params->device_state_threads;
+    }
 }
 
 static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
@@ -1398,6 +1493,18 @@ static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
     if (params->has_announce_step) {
         s->parameters.announce_step = params->announce_step;
     }
+    if (params->has_fixed_ram_threads) {
+        s->parameters.fixed_ram_threads = params->fixed_ram_threads;
+    }
+    if (params->has_direct_io) {
+        s->parameters.direct_io = params->direct_io;
+    }
+    if (params->has_vcpu_dirty_limit) {
+        s->parameters.vcpu_dirty_limit = params->vcpu_dirty_limit;
+    }
+    if (params->has_device_state_threads) {
+        s->parameters.device_state_threads = params->device_state_threads;
+    }
 }
 
 void qmp_migrate_set_parameters(MigrateSetParameters *params, Error **errp)
@@ -1522,6 +1629,7 @@ static void migrate_fd_cleanup(MigrationState *s)
         qemu_mutex_lock_iothread();
 
         multifd_save_cleanup();
+        file_cleanup_outgoing_migration();
         qemu_mutex_lock(&s->qemu_file_lock);
         tmp = s->to_dst_file;
         s->to_dst_file = NULL;
@@ -1896,6 +2004,12 @@ static bool migrate_prepare(MigrationState *s, bool blk, bool blk_inc,
         return false;
     }
 
+    if (dirtyrate_measuring()) {
+        error_setg(errp, "Cannot migrate while the dirty rate is being "
+                   "measured");
+        return false;
+    }
+
     if (blk || blk_inc) {
         if (migrate_use_block() || migrate_use_block_incremental()) {
             error_setg(errp, "Command options are incompatible with "
@@ -1950,6 +2064,8 @@ void qmp_migrate(const char *uri, bool has_blk, bool blk,
         unix_start_outgoing_migration(s, p, &local_err);
     } else if (strstart(uri, "fd:", &p)) {
         fd_start_outgoing_migration(s, p, &local_err);
+    } else if (strstart(uri, "file:", &p)) {
+        file_start_outgoing_migration(s, p, &local_err);
     } else {
         error_setg(errp, QERR_INVALID_PARAMETER_VALUE, "uri",
                    "a valid migration protocol");
@@ -2158,6 +2274,69 @@ bool migrate_use_multifd(void)
     return s->enabled_capabilities[MIGRATION_CAPABILITY_MULTIFD];
 }
 
+bool migrate_use_fixed_ram(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_FIXED_RAM];
+}
+
+int migrate_fixed_ram_threads(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.fixed_ram_threads;
+}
+
+bool migrate_direct_io(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.direct_io;
+}
+
+bool migrate_dirty_limit(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_DIRTY_LIMIT];
+}
+
+uint64_t migrate_vcpu_dirty_limit(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.vcpu_dirty_limit;
+}
+
+bool migrate_parallel_device_state(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->enabled_capabilities[MIGRATION_CAPABILITY_PARALLEL_DEVICE_STATE];
+}
+
+int migrate_device_state_threads(void)
+{
+    MigrationState *s;
+
+    s = migrate_get_current();
+
+    return s->parameters.device_state_threads;
+}
+
 bool migrate_pause_before_switchover(void)
 {
     MigrationState *s;
@@ -3456,6 +3635,17 @@ static Property migration_properties[] = {
     DEFINE_PROP_SIZE("announce-step", MigrationState,
                       parameters.announce_step,
                       DEFAULT_MIGRATE_ANNOUNCE_STEP),
+    DEFINE_PROP_UINT8("fixed-ram-threads", MigrationState,
+                      parameters.fixed_ram_threads,
+                      DEFAULT_MIGRATE_FIXED_RAM_THREADS),
+    DEFINE_PROP_BOOL("direct-io", MigrationState,
+                      parameters.direct_io, false),
+    DEFINE_PROP_UINT64("vcpu-dirty-limit", MigrationState,
+                      parameters.vcpu_dirty_limit,
+                      DEFAULT_MIGRATE_VCPU_DIRTY_LIMIT),
+    DEFINE_PROP_UINT8("device-state-threads", MigrationState,
+                      parameters.device_state_threads,
+                      DEFAULT_MIGRATE_DEVICE_STATE_THREADS),
 
     /* Migration capabilities */
     DEFINE_PROP_MIG_CAP("x-xbzrle", MIGRATION_CAPABILITY_XBZRLE),
@@ -3470,6 +3660,10 @@ static Property migration_properties[] = {
     DEFINE_PROP_MIG_CAP("x-block", MIGRATION_CAPABILITY_BLOCK),
     DEFINE_PROP_MIG_CAP("x-return-path", MIGRATION_CAPABILITY_RETURN_PATH),
     DEFINE_PROP_MIG_CAP("x-multifd", MIGRATION_CAPABILITY_MULTIFD),
+    DEFINE_PROP_MIG_CAP("x-fixed-ram", MIGRATION_CAPABILITY_FIXED_RAM),
+    DEFINE_PROP_MIG_CAP("x-dirty-limit", MIGRATION_CAPABILITY_DIRTY_LIMIT),
+    DEFINE_PROP_MIG_CAP("x-parallel-device-state",
+                        MIGRATION_CAPABILITY_PARALLEL_DEVICE_STATE),
 
     DEFINE_PROP_END_OF_LIST(),
 };
@@ -3531,6 +3725,10 @@ static void migration_instance_init(Object *obj)
     params->has_announce_max = true;
     params->has_announce_rounds = true;
     params->has_announce_step = true;
+    params->has_fixed_ram_threads = true;
+    params->has_direct_io = true;
+    params->has_vcpu_dirty_limit = true;
+    params->has_device_state_threads = true;
 
     qemu_sem_init(&ms->postcopy_pause_sem, 0);
     qemu_sem_init(&ms->postcopy_pause_rp_sem, 0);
@@ -295,6 +295,13 @@ bool migrate_auto_converge(void);
 bool migrate_use_multifd(void);
 bool migrate_pause_before_switchover(void);
 int migrate_multifd_channels(void);
+bool migrate_use_fixed_ram(void);
+int migrate_fixed_ram_threads(void);
+bool migrate_direct_io(void);
+bool migrate_dirty_limit(void);
+uint64_t migrate_vcpu_dirty_limit(void);
+bool migrate_parallel_device_state(void);
+int migrate_device_state_threads(void);
 
 int migrate_use_xbzrle(void);
 int64_t migrate_xbzrle_cache_size(void);
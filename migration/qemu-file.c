@@ -830,3 +830,75 @@ void qemu_file_set_blocking(QEMUFile *f, bool block)
         f->ops->set_blocking(f->opaque, block, NULL);
     }
 }
+
+/*
+ * Return the QIOChannel backing the QEMUFile, or NULL if the QEMUFile
+ * is not built on top of one.
+ */
+QIOChannel *qemu_file_get_ioc(QEMUFile *f)
+{
+    if (!f->ops->get_ioc) {
+        return NULL;
+    }
+    return f->ops->get_ioc(f->opaque);
+}
+
+/*
+ * Return the offset in the underlying seekable channel that the next
+ * byte will be written to or read from, accounting for anything still
+ * buffered in the QEMUFile.  Returns -1 if the channel is not seekable.
+ *
+ * Note: unlike qemu_ftell() this is the real channel position and not
+ *       the number of bytes transferred so far.
+ */
+off_t qemu_file_get_offset(QEMUFile *f)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    off_t ret;
+
+    if (!ioc || !qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        return -1;
+    }
+
+    qemu_fflush(f);
+    ret = qio_channel_io_seek(ioc, 0, SEEK_CUR, NULL);
+    if (ret < 0) {
+        return -1;
+    }
+    if (!qemu_file_is_writable(f)) {
+        ret -= f->buf_size - f->buf_index;
+    }
+    return ret;
+}
+
+/*
+ * Move the underlying seekable channel to @offset.  Pending writes are
+ * flushed first and any read-ahead data is discarded, so the next
+ * qemu_put_*() / qemu_get_*() call operates at @offset.
+ *
+ * Returns 0 on success, or a negative errno value, which is also
+ * latched as the QEMUFile error.
+ */
+int qemu_file_set_offset(QEMUFile *f, off_t offset)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    Error *local_err = NULL;
+
+    if (!ioc || !qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        qemu_file_set_error(f, -EINVAL);
+        return -EINVAL;
+    }
+
+    if (qemu_file_is_writable(f)) {
+        qemu_fflush(f);
+    } else {
+        f->buf_index = 0;
+        f->buf_size = 0;
+    }
+
+    if (qio_channel_io_seek(ioc, offset, SEEK_SET, &local_err) < 0) {
+        qemu_file_set_error_obj(f, -EIO, local_err);
+        return -EIO;
+    }
+    return 0;
+}
@@ -102,6 +102,30 @@ QJSON *qjson_new(void)
     return json;
 }
 
+/*
+ * A fragment holds a sequence of elements, without the enclosing braces,
+ * that is built separately and spliced into another QJSON later on.
+ */
+QJSON *qjson_new_fragment(void)
+{
+    QJSON *json = g_new0(QJSON, 1);
+
+    json->str = qstring_new();
+    json->omit_comma = true;
+    return json;
+}
+
+void json_append_fragment(QJSON *json, QJSON *fragment)
+{
+    const char *str = qstring_get_str(fragment->str);
+
+    if (!*str) {
+        return;
+    }
+    json_emit_element(json, NULL);
+    qstring_append(json->str, str);
+}
+
 void qjson_finish(QJSON *json)
 {
     json_end_object(json);
@@ -22,6 +22,8 @@ void json_start_array(QJSON *json, const char *name);
 void json_end_object(QJSON *json);
 void json_start_object(QJSON *json, const char *name);
 const char *qjson_get_str(QJSON *json);
+QJSON *qjson_new_fragment(void);
+void json_append_fragment(QJSON *json, QJSON *fragment);
 void qjson_finish(QJSON *json);
 
 #endif /* QEMU_QJSON_H */
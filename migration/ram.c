@@ -38,6 +38,8 @@
 #include "ram.h"
 #include "migration.h"
 #include "socket.h"
+#include "file.h"
+#include "dirtyrate.h"
 #include "migration/register.h"
 #include "migration/misc.h"
 #include "qemu-file.h"
@@ -320,6 +322,8 @@ struct RAMState {
     bool fpo_enabled;
     /* How many times we have dirty too many pages */
     int dirty_rate_high_cnt;
+    /* CPUState::dirty_pages of each vCPU at the last bitmap sync */
+    uint64_t *vcpu_dirty_pages_prev;
     /* these variables are used for bitmap sync */
     /* last time we did a full bitmap_sync */
     int64_t time_last_bitmap_sync;
@@ -1511,6 +1515,576 @@ bool multifd_recv_new_channel(QIOChannel *ioc, Error **errp)
            migrate_multifd_channels();
 }
 
+/* Fixed-ram: every RAM page has a fixed offset in a seekable stream */
+
+#define FIXED_RAM_HDR_VERSION 1
+/* version, page size, bitmap offset and pages offset */
+#define FIXED_RAM_HDR_SIZE (4 + 8 + 8 + 8)
+/* The pages of each RAMBlock start at a multiple of this in the stream */
+#define FIXED_RAM_FILE_OFFSET_ALIGNMENT 0x100000
+/* Maximum number of contiguous pages handed to an I/O thread at once */
+#define FIXED_RAM_MAX_BATCH_PAGES 256
+
+typedef struct {
+    bool done;
+    bool quit;
+    QemuMutex mutex;
+    QemuCond cond;
+    /* run of pages to write; block is NULL while there is nothing to do */
+    RAMBlock *block;
+    unsigned long page;
+    unsigned long npages;
+} FixedRamSendParams;
+
+static struct {
+    FixedRamSendParams *params;
+    QemuThread *threads;
+    int count;
+    /* channel used by the I/O threads, may be opened with O_DIRECT */
+    QIOChannel *ioc;
+    /* done_cond wakes the migration thread when an I/O thread is idle */
+    QemuMutex done_lock;
+    QemuCond done_cond;
+    /* first error reported by an I/O thread, protected by done_lock */
+    Error *error;
+    /* run of dirty pages being collected by the migration thread */
+    RAMBlock *block;
+    unsigned long page;
+    unsigned long npages;
+} *fixed_ram_send_state;
+
+/* Size in bytes of the on-disk bitmap of a block with @npages pages */
+static size_t fixed_ram_bitmap_size(unsigned long npages)
+{
+    /* Always a multiple of 64 bits so 32 and 64 bit hosts agree */
+    return DIV_ROUND_UP(npages, 64) * 8;
+}
+
+static void *fixed_ram_send_thread(void *opaque)
+{
+    FixedRamSendParams *p = opaque;
+    RAMBlock *block;
+    unsigned long page, npages;
+    Error *local_err = NULL;
+    int ret;
+
+    qemu_mutex_lock(&p->mutex);
+    while (!p->quit) {
+        if (p->block) {
+            block = p->block;
+            page = p->page;
+            npages = p->npages;
+            p->block = NULL;
+            qemu_mutex_unlock(&p->mutex);
+
+            ret = qio_channel_pwrite_all(fixed_ram_send_state->ioc,
+                        (char *)block->host + (page << TARGET_PAGE_BITS),
+                        npages << TARGET_PAGE_BITS,
+                        block->pages_offset + (page << TARGET_PAGE_BITS),
+                        &local_err);
+            trace_fixed_ram_send(block->idstr, page, npages, ret);
+
+            qemu_mutex_lock(&fixed_ram_send_state->done_lock);
+            if (ret < 0) {
+                if (!fixed_ram_send_state->error) {
+                    fixed_ram_send_state->error = local_err;
+                } else {
+                    error_free(local_err);
+                }
+                local_err = NULL;
+            }
+            p->done = true;
+            qemu_cond_signal(&fixed_ram_send_state->done_cond);
+            qemu_mutex_unlock(&fixed_ram_send_state->done_lock);
+
+            qemu_mutex_lock(&p->mutex);
+        } else {
+            qemu_cond_wait(&p->cond, &p->mutex);
+        }
+    }
+    qemu_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+static void fixed_ram_save_cleanup(void)
+{
+    int i;
+
+    if (!fixed_ram_send_state) {
+        return;
+    }
+
+    for (i = 0; i < fixed_ram_send_state->count; i++) {
+        FixedRamSendParams *p = &fixed_ram_send_state->params[i];
+
+        qemu_mutex_lock(&p->mutex);
+        p->quit = true;
+        qemu_cond_signal(&p->cond);
+        qemu_mutex_unlock(&p->mutex);
+
+        qemu_thread_join(&fixed_ram_send_state->threads[i]);
+        qemu_mutex_destroy(&p->mutex);
+        qemu_cond_destroy(&p->cond);
+    }
+    qemu_mutex_destroy(&fixed_ram_send_state->done_lock);
+    qemu_cond_destroy(&fixed_ram_send_state->done_cond);
+    error_free(fixed_ram_send_state->error);
+    object_unref(OBJECT(fixed_ram_send_state->ioc));
+    g_free(fixed_ram_send_state->params);
+    g_free(fixed_ram_send_state->threads);
+    g_free(fixed_ram_send_state);
+    fixed_ram_send_state = NULL;
+}
+
+/*
+ * Open the channel used for positioned I/O on RAM pages: a separate
+ * channel on the migration file when possible, so that O_DIRECT does
+ * not affect the buffered main stream, otherwise the main channel.
+ */
+static QIOChannel *fixed_ram_open_channel(QEMUFile *f, bool outgoing,
+                                          Error **errp)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    QIOChannel *aux;
+    Error *local_err = NULL;
+
+    if (!ioc || !qio_channel_has_feature(ioc, QIO_CHANNEL_FEATURE_SEEKABLE)) {
+        error_setg(errp, "fixed-ram requires a seekable migration channel, "
+                   "such as a file: URI");
+        return NULL;
+    }
+
+    if (migrate_direct_io() &&
+        TARGET_PAGE_SIZE % qemu_real_host_page_size) {
+        error_setg(errp, "direct-io requires the target page size to be a "
+                   "multiple of the host page size");
+        return NULL;
+    }
+
+    aux = file_open_aux_channel(outgoing, migrate_direct_io(), &local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        return NULL;
+    }
+    if (aux) {
+        return aux;
+    }
+
+    if (migrate_direct_io()) {
+        error_setg(errp, "direct-io is only supported with file: URIs");
+        return NULL;
+    }
+    object_ref(OBJECT(ioc));
+    return ioc;
+}
+
+static int fixed_ram_save_setup(QEMUFile *f)
+{
+    int i, thread_count;
+    Error *local_err = NULL;
+    QIOChannel *ioc;
+
+    if (!migrate_use_fixed_ram()) {
+        return 0;
+    }
+
+    ioc = fixed_ram_open_channel(f, true, &local_err);
+    if (!ioc) {
+        error_report_err(local_err);
+        return -1;
+    }
+
+    thread_count = migrate_fixed_ram_threads();
+    fixed_ram_send_state = g_malloc0(sizeof(*fixed_ram_send_state));
+    fixed_ram_send_state->ioc = ioc;
+    fixed_ram_send_state->params = g_new0(FixedRamSendParams, thread_count);
+    fixed_ram_send_state->threads = g_new0(QemuThread, thread_count);
+    qemu_mutex_init(&fixed_ram_send_state->done_lock);
+    qemu_cond_init(&fixed_ram_send_state->done_cond);
+    for (i = 0; i < thread_count; i++) {
+        FixedRamSendParams *p = &fixed_ram_send_state->params[i];
+
+        p->done = true;
+        qemu_mutex_init(&p->mutex);
+        qemu_cond_init(&p->cond);
+        qemu_thread_create(&fixed_ram_send_state->threads[i],
+                           "fixed-ram-send", fixed_ram_send_thread, p,
+                           QEMU_THREAD_JOINABLE);
+        fixed_ram_send_state->count++;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns -EIO if an I/O thread failed, after handing its error to the
+ * migration state.  Called with done_lock held.
+ */
+static int fixed_ram_check_error_locked(void)
+{
+    if (fixed_ram_send_state->error) {
+        migrate_set_error(migrate_get_current(), fixed_ram_send_state->error);
+        error_report_err(fixed_ram_send_state->error);
+        fixed_ram_send_state->error = NULL;
+        return -EIO;
+    }
+    return 0;
+}
+
+/* Hand the run of pages collected so far to an idle I/O thread */
+static int fixed_ram_send_pages(void)
+{
+    int i, ret;
+
+    if (!fixed_ram_send_state->npages) {
+        return 0;
+    }
+
+    qemu_mutex_lock(&fixed_ram_send_state->done_lock);
+    while (true) {
+        ret = fixed_ram_check_error_locked();
+        if (ret < 0) {
+            break;
+        }
+        for (i = 0; i < fixed_ram_send_state->count; i++) {
+            if (fixed_ram_send_state->params[i].done) {
+                break;
+            }
+        }
+        if (i < fixed_ram_send_state->count) {
+            FixedRamSendParams *p = &fixed_ram_send_state->params[i];
+
+            p->done = false;
+            qemu_mutex_lock(&p->mutex);
+            p->block = fixed_ram_send_state->block;
+            p->page = fixed_ram_send_state->page;
+            p->npages = fixed_ram_send_state->npages;
+            qemu_cond_signal(&p->cond);
+            qemu_mutex_unlock(&p->mutex);
+            break;
+        }
+        qemu_cond_wait(&fixed_ram_send_state->done_cond,
+                       &fixed_ram_send_state->done_lock);
+    }
+    qemu_mutex_unlock(&fixed_ram_send_state->done_lock);
+
+    fixed_ram_send_state->block = NULL;
+    fixed_ram_send_state->npages = 0;
+    return ret;
+}
+
+/* Queue a page for writing, merging it with the pending run if possible */
+static int fixed_ram_queue_page(RAMBlock *block, unsigned long page)
+{
+    if (fixed_ram_send_state->block == block &&
+        fixed_ram_send_state->page + fixed_ram_send_state->npages == page &&
+        fixed_ram_send_state->npages < FIXED_RAM_MAX_BATCH_PAGES) {
+        fixed_ram_send_state->npages++;
+        return 0;
+    }
+
+    if (fixed_ram_send_pages() < 0) {
+        return -EIO;
+    }
+    fixed_ram_send_state->block = block;
+    fixed_ram_send_state->page = page;
+    fixed_ram_send_state->npages = 1;
+    return 0;
+}
+
+/* Write out the pending run and wait until all I/O threads are idle */
+static int fixed_ram_flush(void)
+{
+    int i, ret;
+
+    if (!fixed_ram_send_state) {
+        return 0;
+    }
+
+    ret = fixed_ram_send_pages();
+    if (ret < 0) {
+        return ret;
+    }
+
+    qemu_mutex_lock(&fixed_ram_send_state->done_lock);
+    for (i = 0; i < fixed_ram_send_state->count; i++) {
+        while (!fixed_ram_send_state->params[i].done) {
+            qemu_cond_wait(&fixed_ram_send_state->done_cond,
+                           &fixed_ram_send_state->done_lock);
+        }
+    }
+    ret = fixed_ram_check_error_locked();
+    qemu_mutex_unlock(&fixed_ram_send_state->done_lock);
+
+    return ret;
+}
+
+/*
+ * Write the fixed-ram header of @block to the stream, reserve room for
+ * its bitmap and pages and move the stream past them.
+ */
+static void fixed_ram_save_header(QEMUFile *f, RAMBlock *block)
+{
+    unsigned long npages = block->used_length >> TARGET_PAGE_BITS;
+    off_t header_end = qemu_file_get_offset(f) + FIXED_RAM_HDR_SIZE;
+
+    block->bitmap_offset = header_end;
+    block->pages_offset = ROUND_UP(header_end + fixed_ram_bitmap_size(npages),
+                                   FIXED_RAM_FILE_OFFSET_ALIGNMENT);
+    block->file_bmap = bitmap_new(npages);
+
+    qemu_put_be32(f, FIXED_RAM_HDR_VERSION);
+    qemu_put_be64(f, TARGET_PAGE_SIZE);
+    qemu_put_be64(f, block->bitmap_offset);
+    qemu_put_be64(f, block->pages_offset);
+
+    qemu_file_set_offset(f, block->pages_offset + block->used_length);
+}
+
+/*
+ * Write the bitmap of pages present in the stream of every block.
+ * The I/O threads must be idle.
+ */
+static int fixed_ram_save_bitmaps(QEMUFile *f)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    Error *local_err = NULL;
+    RAMBlock *block;
+    int ret = 0;
+
+    RAMBLOCK_FOREACH_MIGRATABLE(block) {
+        unsigned long npages = block->used_length >> TARGET_PAGE_BITS;
+        size_t size = fixed_ram_bitmap_size(npages);
+        unsigned long *le_bitmap = bitmap_new(npages + 64);
+
+        bitmap_to_le(le_bitmap, block->file_bmap, npages);
+        ret = qio_channel_pwrite_all(ioc, (char *)le_bitmap, size,
+                                     block->bitmap_offset, &local_err);
+        g_free(le_bitmap);
+        if (ret < 0) {
+            migrate_set_error(migrate_get_current(), local_err);
+            error_report_err(local_err);
+            return -EIO;
+        }
+    }
+    return ret;
+}
+
+/**
+ * ram_save_fixed_ram_page: save a page at its fixed offset
+ *
+ * Zero pages are not written, they are just left out of the bitmap of
+ * pages present in the stream.
+ *
+ * Returns the number of pages written, or negative on error
+ *
+ * @rs: current RAM state
+ * @block: block that contains the page we want to send
+ * @page: index of the page inside the block
+ */
+static int ram_save_fixed_ram_page(RAMState *rs, RAMBlock *block,
+                                   unsigned long page)
+{
+    uint8_t *p = block->host + (page << TARGET_PAGE_BITS);
+
+    if (is_zero_range(p, TARGET_PAGE_SIZE)) {
+        clear_bit(page, block->file_bmap);
+        ram_counters.duplicate++;
+        return 1;
+    }
+
+    set_bit(page, block->file_bmap);
+    if (fixed_ram_queue_page(block, page) < 0) {
+        return -EIO;
+    }
+    qemu_update_position(rs->f, TARGET_PAGE_SIZE);
+    qemu_file_update_transfer(rs->f, TARGET_PAGE_SIZE);
+    ram_counters.transferred += TARGET_PAGE_SIZE;
+    ram_counters.normal++;
+    return 1;
+}
+
+typedef struct {
+    QemuThread thread;
+    QIOChannel *ioc;
+    RAMBlock *block;
+    unsigned long *bitmap;
+    off_t pages_offset;
+    unsigned long start;
+    unsigned long end;
+    Error *err;
+} FixedRamRecvParams;
+
+static QIOChannel *fixed_ram_recv_ioc;
+
+/*
+ * Load the pages [start, end) of a block: pages present in the stream
+ * are read at their fixed offset, all others must end up zero.
+ */
+static void *fixed_ram_recv_thread(void *opaque)
+{
+    FixedRamRecvParams *p = opaque;
+    unsigned long page = p->start, next;
+
+    while (page < p->end) {
+        uint8_t *host = p->block->host + (page << TARGET_PAGE_BITS);
+        size_t len;
+
+        if (test_bit(page, p->bitmap)) {
+            next = find_next_zero_bit(p->bitmap, p->end, page);
+            len = (next - page) << TARGET_PAGE_BITS;
+            if (qio_channel_pread_all(p->ioc, (char *)host, len,
+                                      p->pages_offset +
+                                      (page << TARGET_PAGE_BITS),
+                                      &p->err) < 0) {
+                break;
+            }
+        } else {
+            next = find_next_bit(p->bitmap, p->end, page);
+            len = (next - page) << TARGET_PAGE_BITS;
+            if (!buffer_is_zero(host, len)) {
+                memset(host, 0, len);
+            }
+        }
+        trace_fixed_ram_recv(p->block->idstr, page, next - page,
+                             test_bit(page, p->bitmap));
+        page = next;
+    }
+
+    return NULL;
+}
+
+static int fixed_ram_load_setup(QEMUFile *f)
+{
+    Error *local_err = NULL;
+
+    if (!migrate_use_fixed_ram()) {
+        return 0;
+    }
+
+    fixed_ram_recv_ioc = fixed_ram_open_channel(f, false, &local_err);
+    if (!fixed_ram_recv_ioc) {
+        error_report_err(local_err);
+        return -1;
+    }
+    return 0;
+}
+
+static void fixed_ram_load_cleanup(void)
+{
+    if (fixed_ram_recv_ioc) {
+        object_unref(OBJECT(fixed_ram_recv_ioc));
+        fixed_ram_recv_ioc = NULL;
+    }
+}
+
+/**
+ * fixed_ram_load_block: load all pages of a block from the stream
+ *
+ * Reads the fixed-ram header of @block, then reads its pages with
+ * several threads and leaves the stream positioned after them.
+ *
+ * Returns 0 for success or -errno in case of error
+ *
+ * @f: QEMUFile where to receive the data
+ * @block: the block being loaded
+ * @length: used length of the block on the source
+ */
+static int fixed_ram_load_block(QEMUFile *f, RAMBlock *block,
+                                ram_addr_t length)
+{
+    unsigned long npages = length >> TARGET_PAGE_BITS;
+    unsigned long *le_bitmap, *bitmap, chunk;
+    FixedRamRecvParams *params;
+    uint32_t version;
+    uint64_t page_size;
+    off_t bitmap_offset, pages_offset;
+    Error *local_err = NULL;
+    int i, thread_count, ret = 0;
+
+    version = qemu_get_be32(f);
+    page_size = qemu_get_be64(f);
+    bitmap_offset = qemu_get_be64(f);
+    pages_offset = qemu_get_be64(f);
+    ret = qemu_file_get_error(f);
+    if (ret) {
+        return ret;
+    }
+    if (version != FIXED_RAM_HDR_VERSION) {
+        error_report("Unsupported fixed-ram version %" PRIu32 " for block %s",
+                     version, block->idstr);
+        return -EINVAL;
+    }
+    if (page_size != TARGET_PAGE_SIZE) {
+        error_report("Mismatched fixed-ram page size %" PRIu64 " for "
+                     "block %s", page_size, block->idstr);
+        return -EINVAL;
+    }
+    if (length > block->used_length) {
+        error_report("Fixed-ram block %s is larger than the local block",
+                     block->idstr);
+        return -EINVAL;
+    }
+
+    if (ramblock_is_ignored(block)) {
+        goto out;
+    }
+
+    /*
+     * The bitmap is neither aligned nor a multiple of the block size, read
+     * it through the main channel, which is never opened with O_DIRECT.
+     */
+    le_bitmap = bitmap_new(npages + 64);
+    bitmap = bitmap_new(npages);
+    if (qio_channel_pread_all(qemu_file_get_ioc(f), (char *)le_bitmap,
+                              fixed_ram_bitmap_size(npages), bitmap_offset,
+                              &local_err) < 0) {
+        error_report_err(local_err);
+        g_free(le_bitmap);
+        g_free(bitmap);
+        return -EIO;
+    }
+    bitmap_from_le(bitmap, le_bitmap, npages);
+    g_free(le_bitmap);
+
+    /* Split the block in chunks, keeping them word aligned in the bitmap */
+    thread_count = migrate_fixed_ram_threads();
+    chunk = ROUND_UP(DIV_ROUND_UP(npages, thread_count), BITS_PER_LONG);
+    params = g_new0(FixedRamRecvParams, thread_count);
+    for (i = 0; i < thread_count; i++) {
+        FixedRamRecvParams *p = &params[i];
+
+        p->ioc = fixed_ram_recv_ioc;
+        p->block = block;
+        p->bitmap = bitmap;
+        p->pages_offset = pages_offset;
+        p->start = MIN((unsigned long)i * chunk, npages);
+        p->end = MIN(p->start + chunk, npages);
+        qemu_thread_create(&p->thread, "fixed-ram-recv",
+                           fixed_ram_recv_thread, p, QEMU_THREAD_JOINABLE);
+    }
+    for (i = 0; i < thread_count; i++) {
+        qemu_thread_join(&params[i].thread);
+        if (params[i].err) {
+            if (!ret) {
+                error_report_err(params[i].err);
+                ret = -EIO;
+            } else {
+                error_free(params[i].err);
+            }
+        }
+    }
+    g_free(params);
+    g_free(bitmap);
+    if (ret) {
+        return ret;
+    }
+
+out:
+    return qemu_file_set_offset(f, pages_offset + length);
+}
+
 /**
  * save_page_header: write page header to wire
  *
@@ -1570,6 +2144,80 @@ static void mig_throttle_guest_down(void)
     }
 }
 
+/**
+ * mig_throttle_vcpus_dirty_limit: throttle each vCPU towards the dirty limit
+ *
+ * Adjust the throttle of every vCPU according to the rate at which it
+ * dirtied memory during the last sync period: vCPUs above vcpu-dirty-limit
+ * are throttled harder if migration is not converging, vCPUs well below
+ * the limit are gradually released.  Only TCG knows how many pages each
+ * vCPU dirtied, so the capability is refused with other accelerators.
+ *
+ * @rs: current RAM state
+ * @period_ms: length of the sync period
+ * @converging: whether the dirty rate is below the transfer rate
+ */
+static void mig_throttle_vcpus_dirty_limit(RAMState *rs, int64_t period_ms,
+                                           bool converging)
+{
+    MigrationState *s = migrate_get_current();
+    uint64_t limit = migrate_vcpu_dirty_limit();
+    int pct_increment = s->parameters.cpu_throttle_increment;
+    int pct_max = s->parameters.max_cpu_throttle;
+    int pct_initial = MIN(s->parameters.cpu_throttle_initial, pct_max);
+    CPUState *cpu;
+
+    rcu_read_lock();
+    CPU_FOREACH(cpu) {
+        int pct = atomic_read(&cpu->throttle_percentage);
+        uint64_t now = atomic_read__nocheck(&cpu->dirty_pages);
+        uint64_t pages, rate;
+
+        pages = now - rs->vcpu_dirty_pages_prev[cpu->cpu_index];
+        rs->vcpu_dirty_pages_prev[cpu->cpu_index] = now;
+        rate = (pages * TARGET_PAGE_SIZE * 1000 / MAX(period_ms, 1)) >> 20;
+
+        if (rate > limit && !converging) {
+            pct = pct ? MIN(pct + pct_increment, pct_max) : pct_initial;
+        } else if (rate < limit / 2) {
+            pct = MAX(pct - pct_increment, 0);
+        }
+        trace_migration_dirty_limit_vcpu(cpu->cpu_index, rate, pct);
+        cpu_throttle_set_vcpu(cpu, pct);
+    }
+    rcu_read_unlock();
+}
+
+/**
+ * mig_throttle_vcpus_dirty_limit_seed: throttle vCPUs known to be too fast
+ *
+ * Without this the per-vCPU throttle only starts after a couple of sync
+ * periods during which migration does not converge.  If calc-dirty-rate
+ * measured the vCPUs shortly before migration started, throttle those
+ * above vcpu-dirty-limit from the first iteration instead.
+ *
+ * Called with the BQL and the RCU read lock held.
+ */
+static void mig_throttle_vcpus_dirty_limit_seed(void)
+{
+    MigrationState *s = migrate_get_current();
+    uint64_t limit = migrate_vcpu_dirty_limit();
+    int pct_max = s->parameters.max_cpu_throttle;
+    int pct_initial = MIN(s->parameters.cpu_throttle_initial, pct_max);
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        int64_t rate = dirtyrate_vcpu_last(cpu->cpu_index,
+                                           DIRTY_LIMIT_SEED_MAX_AGE_MS);
+
+        if (rate >= 0 && (uint64_t)rate > limit) {
+            trace_migration_dirty_limit_vcpu(cpu->cpu_index, rate,
+                                             pct_initial);
+            cpu_throttle_set_vcpu(cpu, pct_initial);
+        }
+    }
+}
+
 /**
  * xbzrle_cache_zero_page: insert a zero page in the XBZRLE cache
  *
@@ -1869,7 +2517,21 @@ static void migration_bitmap_sync(RAMState *rs)
         /* During block migration the auto-converge logic incorrectly detects
          * that ram migration makes no progress. Avoid this by disabling the
          * throttling logic during the bulk phase of block migration. */
-        if (migrate_auto_converge() && !blk_mig_bulk_active()) {
+        if (migrate_dirty_limit() && !blk_mig_bulk_active()) {
+            bool converging = true;
+
+            /* Same detection logic as auto-converge below */
+            if ((rs->num_dirty_pages_period * TARGET_PAGE_SIZE >
+                   (bytes_xfer_now - rs->bytes_xfer_prev) / 2) &&
+                (++rs->dirty_rate_high_cnt >= 2)) {
+                trace_migration_throttle();
+                rs->dirty_rate_high_cnt = 0;
+                converging = false;
+            }
+            mig_throttle_vcpus_dirty_limit(rs,
+                                           end_time - rs->time_last_bitmap_sync,
+                                           converging);
+        } else if (migrate_auto_converge() && !blk_mig_bulk_active()) {
             /* The following detection logic can be refined later. For now:
                Check to see if the dirtied bytes is 50% more than the approx.
                amount of bytes that just got transferred since the last time we
@@ -2544,6 +3206,10 @@ static int ram_save_target_page(RAMState *rs, PageSearchStatus *pss,
     ram_addr_t offset = pss->page << TARGET_PAGE_BITS;
     int res;
 
+    if (migrate_use_fixed_ram()) {
+        return ram_save_fixed_ram_page(rs, block, pss->page);
+    }
+
     if (control_save_page(rs, block, offset, &res)) {
         return res;
     }
@@ -2741,6 +3407,7 @@ static void ram_state_cleanup(RAMState **rsp)
         migration_page_queue_free(*rsp);
         qemu_mutex_destroy(&(*rsp)->bitmap_mutex);
         qemu_mutex_destroy(&(*rsp)->src_page_req_mutex);
+        g_free((*rsp)->vcpu_dirty_pages_prev);
         g_free(*rsp);
         *rsp = NULL;
     }
@@ -2779,10 +3446,13 @@ static void ram_save_cleanup(void *opaque)
         block->bmap = NULL;
         g_free(block->unsentmap);
         block->unsentmap = NULL;
+        g_free(block->file_bmap);
+        block->file_bmap = NULL;
     }
 
     xbzrle_cleanup();
     compress_threads_save_cleanup();
+    fixed_ram_save_cleanup();
     ram_state_cleanup(rsp);
 }
 
@@ -3245,6 +3915,9 @@ static int ram_state_init(RAMState **rsp)
     (*rsp)->migration_dirty_pages = ram_bytes_total() >> TARGET_PAGE_BITS;
     ram_state_reset(*rsp);
 
+    (*rsp)->vcpu_dirty_pages_prev = g_new0(uint64_t, vcpu_dirty_pages_nr());
+    vcpu_dirty_pages_snapshot((*rsp)->vcpu_dirty_pages_prev);
+
     return 0;
 }
 
@@ -3301,6 +3974,9 @@ static void ram_init_bitmaps(RAMState *rs)
     ram_list_init_bitmaps();
     memory_global_dirty_log_start();
     migration_bitmap_sync_precopy(rs);
+    if (migrate_dirty_limit()) {
+        mig_throttle_vcpus_dirty_limit_seed();
+    }
 
     rcu_read_unlock();
     qemu_mutex_unlock_ramlist();
@@ -3429,10 +4105,16 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
         return -1;
     }
 
+    if (fixed_ram_save_setup(f)) {
+        compress_threads_save_cleanup();
+        return -1;
+    }
+
     /* migration has already setup the bitmap, reuse it. */
     if (!migration_in_colo_state()) {
         if (ram_init_all(rsp) != 0) {
             compress_threads_save_cleanup();
+            fixed_ram_save_cleanup();
             return -1;
         }
     }
@@ -3452,6 +4134,9 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
         if (migrate_ignore_shared()) {
             qemu_put_be64(f, block->mr->addr);
         }
+        if (migrate_use_fixed_ram()) {
+            fixed_ram_save_header(f, block);
+        }
     }
 
     rcu_read_unlock();
@@ -3604,6 +4289,13 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
     flush_compressed_data(rs);
     ram_control_after_iterate(f, RAM_CONTROL_FINISH);
 
+    if (!ret && migrate_use_fixed_ram()) {
+        ret = fixed_ram_flush();
+        if (!ret) {
+            ret = fixed_ram_save_bitmaps(f);
+        }
+    }
+
     rcu_read_unlock();
 
     multifd_send_sync_main(rs);
@@ -4053,6 +4745,11 @@ static int ram_load_setup(QEMUFile *f, void *opaque)
         return -1;
     }
 
+    if (fixed_ram_load_setup(f)) {
+        compress_threads_load_cleanup();
+        return -1;
+    }
+
     xbzrle_load_setup();
     ramblock_recv_map_init();
 
@@ -4071,6 +4768,7 @@ static int ram_load_cleanup(void *opaque)
 
     xbzrle_load_cleanup();
     compress_threads_load_cleanup();
+    fixed_ram_load_cleanup();
 
     RAMBLOCK_FOREACH_NOT_IGNORED(rb) {
         g_free(rb->receivedmap);
@@ -4412,6 +5110,9 @@ static int ram_load_precopy(QEMUFile *f)
                             ret = -EINVAL;
                         }
                     }
+                    if (!ret && migrate_use_fixed_ram()) {
+                        ret = fixed_ram_load_block(f, block, length);
+                    }
                     ram_control_load_hook(f, RAM_CONTROL_BLOCK_REG,
                                           block->idstr);
                 } else {
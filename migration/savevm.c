@@ -89,6 +89,7 @@ enum qemu_vm_cmd {
 };
 
 #define MAX_VM_CMD_PACKAGED_SIZE UINT32_MAX
+#define MAX_VM_SECTION_SIZED_SIZE UINT32_MAX
 static struct mig_cmd_args {
     ssize_t     len; /* -1 = variable */
     const char *name;
@@ -246,6 +247,10 @@ typedef struct SaveStateEntry {
     void *opaque;
     CompatEntry *compat;
     int is_ram;
+    /* cost of the last stop-and-copy save and full section load */
+    int64_t save_time_us;
+    int64_t save_size;
+    int64_t load_time_us;
 } SaveStateEntry;
 
 typedef struct SaveState {
@@ -873,6 +878,7 @@ static void save_section_header(QEMUFile *f, SaveStateEntry *se,
     qemu_put_be32(f, se->section_id);
 
     if (section_type == QEMU_VM_SECTION_FULL ||
+        section_type == QEMU_VM_SECTION_FULL_SIZED ||
         section_type == QEMU_VM_SECTION_START) {
         /* ID string */
         size_t len = strlen(se->idstr);
@@ -896,6 +902,254 @@ static void save_section_footer(QEMUFile *f, SaveStateEntry *se)
     }
 }
 
+/*
+ * The state of sections whose vmsd is marked as independent can be saved
+ * and loaded by a pool of worker threads, while the migration thread keeps
+ * the stream in order.  Such sections are sent as QEMU_VM_SECTION_FULL_SIZED,
+ * whose data is prefixed by its length so that the destination can hand it
+ * over to a worker without parsing it first.
+ */
+typedef struct DeviceStateJob {
+    SaveStateEntry *se;
+    QIOChannelBuffer *bioc;
+    QEMUFile *f;
+    /* vmdesc fields of the section, save only */
+    QJSON *vmdesc;
+    /* post_load hooks left for the migration thread, load only */
+    GArray *post_loads;
+    bool done;
+    int ret;
+    QSIMPLEQ_ENTRY(DeviceStateJob) next;
+    QSIMPLEQ_ENTRY(DeviceStateJob) order;
+} DeviceStateJob;
+
+typedef QSIMPLEQ_HEAD(, DeviceStateJob) DeviceStateJobList;
+
+typedef struct DeviceStateWorkers {
+    bool load;
+    int nr_threads;
+    QemuThread *threads;
+    QemuMutex lock;
+    /* signalled when a job is queued or when the workers must quit */
+    QemuCond job_cond;
+    /* signalled when a job completes */
+    QemuCond done_cond;
+    DeviceStateJobList queue;
+    /* load jobs in stream order, until their post_load hooks have run */
+    DeviceStateJobList loaded;
+    /* jobs queued or running */
+    int outstanding;
+    /* first error returned by a job */
+    int ret;
+    bool quit;
+} DeviceStateWorkers;
+
+static bool savevm_section_is_independent(SaveStateEntry *se)
+{
+    return se->vmsd && se->vmsd->independent;
+}
+
+static void device_state_job_free(DeviceStateJob *job)
+{
+    if (job->f) {
+        qemu_fclose(job->f);
+    }
+    object_unref(OBJECT(job->bioc));
+    if (job->vmdesc) {
+        qjson_destroy(job->vmdesc);
+    }
+    if (job->post_loads) {
+        g_array_free(job->post_loads, TRUE);
+    }
+    g_free(job);
+}
+
+static int device_state_job_run(DeviceStateWorkers *w, DeviceStateJob *job)
+{
+    SaveStateEntry *se = job->se;
+    int64_t start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    int ret;
+
+    if (w->load) {
+        ret = vmstate_load(job->f, se);
+        se->load_time_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+        trace_vmstate_load_parallel(se->idstr, se->load_time_us, ret);
+        if (ret < 0) {
+            error_report("error while loading state for instance 0x%x of"
+                         " device '%s'", se->instance_id, se->idstr);
+        }
+    } else {
+        ret = vmstate_save(job->f, se, job->vmdesc);
+        qemu_fflush(job->f);
+        if (!ret) {
+            ret = qemu_file_get_error(job->f);
+        }
+        se->save_time_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+        se->save_size = job->bioc->usage;
+        trace_vmstate_save_parallel(se->idstr, se->save_time_us,
+                                    se->save_size, ret);
+    }
+
+    return ret;
+}
+
+static void *device_state_worker(void *opaque)
+{
+    DeviceStateWorkers *w = opaque;
+    DeviceStateJob *job;
+    int ret;
+
+    rcu_register_thread();
+
+    qemu_mutex_lock(&w->lock);
+    while (true) {
+        job = QSIMPLEQ_FIRST(&w->queue);
+        if (!job) {
+            if (w->quit) {
+                break;
+            }
+            qemu_cond_wait(&w->job_cond, &w->lock);
+            continue;
+        }
+        QSIMPLEQ_REMOVE_HEAD(&w->queue, next);
+        qemu_mutex_unlock(&w->lock);
+
+        if (w->load) {
+            /*
+             * post_load hooks may touch memory regions, the TLB and other
+             * state guarded by the BQL, leave them to the migration thread.
+             */
+            job->post_loads = vmstate_defer_post_load_begin();
+            ret = device_state_job_run(w, job);
+            vmstate_defer_post_load_end();
+        } else {
+            ret = device_state_job_run(w, job);
+        }
+
+        qemu_mutex_lock(&w->lock);
+        job->ret = ret;
+        job->done = true;
+        if (ret < 0 && !w->ret) {
+            w->ret = ret;
+        }
+        w->outstanding--;
+        qemu_cond_broadcast(&w->done_cond);
+    }
+    qemu_mutex_unlock(&w->lock);
+
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static DeviceStateWorkers *device_state_workers_new(bool load)
+{
+    DeviceStateWorkers *w = g_new0(DeviceStateWorkers, 1);
+    int i;
+
+    w->load = load;
+    w->nr_threads = migrate_device_state_threads();
+    w->threads = g_new0(QemuThread, w->nr_threads);
+    qemu_mutex_init(&w->lock);
+    qemu_cond_init(&w->job_cond);
+    qemu_cond_init(&w->done_cond);
+    QSIMPLEQ_INIT(&w->queue);
+    QSIMPLEQ_INIT(&w->loaded);
+
+    for (i = 0; i < w->nr_threads; i++) {
+        qemu_thread_create(&w->threads[i],
+                           load ? "devstate-load" : "devstate-save",
+                           device_state_worker, w, QEMU_THREAD_JOINABLE);
+    }
+    return w;
+}
+
+static void device_state_workers_queue(DeviceStateWorkers *w,
+                                       DeviceStateJob *job)
+{
+    qemu_mutex_lock(&w->lock);
+    QSIMPLEQ_INSERT_TAIL(&w->queue, job, next);
+    if (w->load) {
+        QSIMPLEQ_INSERT_TAIL(&w->loaded, job, order);
+    }
+    w->outstanding++;
+    qemu_cond_signal(&w->job_cond);
+    qemu_mutex_unlock(&w->lock);
+}
+
+static int device_state_job_wait(DeviceStateWorkers *w, DeviceStateJob *job)
+{
+    qemu_mutex_lock(&w->lock);
+    while (!job->done) {
+        qemu_cond_wait(&w->done_cond, &w->lock);
+    }
+    qemu_mutex_unlock(&w->lock);
+
+    return job->ret;
+}
+
+/*
+ * Wait for all queued jobs, returns the first error any of them hit.  On
+ * load, this also runs the post_load hooks the workers left behind, in
+ * stream order; the caller holds the BQL.
+ */
+static int device_state_workers_wait(DeviceStateWorkers *w)
+{
+    DeviceStateJob *job;
+    int64_t start;
+    int ret;
+
+    qemu_mutex_lock(&w->lock);
+    while (w->outstanding) {
+        qemu_cond_wait(&w->done_cond, &w->lock);
+    }
+    ret = w->ret;
+    qemu_mutex_unlock(&w->lock);
+
+    /* No worker is busy, w->loaded is ours until the next job is queued */
+    while ((job = QSIMPLEQ_FIRST(&w->loaded))) {
+        QSIMPLEQ_REMOVE_HEAD(&w->loaded, order);
+        if (!ret && !job->ret) {
+            start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+            ret = vmstate_run_post_loads(job->post_loads);
+            job->post_loads = NULL;
+            job->se->load_time_us += qemu_clock_get_us(QEMU_CLOCK_REALTIME) -
+                                     start;
+            if (ret < 0) {
+                error_report("error while loading state for instance 0x%x of"
+                             " device '%s'", job->se->instance_id,
+                             job->se->idstr);
+                w->ret = ret;
+            }
+        }
+        device_state_job_free(job);
+    }
+
+    return ret;
+}
+
+static int device_state_workers_free(DeviceStateWorkers *w)
+{
+    int ret = device_state_workers_wait(w);
+    int i;
+
+    qemu_mutex_lock(&w->lock);
+    w->quit = true;
+    qemu_cond_broadcast(&w->job_cond);
+    qemu_mutex_unlock(&w->lock);
+
+    for (i = 0; i < w->nr_threads; i++) {
+        qemu_thread_join(&w->threads[i]);
+    }
+
+    qemu_cond_destroy(&w->done_cond);
+    qemu_cond_destroy(&w->job_cond);
+    qemu_mutex_destroy(&w->lock);
+    g_free(w->threads);
+    g_free(w);
+
+    return ret;
+}
+
 /**
  * qemu_savevm_command_send: Send a 'QEMU_VM_COMMAND' type element with the
  *                           command and associated data.
@@ -1254,6 +1508,7 @@ static
 int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
 {
     SaveStateEntry *se;
+    int64_t start, start_pos;
     int ret;
 
     QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
@@ -1273,7 +1528,11 @@ int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
 
         save_section_header(f, se, QEMU_VM_SECTION_END);
 
+        start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+        start_pos = qemu_ftell_fast(f);
         ret = se->ops->save_live_complete_precopy(f, se->opaque);
+        se->save_time_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+        se->save_size = qemu_ftell_fast(f) - start_pos;
         trace_savevm_section_end(se->idstr, se->section_id, ret);
         save_section_footer(f, se);
         if (ret < 0) {
@@ -1285,15 +1544,85 @@ int qemu_savevm_state_complete_precopy_iterable(QEMUFile *f, bool in_postcopy)
     return 0;
 }
 
+/*
+ * Queue the independent sections to the device state workers, which save
+ * them while the caller goes through the other sections.
+ */
+static void savevm_queue_independent_sections(DeviceStateWorkers *w,
+                                              DeviceStateJobList *jobs)
+{
+    SaveStateEntry *se;
+    DeviceStateJob *job;
+
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        if (!savevm_section_is_independent(se) ||
+            !vmstate_save_needed(se->vmsd, se->opaque)) {
+            continue;
+        }
+
+        job = g_new0(DeviceStateJob, 1);
+        job->se = se;
+        job->bioc = qio_channel_buffer_new(4096);
+        qio_channel_set_name(QIO_CHANNEL(job->bioc),
+                             "migration-savevm-buffer");
+        job->f = qemu_fopen_channel_output(QIO_CHANNEL(job->bioc));
+        job->vmdesc = qjson_new_fragment();
+        QSIMPLEQ_INSERT_TAIL(jobs, job, order);
+        device_state_workers_queue(w, job);
+    }
+}
+
+/* Write out a section saved by a device state worker */
+static int savevm_put_independent_section(QEMUFile *f, DeviceStateWorkers *w,
+                                          DeviceStateJob *job, QJSON *vmdesc)
+{
+    SaveStateEntry *se = job->se;
+    int ret;
+
+    ret = device_state_job_wait(w, job);
+    if (ret) {
+        qemu_file_set_error(f, ret);
+        return ret;
+    }
+
+    trace_savevm_section_start(se->idstr, se->section_id);
+
+    json_start_object(vmdesc, NULL);
+    json_prop_str(vmdesc, "name", se->idstr);
+    json_prop_int(vmdesc, "instance_id", se->instance_id);
+    json_append_fragment(vmdesc, job->vmdesc);
+
+    save_section_header(f, se, QEMU_VM_SECTION_FULL_SIZED);
+    qemu_put_be64(f, job->bioc->usage);
+    qemu_put_buffer(f, job->bioc->data, job->bioc->usage);
+
+    trace_savevm_section_end(se->idstr, se->section_id, 0);
+    save_section_footer(f, se);
+
+    json_end_object(vmdesc);
+
+    return 0;
+}
+
 static
 int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
                                                     bool in_postcopy,
                                                     bool inactivate_disks)
 {
+    DeviceStateJobList jobs = QSIMPLEQ_HEAD_INITIALIZER(jobs);
+    DeviceStateWorkers *workers = NULL;
+    DeviceStateJob *job;
     QJSON *vmdesc;
     int vmdesc_len;
     SaveStateEntry *se;
-    int ret;
+    int64_t start, start_pos;
+    int ret = 0;
+
+    if (migrate_parallel_device_state()) {
+        workers = device_state_workers_new(false);
+        savevm_queue_independent_sections(workers, &jobs);
+    }
+    job = QSIMPLEQ_FIRST(&jobs);
 
     vmdesc = qjson_new();
     json_prop_int(vmdesc, "page_size", qemu_target_page_size());
@@ -1303,6 +1632,14 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
         if ((!se->ops || !se->ops->save_state) && !se->vmsd) {
             continue;
         }
+        if (job && job->se == se) {
+            ret = savevm_put_independent_section(f, workers, job, vmdesc);
+            if (ret) {
+                goto out;
+            }
+            job = QSIMPLEQ_NEXT(job, order);
+            continue;
+        }
         if (se->vmsd && !vmstate_save_needed(se->vmsd, se->opaque)) {
             trace_savevm_section_skip(se->idstr, se->section_id);
             continue;
@@ -1315,11 +1652,15 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
         json_prop_int(vmdesc, "instance_id", se->instance_id);
 
         save_section_header(f, se, QEMU_VM_SECTION_FULL);
+        start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+        start_pos = qemu_ftell_fast(f);
         ret = vmstate_save(f, se, vmdesc);
         if (ret) {
             qemu_file_set_error(f, ret);
-            return ret;
+            goto out;
         }
+        se->save_time_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
+        se->save_size = qemu_ftell_fast(f) - start_pos;
         trace_savevm_section_end(se->idstr, se->section_id, 0);
         save_section_footer(f, se);
 
@@ -1334,7 +1675,7 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
             error_report("%s: bdrv_inactivate_all() failed (%d)",
                          __func__, ret);
             qemu_file_set_error(f, ret);
-            return ret;
+            goto out;
         }
     }
     if (!in_postcopy) {
@@ -1351,9 +1692,19 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
         qemu_put_be32(f, vmdesc_len);
         qemu_put_buffer(f, (uint8_t *)qjson_get_str(vmdesc), vmdesc_len);
     }
+
+out:
     qjson_destroy(vmdesc);
+    if (workers) {
+        /* The jobs must not be freed while a worker still uses them */
+        device_state_workers_free(workers);
+        while ((job = QSIMPLEQ_FIRST(&jobs))) {
+            QSIMPLEQ_REMOVE_HEAD(&jobs, order);
+            device_state_job_free(job);
+        }
+    }
 
-    return 0;
+    return ret;
 }
 
 int qemu_savevm_state_complete_precopy(QEMUFile *f, bool iterable_only,
@@ -2182,8 +2533,8 @@ static bool check_section_footer(QEMUFile *f, SaveStateEntry *se)
     return true;
 }
 
-static int
-qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
+/* Read the header of a FULL, FULL_SIZED or START section */
+static int qemu_loadvm_section_header(QEMUFile *f, SaveStateEntry **sep)
 {
     uint32_t instance_id, version_id, section_id;
     SaveStateEntry *se;
@@ -2234,12 +2585,30 @@ qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
         return -EINVAL;
     }
 
+    *sep = se;
+    return 0;
+}
+
+static int
+qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
+{
+    SaveStateEntry *se;
+    int64_t start;
+    int ret;
+
+    ret = qemu_loadvm_section_header(f, &se);
+    if (ret < 0) {
+        return ret;
+    }
+
+    start = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     ret = vmstate_load(f, se);
     if (ret < 0) {
         error_report("error while loading state for instance 0x%x of"
-                     " device '%s'", instance_id, idstr);
+                     " device '%s'", se->instance_id, se->idstr);
         return ret;
     }
+    se->load_time_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start;
     if (!check_section_footer(f, se)) {
         return -EINVAL;
     }
@@ -2247,6 +2616,72 @@ qemu_loadvm_section_start_full(QEMUFile *f, MigrationIncomingState *mis)
     return 0;
 }
 
+/*
+ * Read a FULL_SIZED section and load it on a device state worker.  The
+ * data of the section is read in one go so that the stream can move on
+ * to the next section while the worker loads this one.
+ */
+static int
+qemu_loadvm_section_full_sized(QEMUFile *f, MigrationIncomingState *mis,
+                               DeviceStateWorkers *w)
+{
+    DeviceStateJob *job;
+    SaveStateEntry *se;
+    uint64_t length;
+    size_t ret_read;
+    int ret;
+
+    ret = qemu_loadvm_section_header(f, &se);
+    if (ret < 0) {
+        return ret;
+    }
+
+    length = qemu_get_be64(f);
+    if (length > MAX_VM_SECTION_SIZED_SIZE) {
+        error_report("Unreasonably large section '%s': %" PRIu64,
+                     se->idstr, length);
+        return -EINVAL;
+    }
+    trace_qemu_loadvm_section_full_sized(se->idstr, length);
+
+    job = g_new0(DeviceStateJob, 1);
+    job->se = se;
+    job->bioc = qio_channel_buffer_new(length);
+    qio_channel_set_name(QIO_CHANNEL(job->bioc), "migration-loadvm-buffer");
+    ret_read = qemu_get_buffer(f, job->bioc->data, length);
+    if (ret_read != length) {
+        device_state_job_free(job);
+        error_report("Section '%s': buffer receive fail ret=%zu length=%"
+                     PRIu64, se->idstr, ret_read, length);
+        ret = qemu_file_get_error(f);
+        return ret < 0 ? ret : -EIO;
+    }
+    job->bioc->usage = length;
+    job->f = qemu_fopen_channel_input(QIO_CHANNEL(job->bioc));
+
+    if (!check_section_footer(f, se)) {
+        device_state_job_free(job);
+        return -EINVAL;
+    }
+
+    if (savevm_section_is_independent(se)) {
+        device_state_workers_queue(w, job);
+        return 0;
+    }
+
+    /*
+     * The source thinks the section is independent but we do not, load it
+     * here once everything before it is in place.
+     */
+    ret = device_state_workers_wait(w);
+    if (ret == 0) {
+        ret = device_state_job_run(w, job);
+    }
+    device_state_job_free(job);
+
+    return ret;
+}
+
 static int
 qemu_loadvm_section_part_end(QEMUFile *f, MigrationIncomingState *mis)
 {
@@ -2402,6 +2837,7 @@ static bool postcopy_pause_incoming(MigrationIncomingState *mis)
 
 int qemu_loadvm_state_main(QEMUFile *f, MigrationIncomingState *mis)
 {
+    DeviceStateWorkers *workers = NULL;
     uint8_t section_type;
     int ret = 0;
 
@@ -2415,6 +2851,18 @@ retry:
         }
 
         trace_qemu_loadvm_state_section(section_type);
+
+        /*
+         * Independent sections only run concurrently with each other, the
+         * others see the state of all the sections that came before them.
+         */
+        if (workers && section_type != QEMU_VM_SECTION_FULL_SIZED) {
+            ret = device_state_workers_wait(workers);
+            if (ret < 0) {
+                goto out;
+            }
+        }
+
         switch (section_type) {
         case QEMU_VM_SECTION_START:
         case QEMU_VM_SECTION_FULL:
@@ -2423,6 +2871,15 @@ retry:
                 goto out;
             }
             break;
+        case QEMU_VM_SECTION_FULL_SIZED:
+            if (!workers) {
+                workers = device_state_workers_new(true);
+            }
+            ret = qemu_loadvm_section_full_sized(f, mis, workers);
+            if (ret < 0) {
+                goto out;
+            }
+            break;
         case QEMU_VM_SECTION_PART:
         case QEMU_VM_SECTION_END:
             ret = qemu_loadvm_section_part_end(f, mis);
@@ -2448,6 +2905,15 @@ retry:
     }
 
 out:
+    if (workers) {
+        int wret = device_state_workers_free(workers);
+
+        workers = NULL;
+        if (ret >= 0 && wret < 0) {
+            ret = wret;
+        }
+    }
+
     if (ret < 0) {
         qemu_file_set_error(f, ret);
 
@@ -2853,6 +3319,33 @@ err_drain:
     return ret;
 }
 
+VMStateTimingInfoList *qmp_query_vmstate_timing(Error **errp)
+{
+    VMStateTimingInfoList *head = NULL, **tail = &head;
+    SaveStateEntry *se;
+
+    QTAILQ_FOREACH(se, &savevm_state.handlers, entry) {
+        VMStateTimingInfoList *entry;
+
+        if (!se->save_size && !se->save_time_us && !se->load_time_us) {
+            continue;
+        }
+
+        entry = g_new0(VMStateTimingInfoList, 1);
+        entry->value = g_new0(VMStateTimingInfo, 1);
+        entry->value->name = g_strdup(se->idstr);
+        entry->value->instance_id = se->instance_id;
+        entry->value->independent = savevm_section_is_independent(se);
+        entry->value->save_time = se->save_time_us;
+        entry->value->save_size = se->save_size;
+        entry->value->load_time = se->load_time_us;
+        *tail = entry;
+        tail = &entry->next;
+    }
+
+    return head;
+}
+
 void vmstate_register_ram(MemoryRegion *mr, DeviceState *dev)
 {
     qemu_ram_set_idstr(mr->ram_block,
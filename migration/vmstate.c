@@ -25,6 +25,15 @@ static int vmstate_subsection_save(QEMUFile *f, const VMStateDescription *vmsd,
 static int vmstate_subsection_load(QEMUFile *f, const VMStateDescription *vmsd,
                                    void *opaque);
 
+typedef struct VMStatePostLoad {
+    const VMStateDescription *vmsd;
+    void *opaque;
+    int version_id;
+} VMStatePostLoad;
+
+/* post_load hooks recorded instead of being run, see vmstate_defer_post_load */
+static __thread GArray *deferred_post_loads;
+
 static int vmstate_n_elems(void *opaque, const VMStateField *field)
 {
     int n_elems = 1;
@@ -165,12 +174,59 @@ int vmstate_load_state(QEMUFile *f, const VMStateDescription *vmsd,
         return ret;
     }
     if (vmsd->post_load) {
-        ret = vmsd->post_load(opaque, version_id);
+        if (deferred_post_loads) {
+            VMStatePostLoad pl = { vmsd, opaque, version_id };
+
+            g_array_append_val(deferred_post_loads, pl);
+        } else {
+            ret = vmsd->post_load(opaque, version_id);
+        }
     }
     trace_vmstate_load_state_end(vmsd->name, "end", ret);
     return ret;
 }
 
+/*
+ * Until vmstate_defer_post_load_end() is called, vmstate_load_state() on
+ * the calling thread only parses the fields and records the post_load
+ * hooks it would have run.  This lets a thread without the BQL load a
+ * section, while hooks that touch the rest of QEMU run later from the
+ * thread that owns the BQL, through vmstate_run_post_loads().
+ */
+GArray *vmstate_defer_post_load_begin(void)
+{
+    assert(!deferred_post_loads);
+    deferred_post_loads = g_array_new(FALSE, FALSE, sizeof(VMStatePostLoad));
+    return deferred_post_loads;
+}
+
+void vmstate_defer_post_load_end(void)
+{
+    deferred_post_loads = NULL;
+}
+
+/*
+ * Run the hooks recorded in @post_loads in the order vmstate_load_state()
+ * met them, which is the order it would have run them in, and free the
+ * array.  Returns the first error.
+ */
+int vmstate_run_post_loads(GArray *post_loads)
+{
+    int ret = 0;
+    guint i;
+
+    for (i = 0; i < post_loads->len && !ret; i++) {
+        VMStatePostLoad *pl = &g_array_index(post_loads, VMStatePostLoad, i);
+
+        ret = pl->vmsd->post_load(pl->opaque, pl->version_id);
+        if (ret) {
+            error_report("post_load of %s failed: %d", pl->vmsd->name, ret);
+        }
+    }
+    g_array_free(post_loads, TRUE);
+    return ret;
+}
+
 static int vmfield_name_num(const VMStateField *start,
                             const VMStateField *search)
 {
@@ -129,6 +129,13 @@ void hmp_info_kvm(Monitor *mon, const QDict *qdict)
     } else {
         monitor_printf(mon, "not compiled\n");
     }
+    if (info->has_memslot_stats) {
+        monitor_printf(mon, "memslot updates: %" PRIu64
+                       " (%" PRIu64 " elided), %" PRIu64 " us\n",
+                       info->memslot_stats->updates,
+                       info->memslot_stats->elided,
+                       info->memslot_stats->time_ns / SCALE_US);
+    }
 
     qapi_free_KvmInfo(info);
 }
@@ -457,6 +464,18 @@ void hmp_info_migrate_parameters(Monitor *mon, const QDict *qdict)
         monitor_printf(mon, " %s: '%s'\n",
             MigrationParameter_str(MIGRATION_PARAMETER_TLS_AUTHZ),
             params->has_tls_authz ? params->tls_authz : "");
+        monitor_printf(mon, "%s: %u\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_FIXED_RAM_THREADS),
+            params->fixed_ram_threads);
+        monitor_printf(mon, "%s: %s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_DIRECT_IO),
+            params->direct_io ? "on" : "off");
+        monitor_printf(mon, "%s: %" PRIu64 " MB/s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_VCPU_DIRTY_LIMIT),
+            params->vcpu_dirty_limit);
+        monitor_printf(mon, "%s: %u\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_DEVICE_STATE_THREADS),
+            params->device_state_threads);
     }
 
     qapi_free_MigrationParameters(params);
@@ -468,6 +487,51 @@ void hmp_info_migrate_cache_size(Monitor *mon, const QDict *qdict)
                    qmp_query_migrate_cache_size(NULL) >> 10);
 }
 
+void hmp_info_vmstate_timing(Monitor *mon, const QDict *qdict)
+{
+    VMStateTimingInfoList *list, *info;
+
+    list = qmp_query_vmstate_timing(NULL);
+
+    monitor_printf(mon, "%-32s %8s %12s %12s %12s\n", "section", "instance",
+                   "save (us)", "size", "load (us)");
+    for (info = list; info; info = info->next) {
+        VMStateTimingInfo *t = info->value;
+
+        monitor_printf(mon, "%-32s %8" PRId64 " %12" PRId64 " %12" PRId64
+                       " %12" PRId64 "%s\n", t->name, t->instance_id,
+                       t->save_time, t->save_size, t->load_time,
+                       t->independent ? " (independent)" : "");
+    }
+
+    qapi_free_VMStateTimingInfoList(list);
+}
+
+void hmp_info_dirty_rate(Monitor *mon, const QDict *qdict)
+{
+    DirtyRateInfo *info;
+    DirtyRateVcpuList *rate;
+
+    info = qmp_query_dirty_rate(NULL);
+    if (!info) {
+        return;
+    }
+
+    monitor_printf(mon, "Status: %s\n", DirtyRateStatus_str(info->status));
+    monitor_printf(mon, "Start Time: %" PRIi64 " (s)\n", info->start_time);
+    monitor_printf(mon, "Period: %" PRIi64 " (s)\n", info->calc_time);
+    if (info->has_dirty_rate) {
+        monitor_printf(mon, "Dirty rate: %" PRIi64 " (MiB/s)\n",
+                       info->dirty_rate);
+    }
+    for (rate = info->vcpu_dirty_rate; rate; rate = rate->next) {
+        monitor_printf(mon, "vcpu[%" PRIi64 "] dirty rate: %" PRIi64
+                       " (MiB/s)\n", rate->value->id, rate->value->dirty_rate);
+    }
+
+    qapi_free_DirtyRateInfo(info);
+}
+
 static void print_block_info(Monitor *mon, BlockInfo *info,
                              BlockDeviceInfo *inserted, bool verbose)
 {
@@ -1856,6 +1920,22 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         p->has_announce_step = true;
         visit_type_size(v, param, &p->announce_step, &err);
         break;
+    case MIGRATION_PARAMETER_FIXED_RAM_THREADS:
+        p->has_fixed_ram_threads = true;
+        visit_type_int(v, param, &p->fixed_ram_threads, &err);
+        break;
+    case MIGRATION_PARAMETER_DIRECT_IO:
+        p->has_direct_io = true;
+        visit_type_bool(v, param, &p->direct_io, &err);
+        break;
+    case MIGRATION_PARAMETER_VCPU_DIRTY_LIMIT:
+        p->has_vcpu_dirty_limit = true;
+        visit_type_int(v, param, &p->vcpu_dirty_limit, &err);
+        break;
+    case MIGRATION_PARAMETER_DEVICE_STATE_THREADS:
+        p->has_device_state_threads = true;
+        visit_type_int(v, param, &p->device_state_threads, &err);
+        break;
     default:
         assert(0);
     }
@@ -1889,6 +1969,19 @@ void hmp_client_migrate_info(Monitor *mon, const QDict *qdict)
     hmp_handle_error(mon, &err);
 }
 
+void hmp_calc_dirty_rate(Monitor *mon, const QDict *qdict)
+{
+    int64_t sec = qdict_get_int(qdict, "second");
+    Error *err = NULL;
+
+    qmp_calc_dirty_rate(sec, &err);
+    if (!err) {
+        monitor_printf(mon, "Measuring dirty rate for %" PRIi64 " seconds,"
+                       " use 'info dirty_rate' to see the result\n", sec);
+    }
+    hmp_handle_error(mon, &err);
+}
+
 void hmp_migrate_start_postcopy(Monitor *mon, const QDict *qdict)
 {
     Error *err = NULL;
@@ -2592,6 +2685,13 @@ void hmp_info_iothreads(Monitor *mon, const QDict *qdict)
         monitor_printf(mon, "  poll-max-ns=%" PRId64 "\n", value->poll_max_ns);
         monitor_printf(mon, "  poll-grow=%" PRId64 "\n", value->poll_grow);
         monitor_printf(mon, "  poll-shrink=%" PRId64 "\n", value->poll_shrink);
+        monitor_printf(mon, "  poll-latency-ns=%" PRId64 "\n",
+                       value->poll_latency_ns);
+        monitor_printf(mon, "  poll-cpu-budget=%" PRId64 "\n",
+                       value->poll_cpu_budget);
+        monitor_printf(mon, "  poll-hits=%" PRIu64 " poll-misses=%" PRIu64
+                       " poll-time-ns=%" PRIu64 "\n", value->poll_hits,
+                       value->poll_misses, value->poll_time_ns);
     }
 
     qapi_free_IOThreadInfoList(info_list);
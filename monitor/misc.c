@@ -74,6 +74,9 @@
 #include "sysemu/cpus.h"
 #include "qemu/cutils.h"
 #include "tcg/tcg.h"
+#ifdef CONFIG_TCG
+#include "exec/tb-stats.h"
+#endif
 
 #if defined(TARGET_S390X)
 #include "hw/s390x/storage-keys.h"
@@ -474,6 +477,207 @@ static void hmp_info_opcount(Monitor *mon, const QDict *qdict)
 {
     dump_opcount_info();
 }
+
+void qmp_x_tb_stats(TbStatsAction action, Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB statistics are only available with accel=tcg");
+        return;
+    }
+
+    switch (action) {
+    case TB_STATS_ACTION_START:
+        tb_stats_set_enabled(true);
+        break;
+    case TB_STATS_ACTION_STOP:
+        tb_stats_set_enabled(false);
+        break;
+    case TB_STATS_ACTION_RESET:
+        tb_stats_reset();
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+/* The last report of "info tb-stats", for "info tb" */
+static GPtrArray *tb_stats_report;
+
+TbStatsInfoList *qmp_x_query_tb_stats(bool has_max, int64_t max,
+                                      bool has_sort_by, TbStatsSortBy sort_by,
+                                      Error **errp)
+{
+    TbStatsInfoList *head = NULL, **tail = &head;
+    GPtrArray *arr;
+    guint i;
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB statistics are only available with accel=tcg");
+        return NULL;
+    }
+
+    arr = tb_stats_sorted(has_sort_by ? sort_by : TB_STATS_SORT_BY_EXEC_COUNT,
+                          has_max ? max : 10);
+    for (i = 0; i < arr->len; i++) {
+        TBStatistics *s = g_ptr_array_index(arr, i);
+        TbStatsInfoList *entry = g_new0(TbStatsInfoList, 1);
+        TbStatsInfo *info = g_new0(TbStatsInfo, 1);
+
+        info->id = i;
+        info->pc = s->pc;
+        info->phys_pc = s->phys_pc;
+        info->cs_base = s->cs_base;
+        info->flags = s->flags;
+        info->exec_count = atomic_read__nocheck(&s->exec_count);
+        info->translations = atomic_read__nocheck(&s->translations);
+        info->invalidations = atomic_read__nocheck(&s->invalidations);
+        info->guest_insns = atomic_read__nocheck(&s->guest_insns);
+        info->guest_bytes = atomic_read__nocheck(&s->guest_bytes);
+        info->host_bytes = atomic_read__nocheck(&s->host_bytes);
+        info->ops = atomic_read__nocheck(&s->ops);
+        info->spills = atomic_read__nocheck(&s->spills);
+
+        entry->value = info;
+        *tail = entry;
+        tail = &entry->next;
+    }
+    g_ptr_array_free(arr, true);
+    return head;
+}
+
+static void hmp_tb_stats(Monitor *mon, const QDict *qdict)
+{
+    const char *op = qdict_get_try_str(qdict, "op");
+
+    if (!tcg_enabled()) {
+        error_report("TB statistics are only available with accel=tcg");
+        return;
+    }
+
+    if (op == NULL) {
+        monitor_printf(mon, "TB statistics are %s\n",
+                       tb_stats_collection_enabled() ? "on" : "off");
+    } else if (!strcmp(op, "on")) {
+        tb_stats_set_enabled(true);
+    } else if (!strcmp(op, "off")) {
+        tb_stats_set_enabled(false);
+    } else if (!strcmp(op, "reset")) {
+        tb_stats_reset();
+    } else {
+        monitor_printf(mon, "Invalid option '%s'\n", op);
+    }
+}
+
+static void hmp_info_tb_stats(Monitor *mon, const QDict *qdict)
+{
+    int64_t max = qdict_get_try_int(qdict, "max", 10);
+    TbStatsSortBy sort_by = TB_STATS_SORT_BY_EXEC_COUNT;
+    guint i;
+
+    if (!tcg_enabled()) {
+        error_report("TB statistics are only available with accel=tcg");
+        return;
+    }
+
+    if (qdict_get_try_bool(qdict, "translations", false)) {
+        sort_by = TB_STATS_SORT_BY_TRANSLATIONS;
+    } else if (qdict_get_try_bool(qdict, "expansion", false)) {
+        sort_by = TB_STATS_SORT_BY_EXPANSION;
+    }
+
+    if (tb_stats_report) {
+        g_ptr_array_free(tb_stats_report, true);
+    }
+    tb_stats_report = tb_stats_sorted(sort_by, max);
+
+    if (!tb_stats_collection_enabled() && tb_stats_report->len == 0) {
+        monitor_printf(mon, "TB statistics are off, enable them with "
+                       "\"tb-stats on\"\n");
+        return;
+    }
+
+    monitor_printf(mon, "%4s %-18s %-18s %8s %14s %6s %6s %6s %6s %6s\n",
+                   "id", "pc", "phys_pc", "flags", "exec", "trans", "inval",
+                   "insns", "expand", "spills");
+    for (i = 0; i < tb_stats_report->len; i++) {
+        TBStatistics *s = g_ptr_array_index(tb_stats_report, i);
+        uint64_t trans = atomic_read__nocheck(&s->translations);
+        uint64_t guest_bytes = atomic_read__nocheck(&s->guest_bytes);
+        uint64_t host_bytes = atomic_read__nocheck(&s->host_bytes);
+
+        monitor_printf(mon, "%4u 0x%016" PRIx64 " 0x%016" PRIx64
+                       " %08x %14" PRIu64 " %6" PRIu64 " %6" PRIu64
+                       " %6" PRIu64 " %6.2f %6" PRIu64 "\n",
+                       i, (uint64_t)s->pc, (uint64_t)s->phys_pc, s->flags,
+                       atomic_read__nocheck(&s->exec_count), trans,
+                       atomic_read__nocheck(&s->invalidations),
+                       trans ? atomic_read__nocheck(&s->guest_insns) / trans
+                             : 0,
+                       guest_bytes ? (double)host_bytes / guest_bytes : 0,
+                       trans ? atomic_read__nocheck(&s->spills) / trans : 0);
+    }
+}
+
+static void hmp_info_tb(Monitor *mon, const QDict *qdict)
+{
+    int64_t id = qdict_get_int(qdict, "id");
+    CPUState *cs = mon_get_cpu();
+    TranslationBlock *tb;
+    TBStatistics *s;
+    unsigned flush_count;
+
+    if (!tcg_enabled()) {
+        error_report("TB statistics are only available with accel=tcg");
+        return;
+    }
+    if (!tb_stats_report || id < 0 || id >= tb_stats_report->len) {
+        monitor_printf(mon, "No TB with id %" PRId64 " in the last "
+                       "\"info tb-stats\" report\n", id);
+        return;
+    }
+
+    s = g_ptr_array_index(tb_stats_report, id);
+    monitor_printf(mon, "TB id %" PRId64 ": pc 0x%016" PRIx64
+                   " phys_pc 0x%016" PRIx64 " flags 0x%08x\n",
+                   id, (uint64_t)s->pc, (uint64_t)s->phys_pc, s->flags);
+    monitor_printf(mon, "  executed %" PRIu64 " times, translated %" PRIu64
+                   " times, invalidated %" PRIu64 " times\n",
+                   atomic_read__nocheck(&s->exec_count),
+                   atomic_read__nocheck(&s->translations),
+                   atomic_read__nocheck(&s->invalidations));
+    monitor_printf(mon, "  %" PRIu64 " guest insns, %" PRIu64 " guest bytes, "
+                   "%" PRIu64 " TCG ops, %" PRIu64 " host bytes, "
+                   "%" PRIu64 " spills (all translations)\n",
+                   atomic_read__nocheck(&s->guest_insns),
+                   atomic_read__nocheck(&s->guest_bytes),
+                   atomic_read__nocheck(&s->ops),
+                   atomic_read__nocheck(&s->host_bytes),
+                   atomic_read__nocheck(&s->spills));
+
+    /*
+     * The code buffer is never unmapped, so a concurrent tb_flush can at
+     * worst make the disassembly stale; detect that and say so.
+     */
+    flush_count = atomic_mb_read(&tb_ctx.tb_flush_count);
+    tb = atomic_read(&s->tb);
+    if (!tb) {
+        monitor_printf(mon, "  not currently translated\n");
+        return;
+    }
+
+    monitor_printf(mon, "\nGuest code (%d insns, current CPU mappings):\n",
+                   tb->icount);
+    if (cs) {
+        monitor_disas(mon, cs, s->pc, tb->icount, 0);
+    }
+    monitor_printf(mon, "\nHost code (%zu bytes):\n", tb->tc.size);
+    disas(NULL, tb->tc.ptr, tb->tc.size);
+
+    if (atomic_mb_read(&tb_ctx.tb_flush_count) != flush_count) {
+        monitor_printf(mon, "\nThe code cache was flushed meanwhile, "
+                       "the host code above may be stale\n");
+    }
+}
 #endif
 
 static void hmp_info_sync_profile(Monitor *mon, const QDict *qdict)
@@ -70,6 +70,10 @@ KvmInfo *qmp_query_kvm(Error **errp)
 
     info->enabled = kvm_enabled();
     info->present = kvm_available();
+    if (info->enabled) {
+        info->has_memslot_stats = true;
+        info->memslot_stats = kvm_memslot_stats();
+    }
 
     return info;
 }
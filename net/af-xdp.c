@@ -0,0 +1,408 @@
+/*
+ * AF_XDP network backend
+ *
+ * Each queue of the backend binds an AF_XDP socket to one queue of a
+ * host network interface.  Frames go between the guest and the UMEM of
+ * the socket with a single copy, bypassing the host network stack.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/if_link.h>
+#include <xdp/xsk.h>
+
+#include "net/net.h"
+#include "clients.h"
+#include "qapi/error.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+
+/* Busy polling socket options, may be missing from older headers */
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+/* Frames moved per invocation of the read handler */
+#define AF_XDP_BATCH_SIZE 64
+
+typedef struct AFXDPState {
+    NetClientState      nc;
+
+    struct xsk_socket   *xsk;
+    struct xsk_ring_cons rx;
+    struct xsk_ring_prod tx;
+    struct xsk_ring_cons cq;
+    struct xsk_ring_prod fq;
+
+    char                ifname[IFNAMSIZ];
+    int                 ifindex;
+    bool                read_poll;
+    bool                write_poll;
+    bool                busy_poll;
+    uint32_t            outstanding_tx;
+
+    /* UMEM and the addresses of its frames that are not in a ring */
+    struct xsk_umem     *umem;
+    void                *buffer;
+    uint64_t            *pool;
+    uint32_t            n_pool;
+
+    uint32_t            xdp_flags;
+} AFXDPState;
+
+static void af_xdp_send(void *opaque);
+static void af_xdp_writable(void *opaque);
+
+/* Set the event-loop handlers for the af-xdp backend. */
+static void af_xdp_update_fd_handler(AFXDPState *s)
+{
+    qemu_set_fd_handler(xsk_socket__fd(s->xsk),
+                        s->read_poll ? af_xdp_send : NULL,
+                        s->write_poll ? af_xdp_writable : NULL,
+                        s);
+}
+
+static void af_xdp_read_poll(AFXDPState *s, bool enable)
+{
+    if (s->read_poll != enable) {
+        s->read_poll = enable;
+        af_xdp_update_fd_handler(s);
+    }
+}
+
+static void af_xdp_write_poll(AFXDPState *s, bool enable)
+{
+    if (s->write_poll != enable) {
+        s->write_poll = enable;
+        af_xdp_update_fd_handler(s);
+    }
+}
+
+static void af_xdp_poll(NetClientState *nc, bool enable)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+
+    if (s->read_poll != enable || s->write_poll != enable) {
+        s->write_poll = enable;
+        s->read_poll  = enable;
+        af_xdp_update_fd_handler(s);
+    }
+}
+
+/* Return the frames of completed transmissions to the pool. */
+static void af_xdp_complete_tx(AFXDPState *s)
+{
+    uint32_t idx = 0;
+    uint32_t done, i;
+
+    done = xsk_ring_cons__peek(&s->cq, XSK_RING_CONS__DEFAULT_NUM_DESCS, &idx);
+    for (i = 0; i < done; i++) {
+        s->pool[s->n_pool++] = *xsk_ring_cons__comp_addr(&s->cq, idx++);
+    }
+    if (done) {
+        xsk_ring_cons__release(&s->cq, done);
+        s->outstanding_tx -= done;
+    }
+}
+
+/*
+ * The fd_write() callback, invoked if the fd is marked as
+ * writable after a poll. Unregister the handler and flush any
+ * buffered packets.
+ */
+static void af_xdp_writable(void *opaque)
+{
+    AFXDPState *s = opaque;
+
+    af_xdp_complete_tx(s);
+    af_xdp_write_poll(s, false);
+    qemu_flush_queued_packets(&s->nc);
+}
+
+static ssize_t af_xdp_receive(NetClientState *nc,
+                              const uint8_t *buf, size_t size)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+    struct xdp_desc *desc;
+    uint32_t idx;
+
+    if (size > XSK_UMEM__DEFAULT_FRAME_SIZE) {
+        /* We can't transmit a packet this size... */
+        return size;
+    }
+
+    af_xdp_complete_tx(s);
+    if (!s->n_pool || !xsk_ring_prod__reserve(&s->tx, 1, &idx)) {
+        /* no room, wait for the kernel to complete transmissions */
+        af_xdp_write_poll(s, true);
+        return 0;
+    }
+
+    desc = xsk_ring_prod__tx_desc(&s->tx, idx);
+    desc->addr = s->pool[--s->n_pool];
+    desc->len = size;
+    memcpy(xsk_umem__get_data(s->buffer, desc->addr), buf, size);
+
+    xsk_ring_prod__submit(&s->tx, 1);
+    s->outstanding_tx++;
+
+    if (s->busy_poll || xsk_ring_prod__needs_wakeup(&s->tx)) {
+        sendto(xsk_socket__fd(s->xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+
+    return size;
+}
+
+/* Hand up to @n frames of the pool to the kernel for reception. */
+static void af_xdp_fq_refill(AFXDPState *s, uint32_t n)
+{
+    uint32_t i, idx = 0;
+
+    n = MIN(n, s->n_pool);
+    if (!n || !xsk_ring_prod__reserve(&s->fq, n, &idx)) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        *xsk_ring_prod__fill_addr(&s->fq, idx++) = s->pool[--s->n_pool];
+    }
+    xsk_ring_prod__submit(&s->fq, n);
+
+    if (s->busy_poll || xsk_ring_prod__needs_wakeup(&s->fq)) {
+        /* let the kernel process the fill queue */
+        recvfrom(xsk_socket__fd(s->xsk), NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+}
+
+static void af_xdp_send_completed(NetClientState *nc, ssize_t len)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+
+    af_xdp_read_poll(s, true);
+}
+
+static void af_xdp_send(void *opaque)
+{
+    AFXDPState *s = opaque;
+    uint32_t i, n_rx, idx = 0;
+    ssize_t ret;
+
+    n_rx = xsk_ring_cons__peek(&s->rx, AF_XDP_BATCH_SIZE, &idx);
+    if (!n_rx) {
+        af_xdp_fq_refill(s, AF_XDP_BATCH_SIZE);
+        return;
+    }
+
+    qemu_send_batch_begin(&s->nc);
+    for (i = 0; i < n_rx; i++) {
+        const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&s->rx, idx++);
+        uint64_t addr = desc->addr;
+
+        s->pool[s->n_pool++] = xsk_umem__extract_addr(addr);
+        addr = xsk_umem__add_offset_to_addr(addr);
+
+        ret = qemu_send_packet_async(&s->nc,
+                                     xsk_umem__get_data(s->buffer, addr),
+                                     desc->len, af_xdp_send_completed);
+        if (ret == 0) {
+            /*
+             * The packet was queued by the peer: stop reading until it
+             * is consumed and leave the rest of the ring for later.
+             */
+            af_xdp_read_poll(s, false);
+            xsk_ring_cons__cancel(&s->rx, n_rx - i - 1);
+            n_rx = i + 1;
+            break;
+        }
+    }
+    qemu_send_batch_end(&s->nc);
+
+    xsk_ring_cons__release(&s->rx, n_rx);
+    af_xdp_fq_refill(s, n_rx);
+}
+
+static void af_xdp_cleanup(NetClientState *nc)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+
+    qemu_purge_queued_packets(nc);
+    if (s->xsk) {
+        af_xdp_poll(nc, false);
+        xsk_socket__delete(s->xsk);
+        s->xsk = NULL;
+    }
+    g_free(s->pool);
+    s->pool = NULL;
+    xsk_umem__delete(s->umem);
+    s->umem = NULL;
+    qemu_vfree(s->buffer);
+    s->buffer = NULL;
+}
+
+static int af_xdp_umem_create(AFXDPState *s, Error **errp)
+{
+    struct xsk_umem_config config = {
+        .fill_size = XSK_RING_PROD__DEFAULT_NUM_DESCS,
+        .comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+        .frame_size = XSK_UMEM__DEFAULT_FRAME_SIZE,
+        .frame_headroom = 0,
+    };
+    uint64_t n_frames;
+    uint64_t size;
+    int ret;
+    uint64_t i;
+
+    /* enough frames for all four rings to be full */
+    n_frames = (XSK_RING_PROD__DEFAULT_NUM_DESCS +
+                XSK_RING_CONS__DEFAULT_NUM_DESCS) * 2;
+    size = n_frames * XSK_UMEM__DEFAULT_FRAME_SIZE;
+
+    s->buffer = qemu_memalign(qemu_real_host_page_size, size);
+    memset(s->buffer, 0, size);
+
+    ret = xsk_umem__create(&s->umem, s->buffer, size, &s->fq, &s->cq, &config);
+    if (ret) {
+        qemu_vfree(s->buffer);
+        s->buffer = NULL;
+        error_setg_errno(errp, -ret, "failed to create umem for %s queue %d",
+                         s->ifname, s->nc.queue_index);
+        return -1;
+    }
+
+    s->pool = g_new(uint64_t, n_frames);
+    for (i = 0; i < n_frames; i++) {
+        s->pool[i] = i * XSK_UMEM__DEFAULT_FRAME_SIZE;
+    }
+    s->n_pool = n_frames;
+    return 0;
+}
+
+static int af_xdp_socket_create(AFXDPState *s, const NetdevAFXDPOptions *opts,
+                                int queue_id, Error **errp)
+{
+    struct xsk_socket_config cfg = {
+        .rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS,
+        .tx_size = XSK_RING_PROD__DEFAULT_NUM_DESCS,
+        .bind_flags = XDP_USE_NEED_WAKEUP,
+        .xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST,
+    };
+    int ret = -EINVAL;
+    int fd;
+
+    if (!opts->has_mode || opts->mode == AFXDP_MODE_NATIVE) {
+        /* zero-copy needs native mode; fall back to copy mode without it */
+        cfg.xdp_flags |= XDP_FLAGS_DRV_MODE;
+        if (!opts->has_force_copy || !opts->force_copy) {
+            cfg.bind_flags |= XDP_ZEROCOPY;
+            ret = xsk_socket__create(&s->xsk, s->ifname, queue_id, s->umem,
+                                     &s->rx, &s->tx, &cfg);
+        }
+        if (ret) {
+            cfg.bind_flags &= ~XDP_ZEROCOPY;
+            cfg.bind_flags |= XDP_COPY;
+            ret = xsk_socket__create(&s->xsk, s->ifname, queue_id, s->umem,
+                                     &s->rx, &s->tx, &cfg);
+        }
+    }
+    if (ret && (!opts->has_mode || opts->mode == AFXDP_MODE_SKB)) {
+        /* generic XDP works with every driver */
+        cfg.xdp_flags &= ~XDP_FLAGS_DRV_MODE;
+        cfg.xdp_flags |= XDP_FLAGS_SKB_MODE;
+        cfg.bind_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        ret = xsk_socket__create(&s->xsk, s->ifname, queue_id, s->umem,
+                                 &s->rx, &s->tx, &cfg);
+    }
+    if (ret) {
+        error_setg_errno(errp, -ret, "failed to create AF_XDP socket "
+                         "for %s queue %d", s->ifname, queue_id);
+        return -1;
+    }
+    s->xdp_flags = cfg.xdp_flags;
+
+    if (opts->has_busy_poll_budget && opts->busy_poll_budget) {
+        int one = 1, timeout = 20, budget = opts->busy_poll_budget;
+
+        fd = xsk_socket__fd(s->xsk);
+        if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+                       &one, sizeof(one)) < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+                       &timeout, sizeof(timeout)) < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET,
+                       &budget, sizeof(budget)) < 0) {
+            error_setg_errno(errp, errno, "failed to enable busy polling "
+                             "for %s queue %d", s->ifname, queue_id);
+            xsk_socket__delete(s->xsk);
+            s->xsk = NULL;
+            return -1;
+        }
+        s->busy_poll = true;
+    }
+
+    snprintf(s->nc.info_str, sizeof(s->nc.info_str),
+             "af-xdp: ifname=%s queue=%d mode=%s%s", s->ifname, queue_id,
+             s->xdp_flags & XDP_FLAGS_DRV_MODE ? "native" : "skb",
+             cfg.bind_flags & XDP_ZEROCOPY ? ",zero-copy" : "");
+    return 0;
+}
+
+static NetClientInfo net_af_xdp_info = {
+    .type = NET_CLIENT_DRIVER_AF_XDP,
+    .size = sizeof(AFXDPState),
+    .receive = af_xdp_receive,
+    .poll = af_xdp_poll,
+    .cleanup = af_xdp_cleanup,
+};
+
+int net_init_af_xdp(const Netdev *netdev,
+                    const char *name, NetClientState *peer, Error **errp)
+{
+    const NetdevAFXDPOptions *opts = &netdev->u.af_xdp;
+    NetClientState *nc, *nc0 = NULL;
+    AFXDPState *s;
+    int64_t i, queues, start_queue;
+    int ifindex;
+
+    ifindex = if_nametoindex(opts->ifname);
+    if (!ifindex) {
+        error_setg_errno(errp, errno, "failed to get ifindex for '%s'",
+                         opts->ifname);
+        return -1;
+    }
+
+    queues = opts->has_queues ? opts->queues : 1;
+    start_queue = opts->has_start_queue ? opts->start_queue : 0;
+    if (queues < 1 || queues > MAX_QUEUE_NUM || start_queue < 0) {
+        error_setg(errp, "invalid queues or start-queue for af-xdp");
+        return -1;
+    }
+
+    for (i = 0; i < queues; i++) {
+        nc = qemu_new_net_client(&net_af_xdp_info, peer, "af-xdp", name);
+        nc->queue_index = i;
+        if (!nc0) {
+            nc0 = nc;
+        }
+
+        s = DO_UPCAST(AFXDPState, nc, nc);
+        pstrcpy(s->ifname, sizeof(s->ifname), opts->ifname);
+        s->ifindex = ifindex;
+
+        if (af_xdp_umem_create(s, errp) ||
+            af_xdp_socket_create(s, opts, start_queue + i, errp)) {
+            /* removes all the queues created so far */
+            qemu_del_net_client(nc0);
+            return -1;
+        }
+        af_xdp_fq_refill(s, XSK_RING_PROD__DEFAULT_NUM_DESCS);
+        af_xdp_read_poll(s, true); /* Initially only poll for reads. */
+    }
+
+    return 0;
+}
@@ -100,6 +100,15 @@ typedef struct CompareState {
     GQueue conn_list;
     /* Record the connection without repetition */
     GHashTable *connection_track_table;
+    /*
+     * Connections that got packets in the current chardev read batch,
+     * compared once the whole batch has been enqueued.
+     * Element type: Connection
+     */
+    GQueue pending_conns;
+    /* Flow cache, consecutive packets mostly belong to the same flow */
+    ConnectionKey last_key;
+    Connection *last_conn;
 
     IOThread *iothread;
     GMainContext *worker_context;
@@ -191,13 +200,24 @@ static void fill_pkt_tcp_info(void *data, uint32_t *max_ack)
  */
 static int colo_insert_packet(GQueue *queue, Packet *pkt, uint32_t *max_ack)
 {
+    Packet *tail;
+
     if (g_queue_get_length(queue) <= MAX_QUEUE_SIZE) {
         if (pkt->ip->ip_p == IPPROTO_TCP) {
             fill_pkt_tcp_info(pkt, max_ack);
-            g_queue_insert_sorted(queue,
-                                  pkt,
-                                  (GCompareDataFunc)seq_sorter,
-                                  NULL);
+            /*
+             * Segments mostly arrive in order, skip the sorted insert
+             * walk when the packet goes after the tail.
+             */
+            tail = g_queue_peek_tail(queue);
+            if (tail && seq_sorter(pkt, tail, NULL) > 0) {
+                g_queue_push_tail(queue, pkt);
+            } else {
+                g_queue_insert_sorted(queue,
+                                      pkt,
+                                      (GCompareDataFunc)seq_sorter,
+                                      NULL);
+            }
         } else {
             g_queue_push_tail(queue, pkt);
         }
@@ -210,6 +230,8 @@ static int colo_insert_packet(GQueue *queue, Packet *pkt, uint32_t *max_ack)
  * Return 0 on success, if return -1 means the pkt
  * is unsupported(arp and ipv6) and will be sent later
  */
+static void colo_compare_pending_conns(CompareState *s);
+
 static int packet_enqueue(CompareState *s, int mode, Connection **con)
 {
     ConnectionKey key;
@@ -233,9 +255,21 @@ static int packet_enqueue(CompareState *s, int mode, Connection **con)
     }
     fill_connection_key(pkt, &key);
 
-    conn = connection_get(s->connection_track_table,
-                          &key,
-                          &s->conn_list);
+    if (s->last_conn && connection_key_equal(&key, &s->last_key)) {
+        conn = s->last_conn;
+    } else {
+        if (connection_hashtable_full(s->connection_track_table) &&
+            !connection_has_tracked(s->connection_track_table, &key)) {
+            /* connection_get() will destroy all the tracked connections */
+            colo_compare_pending_conns(s);
+            s->last_conn = NULL;
+        }
+        conn = connection_get(s->connection_track_table,
+                              &key,
+                              &s->conn_list);
+        s->last_key = key;
+        s->last_conn = conn;
+    }
 
     if (!conn->processing) {
         g_queue_push_tail(&s->conn_list, conn);
@@ -278,6 +312,22 @@ static void colo_release_primary_pkt(CompareState *s, Packet *pkt)
     packet_destroy(pkt, NULL);
 }
 
+static void colo_compare_trace_ip_info(Packet *ppkt, Packet *spkt)
+{
+    if (trace_event_get_state_backends(TRACE_COLO_COMPARE_MISCOMPARE)) {
+        char pri_ip_src[20], pri_ip_dst[20], sec_ip_src[20], sec_ip_dst[20];
+
+        strcpy(pri_ip_src, inet_ntoa(ppkt->ip->ip_src));
+        strcpy(pri_ip_dst, inet_ntoa(ppkt->ip->ip_dst));
+        strcpy(sec_ip_src, inet_ntoa(spkt->ip->ip_src));
+        strcpy(sec_ip_dst, inet_ntoa(spkt->ip->ip_dst));
+
+        trace_colo_compare_ip_info(ppkt->size, pri_ip_src,
+                                   pri_ip_dst, spkt->size,
+                                   sec_ip_src, sec_ip_dst);
+    }
+}
+
 /*
  * The IP packets sent by primary and secondary
  * will be compared in here
@@ -292,20 +342,24 @@ static int colo_compare_packet_payload(Packet *ppkt,
                                        uint16_t len)
 
 {
-    if (trace_event_get_state_backends(TRACE_COLO_COMPARE_MISCOMPARE)) {
-        char pri_ip_src[20], pri_ip_dst[20], sec_ip_src[20], sec_ip_dst[20];
+    colo_compare_trace_ip_info(ppkt, spkt);
 
-        strcpy(pri_ip_src, inet_ntoa(ppkt->ip->ip_src));
-        strcpy(pri_ip_dst, inet_ntoa(ppkt->ip->ip_dst));
-        strcpy(sec_ip_src, inet_ntoa(spkt->ip->ip_src));
-        strcpy(sec_ip_dst, inet_ntoa(spkt->ip->ip_dst));
+    return memcmp(ppkt->data + poffset, spkt->data + soffset, len);
+}
 
-        trace_colo_compare_ip_info(ppkt->size, pri_ip_src,
-                                   pri_ip_dst, spkt->size,
-                                   sec_ip_src, sec_ip_dst);
-    }
+/*
+ * Like colo_compare_packet_payload() for data that runs from @offset
+ * to the end of both packets, rejects mismatches on the checksum first.
+ * return:    0  means packet same
+ *            -1 means packet different
+ */
+static int colo_compare_packet_tail(Packet *ppkt,
+                                    Packet *spkt,
+                                    uint16_t offset)
+{
+    colo_compare_trace_ip_info(ppkt, spkt);
 
-    return memcmp(ppkt->data + poffset, spkt->data + soffset, len);
+    return packet_payload_equal(ppkt, spkt, offset) ? 0 : -1;
 }
 
 /*
@@ -492,8 +546,7 @@ static int colo_packet_compare_udp(Packet *spkt, Packet *ppkt)
         trace_colo_compare_main("UDP: payload size of packets are different");
         return -1;
     }
-    if (colo_compare_packet_payload(ppkt, spkt, offset, offset,
-                                    ppkt->size - offset)) {
+    if (colo_compare_packet_tail(ppkt, spkt, offset)) {
         trace_colo_compare_udp_miscompare("primary pkt size", ppkt->size);
         trace_colo_compare_udp_miscompare("Secondary pkt size", spkt->size);
         if (trace_event_get_state_backends(TRACE_COLO_COMPARE_MISCOMPARE)) {
@@ -533,8 +586,7 @@ static int colo_packet_compare_icmp(Packet *spkt, Packet *ppkt)
         trace_colo_compare_main("ICMP: payload size of packets are different");
         return -1;
     }
-    if (colo_compare_packet_payload(ppkt, spkt, offset, offset,
-                                    ppkt->size - offset)) {
+    if (colo_compare_packet_tail(ppkt, spkt, offset)) {
         trace_colo_compare_icmp_miscompare("primary pkt size",
                                            ppkt->size);
         trace_colo_compare_icmp_miscompare("Secondary pkt size",
@@ -560,25 +612,13 @@ static int colo_packet_compare_other(Packet *spkt, Packet *ppkt)
     uint16_t offset = ppkt->vnet_hdr_len;
 
     trace_colo_compare_main("compare other");
-    if (trace_event_get_state_backends(TRACE_COLO_COMPARE_MISCOMPARE)) {
-        char pri_ip_src[20], pri_ip_dst[20], sec_ip_src[20], sec_ip_dst[20];
-
-        strcpy(pri_ip_src, inet_ntoa(ppkt->ip->ip_src));
-        strcpy(pri_ip_dst, inet_ntoa(ppkt->ip->ip_dst));
-        strcpy(sec_ip_src, inet_ntoa(spkt->ip->ip_src));
-        strcpy(sec_ip_dst, inet_ntoa(spkt->ip->ip_dst));
-
-        trace_colo_compare_ip_info(ppkt->size, pri_ip_src,
-                                   pri_ip_dst, spkt->size,
-                                   sec_ip_src, sec_ip_dst);
-    }
+    colo_compare_trace_ip_info(ppkt, spkt);
 
     if (ppkt->size != spkt->size) {
         trace_colo_compare_main("Other: payload size of packets are different");
         return -1;
     }
-    return colo_compare_packet_payload(ppkt, spkt, offset, offset,
-                                       ppkt->size - offset);
+    return colo_compare_packet_tail(ppkt, spkt, offset);
 }
 
 static int colo_old_packet_check_one(Packet *pkt, int64_t *check_time)
@@ -698,6 +738,35 @@ static void colo_compare_connection(void *opaque, void *user_data)
     }
 }
 
+/*
+ * Queue @conn to be compared at the end of the current batch, so that
+ * a chardev read carrying several packets of one connection walks its
+ * queues only once.
+ */
+static void colo_compare_mark_pending(CompareState *s, Connection *conn)
+{
+    if (!conn->compare_pending) {
+        conn->compare_pending = true;
+        g_queue_push_tail(&s->pending_conns, conn);
+    }
+}
+
+static void colo_compare_pending_conns(CompareState *s)
+{
+    Connection *conn;
+
+    if (g_queue_is_empty(&s->pending_conns)) {
+        return;
+    }
+
+    trace_colo_compare_batch(g_queue_get_length(&s->pending_conns));
+    while (!g_queue_is_empty(&s->pending_conns)) {
+        conn = g_queue_pop_head(&s->pending_conns);
+        conn->compare_pending = false;
+        colo_compare_connection(conn, s);
+    }
+}
+
 static int compare_chr_send(CompareState *s,
                             const uint8_t *buf,
                             uint32_t size,
@@ -774,6 +843,7 @@ static void compare_pri_chr_in(void *opaque, const uint8_t *buf, int size)
     int ret;
 
     ret = net_fill_rstate(&s->pri_rs, buf, size);
+    colo_compare_pending_conns(s);
     if (ret == -1) {
         qemu_chr_fe_set_handlers(&s->chr_pri_in, NULL, NULL, NULL, NULL,
                                  NULL, NULL, true);
@@ -791,6 +861,7 @@ static void compare_sec_chr_in(void *opaque, const uint8_t *buf, int size)
     int ret;
 
     ret = net_fill_rstate(&s->sec_rs, buf, size);
+    colo_compare_pending_conns(s);
     if (ret == -1) {
         qemu_chr_fe_set_handlers(&s->chr_sec_in, NULL, NULL, NULL, NULL,
                                  NULL, NULL, true);
@@ -998,7 +1069,7 @@ static void compare_pri_rs_finalize(SocketReadState *pri_rs)
                          false);
     } else {
         /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
+        colo_compare_mark_pending(s, conn);
     }
 }
 
@@ -1011,7 +1082,7 @@ static void compare_sec_rs_finalize(SocketReadState *sec_rs)
         trace_colo_compare_main("secondary: unsupported packet in");
     } else {
         /* compare packet in the specified connection */
-        colo_compare_connection(conn, s);
+        colo_compare_mark_pending(s, conn);
     }
 }
 
@@ -1122,6 +1193,7 @@ static void colo_compare_complete(UserCreatable *uc, Error **errp)
     QTAILQ_INSERT_TAIL(&net_compares, s, next);
 
     g_queue_init(&s->conn_list);
+    g_queue_init(&s->pending_conns);
 
     qemu_mutex_init(&event_mtx);
     qemu_cond_init(&event_complete_cond);
@@ -1219,6 +1291,7 @@ static void colo_compare_finalize(Object *obj)
     g_queue_foreach(&s->conn_list, colo_flush_packets, s);
 
     g_queue_clear(&s->conn_list);
+    g_queue_clear(&s->pending_conns);
 
     if (s->connection_track_table) {
         g_hash_table_destroy(s->connection_track_table);
@@ -13,6 +13,8 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/bitops.h"
 #include "trace.h"
 #include "colo.h"
 #include "util.h"
@@ -137,6 +139,7 @@ Connection *connection_new(ConnectionKey *key)
 
     conn->ip_proto = key->ip_proto;
     conn->processing = false;
+    conn->compare_pending = false;
     conn->offset = 0;
     conn->tcp_state = TCPS_CLOSED;
     conn->pack = 0;
@@ -160,9 +163,26 @@ void connection_destroy(void *opaque)
 
 Packet *packet_new(const void *data, int size, int vnet_hdr_len)
 {
-    Packet *pkt = g_slice_new(Packet);
+    Packet *pkt = packet_new_borrowed((void *)data, size, vnet_hdr_len);
 
     pkt->data = g_memdup(data, size);
+    pkt->borrowed = false;
+    return pkt;
+}
+
+/*
+ * Create a packet that refers to the caller's @data instead of copying
+ * it.  The data must stay valid until the packet is destroyed, and the
+ * packet must go through packet_make_writable() before it is modified.
+ */
+Packet *packet_new_borrowed(void *data, int size, int vnet_hdr_len)
+{
+    Packet *pkt = g_slice_new(Packet);
+
+    pkt->data = data;
+    pkt->network_header = NULL;
+    pkt->transport_header = NULL;
+    pkt->borrowed = true;
     pkt->size = size;
     pkt->creation_ms = qemu_clock_get_ms(QEMU_CLOCK_HOST);
     pkt->vnet_hdr_len = vnet_hdr_len;
@@ -173,15 +193,41 @@ Packet *packet_new(const void *data, int size, int vnet_hdr_len)
     pkt->payload_size = 0;
     pkt->offset = 0;
     pkt->flags = 0;
+    pkt->csum_valid = false;
+    pkt->csum_offset = 0;
+    pkt->csum = 0;
 
     return pkt;
 }
 
+/* Give @pkt its own copy of borrowed data, keeping the parsed headers */
+void packet_make_writable(Packet *pkt)
+{
+    uint8_t *old = pkt->data;
+
+    if (!pkt->borrowed) {
+        return;
+    }
+
+    pkt->data = g_memdup(old, pkt->size);
+    pkt->borrowed = false;
+    if (pkt->network_header) {
+        pkt->network_header = (uint8_t *)pkt->data +
+                              (pkt->network_header - old);
+    }
+    if (pkt->transport_header) {
+        pkt->transport_header = (uint8_t *)pkt->data +
+                                (pkt->transport_header - old);
+    }
+}
+
 void packet_destroy(void *opaque, void *user_data)
 {
     Packet *pkt = opaque;
 
-    g_free(pkt->data);
+    if (!pkt->borrowed) {
+        g_free(pkt->data);
+    }
     g_slice_free(Packet, pkt);
 }
 
@@ -193,6 +239,15 @@ void connection_hashtable_reset(GHashTable *connection_track_table)
     g_hash_table_remove_all(connection_track_table);
 }
 
+/*
+ * Return true if the next connection_get() for an untracked key
+ * will reset the hashtable and destroy every tracked connection.
+ */
+bool connection_hashtable_full(GHashTable *connection_track_table)
+{
+    return g_hash_table_size(connection_track_table) > HASHTABLE_MAX_SIZE;
+}
+
 /* if not found, create a new connection and add to hash table */
 Connection *connection_get(GHashTable *connection_track_table,
                            ConnectionKey *key,
@@ -230,3 +285,68 @@ bool connection_has_tracked(GHashTable *connection_track_table,
 
     return conn ? true : false;
 }
+
+/*
+ * Fletcher-style checksum on 64-bit words, cheap enough to run
+ * at memory bandwidth and order sensitive unlike a plain sum.
+ */
+static uint64_t packet_csum(const uint8_t *buf, size_t len)
+{
+    uint64_t a = 0, b = 0, w;
+
+    while (len >= 8) {
+        a += ldq_he_p(buf);
+        b += a;
+        buf += 8;
+        len -= 8;
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, buf, len);
+        a += w;
+        b += a;
+    }
+
+    return a ^ ror64(b, 32);
+}
+
+/*
+ * Return the checksum of the packet data from @offset to the end
+ * of the packet, computing it on first use.
+ */
+uint64_t packet_payload_csum(Packet *pkt, uint16_t offset)
+{
+    if (!pkt->csum_valid || pkt->csum_offset != offset) {
+        pkt->csum = packet_csum((uint8_t *)pkt->data + offset,
+                                pkt->size - offset);
+        pkt->csum_offset = offset;
+        pkt->csum_valid = true;
+    }
+
+    return pkt->csum;
+}
+
+/*
+ * Compare the data of two packets from @offset to the end of the packet.
+ *
+ * The checksums are cached in the packets, so when one packet is matched
+ * against a queue of candidates each of them is read at most once, and
+ * only a candidate with the same checksum goes through memcmp().
+ */
+bool packet_payload_equal(Packet *ppkt, Packet *spkt, uint16_t offset)
+{
+    if (ppkt->size != spkt->size) {
+        return false;
+    }
+    if (offset >= ppkt->size) {
+        return true;
+    }
+    if (packet_payload_csum(ppkt, offset) !=
+        packet_payload_csum(spkt, offset)) {
+        return false;
+    }
+
+    return !memcmp((uint8_t *)ppkt->data + offset,
+                   (uint8_t *)spkt->data + offset,
+                   ppkt->size - offset);
+}
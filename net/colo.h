@@ -54,6 +54,12 @@ typedef struct Packet {
     /* record the payload offset(the length that has been compared) */
     uint16_t offset;
     uint8_t flags; /* Flags(aka Control bits) */
+    /* cached payload checksum, see packet_payload_equal() */
+    bool csum_valid;
+    uint16_t csum_offset;
+    uint64_t csum;
+    /* data belongs to the caller, see packet_new_borrowed() */
+    bool borrowed;
 } Packet;
 
 typedef struct ConnectionKey {
@@ -72,6 +78,8 @@ typedef struct Connection {
     GQueue secondary_list;
     /* flag to enqueue unprocessed_connections */
     bool processing;
+    /* flag to enqueue the connections compared at the end of a batch */
+    bool compare_pending;
     uint8_t ip_proto;
     /* record the sequence number that has been compared */
     uint32_t compare_seq;
@@ -100,7 +108,12 @@ Connection *connection_get(GHashTable *connection_track_table,
 bool connection_has_tracked(GHashTable *connection_track_table,
                             ConnectionKey *key);
 void connection_hashtable_reset(GHashTable *connection_track_table);
+bool connection_hashtable_full(GHashTable *connection_track_table);
 Packet *packet_new(const void *data, int size, int vnet_hdr_len);
+Packet *packet_new_borrowed(void *data, int size, int vnet_hdr_len);
+void packet_make_writable(Packet *pkt);
 void packet_destroy(void *opaque, void *user_data);
+uint64_t packet_payload_csum(Packet *pkt, uint16_t offset);
+bool packet_payload_equal(Packet *ppkt, Packet *spkt, uint16_t offset);
 
 #endif /* NET_COLO_H */
@@ -79,10 +79,14 @@ static int filter_send(MirrorState *s,
         }
     }
 
-    buf = g_malloc(size);
-    iov_to_buf(iov, iovcnt, 0, buf, size);
-    ret = qemu_chr_fe_write_all(&s->chr_out, (uint8_t *)buf, size);
-    g_free(buf);
+    if (iovcnt == 1) {
+        ret = qemu_chr_fe_write_all(&s->chr_out, iov[0].iov_base, size);
+    } else {
+        buf = g_malloc(size);
+        iov_to_buf(iov, iovcnt, 0, buf, size);
+        ret = qemu_chr_fe_write_all(&s->chr_out, (uint8_t *)buf, size);
+        g_free(buf);
+    }
     if (ret != size) {
         goto err;
     }
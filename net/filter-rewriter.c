@@ -109,6 +109,8 @@ static int handle_primary_tcp_pkt(RewriterState *rf,
         }
         if (conn->offset) {
             /* handle packets to the secondary from the primary */
+            packet_make_writable(pkt);
+            tcp_pkt = (struct tcp_hdr *)pkt->transport_header;
             tcp_pkt->th_ack = htonl(ntohl(tcp_pkt->th_ack) + conn->offset);
 
             net_checksum_calculate((uint8_t *)pkt->data + pkt->vnet_hdr_len,
@@ -208,6 +210,8 @@ static int handle_secondary_tcp_pkt(RewriterState *rf,
         /* Only need to adjust seq while offset is Non-zero */
         if (conn->offset) {
             /* handle packets to the primary from the secondary*/
+            packet_make_writable(pkt);
+            tcp_pkt = (struct tcp_hdr *)pkt->transport_header;
             tcp_pkt->th_seq = htonl(ntohl(tcp_pkt->th_seq) - conn->offset);
 
             net_checksum_calculate((uint8_t *)pkt->data + pkt->vnet_hdr_len,
@@ -257,16 +261,24 @@ static ssize_t colo_rewriter_receive_iov(NetFilterState *nf,
     Packet *pkt;
     ssize_t size = iov_size(iov, iovcnt);
     ssize_t vnet_hdr_len = 0;
-    char *buf = g_malloc0(size);
-
-    iov_to_buf(iov, iovcnt, 0, buf, size);
 
     if (s->vnet_hdr) {
         vnet_hdr_len = nf->netdev->vnet_hdr_len;
     }
 
-    pkt = packet_new(buf, size, vnet_hdr_len);
-    g_free(buf);
+    /*
+     * Most packets are only looked at, so parse them in place; the
+     * packet is copied only when a TCP header has to be rewritten.
+     */
+    if (iovcnt == 1) {
+        pkt = packet_new_borrowed(iov[0].iov_base, size, vnet_hdr_len);
+    } else {
+        char *buf = g_malloc(size);
+
+        iov_to_buf(iov, iovcnt, 0, buf, size);
+        pkt = packet_new_borrowed(buf, size, vnet_hdr_len);
+        pkt->borrowed = false; /* the packet frees buf */
+    }
 
     /*
      * if we get tcp packet
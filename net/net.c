@@ -230,6 +230,7 @@ static ssize_t qemu_deliver_packet_iov(NetClientState *sender,
                                        const struct iovec *iov,
                                        int iovcnt,
                                        void *opaque);
+static void qemu_deliver_batch_end(void *opaque);
 
 static void qemu_net_client_setup(NetClientState *nc,
                                   NetClientInfo *info,
@@ -254,6 +255,10 @@ static void qemu_net_client_setup(NetClientState *nc,
     QTAILQ_INSERT_TAIL(&net_clients, nc, next);
 
     nc->incoming_queue = qemu_new_net_queue(qemu_deliver_packet_iov, nc);
+    if (info->receive_batch_end) {
+        qemu_net_queue_set_batch_end(nc->incoming_queue,
+                                     qemu_deliver_batch_end);
+    }
     nc->destructor = destructor;
     QTAILQ_INIT(&nc->filters);
 }
@@ -619,6 +624,31 @@ void qemu_flush_queued_packets(NetClientState *nc)
     qemu_flush_or_purge_queued_packets(nc, false);
 }
 
+/*
+ * Packets sent by @nc between qemu_send_batch_begin() and
+ * qemu_send_batch_end() form one burst for the peer, which is told when
+ * the burst ends through NetClientInfo::receive_batch_end.
+ */
+void qemu_send_batch_begin(NetClientState *nc)
+{
+    if (nc->peer) {
+        qemu_net_queue_batch_begin(nc->peer->incoming_queue);
+    }
+}
+
+void qemu_send_batch_end(NetClientState *nc)
+{
+    if (nc->peer) {
+        qemu_net_queue_batch_end(nc->peer->incoming_queue);
+    }
+}
+
+/* Whether @nc is receiving a burst whose end will be signalled */
+bool qemu_receive_batching(NetClientState *nc)
+{
+    return qemu_net_queue_batching(nc->incoming_queue);
+}
+
 static ssize_t qemu_send_packet_async_with_flags(NetClientState *sender,
                                                  unsigned flags,
                                                  const uint8_t *buf, int size,
@@ -735,6 +765,13 @@ static ssize_t qemu_deliver_packet_iov(NetClientState *sender,
     return ret;
 }
 
+static void qemu_deliver_batch_end(void *opaque)
+{
+    NetClientState *nc = opaque;
+
+    nc->info->receive_batch_end(nc);
+}
+
 ssize_t qemu_sendv_packet_async(NetClientState *sender,
                                 const struct iovec *iov, int iovcnt,
                                 NetPacketSent *sent_cb)
@@ -952,6 +989,9 @@ static int (* const net_client_init_fun[NET_CLIENT_DRIVER__MAX])(
 #ifdef CONFIG_NETMAP
         [NET_CLIENT_DRIVER_NETMAP]    = net_init_netmap,
 #endif
+#ifdef CONFIG_AF_XDP
+        [NET_CLIENT_DRIVER_AF_XDP]    = net_init_af_xdp,
+#endif
 #ifdef CONFIG_NET_BRIDGE
         [NET_CLIENT_DRIVER_BRIDGE]    = net_init_bridge,
 #endif
@@ -1085,6 +1125,9 @@ static void show_netdevs(void)
 #ifdef CONFIG_NETMAP
         "netmap",
 #endif
+#ifdef CONFIG_AF_XDP
+        "af-xdp",
+#endif
 #ifdef CONFIG_POSIX
         "vhost-user",
 #endif
@@ -24,6 +24,7 @@
 #include "qemu/osdep.h"
 #include "net/queue.h"
 #include "qemu/queue.h"
+#include "qemu/iov.h"
 #include "net/net.h"
 
 /* The delivery handler may only return zero if it will call
@@ -38,6 +39,19 @@
  *
  * If a sent callback isn't provided, we just drop the packet to avoid
  * unbounded queueing.
+ *
+ * A sender that has several packets at hand can bracket them with
+ * qemu_net_queue_batch_begin() and qemu_net_queue_batch_end().  The
+ * batch end handler is then invoked once after the outermost batch if
+ * any packet was delivered in it, so that the receiver can defer work
+ * such as interrupting the guest until the whole burst is in.
+ *
+ * Packet data is copied once, when a packet is first queued.  While a
+ * queue delivers a packet, the data stays valid after the delivery
+ * handler returns, so a filter or queue further down the chain that
+ * needs to hold on to the same data takes a reference instead of making
+ * another copy.  Delivery handlers get a const iovec and must not
+ * modify it; a filter that rewrites a packet works on its own copy.
  */
 
 struct NetPacket {
@@ -46,18 +60,85 @@ struct NetPacket {
     unsigned flags;
     int size;
     NetPacketSent *sent_cb;
+    NetPacket *owner;       /* packet whose data[] this one refers to */
+    int refcnt;             /* references to data[], if owner == self */
     uint8_t data[0];
 };
 
+/* The packet whose data is being delivered by a queue of this thread */
+static __thread NetPacket *net_packet_in_flight;
+
+static uint8_t *net_packet_data(NetPacket *packet)
+{
+    return packet->owner->data;
+}
+
+static NetPacket *net_packet_new(NetClientState *sender, unsigned flags,
+                                 size_t size, NetPacketSent *sent_cb)
+{
+    NetPacket *packet = g_malloc(sizeof(NetPacket) + size);
+
+    packet->sender = sender;
+    packet->flags = flags;
+    packet->size = size;
+    packet->sent_cb = sent_cb;
+    packet->owner = packet;
+    packet->refcnt = 1;
+    return packet;
+}
+
+/*
+ * If @iov is exactly the data of the packet in flight, return a new
+ * packet that shares it, otherwise NULL.
+ */
+static NetPacket *net_packet_new_shared(NetClientState *sender,
+                                        unsigned flags,
+                                        const struct iovec *iov,
+                                        int iovcnt,
+                                        NetPacketSent *sent_cb)
+{
+    NetPacket *owner = net_packet_in_flight;
+    NetPacket *packet;
+
+    if (!owner || iovcnt != 1 || iov[0].iov_base != owner->data ||
+        iov[0].iov_len != owner->size) {
+        return NULL;
+    }
+
+    packet = g_new(NetPacket, 1);
+    packet->sender = sender;
+    packet->flags = flags;
+    packet->size = owner->size;
+    packet->sent_cb = sent_cb;
+    packet->owner = owner;
+    owner->refcnt++;
+    return packet;
+}
+
+static void net_packet_free(NetPacket *packet)
+{
+    NetPacket *owner = packet->owner;
+
+    if (packet != owner) {
+        g_free(packet);
+    }
+    if (--owner->refcnt == 0) {
+        g_free(owner);
+    }
+}
+
 struct NetQueue {
     void *opaque;
     uint32_t nq_maxlen;
     uint32_t nq_count;
     NetQueueDeliverFunc *deliver;
+    NetQueueBatchEndFunc *batch_end;
 
     QTAILQ_HEAD(, NetPacket) packets;
 
     unsigned delivering : 1;
+    unsigned batch_delivered : 1;
+    unsigned batch_depth;
 };
 
 NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
@@ -78,13 +159,19 @@ NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
     return queue;
 }
 
+void qemu_net_queue_set_batch_end(NetQueue *queue,
+                                  NetQueueBatchEndFunc *batch_end)
+{
+    queue->batch_end = batch_end;
+}
+
 void qemu_del_net_queue(NetQueue *queue)
 {
     NetPacket *packet, *next;
 
     QTAILQ_FOREACH_SAFE(packet, &queue->packets, entry, next) {
         QTAILQ_REMOVE(&queue->packets, packet, entry);
-        g_free(packet);
+        net_packet_free(packet);
     }
 
     g_free(queue);
@@ -99,15 +186,19 @@ static void qemu_net_queue_append(NetQueue *queue,
 {
     NetPacket *packet;
 
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size
+    };
+
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
         return; /* drop if queue full and no callback */
     }
-    packet = g_malloc(sizeof(NetPacket) + size);
-    packet->sender = sender;
-    packet->flags = flags;
-    packet->size = size;
-    packet->sent_cb = sent_cb;
-    memcpy(packet->data, buf, size);
+    packet = net_packet_new_shared(sender, flags, &iov, 1, sent_cb);
+    if (!packet) {
+        packet = net_packet_new(sender, flags, size, sent_cb);
+        memcpy(packet->data, buf, size);
+    }
 
     queue->nq_count++;
     QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
@@ -121,27 +212,16 @@ void qemu_net_queue_append_iov(NetQueue *queue,
                                NetPacketSent *sent_cb)
 {
     NetPacket *packet;
-    size_t max_len = 0;
-    int i;
 
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
         return; /* drop if queue full and no callback */
     }
-    for (i = 0; i < iovcnt; i++) {
-        max_len += iov[i].iov_len;
-    }
+    packet = net_packet_new_shared(sender, flags, iov, iovcnt, sent_cb);
+    if (!packet) {
+        size_t size = iov_size(iov, iovcnt);
 
-    packet = g_malloc(sizeof(NetPacket) + max_len);
-    packet->sender = sender;
-    packet->sent_cb = sent_cb;
-    packet->flags = flags;
-    packet->size = 0;
-
-    for (i = 0; i < iovcnt; i++) {
-        size_t len = iov[i].iov_len;
-
-        memcpy(packet->data + packet->size, iov[i].iov_base, len);
-        packet->size += len;
+        packet = net_packet_new(sender, flags, size, sent_cb);
+        iov_to_buf(iov, iovcnt, 0, packet->data, size);
     }
 
     queue->nq_count++;
@@ -163,6 +243,7 @@ static ssize_t qemu_net_queue_deliver(NetQueue *queue,
     queue->delivering = 1;
     ret = queue->deliver(sender, flags, &iov, 1, queue->opaque);
     queue->delivering = 0;
+    queue->batch_delivered |= ret > 0 && queue->batch_depth;
 
     return ret;
 }
@@ -178,6 +259,7 @@ static ssize_t qemu_net_queue_deliver_iov(NetQueue *queue,
     queue->delivering = 1;
     ret = queue->deliver(sender, flags, iov, iovcnt, queue->opaque);
     queue->delivering = 0;
+    queue->batch_delivered |= ret > 0 && queue->batch_depth;
 
     return ret;
 }
@@ -243,26 +325,51 @@ void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
             if (packet->sent_cb) {
                 packet->sent_cb(packet->sender, 0);
             }
-            g_free(packet);
+            net_packet_free(packet);
         }
     }
 }
 
-bool qemu_net_queue_flush(NetQueue *queue)
+void qemu_net_queue_batch_begin(NetQueue *queue)
+{
+    queue->batch_depth++;
+}
+
+void qemu_net_queue_batch_end(NetQueue *queue)
+{
+    assert(queue->batch_depth > 0);
+    if (--queue->batch_depth || !queue->batch_delivered) {
+        return;
+    }
+    queue->batch_delivered = 0;
+    if (queue->batch_end) {
+        queue->batch_end(queue->opaque);
+    }
+}
+
+bool qemu_net_queue_batching(NetQueue *queue)
+{
+    return queue->batch_depth > 0;
+}
+
+static bool qemu_net_queue_flush_batch(NetQueue *queue)
 {
     while (!QTAILQ_EMPTY(&queue->packets)) {
-        NetPacket *packet;
+        NetPacket *packet, *in_flight;
         int ret;
 
         packet = QTAILQ_FIRST(&queue->packets);
         QTAILQ_REMOVE(&queue->packets, packet, entry);
         queue->nq_count--;
 
+        in_flight = net_packet_in_flight;
+        net_packet_in_flight = packet->owner;
         ret = qemu_net_queue_deliver(queue,
                                      packet->sender,
                                      packet->flags,
-                                     packet->data,
+                                     net_packet_data(packet),
                                      packet->size);
+        net_packet_in_flight = in_flight;
         if (ret == 0) {
             queue->nq_count++;
             QTAILQ_INSERT_HEAD(&queue->packets, packet, entry);
@@ -273,7 +380,17 @@ bool qemu_net_queue_flush(NetQueue *queue)
             packet->sent_cb(packet->sender, ret);
         }
 
-        g_free(packet);
+        net_packet_free(packet);
     }
     return true;
 }
+
+bool qemu_net_queue_flush(NetQueue *queue)
+{
+    bool ret;
+
+    qemu_net_queue_batch_begin(queue);
+    ret = qemu_net_queue_flush_batch(queue);
+    qemu_net_queue_batch_end(queue);
+    return ret;
+}
@@ -187,6 +187,8 @@ static void tap_send(void *opaque)
     int size;
     int packets = 0;
 
+    /* let the peer handle everything read in this wakeup as one burst */
+    qemu_send_batch_begin(&s->nc);
     while (true) {
         uint8_t *buf = s->buf;
 
@@ -219,6 +221,7 @@ static void tap_send(void *opaque)
             break;
         }
     }
+    qemu_send_batch_end(&s->nc);
 }
 
 static bool tap_has_ufo(NetClientState *nc)
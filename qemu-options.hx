@@ -2210,6 +2210,12 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "                VALE port (created on the fly) called 'name' ('nmname' is name of the \n"
     "                netmap device, defaults to '/dev/netmap')\n"
 #endif
+#ifdef CONFIG_AF_XDP
+    "-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off]\n"
+    "         [,queues=n][,start-queue=m][,busy-poll-budget=b]\n"
+    "                attach to queues 'm' to 'm+n-1' of the host network interface\n"
+    "                'name' with AF_XDP sockets, bypassing the host network stack\n"
+#endif
 #ifdef CONFIG_POSIX
     "-netdev vhost-user,id=str,chardev=dev[,vhostforce=on|off]\n"
     "                configure a vhost-user network, backed by a chardev 'dev'\n"
@@ -2230,6 +2236,9 @@ DEF("nic", HAS_ARG, QEMU_OPTION_nic,
 #ifdef CONFIG_NETMAP
     "netmap|"
 #endif
+#ifdef CONFIG_AF_XDP
+    "af-xdp|"
+#endif
 #ifdef CONFIG_POSIX
     "vhost-user|"
 #endif
@@ -2671,6 +2680,30 @@ qemu -m 512 -object memory-backend-file,id=mem,size=512M,mem-path=/hugetlbfs,sha
      -device virtio-net-pci,netdev=net0
 @end example
 
+@item -netdev af-xdp,id=@var{id},ifname=@var{name}[,mode=native|skb][,force-copy=on|off][,queues=@var{n}][,start-queue=@var{m}][,busy-poll-budget=@var{b}]
+
+Exchange packets with the host network interface @var{name} through AF_XDP
+sockets, without going through the host network stack. Each of the @var{n}
+queues (default 1) of the netdev binds to one queue of the interface, starting
+at queue @var{m} (default 0); use a multiqueue NIC such as virtio-net with
+@option{mq=on} to spread the traffic over them. The host interface should
+steer the traffic for the guest to these queues, for example with ethtool
+ntuple filters.
+
+The XDP program is attached in native @option{mode} when the driver supports
+it, and zero-copy is used if possible unless @option{force-copy=on}; otherwise
+the netdev falls back to copy mode, or to generic (@option{skb}) mode.
+With @option{busy-poll-budget=@var{b}} the kernel busy-polls the interface
+queues, handling up to @var{b} packets at a time.
+
+Example (using one end of a veth pair):
+@example
+ip link add veth0 type veth peer name veth1
+@value{qemu_system} linux.img \
+     -netdev af-xdp,id=net0,ifname=veth0,mode=native \
+     -device virtio-net-pci,netdev=net0
+@end example
+
 @item -netdev hubport,id=@var{id},hubid=@var{hubid}[,netdev=@var{nd}]
 
 Create a hub port on the emulated hub with ID @var{hubid}.
@@ -3947,6 +3980,8 @@ DEF("incoming", HAS_ARG, QEMU_OPTION_incoming, \
     "-incoming exec:cmdline\n" \
     "                accept incoming migration on given file descriptor\n" \
     "                or from given external command\n" \
+    "-incoming file:filename\n" \
+    "                accept incoming migration from given file\n" \
     "-incoming defer\n" \
     "                wait for the URI to be specified via migrate_incoming\n",
     QEMU_ARCH_ALL)
@@ -3965,6 +4000,11 @@ Accept incoming migration from a given filedescriptor.
 @item -incoming exec:@var{cmdline}
 Accept incoming migration as an output from specified external command.
 
+@item -incoming file:@var{filename}
+Accept incoming migration from a file previously written with the
+@code{file:} migration URI.  The file must have been written with the
+same setting of the @code{fixed-ram} migration capability.
+
 @item -incoming defer
 Wait for the URI to be specified via migrate_incoming.  The monitor can
 be used to change settings (such as migration parameters) prior to issuing
@@ -15,6 +15,7 @@
 #include "replay-internal.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
+#include "hw/core/cpu.h"
 
 /* Mutex to protect reading and writing events to the log.
    data_kind and has_unread_data are also protected
@@ -23,6 +24,11 @@
    written or read to the log. */
 static QemuMutex lock;
 
+/* Signalled when the vCPU turn may have changed hands; the number of
+   vCPU threads waiting for a turn is protected by the replay mutex. */
+static QemuCond vcpu_cond;
+static int vcpu_waiters;
+
 /* File for replay writing */
 static bool write_error;
 FILE *replay_file;
@@ -190,6 +196,9 @@ void replay_finish_event(void)
 {
     replay_state.has_unread_data = 0;
     replay_fetch_data_kind();
+    if (vcpu_waiters) {
+        qemu_cond_broadcast(&vcpu_cond);
+    }
 }
 
 static __thread bool replay_locked;
@@ -197,6 +206,7 @@ static __thread bool replay_locked;
 void replay_mutex_init(void)
 {
     qemu_mutex_init(&lock);
+    qemu_cond_init(&vcpu_cond);
     /* Hold the mutex while we start-up */
     qemu_mutex_lock(&lock);
     replay_locked = true;
@@ -227,6 +237,65 @@ void replay_mutex_unlock(void)
     }
 }
 
+static bool replay_vcpu_may_run(CPUState *cpu)
+{
+    if (replay_mode == REPLAY_MODE_PLAY) {
+        if (replay_next_event_is(EVENT_VCPU)) {
+            replay_state.vcpu_owner = replay_get_dword();
+            replay_finish_event();
+        }
+        return replay_state.vcpu_owner == cpu->cpu_index;
+    }
+
+    /* Let the other vCPUs in before taking two turns in a row.  */
+    return replay_state.vcpu_owner != cpu->cpu_index || vcpu_waiters == 1;
+}
+
+bool replay_vcpu_turn_begin(CPUState *cpu)
+{
+    replay_mutex_lock();
+    vcpu_waiters++;
+    while (!replay_vcpu_may_run(cpu)) {
+        if (cpu->stop || atomic_read(&cpu->queued_work_first) ||
+            atomic_read(&cpu->exit_request)) {
+            vcpu_waiters--;
+            replay_mutex_unlock();
+            return false;
+        }
+        replay_locked = false;
+        qemu_cond_wait(&vcpu_cond, &lock);
+        replay_locked = true;
+    }
+    vcpu_waiters--;
+    return true;
+}
+
+void replay_vcpu_turn_claim(CPUState *cpu)
+{
+    g_assert(replay_mutex_locked());
+    if (replay_mode == REPLAY_MODE_RECORD &&
+        replay_state.vcpu_owner != cpu->cpu_index) {
+        replay_save_instructions();
+        replay_put_event(EVENT_VCPU);
+        replay_put_dword(cpu->cpu_index);
+        replay_state.vcpu_owner = cpu->cpu_index;
+    }
+}
+
+void replay_vcpu_turn_end(void)
+{
+    if (vcpu_waiters) {
+        qemu_cond_broadcast(&vcpu_cond);
+    }
+    replay_mutex_unlock();
+}
+
+void replay_vcpu_kick(void)
+{
+    g_assert(replay_mutex_locked());
+    qemu_cond_broadcast(&vcpu_cond);
+}
+
 void replay_advance_current_icount(uint64_t current_icount)
 {
     int diff = (int)(current_icount - replay_state.current_icount);
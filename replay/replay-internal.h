@@ -34,6 +34,8 @@ enum ReplayEvents {
     EVENT_AUDIO_OUT,
     /* for audio in event */
     EVENT_AUDIO_IN,
+    /* for vCPU turns in multi-threaded TCG */
+    EVENT_VCPU,
     /* for clock read/writes */
     /* some of greater codes are reserved for clocks */
     EVENT_CLOCK,
@@ -86,6 +88,9 @@ typedef struct ReplayState {
     uint64_t read_event_id;
     /*! Asynchronous event checkpoint id read from the log */
     int32_t read_event_checkpoint;
+    /*! Index of the vCPU that executes guest code in multi-threaded TCG,
+        or -1 before the first turn. */
+    int32_t vcpu_owner;
 } ReplayState;
 extern ReplayState replay_state;
 
@@ -40,6 +40,7 @@ static int replay_post_load(void *opaque, int version_id)
            Therefore reset all the counters. */
         state->instruction_count = 0;
         state->block_request_id = 0;
+        state->vcpu_owner = -1;
     }
 
     return 0;
@@ -47,7 +48,7 @@ static int replay_post_load(void *opaque, int version_id)
 
 static const VMStateDescription vmstate_replay = {
     .name = "replay",
-    .version_id = 2,
+    .version_id = 3,
     .minimum_version_id = 2,
     .pre_save = replay_pre_save,
     .post_load = replay_post_load,
@@ -62,6 +63,7 @@ static const VMStateDescription vmstate_replay = {
         VMSTATE_INT32(read_event_kind, ReplayState),
         VMSTATE_UINT64(read_event_id, ReplayState),
         VMSTATE_INT32(read_event_checkpoint, ReplayState),
+        VMSTATE_INT32_V(vcpu_owner, ReplayState, 3),
         VMSTATE_END_OF_LIST()
     },
 };
@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+#
+# Sample the device IOTLB statistics of vhost devices behind a vIOMMU
+#
+# Start QEMU with an intel-iommu and a vhost-net device that goes through
+# it, and a QMP socket, for example:
+#
+#   qemu-system-x86_64 -machine q35,kernel-irqchip=split -enable-kvm \
+#       -device intel-iommu,intremap=on,device-iotlb=on,caching-mode=on \
+#       -netdev tap,id=hn0,vhost=on \
+#       -device virtio-net-pci,netdev=hn0,iommu_platform=on,ats=on \
+#       -qmp unix:/tmp/qmp.sock,server,nowait ...
+#
+# then drive traffic through the device (e.g. netperf TCP_RR or a
+# streaming test between the guest and the host) while this script runs.
+# It prints, for each interval, the rate of IOTLB misses seen by vhost,
+# how many of them were answered without a new update because an earlier
+# message of the same batch already covered them, and how many pages
+# were sent ahead of time.
+#
+# This work is licensed under the terms of the GNU GPL, version 2 or later.
+# See the COPYING file in the top-level directory.
+#
+
+from __future__ import print_function
+import os
+import sys
+import time
+import argparse
+
+sys.path.append(os.path.join(os.path.dirname(__file__), '..', 'python'))
+from qemu import qmp
+
+
+FIELDS = ['misses', 'covered', 'batches', 'updates', 'prefetched',
+          'invalidations']
+
+
+def query(mon):
+    stats = {}
+    for s in mon.command('x-query-vhost-iotlb'):
+        stats[(s['device'], s['vq-index'])] = s
+    return stats
+
+
+def report(old, new, interval):
+    for key in sorted(new):
+        if key not in old:
+            continue
+        d = dict((f, new[key][f] - old[key][f]) for f in FIELDS)
+        print('%s vq %d:' % key)
+        print('  misses/s %10.1f  covered %5.1f%%  updates/miss %5.2f'
+              '  prefetched/update %5.2f  invalidations/s %10.1f' %
+              (d['misses'] / interval,
+               100.0 * d['covered'] / max(d['misses'], 1),
+               float(d['updates']) / max(d['misses'], 1),
+               float(d['prefetched']) / max(d['updates'], 1),
+               d['invalidations'] / interval))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Sample vhost device IOTLB statistics')
+    parser.add_argument('socket', help='QMP socket path or host:port')
+    parser.add_argument('-i', '--interval', type=float, default=1.0,
+                        help='sampling interval in seconds')
+    parser.add_argument('-n', '--count', type=int, default=10,
+                        help='number of intervals')
+    args = parser.parse_args()
+
+    address = args.socket
+    if ':' in address:
+        host, port = address.rsplit(':', 1)
+        address = (host, int(port))
+
+    mon = qmp.QEMUMonitorProtocol(address)
+    mon.connect()
+
+    old = query(mon)
+    if not old:
+        print('no vhost device translates addresses through a vIOMMU',
+              file=sys.stderr)
+        return 1
+
+    for _ in range(args.count):
+        time.sleep(args.interval)
+        new = query(mon)
+        report(old, new, args.interval)
+        old = new
+
+    mon.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -35,6 +35,9 @@
    close to the modifying instruction */
 #define TARGET_HAS_PRECISE_SMC
 
+/* hot blocks are retranslated following direct jumps, see CF_SUPERBLOCK */
+#define TARGET_HAS_SUPERBLOCKS
+
 #ifdef TARGET_X86_64
 #define I386_ELF_MACHINE  EM_X86_64
 #define ELF_MACHINE_UNAME "x86_64"
@@ -115,6 +115,7 @@ typedef struct DisasContext {
     int iopl;
     int tf;     /* TF cpu flag */
     int jmp_opt; /* use direct block chaining for direct jumps */
+    int goto_tb_used; /* mask of the goto_tb slots already emitted */
     int repz_opt; /* optimize jumps within repz instructions */
     int mem_index; /* select memory access functions */
     uint64_t flags; /* all execution flags */
@@ -2225,8 +2226,10 @@ static inline void gen_goto_tb(DisasContext *s, int tb_num, target_ulong eip)
 {
     target_ulong pc = s->cs_base + eip;
 
-    if (use_goto_tb(s, pc))  {
+    /* A superblock may have used the slot already for a side exit.  */
+    if (use_goto_tb(s, pc) && !(s->goto_tb_used & (1 << tb_num))) {
         /* jump to same page: we can use a direct jump */
+        s->goto_tb_used |= 1 << tb_num;
         tcg_gen_goto_tb(tb_num);
         gen_jmp_im(s, eip);
         tcg_gen_exit_tb(s->base.tb, tb_num);
@@ -2243,7 +2246,16 @@ static inline void gen_jcc(DisasContext *s, int b,
 {
     TCGLabel *l1, *l2;
 
-    if (s->jmp_opt) {
+    if (s->jmp_opt
+        && translator_follow_jump(&s->base, s->pc, s->cs_base + next_eip)) {
+        /* In a superblock, leave through a side exit if the branch is
+           taken and keep translating the fall-through path.  */
+        l1 = gen_new_label();
+        gen_jcc1(s, b ^ 1, l1);
+        gen_goto_tb(s, s->goto_tb_used & 1, val);
+        gen_set_label(l1);
+        s->base.is_jmp = DISAS_NEXT;
+    } else if (s->jmp_opt) {
         l1 = gen_new_label();
         gen_jcc1(s, b, l1);
 
@@ -2573,9 +2585,12 @@ static void gen_bnd_jmp(DisasContext *s)
 /* Generate an end of block. Trace exception is also generated if needed.
    If INHIBIT, set HF_INHIBIT_IRQ_MASK if it isn't already set.
    If RECHECK_TF, emit a rechecking helper for #DB, ignoring the state of
-   S->TF.  This is used by the syscall/sysret insns.  */
+   S->TF.  This is used by the syscall/sysret insns.
+   If JR, look up the next TB; DEST is its eip, or NULL if the jump may
+   change the TB flags.  */
 static void
-do_gen_eob_worker(DisasContext *s, bool inhibit, bool recheck_tf, bool jr)
+do_gen_eob_worker(DisasContext *s, bool inhibit, bool recheck_tf, bool jr,
+                  TCGv dest)
 {
     gen_update_cc_op(s);
 
@@ -2596,6 +2611,13 @@ do_gen_eob_worker(DisasContext *s, bool inhibit, bool recheck_tf, bool jr)
         tcg_gen_exit_tb(NULL, 0);
     } else if (s->tf) {
         gen_helper_single_step(cpu_env);
+    } else if (jr && dest
+               && !(s->base.tb->flags & (HF_INHIBIT_IRQ_MASK | HF_RF_MASK))) {
+        /* The flags are unchanged, the target can be predicted.  */
+        if (s->cs_base) {
+            tcg_gen_addi_tl(dest, dest, s->cs_base);
+        }
+        translator_lookup_and_goto_ptr(&s->base, dest);
     } else if (jr) {
         tcg_gen_lookup_and_goto_ptr();
     } else {
@@ -2607,7 +2629,7 @@ do_gen_eob_worker(DisasContext *s, bool inhibit, bool recheck_tf, bool jr)
 static inline void
 gen_eob_worker(DisasContext *s, bool inhibit, bool recheck_tf)
 {
-    do_gen_eob_worker(s, inhibit, recheck_tf, false);
+    do_gen_eob_worker(s, inhibit, recheck_tf, false, NULL);
 }
 
 /* End of block.
@@ -2623,10 +2645,10 @@ static void gen_eob(DisasContext *s)
     gen_eob_worker(s, false, false);
 }
 
-/* Jump to register */
+/* Jump to register.  DEST is the new eip for near jumps, NULL otherwise.  */
 static void gen_jr(DisasContext *s, TCGv dest)
 {
-    do_gen_eob_worker(s, false, false, true);
+    do_gen_eob_worker(s, false, false, true, dest);
 }
 
 /* generate a jump to eip. No segment change must happen before as a
@@ -2648,6 +2670,18 @@ static void gen_jmp(DisasContext *s, target_ulong eip)
     gen_jmp_tb(s, eip, 0);
 }
 
+/* Direct jump from a branch instruction: in a superblock, continue
+   translating at the destination.  */
+static void gen_jmp_direct(DisasContext *s, target_ulong eip)
+{
+    if (s->jmp_opt
+        && translator_follow_jump(&s->base, s->pc, s->cs_base + eip)) {
+        s->pc = s->cs_base + eip;
+    } else {
+        gen_jmp(s, eip);
+    }
+}
+
 static inline void gen_ldq_env_A0(DisasContext *s, int offset)
 {
     tcg_gen_qemu_ld_i64(s->tmp1_i64, s->A0, s->mem_index, MO_LEQ);
@@ -5083,8 +5117,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
                                       tcg_const_i32(dflag - 1),
                                       tcg_const_i32(s->pc - s->cs_base));
             }
-            tcg_gen_ld_tl(s->tmp4, cpu_env, offsetof(CPUX86State, eip));
-            gen_jr(s, s->tmp4);
+            gen_jr(s, NULL);
             break;
         case 4: /* jmp Ev */
             if (dflag == MO_16) {
@@ -5107,8 +5140,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
                 gen_op_movl_seg_T0_vm(s, R_CS);
                 gen_op_jmp_v(s->T1);
             }
-            tcg_gen_ld_tl(s->tmp4, cpu_env, offsetof(CPUX86State, eip));
-            gen_jr(s, s->tmp4);
+            gen_jr(s, NULL);
             break;
         case 6: /* push Ev */
             gen_push_v(s, s->T0);
@@ -6585,7 +6617,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
             tcg_gen_movi_tl(s->T0, next_eip);
             gen_push_v(s, s->T0);
             gen_bnd_jmp(s);
-            gen_jmp(s, tval);
+            gen_jmp_direct(s, tval);
         }
         break;
     case 0x9a: /* lcall im */
@@ -6615,7 +6647,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
             tval &= 0xffffffff;
         }
         gen_bnd_jmp(s);
-        gen_jmp(s, tval);
+        gen_jmp_direct(s, tval);
         break;
     case 0xea: /* ljmp im */
         {
@@ -6637,7 +6669,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
         if (dflag == MO_16) {
             tval &= 0xffff;
         }
-        gen_jmp(s, tval);
+        gen_jmp_direct(s, tval);
         break;
     case 0x70 ... 0x7f: /* jcc Jb */
         tval = (int8_t)insn_get(env, s, MO_8);
@@ -8489,6 +8521,7 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
     dc->flags = flags;
     dc->jmp_opt = !(dc->tf || dc->base.singlestep_enabled ||
                     (flags & HF_INHIBIT_IRQ_MASK));
+    dc->goto_tb_used = 0;
     /* Do not optimize repz jumps at all in icount mode, because
        rep movsS instructions are execured with different paths
        in !repz_opt and repz_opt modes. The first one was used
@@ -1114,6 +1114,7 @@ void tcg_func_start(TCGContext *s)
     memset(s->free_temps, 0, sizeof(s->free_temps));
 
     s->nb_ops = 0;
+    s->nb_spills = 0;
     s->nb_labels = 0;
     s->current_frame_offset = s->frame_start;
 
@@ -3146,6 +3147,9 @@ static void tcg_reg_free(TCGContext *s, TCGReg reg, TCGRegSet allocated_regs)
 {
     TCGTemp *ts = s->reg_to_temp[reg];
     if (ts != NULL) {
+        if (!ts->fixed_reg && !ts->mem_coherent) {
+            s->nb_spills++;
+        }
         temp_sync(s, ts, allocated_regs, 0, -1);
     }
 }
@@ -3924,6 +3928,8 @@ void tcg_profile_snapshot(TCGProfile *prof, bool counters, bool table)
             PROF_ADD(prof, orig, opt_time);
             PROF_ADD(prof, orig, restore_count);
             PROF_ADD(prof, orig, restore_time);
+            PROF_ADD(prof, orig, ibtc_hits);
+            PROF_ADD(prof, orig, ibtc_misses);
         }
         if (table) {
             int i;
@@ -4262,6 +4268,11 @@ void tcg_dump_info(void)
                 s->restore_count);
     qemu_printf("  avg cycles        %0.1f\n",
                 s->restore_count ? (double)s->restore_time / s->restore_count : 0);
+    qemu_printf("indirect jumps      %" PRId64 " (inline hits %0.1f%%)\n",
+                s->ibtc_hits + s->ibtc_misses,
+                s->ibtc_hits + s->ibtc_misses
+                ? (double)s->ibtc_hits / (s->ibtc_hits + s->ibtc_misses) * 100.0
+                : 0);
 }
 #else
 void tcg_dump_info(void)
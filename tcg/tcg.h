@@ -573,6 +573,8 @@ typedef struct TCGProfile {
     int64_t opt_time;
     int64_t restore_count;
     int64_t restore_time;
+    int64_t ibtc_hits;
+    int64_t ibtc_misses;
     int64_t table_op_count[NB_OPS];
 } TCGProfile;
 
@@ -584,6 +586,7 @@ struct TCGContext {
     int nb_temps;
     int nb_indirects;
     int nb_ops;
+    int nb_spills;      /* registers spilled by the allocator, for TB stats */
 
     /* goto_tb support */
     tcg_insn_unit *code_buf;
@@ -1390,7 +1393,8 @@ GEN_ATOMIC_HELPER_ALL(xchg)
  *
  * The cmpxchg functions are only defined if HAVE_CMPXCHG128;
  * the ld/st functions are only defined if HAVE_ATOMIC128,
- * as defined by <qemu/atomic128.h>.
+ * as defined by <qemu/atomic128.h>.  For user-only, the ld functions
+ * still raise EXCP_ATOMIC on read-only pages unless HAVE_ATOMIC128_RO.
  */
 Int128 helper_atomic_cmpxchgo_le_mmu(CPUArchState *env, target_ulong addr,
                                      Int128 cmpv, Int128 newv,
@@ -0,0 +1,326 @@
+/*
+ * Replay a pcap capture through the COLO packet comparison helpers
+ *
+ * Every ethernet frame of the capture is enqueued twice, once as the
+ * primary and once as the secondary copy, into the connection it belongs
+ * to.  Connections are compared in batches, the way colo-compare does
+ * for the packets carried by one chardev read.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/timer.h"
+#include "../net/colo.h"
+
+#define PCAP_MAGIC              0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET  1
+#define PCAP_FILE_HDR_LEN       24
+#define PCAP_REC_HDR_LEN        16
+
+typedef struct Frame {
+    const uint8_t *data;
+    int size;
+} Frame;
+
+static const char *pcap_file;
+static unsigned int n_repeat = 10;
+static unsigned int batch_size = 32;
+static double mismatch_rate; /* 0.0 to 1.0 */
+static bool reverse_secondary;
+static bool plain_memcmp;
+
+static gchar *pcap_buf;
+static GArray *frames;
+
+static GHashTable *connection_track_table;
+static GQueue conn_list;
+static GQueue pending_conns;
+
+static size_t n_skipped;
+static size_t n_same;
+static size_t n_diff;
+
+static const char commands_string[] =
+    " -f = pcap file to replay (ethernet link type)\n"
+    " -n = number of times the capture is replayed\n"
+    " -b = number of frames compared per batch\n"
+    " -m = rate of secondary frames modified (0.0 to 100.0)\n"
+    " -r = enqueue the secondary frames of a batch in reverse order\n"
+    " -M = compare with plain memcmp() instead of checksums first\n";
+
+static void usage_complete(int argc, char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+static uint32_t pcap_ld32(const uint8_t *p, bool swap)
+{
+    uint32_t val = ldl_he_p(p);
+
+    return swap ? bswap32(val) : val;
+}
+
+static void pcap_load(void)
+{
+    GError *err = NULL;
+    const uint8_t *p, *end;
+    gsize len;
+    uint32_t magic;
+    bool swap;
+
+    if (!g_file_get_contents(pcap_file, &pcap_buf, &len, &err)) {
+        fprintf(stderr, "%s\n", err->message);
+        exit(1);
+    }
+    if (len < PCAP_FILE_HDR_LEN) {
+        fprintf(stderr, "%s: truncated pcap header\n", pcap_file);
+        exit(1);
+    }
+
+    p = (const uint8_t *)pcap_buf;
+    end = p + len;
+    magic = ldl_he_p(p);
+    if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NSEC) {
+        swap = false;
+    } else if (magic == bswap32(PCAP_MAGIC) ||
+               magic == bswap32(PCAP_MAGIC_NSEC)) {
+        swap = true;
+    } else {
+        fprintf(stderr, "%s: not a pcap file\n", pcap_file);
+        exit(1);
+    }
+    if (pcap_ld32(p + 20, swap) != PCAP_LINKTYPE_ETHERNET) {
+        fprintf(stderr, "%s: link type is not ethernet\n", pcap_file);
+        exit(1);
+    }
+    p += PCAP_FILE_HDR_LEN;
+
+    frames = g_array_new(false, false, sizeof(Frame));
+    while (end - p >= PCAP_REC_HDR_LEN) {
+        Frame frame;
+        uint32_t caplen = pcap_ld32(p + 8, swap);
+
+        p += PCAP_REC_HDR_LEN;
+        if (caplen > end - p) {
+            break;
+        }
+        frame.data = p;
+        frame.size = caplen;
+        g_array_append_val(frames, frame);
+        p += caplen;
+    }
+    if (!frames->len) {
+        fprintf(stderr, "%s: no frames\n", pcap_file);
+        exit(1);
+    }
+}
+
+static uint16_t payload_offset(Packet *pkt)
+{
+    return pkt->network_header - (uint8_t *)pkt->data + (pkt->ip->ip_hl << 2);
+}
+
+static gint compare_memcmp(gconstpointer a, gconstpointer b)
+{
+    Packet *spkt = (Packet *)a;
+    Packet *ppkt = (Packet *)b;
+    uint16_t offset = payload_offset(ppkt);
+
+    if (ppkt->size != spkt->size) {
+        return -1;
+    }
+    return memcmp((uint8_t *)ppkt->data + offset,
+                  (uint8_t *)spkt->data + offset, ppkt->size - offset);
+}
+
+static gint compare_csum(gconstpointer a, gconstpointer b)
+{
+    Packet *spkt = (Packet *)a;
+    Packet *ppkt = (Packet *)b;
+
+    return packet_payload_equal(ppkt, spkt, payload_offset(ppkt)) ? 0 : -1;
+}
+
+static void connection_flush(Connection *conn)
+{
+    g_queue_foreach(&conn->primary_list, packet_destroy, NULL);
+    g_queue_clear(&conn->primary_list);
+    g_queue_foreach(&conn->secondary_list, packet_destroy, NULL);
+    g_queue_clear(&conn->secondary_list);
+}
+
+static void compare_connection(Connection *conn)
+{
+    GCompareFunc func = plain_memcmp ? compare_memcmp : compare_csum;
+    Packet *ppkt;
+    GList *result;
+
+    while (!g_queue_is_empty(&conn->primary_list) &&
+           !g_queue_is_empty(&conn->secondary_list)) {
+        ppkt = g_queue_pop_head(&conn->primary_list);
+        result = g_queue_find_custom(&conn->secondary_list, ppkt, func);
+        packet_destroy(ppkt, NULL);
+        if (result) {
+            packet_destroy(result->data, NULL);
+            g_queue_delete_link(&conn->secondary_list, result);
+            n_same++;
+        } else {
+            /* colo-compare would checkpoint, which drops both queues */
+            connection_flush(conn);
+            n_diff++;
+        }
+    }
+}
+
+static void compare_pending_conns(void)
+{
+    Connection *conn;
+
+    while (!g_queue_is_empty(&pending_conns)) {
+        conn = g_queue_pop_head(&pending_conns);
+        conn->compare_pending = false;
+        compare_connection(conn);
+    }
+}
+
+static void enqueue_frame(const Frame *frame, bool primary)
+{
+    ConnectionKey key;
+    Connection *conn;
+    Packet *pkt;
+
+    pkt = packet_new(frame->data, frame->size, 0);
+    if (parse_packet_early(pkt)) {
+        packet_destroy(pkt, NULL);
+        n_skipped += primary;
+        return;
+    }
+    if (!primary && mismatch_rate &&
+        g_random_double() < mismatch_rate) {
+        ((uint8_t *)pkt->data)[pkt->size - 1] ^= 0xff;
+    }
+
+    fill_connection_key(pkt, &key);
+    if (connection_hashtable_full(connection_track_table) &&
+        !connection_has_tracked(connection_track_table, &key)) {
+        compare_pending_conns();
+    }
+    conn = connection_get(connection_track_table, &key, &conn_list);
+    if (!conn->processing) {
+        g_queue_push_tail(&conn_list, conn);
+        conn->processing = true;
+    }
+    if (!conn->compare_pending) {
+        g_queue_push_tail(&pending_conns, conn);
+        conn->compare_pending = true;
+    }
+
+    g_queue_push_tail(primary ? &conn->primary_list : &conn->secondary_list,
+                      pkt);
+}
+
+static void replay_batch(guint start, guint end)
+{
+    guint i;
+
+    for (i = start; i < end; i++) {
+        enqueue_frame(&g_array_index(frames, Frame, i), true);
+    }
+    for (i = start; i < end; i++) {
+        guint idx = reverse_secondary ? end - 1 - (i - start) : i;
+
+        enqueue_frame(&g_array_index(frames, Frame, idx), false);
+    }
+    compare_pending_conns();
+}
+
+static void run_test(void)
+{
+    int64_t start_ns, end_ns;
+    size_t n_frames = 0;
+    unsigned int r;
+    guint i, end;
+
+    connection_track_table = g_hash_table_new_full(connection_key_hash,
+                                                   connection_key_equal,
+                                                   g_free,
+                                                   connection_destroy);
+    g_queue_init(&conn_list);
+    g_queue_init(&pending_conns);
+
+    start_ns = get_clock();
+    for (r = 0; r < n_repeat; r++) {
+        for (i = 0; i < frames->len; i += batch_size) {
+            end = MIN(i + batch_size, frames->len);
+            replay_batch(i, end);
+            n_frames += end - i;
+        }
+    }
+    end_ns = get_clock();
+
+    printf("frames:     %zu (%u in capture, %zu not compared)\n",
+           n_frames, frames->len, n_skipped);
+    printf("same:       %zu\n", n_same);
+    printf("different:  %zu\n", n_diff);
+    printf("throughput: %.2f Mpps\n",
+           (double)n_frames * 1e3 / MAX(end_ns - start_ns, 1));
+
+    g_hash_table_destroy(connection_track_table);
+    g_queue_clear(&conn_list);
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "b:f:hm:Mn:r");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'b':
+            batch_size = MAX(atoi(optarg), 1);
+            break;
+        case 'f':
+            pcap_file = optarg;
+            break;
+        case 'h':
+            usage_complete(argc, argv);
+            exit(0);
+        case 'm':
+            mismatch_rate = atof(optarg) / 100.0;
+            if (mismatch_rate > 1.0) {
+                mismatch_rate = 1.0;
+            }
+            break;
+        case 'M':
+            plain_memcmp = true;
+            break;
+        case 'n':
+            n_repeat = atoi(optarg);
+            break;
+        case 'r':
+            reverse_secondary = true;
+            break;
+        }
+    }
+    if (!pcap_file) {
+        usage_complete(argc, argv);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+    pcap_load();
+    run_test();
+    g_array_free(frames, true);
+    g_free(pcap_buf);
+    return 0;
+}
@@ -14,6 +14,7 @@
 
 #include "libqtest.h"
 #include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
 #include "qapi/qmp/qjson.h"
 #include "qemu/module.h"
 #include "qemu/option.h"
@@ -437,6 +438,19 @@ static void migrate_set_parameter_int(QTestState *who, const char *parameter,
     migrate_check_parameter_int(who, parameter, value);
 }
 
+static void migrate_set_parameter_bool(QTestState *who, const char *parameter,
+                                       bool value)
+{
+    QDict *rsp;
+
+    rsp = qtest_qmp(who,
+                    "{ 'execute': 'migrate-set-parameters',"
+                    "'arguments': { %s: %i } }",
+                    parameter, value);
+    g_assert(qdict_haskey(rsp, "return"));
+    qobject_unref(rsp);
+}
+
 static void migrate_pause(QTestState *who)
 {
     QDict *rsp;
@@ -457,6 +471,17 @@ static void migrate_recover(QTestState *who, const char *uri)
     qobject_unref(rsp);
 }
 
+static void migrate_incoming_qmp(QTestState *who, const char *uri)
+{
+    QDict *rsp;
+
+    rsp = wait_command(who,
+                       "{ 'execute': 'migrate-incoming', "
+                       "  'arguments': { 'uri': %s } }",
+                       uri);
+    qobject_unref(rsp);
+}
+
 static void migrate_set_capability(QTestState *who, const char *capability,
                                    bool value)
 {
@@ -947,6 +972,135 @@ static void test_ignore_shared(void)
 }
 #endif
 
+static void do_test_precopy_file_fixed_ram(bool direct_io)
+{
+    char *uri = g_strdup_printf("file:%s/migfile", tmpfs);
+    QTestState *from, *to;
+
+    if (test_migrate_start(&from, &to, "defer", false, false)) {
+        return;
+    }
+
+    migrate_set_capability(from, "fixed-ram", true);
+    migrate_set_capability(to, "fixed-ram", true);
+    migrate_set_parameter_int(from, "fixed-ram-threads", 4);
+    migrate_set_parameter_int(to, "fixed-ram-threads", 4);
+    if (direct_io) {
+        migrate_set_parameter_bool(from, "direct-io", true);
+        migrate_set_parameter_bool(to, "direct-io", true);
+    }
+
+    /* 1 ms should make it not converge */
+    migrate_set_parameter_int(from, "downtime-limit", 1);
+    /* 1GB/s */
+    migrate_set_parameter_int(from, "max-bandwidth", 1000000000);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    migrate(from, uri, "{}");
+
+    wait_for_migration_pass(from);
+
+    /* 300 ms should converge */
+    migrate_set_parameter_int(from, "downtime-limit", 300);
+
+    if (!got_stop) {
+        qtest_qmp_eventwait(from, "STOP");
+    }
+    wait_for_migration_complete(from);
+
+    /* Only now that the file is complete can the destination load it */
+    migrate_incoming_qmp(to, uri);
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+
+    test_migrate_end(from, to, true);
+    cleanup("migfile");
+    g_free(uri);
+}
+
+static void test_precopy_file_fixed_ram(void)
+{
+    do_test_precopy_file_fixed_ram(false);
+}
+
+#ifdef O_DIRECT
+static void test_precopy_file_fixed_ram_direct_io(void)
+{
+    char *path = g_strdup_printf("%s/migfile", tmpfs);
+    int fd = open(path, O_CREAT | O_WRONLY | O_DIRECT, 0600);
+
+    g_free(path);
+    if (fd < 0) {
+        g_test_skip("O_DIRECT is not supported by the test directory");
+        return;
+    }
+    close(fd);
+    cleanup("migfile");
+
+    do_test_precopy_file_fixed_ram(true);
+}
+#endif
+
+static void check_vmstate_timing(QTestState *who)
+{
+    QDict *rsp;
+    QList *list;
+
+    rsp = qtest_qmp(who, "{ 'execute': 'query-vmstate-timing' }");
+    g_assert(qdict_haskey(rsp, "return"));
+    list = qdict_get_qlist(rsp, "return");
+    g_assert(!qlist_empty(list));
+    qobject_unref(rsp);
+}
+
+static void test_precopy_unix_parallel_device_state(void)
+{
+    char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    QTestState *from, *to;
+
+    if (test_migrate_start(&from, &to, uri, false, false)) {
+        return;
+    }
+
+    migrate_set_capability(from, "parallel-device-state", true);
+    migrate_set_parameter_int(from, "device-state-threads", 2);
+    migrate_set_parameter_int(to, "device-state-threads", 2);
+
+    /* 1 ms should make it not converge */
+    migrate_set_parameter_int(from, "downtime-limit", 1);
+    /* 1GB/s */
+    migrate_set_parameter_int(from, "max-bandwidth", 1000000000);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    migrate(from, uri, "{}");
+
+    wait_for_migration_pass(from);
+
+    /* 300 ms should converge */
+    migrate_set_parameter_int(from, "downtime-limit", 300);
+
+    if (!got_stop) {
+        qtest_qmp_eventwait(from, "STOP");
+    }
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    check_vmstate_timing(from);
+    check_vmstate_timing(to);
+
+    test_migrate_end(from, to, true);
+    g_free(uri);
+}
+
 static void test_xbzrle(const char *uri)
 {
     QTestState *from, *to;
@@ -990,6 +1144,131 @@ static void test_xbzrle(const char *uri)
     test_migrate_end(from, to, true);
 }
 
+/* Run calc-dirty-rate for one second and wait for its result */
+static void measure_dirty_rate(QTestState *who)
+{
+    QDict *rsp_return;
+    const char *status;
+    bool measured;
+
+    rsp_return = wait_command(who, "{ 'execute': 'calc-dirty-rate',"
+                              "  'arguments': { 'calc-time': 1 } }");
+    qobject_unref(rsp_return);
+
+    do {
+        rsp_return = wait_command(who, "{ 'execute': 'query-dirty-rate' }");
+        status = qdict_get_str(rsp_return, "status");
+        g_assert(!strcmp(status, "measuring") || !strcmp(status, "measured"));
+        measured = !strcmp(status, "measured");
+        if (measured) {
+            g_assert_cmpint(qdict_get_int(rsp_return, "calc-time"), ==, 1);
+            g_assert_cmpint(qdict_get_int(rsp_return, "dirty-rate"), >, 0);
+        }
+        qobject_unref(rsp_return);
+        if (!measured) {
+            usleep(1000 * 100);
+        }
+    } while (!measured);
+}
+
+static void test_dirty_rate(void)
+{
+    QTestState *from, *to;
+
+    if (test_migrate_start(&from, &to, "defer", false, false)) {
+        return;
+    }
+
+    /* The guest dirties its memory as soon as it prints */
+    wait_for_serial("src_serial");
+    measure_dirty_rate(from);
+
+    test_migrate_end(from, to, false);
+}
+
+static void test_dirty_limit(void)
+{
+    char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    QTestState *from, *to;
+    QDict *rsp, *rsp_return;
+    int64_t pct = 0;
+    bool kvm;
+
+    if (test_migrate_start(&from, &to, uri, false, false)) {
+        return;
+    }
+
+    /* Only TCG accounts dirty pages to the vCPU that wrote them */
+    rsp = wait_command(from, "{ 'execute': 'query-kvm' }");
+    kvm = qdict_get_bool(rsp, "enabled");
+    qobject_unref(rsp);
+    if (kvm) {
+        rsp = qtest_qmp(from, "{ 'execute': 'migrate-set-capabilities',"
+                        "'arguments': { 'capabilities': [ {"
+                        "'capability': 'dirty-limit', 'state': true } ] } }");
+        g_assert(qdict_haskey(rsp, "error"));
+        qobject_unref(rsp);
+        test_migrate_end(from, to, false);
+        g_free(uri);
+        return;
+    }
+
+    /* Both throttle the vCPUs, they cannot be enabled together */
+    migrate_set_capability(from, "auto-converge", true);
+    rsp = qtest_qmp(from, "{ 'execute': 'migrate-set-capabilities',"
+                    "'arguments': { 'capabilities': [ {"
+                    "'capability': 'dirty-limit', 'state': true } ] } }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+    migrate_set_capability(from, "auto-converge", false);
+
+    migrate_set_capability(from, "dirty-limit", true);
+    /* The guest dirties far more than 1 MiB/s, every vCPU gets throttled */
+    migrate_set_parameter_int(from, "vcpu-dirty-limit", 1);
+    migrate_set_parameter_int(from, "cpu-throttle-initial", 20);
+    migrate_set_parameter_int(from, "cpu-throttle-increment", 10);
+    migrate_set_parameter_int(from, "max-cpu-throttle", 50);
+
+    /* 1 ms should make it not converge */
+    migrate_set_parameter_int(from, "downtime-limit", 1);
+    /* 3MB/s is less than the guest dirty rate, so it does not converge */
+    migrate_set_parameter_int(from, "max-bandwidth", 3000000);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    /* Lets migration throttle the vCPUs from its first iteration */
+    measure_dirty_rate(from);
+
+    migrate(from, uri, "{}");
+
+    /* The throttle starts at cpu-throttle-initial and stays under the max */
+    while (!pct) {
+        usleep(1000 * 100);
+        g_assert(!got_stop);
+        rsp_return = migrate_query(from);
+        pct = qdict_get_try_int(rsp_return, "cpu-throttle-percentage", 0);
+        qobject_unref(rsp_return);
+    }
+    g_assert_cmpint(pct, >=, 20);
+    g_assert_cmpint(pct, <=, 50);
+
+    /* Now let it converge */
+    migrate_set_parameter_int(from, "downtime-limit", 300);
+    migrate_set_parameter_int(from, "max-bandwidth", 1000000000);
+
+    if (!got_stop) {
+        qtest_qmp_eventwait(from, "STOP");
+    }
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    test_migrate_end(from, to, true);
+    g_free(uri);
+}
+
 static void test_xbzrle_unix(void)
 {
     char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
@@ -1179,7 +1458,17 @@ int main(int argc, char **argv)
     qtest_add_func("/migration/precopy/tcp", test_precopy_tcp);
     /* qtest_add_func("/migration/ignore_shared", test_ignore_shared); */
     qtest_add_func("/migration/xbzrle/unix", test_xbzrle_unix);
+    qtest_add_func("/migration/precopy/file/fixed-ram",
+                   test_precopy_file_fixed_ram);
+#ifdef O_DIRECT
+    qtest_add_func("/migration/precopy/file/fixed-ram/direct-io",
+                   test_precopy_file_fixed_ram_direct_io);
+#endif
     qtest_add_func("/migration/fd_proto", test_migrate_fd_proto);
+    qtest_add_func("/migration/dirty_rate", test_dirty_rate);
+    qtest_add_func("/migration/dirty_limit", test_dirty_limit);
+    qtest_add_func("/migration/precopy/unix/parallel-device-state",
+                   test_precopy_unix_parallel_device_state);
 
     ret = g_test_run();
 
@@ -0,0 +1,237 @@
+/*
+ * Throughput of concurrent MMIO reads with and without the BQL
+ *
+ * Each thread plays a vCPU that keeps accessing the vector control words
+ * of an MSI-X-like table: it makes the same locking decision as
+ * prepare_mmio_access() and then calls the region's callbacks, like
+ * memory_region_dispatch_read/write() do.  By default reads take the lock,
+ * as they did for every region before
+ * memory_region_clear_global_locking_reads(); -u clears the flag the way
+ * msix_init() does.  Writes always take the lock.
+ *
+ * exec.c and memory.c are built per target and cannot be linked into a
+ * test, so those steps are repeated here, with a mutex standing in for
+ * the BQL.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/thread.h"
+#include "qemu/processor.h"
+#include "exec/memory.h"
+
+#define TABLE_ENTRIES 64
+#define ENTRY_SIZE 16
+#define VECTOR_CTRL 12
+
+struct thread_info {
+    uint64_t r;
+    uint64_t accesses;
+    uint64_t sum;
+} QEMU_ALIGNED(64);
+
+static QemuThread *threads;
+static struct thread_info *th_info;
+static unsigned int n_threads = 1;
+static unsigned int n_ready_threads;
+static unsigned int duration = 1;
+static unsigned int write_pct;
+static bool unlocked_reads;
+static bool test_start;
+static bool test_stop;
+
+static QemuMutex bql;
+static __thread bool bql_locked;
+static MemoryRegion mr;
+static uint8_t *table;
+
+static const char commands_string[] =
+    " -n = number of threads\n"
+    " -d = duration in seconds\n"
+    " -u = dispatch reads without the lock\n"
+    " -w = percentage of accesses that are writes";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/* https://en.wikipedia.org/wiki/Xorshift, as in atomic_add-bench */
+static uint64_t xorshift64star(uint64_t x)
+{
+    x ^= x >> 12; /* a */
+    x ^= x << 25; /* b */
+    x ^= x >> 27; /* c */
+    return x * UINT64_C(2685821657736338717);
+}
+
+/* Like msix_table_mmio_read/write */
+static uint64_t bench_table_read(void *opaque, hwaddr addr, unsigned size)
+{
+    uint8_t *t = atomic_rcu_read((uint8_t **)opaque);
+
+    return t ? ldl_le_p(t + addr) : 0;
+}
+
+static void bench_table_write(void *opaque, hwaddr addr, uint64_t val,
+                              unsigned size)
+{
+    stl_le_p(*(uint8_t **)opaque + addr, val);
+}
+
+static const MemoryRegionOps bench_table_ops = {
+    .read = bench_table_read,
+    .write = bench_table_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+};
+
+/* prepare_mmio_access(), for a region without coalesced MMIO */
+static bool bench_prepare_mmio_access(MemoryRegion *mr, bool is_write)
+{
+    if (!bql_locked && memory_region_needs_global_locking(mr, is_write)) {
+        qemu_mutex_lock(&bql);
+        bql_locked = true;
+        return true;
+    }
+    return false;
+}
+
+static void *thread_func(void *arg)
+{
+    struct thread_info *info = arg;
+
+    atomic_inc(&n_ready_threads);
+    while (!atomic_read(&test_start)) {
+        cpu_relax();
+    }
+
+    while (!atomic_read(&test_stop)) {
+        hwaddr addr;
+        bool is_write, release_lock;
+
+        info->r = xorshift64star(info->r);
+        addr = (info->r % TABLE_ENTRIES) * ENTRY_SIZE + VECTOR_CTRL;
+        is_write = (info->r >> 32) % 100 < write_pct;
+
+        release_lock = bench_prepare_mmio_access(&mr, is_write);
+        if (is_write) {
+            mr.ops->write(mr.opaque, addr, (info->r >> 16) & 1, 4);
+        } else {
+            info->sum += mr.ops->read(mr.opaque, addr, 4);
+        }
+        if (release_lock) {
+            bql_locked = false;
+            qemu_mutex_unlock(&bql);
+        }
+        info->accesses++;
+    }
+    return NULL;
+}
+
+static void run_test(void)
+{
+    unsigned int i;
+
+    while (atomic_read(&n_ready_threads) != n_threads) {
+        cpu_relax();
+    }
+
+    atomic_set(&test_start, true);
+    g_usleep(duration * G_USEC_PER_SEC);
+    atomic_set(&test_stop, true);
+
+    for (i = 0; i < n_threads; i++) {
+        qemu_thread_join(&threads[i]);
+    }
+}
+
+static void create_threads(void)
+{
+    unsigned int i;
+
+    qemu_mutex_init(&bql);
+    table = g_malloc0(TABLE_ENTRIES * ENTRY_SIZE);
+    /* what memory_region_init_io() and msix_init() set up */
+    mr.ops = &bench_table_ops;
+    mr.opaque = &table;
+    mr.global_locking = true;
+    mr.global_locking_reads = !unlocked_reads;
+
+    threads = g_new(QemuThread, n_threads);
+    th_info = qemu_memalign(64, sizeof(*th_info) * n_threads);
+    memset(th_info, 0, sizeof(*th_info) * n_threads);
+    for (i = 0; i < n_threads; i++) {
+        struct thread_info *info = &th_info[i];
+
+        info->r = (i + 1) ^ time(NULL);
+        qemu_thread_create(&threads[i], NULL, thread_func, info,
+                           QEMU_THREAD_JOINABLE);
+    }
+}
+
+static void pr_params(void)
+{
+    printf("Parameters:\n");
+    printf(" # of threads:      %u\n", n_threads);
+    printf(" duration:          %u\n", duration);
+    printf(" reads:             %s\n", unlocked_reads ? "unlocked" : "locked");
+    printf(" writes:            %u%%\n", write_pct);
+}
+
+static void pr_stats(void)
+{
+    unsigned long long val = 0;
+    unsigned int i;
+    double tx;
+
+    for (i = 0; i < n_threads; i++) {
+        val += th_info[i].accesses;
+    }
+    tx = val / duration / 1e6;
+
+    printf("Results:\n");
+    printf("Duration:            %u s\n", duration);
+    printf(" Throughput:         %.2f Maccesses/s\n", tx);
+    printf(" Throughput/thread:  %.2f Maccesses/s/thread\n", tx / n_threads);
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hd:n:uw:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'n':
+            n_threads = atoi(optarg);
+            break;
+        case 'u':
+            unlocked_reads = true;
+            break;
+        case 'w':
+            write_pct = MIN(atoi(optarg), 100);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+    pr_params();
+    create_threads();
+    run_test();
+    pr_stats();
+    return 0;
+}
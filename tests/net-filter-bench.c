@@ -0,0 +1,161 @@
+/*
+ * Per-hop cost of passing packets through a chain of buffering filters
+ *
+ * Each hop owns a NetQueue, like filter-buffer does: packets are
+ * appended to the first queue, and flushing a queue hands its packets
+ * to the next hop, which queues them again.  The chain is run twice,
+ * once handing each hop the queued data itself, which lets the next
+ * queue share it, and once handing it a private copy, which is what a
+ * filter that rewrites packets costs and what every hop used to cost.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/iov.h"
+#include "qemu/timer.h"
+#include "net/net.h"
+#include "net/queue.h"
+
+#define MAX_HOPS 16
+
+static unsigned int n_hops = 4;
+static unsigned int n_packets = 1000000;
+static unsigned int packet_size = 1514;
+static unsigned int burst = 64;
+
+static NetQueue *hops[MAX_HOPS + 1];
+static uint8_t *bounce;
+static bool copy_mode;
+static uint64_t n_received;
+
+static const char commands_string[] =
+    " -n = number of filters in the chain\n"
+    " -p = number of packets\n"
+    " -s = packet size in bytes\n"
+    " -b = packets queued before each flush";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+bool qemu_can_send_packet(NetClientState *sender)
+{
+    return true;
+}
+
+static ssize_t hop_deliver(NetClientState *sender, unsigned flags,
+                           const struct iovec *iov, int iovcnt,
+                           void *opaque)
+{
+    NetQueue *next = opaque;
+    size_t size = iov_size(iov, iovcnt);
+    struct iovec copy = {
+        .iov_base = bounce,
+        .iov_len = size,
+    };
+
+    if (copy_mode) {
+        iov_to_buf(iov, iovcnt, 0, bounce, size);
+        qemu_net_queue_append_iov(next, sender, flags, &copy, 1, NULL);
+    } else {
+        qemu_net_queue_append_iov(next, sender, flags, iov, iovcnt, NULL);
+    }
+    return size;
+}
+
+static ssize_t sink_deliver(NetClientState *sender, unsigned flags,
+                            const struct iovec *iov, int iovcnt,
+                            void *opaque)
+{
+    n_received++;
+    return iov_size(iov, iovcnt);
+}
+
+static void setup(void)
+{
+    unsigned int i;
+
+    hops[n_hops] = qemu_new_net_queue(sink_deliver, NULL);
+    for (i = n_hops; i-- > 0;) {
+        hops[i] = qemu_new_net_queue(hop_deliver, hops[i + 1]);
+    }
+    bounce = g_malloc(packet_size);
+}
+
+static double run_chain(bool copy)
+{
+    uint8_t *frame = g_malloc0(packet_size);
+    struct iovec iov = {
+        .iov_base = frame,
+        .iov_len = packet_size,
+    };
+    unsigned int i, j;
+    int64_t start;
+
+    copy_mode = copy;
+    n_received = 0;
+    start = get_clock();
+    for (i = 0; i < n_packets; i += burst) {
+        for (j = 0; j < burst; j++) {
+            frame[0] = j;
+            qemu_net_queue_append_iov(hops[0], NULL, 0, &iov, 1, NULL);
+        }
+        for (j = 0; j <= n_hops; j++) {
+            qemu_net_queue_flush(hops[j]);
+        }
+    }
+    g_free(frame);
+    g_assert(n_received == DIV_ROUND_UP(n_packets, burst) * burst);
+    return (double)(get_clock() - start) / n_received;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hn:p:s:b:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'n':
+            n_hops = MIN(MAX(atoi(optarg), 1), MAX_HOPS);
+            break;
+        case 'p':
+            n_packets = MAX(atoi(optarg), 1);
+            break;
+        case 's':
+            packet_size = MIN(MAX(atoi(optarg), 60), 65536);
+            break;
+        case 'b':
+            burst = MAX(atoi(optarg), 1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double shared, copied;
+
+    parse_args(argc, argv);
+    setup();
+
+    shared = run_chain(false);
+    copied = run_chain(true);
+
+    printf("filters:               %u\n", n_hops);
+    printf("packet size:           %u\n", packet_size);
+    printf("shared, ns/packet:     %.1f (%.1f per filter)\n",
+           shared, shared / n_hops);
+    printf("copied, ns/packet:     %.1f (%.1f per filter)\n",
+           copied, copied / n_hops);
+    return 0;
+}
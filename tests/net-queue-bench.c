@@ -0,0 +1,170 @@
+/*
+ * Cost of delivering bursts of packets with and without batching
+ *
+ * The receiver behaves like virtio-net: it copies each packet into a
+ * ring, the way the packet is written to an rx descriptor, and then
+ * interrupts the guest, which here is a write to an eventfd like the
+ * one behind an irqfd.  Inside a batch it only marks the notification
+ * as pending and sends it from the batch end handler, once per burst.
+ * Bursts are sent through a NetQueue like tap_send() sends one wakeup's
+ * worth of packets, once unbatched and once between
+ * qemu_net_queue_batch_begin() and qemu_net_queue_batch_end().
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/event_notifier.h"
+#include "qemu/iov.h"
+#include "qemu/timer.h"
+#include "net/net.h"
+#include "net/queue.h"
+
+#define RING_SIZE 256
+
+static unsigned int n_packets = 1000000;
+static unsigned int packet_size = 64;
+static unsigned int burst = 50;
+
+static NetQueue *queue;
+static EventNotifier irq;
+static uint8_t *ring;
+static unsigned int ring_idx;
+static bool notify_pending;
+static uint64_t n_received;
+static uint64_t n_notifies;
+
+static const char commands_string[] =
+    " -p = number of packets\n"
+    " -s = packet size in bytes\n"
+    " -b = packets per burst";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+bool qemu_can_send_packet(NetClientState *sender)
+{
+    return true;
+}
+
+static void notify_guest(void)
+{
+    event_notifier_set(&irq);
+    n_notifies++;
+}
+
+static ssize_t rx_deliver(NetClientState *sender, unsigned flags,
+                          const struct iovec *iov, int iovcnt,
+                          void *opaque)
+{
+    size_t size = iov_size(iov, iovcnt);
+
+    iov_to_buf(iov, iovcnt, 0, ring + ring_idx * packet_size, size);
+    ring_idx = (ring_idx + 1) % RING_SIZE;
+    n_received++;
+
+    if (qemu_net_queue_batching(queue)) {
+        notify_pending = true;
+    } else {
+        notify_guest();
+    }
+    return size;
+}
+
+static void rx_batch_end(void *opaque)
+{
+    if (notify_pending) {
+        notify_pending = false;
+        notify_guest();
+    }
+}
+
+static void setup(void)
+{
+    queue = qemu_new_net_queue(rx_deliver, NULL);
+    qemu_net_queue_set_batch_end(queue, rx_batch_end);
+    if (event_notifier_init(&irq, false) < 0) {
+        fprintf(stderr, "cannot create the event notifier\n");
+        exit(1);
+    }
+    ring = g_malloc(RING_SIZE * packet_size);
+}
+
+static double run_bursts(bool batched)
+{
+    uint8_t *frame = g_malloc0(packet_size);
+    unsigned int i, j;
+    int64_t start;
+
+    n_received = 0;
+    n_notifies = 0;
+    start = get_clock();
+    for (i = 0; i < n_packets; i += burst) {
+        if (batched) {
+            qemu_net_queue_batch_begin(queue);
+        }
+        for (j = 0; j < burst; j++) {
+            frame[0] = j;
+            qemu_net_queue_send(queue, NULL, QEMU_NET_PACKET_FLAG_NONE,
+                                frame, packet_size, NULL);
+        }
+        if (batched) {
+            qemu_net_queue_batch_end(queue);
+        }
+        /* the guest takes the interrupt */
+        event_notifier_test_and_clear(&irq);
+    }
+    g_free(frame);
+    g_assert(n_received == DIV_ROUND_UP(n_packets, burst) * burst);
+    return (double)(get_clock() - start) / n_received;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hp:s:b:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'p':
+            n_packets = MAX(atoi(optarg), 1);
+            break;
+        case 's':
+            packet_size = MIN(MAX(atoi(optarg), 60), 65536);
+            break;
+        case 'b':
+            burst = MAX(atoi(optarg), 1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double unbatched, batched;
+    uint64_t unbatched_notifies;
+
+    parse_args(argc, argv);
+    setup();
+
+    unbatched = run_bursts(false);
+    unbatched_notifies = n_notifies;
+    batched = run_bursts(true);
+
+    printf("packet size:           %u\n", packet_size);
+    printf("burst:                 %u\n", burst);
+    printf("unbatched, ns/packet:  %.1f (%.1f Mpps, %" PRIu64 " notifies)\n",
+           unbatched, 1e3 / unbatched, unbatched_notifies);
+    printf("batched, ns/packet:    %.1f (%.1f Mpps, %" PRIu64 " notifies)\n",
+           batched, 1e3 / batched, n_notifies);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * QTest testcase for TCG translation block statistics
+ *
+ * The guest is a boot sector that spins in a two-block loop under TCG;
+ * the statistics of the loop are read back with x-query-tb-stats.  They
+ * also show when the loop is retranslated as a superblock.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+
+#define BOOT_SECTOR_ADDRESS 0x7c00
+#define LOOP_OFFSET 0x03
+#define LOOP_PC (BOOT_SECTOR_ADDRESS + LOOP_OFFSET)
+/* inc %ax; jmp 0x7c10 */
+#define LOOP_BLOCK_BYTES 3
+
+/* Each poll waits TEST_DELAY seconds, up to TEST_CYCLES times */
+#define TEST_DELAY (1 * G_USEC_PER_SEC / 10)
+#define TEST_CYCLES MAX((90 * G_USEC_PER_SEC / TEST_DELAY), 1)
+
+static uint8_t x86_boot_sector[512] = {
+    /* 7c00: cli */
+    [0x00] = 0xfa,
+    /* 7c01: xor %ax,%ax */
+    [0x01] = 0x31,
+    [0x02] = 0xc0,
+    /* 7c03: inc %ax */
+    [0x03] = 0x40,
+    /* 7c04: jmp 0x7c10 */
+    [0x04] = 0xeb,
+    [0x05] = 0x0a,
+    /* 7c10: jmp 0x7c03 */
+    [0x10] = 0xeb,
+    [0x11] = 0xf1,
+    /* End of boot sector marker */
+    [0x1FE] = 0x55,
+    [0x1FF] = 0xAA,
+};
+
+static char disk[] = "tests/tb-stats-test-disk-XXXXXX";
+
+static QTestState *tb_stats_start(void)
+{
+    QTestState *qts;
+    QDict *rsp;
+
+    qts = qtest_initf("-M pc,accel=tcg -S -drive file=%s,format=raw", disk);
+    rsp = qtest_qmp(qts, "{ 'execute': 'x-tb-stats',"
+                         "  'arguments': { 'action': 'start' } }");
+    g_assert(qdict_haskey(rsp, "return"));
+    qobject_unref(rsp);
+    rsp = qtest_qmp(qts, "{ 'execute': 'cont' }");
+    g_assert(qdict_haskey(rsp, "return"));
+    qobject_unref(rsp);
+    return qts;
+}
+
+/* Return the statistics of the block at @pc, or NULL if it has none yet */
+static QDict *tb_stats_lookup(QTestState *qts, uint64_t pc)
+{
+    QDict *rsp, *found = NULL;
+    QListEntry *e;
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'x-query-tb-stats',"
+                         "  'arguments': { 'max': 100 } }");
+    QLIST_FOREACH_ENTRY(qdict_get_qlist(rsp, "return"), e) {
+        QDict *d = qobject_to(QDict, qlist_entry_obj(e));
+
+        if (qdict_get_int(d, "pc") == pc) {
+            found = d;
+            qobject_ref(found);
+            break;
+        }
+    }
+    qobject_unref(rsp);
+    return found;
+}
+
+static void test_exec_count(void)
+{
+    QTestState *qts = tb_stats_start();
+    QDict *stats = NULL;
+    int i;
+
+    for (i = 0; i < TEST_CYCLES; i++) {
+        stats = tb_stats_lookup(qts, LOOP_PC);
+        if (stats && qdict_get_int(stats, "exec-count") > 0) {
+            break;
+        }
+        qobject_unref(stats);
+        stats = NULL;
+        g_usleep(TEST_DELAY);
+    }
+
+    g_assert(stats);
+    g_assert_cmpint(qdict_get_int(stats, "exec-count"), >, 0);
+    g_assert_cmpint(qdict_get_int(stats, "translations"), >, 0);
+    g_assert_cmpint(qdict_get_int(stats, "guest-insns"), >, 0);
+    g_assert_cmpint(qdict_get_int(stats, "guest-bytes"), >, 0);
+    g_assert_cmpint(qdict_get_int(stats, "host-bytes"), >, 0);
+    g_assert_cmpint(qdict_get_int(stats, "ops"), >, 0);
+    qobject_unref(stats);
+
+    qtest_quit(qts);
+}
+
+/*
+ * Once hot, the loop block is retranslated as a superblock that follows
+ * the jump to 0x7c10, on the same page, so that translation covers more
+ * guest code than the plain block does.
+ */
+static void test_superblock(void)
+{
+    QTestState *qts = tb_stats_start();
+    QDict *stats = NULL;
+    int64_t translations = 0;
+    int i;
+
+    for (i = 0; i < TEST_CYCLES; i++) {
+        stats = tb_stats_lookup(qts, LOOP_PC);
+        if (stats) {
+            translations = qdict_get_int(stats, "translations");
+            if (qdict_get_int(stats, "guest-bytes") >
+                translations * LOOP_BLOCK_BYTES) {
+                break;
+            }
+        }
+        qobject_unref(stats);
+        stats = NULL;
+        g_usleep(TEST_DELAY);
+    }
+
+    g_assert(stats);
+    g_assert_cmpint(translations, >=, 2);
+    g_assert_cmpint(qdict_get_int(stats, "guest-insns"), >, translations * 2);
+    /* the plain block was invalidated to make room for the superblock */
+    g_assert_cmpint(qdict_get_int(stats, "invalidations"), >=, 1);
+    qobject_unref(stats);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    int fd, ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    fd = mkstemp(disk);
+    g_assert(fd >= 0);
+    g_assert(write(fd, x86_boot_sector, sizeof(x86_boot_sector)) ==
+             sizeof(x86_boot_sector));
+    close(fd);
+
+    qtest_add_func("tcg/tb-stats/exec-count", test_exec_count);
+    qtest_add_func("tcg/superblock/same-page-jump", test_superblock);
+
+    ret = g_test_run();
+    unlink(disk);
+    return ret;
+}
@@ -512,6 +512,84 @@ static void test_timer_schedule(void)
     timer_del(&data.timer);
 }
 
+#ifndef _WIN32
+static bool adaptive_poll_cb(void *opaque)
+{
+    return false;
+}
+
+/* Run one blocking aio_poll that ends with a timer @ms from now */
+static void adaptive_poll_wait(TimerTestData *data, int64_t ms)
+{
+    data->n = 0;
+    timer_mod(&data->timer, qemu_clock_get_ns(data->clock_type) +
+              ms * SCALE_MS);
+    while (data->n == 0) {
+        aio_poll(ctx, true);
+    }
+}
+
+/*
+ * The poll window depends on wall-clock time, so only check the order of
+ * events: a stream of events eventually makes the context poll, and once
+ * it stops the window shrinks until nothing is polled anymore.
+ */
+static void test_adaptive_poll(void)
+{
+    TimerTestData data = { .n = 0, .ctx = ctx, .max = 1,
+                           .clock_type = QEMU_CLOCK_REALTIME };
+    EventNotifierTestData e = { .n = 0, .active = 0 };
+    AioPollStats before;
+    int i, j;
+
+    aio_context_set_poll_params(ctx, 20 * SCALE_MS, 0, 0, &error_abort);
+    aio_context_set_poll_target(ctx, 1000 * SCALE_MS, 0, &error_abort);
+    aio_timer_init(ctx, &data.timer, data.clock_type,
+                   SCALE_NS, timer_test_cb, &data);
+    event_notifier_init(&e.e, false);
+    aio_set_event_notifier(ctx, &e.e, false, event_ready_cb,
+                           adaptive_poll_cb);
+    do {} while (aio_poll(ctx, false));
+
+    /* No events seen yet: nothing to poll for */
+    before = ctx->poll_stats;
+    adaptive_poll_wait(&data, 1);
+    g_assert_cmpuint(ctx->poll_stats.misses, ==, before.misses);
+    g_assert_cmpuint(ctx->poll_stats.time_ns, ==, before.time_ns);
+
+    /* A steady stream of events makes the context poll for the next one */
+    for (i = 0; i < 100; i++) {
+        before = ctx->poll_stats;
+        for (j = 0; j < 4; j++) {
+            g_usleep(1000);
+            event_notifier_set(&e.e);
+            g_assert(aio_poll(ctx, true));
+        }
+        adaptive_poll_wait(&data, 1);
+        if (ctx->poll_stats.misses > before.misses) {
+            break;
+        }
+    }
+    g_assert_cmpint(i, <, 100);
+    g_assert_cmpint(e.n, ==, 4 * (i + 1));
+
+    /* Once the stream stops, polling stops too */
+    do {
+        before = ctx->poll_stats;
+        adaptive_poll_wait(&data, 1);
+    } while (ctx->poll_stats.misses > before.misses);
+    before = ctx->poll_stats;
+    adaptive_poll_wait(&data, 1);
+    g_assert_cmpuint(ctx->poll_stats.misses, ==, before.misses);
+
+    aio_set_event_notifier(ctx, &e.e, false, NULL, NULL);
+    event_notifier_cleanup(&e.e);
+    timer_del(&data.timer);
+    aio_context_set_poll_target(ctx, 0, 0, &error_abort);
+    aio_context_set_poll_params(ctx, 0, 0, 0, &error_abort);
+}
+#endif
+
 /* Now the same tests, using the context as a GSource.  They are
  * very similar to the ones above, with g_main_context_iteration
  * replacing aio_poll.  However:
@@ -900,6 +978,9 @@ int main(int argc, char **argv)
     g_test_add_func("/aio/event/flush",             test_flush_event_notifier);
     g_test_add_func("/aio/external-client",         test_aio_external_client);
     g_test_add_func("/aio/timer/schedule",          test_timer_schedule);
+#ifndef _WIN32
+    g_test_add_func("/aio/poll/adaptive",           test_adaptive_poll);
+#endif
 
     g_test_add_func("/aio/coroutine/queue-chaining", test_queue_chaining);
 
@@ -34,6 +34,18 @@
 #include "authz/list.h"
 #include "qom/object_interfaces.h"
 
+#ifdef CONFIG_KTLS
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
 #ifdef QCRYPTO_HAVE_TLS_TEST_SUPPORT
 
 #define WORKDIR "tests/test-io-channel-tls-work/"
@@ -48,6 +60,9 @@ struct QIOChannelTLSTestData {
     bool expectClientFail;
     const char *hostname;
     const char *const *wildcards;
+    const char *priority;
+    bool tcp;
+    int ktls; /* TLS 1.x minor version expected to be offloaded, or 0 */
 };
 
 struct QIOChannelTLSHandshakeData {
@@ -66,7 +81,8 @@ static void test_tls_handshake_done(QIOTask *task,
 
 
 static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
-                                              const char *certdir)
+                                              const char *certdir,
+                                              const char *priority)
 {
     Object *parent = object_get_objects_root();
     Object *creds = object_new_with_props(
@@ -79,7 +95,7 @@ static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
                      "server" : "client"),
         "dir", certdir,
         "verify-peer", "yes",
-        "priority", "NORMAL",
+        "priority", priority,
         /* We skip initial sanity checks here because we
          * want to make sure that problems are being
          * detected at the TLS session validation stage,
@@ -94,6 +110,74 @@ static QCryptoTLSCreds *test_tls_creds_create(QCryptoTLSCredsEndpoint endpoint,
 }
 
 
+/*
+ * Connected TCP sockets over loopback, which unlike a UNIX
+ * socketpair let the TLS channels use kernel TLS offload
+ */
+static void test_tls_tcp_socketpair(int channel[2])
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof(addr);
+    int lfd;
+
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(lfd >= 0);
+    g_assert(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    g_assert(listen(lfd, 1) == 0);
+    g_assert(getsockname(lfd, (struct sockaddr *)&addr, &addrlen) == 0);
+
+    channel[0] = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(channel[0] >= 0);
+    g_assert(connect(channel[0], (struct sockaddr *)&addr, addrlen) == 0);
+    channel[1] = accept(lfd, NULL, NULL);
+    g_assert(channel[1] >= 0);
+
+    close(lfd);
+}
+
+
+/*
+ * Whether the running kernel accepts transmit keys for TLS 1.@minor,
+ * i.e. whether QIOChannelTLS must be able to offload such a session
+ */
+static bool test_tls_kernel_offload(int minor)
+{
+#ifdef CONFIG_KTLS
+    struct tls12_crypto_info_aes_gcm_128 info = {
+        .info.cipher_type = TLS_CIPHER_AES_GCM_128,
+    };
+    int channel[2];
+    bool ret;
+
+    switch (minor) {
+    case 2:
+        info.info.version = TLS_1_2_VERSION;
+        break;
+#if defined(TLS_1_3_VERSION) && GNUTLS_VERSION_NUMBER >= 0x030605
+    case 3:
+        info.info.version = TLS_1_3_VERSION;
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    test_tls_tcp_socketpair(channel);
+    ret = setsockopt(channel[0], IPPROTO_TCP, TCP_ULP,
+                     "tls", sizeof("tls")) == 0 &&
+          setsockopt(channel[0], SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+    close(channel[0]);
+    close(channel[1]);
+    return ret;
+#else
+    return false;
+#endif
+}
+
+
 /*
  * This tests validation checking of peer certificates
  *
@@ -122,8 +206,17 @@ static void test_io_channel_tls(const void *opaque)
     QIOChannelTest *test;
     GMainContext *mainloop;
 
+    if (data->ktls && !test_tls_kernel_offload(data->ktls)) {
+        g_test_skip("kernel TLS offload not available");
+        return;
+    }
+
     /* We'll use this for our fake client-server connection */
-    g_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0);
+    if (data->tcp) {
+        test_tls_tcp_socketpair(channel);
+    } else {
+        g_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0);
+    }
 
 #define CLIENT_CERT_DIR "tests/test-io-channel-tls-client/"
 #define SERVER_CERT_DIR "tests/test-io-channel-tls-server/"
@@ -154,12 +247,12 @@ static void test_io_channel_tls(const void *opaque)
 
     clientCreds = test_tls_creds_create(
         QCRYPTO_TLS_CREDS_ENDPOINT_CLIENT,
-        CLIENT_CERT_DIR);
+        CLIENT_CERT_DIR, data->priority);
     g_assert(clientCreds != NULL);
 
     serverCreds = test_tls_creds_create(
         QCRYPTO_TLS_CREDS_ENDPOINT_SERVER,
-        SERVER_CERT_DIR);
+        SERVER_CERT_DIR, data->priority);
     g_assert(serverCreds != NULL);
 
     auth = qauthz_list_new("channeltlsacl",
@@ -226,6 +319,19 @@ static void test_io_channel_tls(const void *opaque)
     g_assert(clientHandshake.failed == data->expectClientFail);
     g_assert(serverHandshake.failed == data->expectServerFail);
 
+    if (data->ktls) {
+        g_assert(clientChanTLS->ktls & QCRYPTO_TLS_KTLS_TX);
+        g_assert(serverChanTLS->ktls & QCRYPTO_TLS_KTLS_TX);
+        if (data->ktls == 3) {
+            /* post-handshake messages must still reach GnuTLS */
+            g_assert(!(clientChanTLS->ktls & QCRYPTO_TLS_KTLS_RX));
+            g_assert(!(serverChanTLS->ktls & QCRYPTO_TLS_KTLS_RX));
+        }
+    } else {
+        g_assert_cmpint(clientChanTLS->ktls, ==, 0);
+        g_assert_cmpint(serverChanTLS->ktls, ==, 0);
+    }
+
     test = qio_channel_test_new();
     qio_channel_test_run_threads(test, false,
                                  QIO_CHANNEL(clientChanTLS),
@@ -282,11 +388,11 @@ int main(int argc, char **argv)
 # define TEST_CHANNEL(name, caCrt,                                      \
                       serverCrt, clientCrt,                             \
                       expectServerFail, expectClientFail,               \
-                      hostname, wildcards)                              \
+                      hostname, wildcards, priority, tcp, ktls)         \
     struct QIOChannelTLSTestData name = {                               \
         caCrt, caCrt, serverCrt, clientCrt,                             \
         expectServerFail, expectClientFail,                             \
-        hostname, wildcards                                             \
+        hostname, wildcards, priority, tcp, ktls                        \
     };                                                                  \
     g_test_add_data_func("/qio/channel/tls/" # name,                    \
                          &name, test_io_channel_tls);
@@ -321,7 +427,18 @@ int main(int argc, char **argv)
     };
     TEST_CHANNEL(basic, cacertreq.filename, servercertreq.filename,
                  clientcertreq.filename, false, false,
-                 "qemu.org", wildcards);
+                 "qemu.org", wildcards, "NORMAL", false, 0);
+    /* Skipped unless the kernel can offload the session */
+    TEST_CHANNEL(ktls12, cacertreq.filename, servercertreq.filename,
+                 clientcertreq.filename, false, false,
+                 "qemu.org", wildcards,
+                 "NORMAL:-VERS-TLS-ALL:+VERS-TLS1.2:-CIPHER-ALL:+AES-128-GCM",
+                 true, 2);
+    TEST_CHANNEL(ktls13, cacertreq.filename, servercertreq.filename,
+                 clientcertreq.filename, false, false,
+                 "qemu.org", wildcards,
+                 "NORMAL:-VERS-TLS-ALL:+VERS-TLS1.3:-CIPHER-ALL:+AES-128-GCM",
+                 true, 3);
 
     ret = g_test_run();
 
@@ -0,0 +1,216 @@
+/*
+ * NetQueue batch unit tests
+ *
+ * A burst of packets delivered between qemu_net_queue_batch_begin() and
+ * qemu_net_queue_batch_end() must end with exactly one call to the batch
+ * end handler, which net.c forwards to NetClientInfo::receive_batch_end.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+#include "qemu/osdep.h"
+#include "qemu/iov.h"
+#include "net/net.h"
+#include "net/queue.h"
+
+static unsigned int n_delivered;
+static unsigned int n_batch_ends;
+static bool receive_disabled;
+
+bool qemu_can_send_packet(NetClientState *sender)
+{
+    return true;
+}
+
+static ssize_t deliver(NetClientState *sender, unsigned flags,
+                       const struct iovec *iov, int iovcnt, void *opaque)
+{
+    NetQueue **queue = opaque;
+
+    if (receive_disabled) {
+        return 0;
+    }
+    /* every packet of these tests is delivered inside a burst */
+    g_assert(qemu_net_queue_batching(*queue));
+    n_delivered++;
+    return iov_size(iov, iovcnt);
+}
+
+static void batch_end(void *opaque)
+{
+    NetQueue **queue = opaque;
+
+    g_assert(!qemu_net_queue_batching(*queue));
+    n_batch_ends++;
+}
+
+static NetQueue *queue_new(NetQueue **queue)
+{
+    n_delivered = 0;
+    n_batch_ends = 0;
+    receive_disabled = false;
+    *queue = qemu_new_net_queue(deliver, queue);
+    qemu_net_queue_set_batch_end(*queue, batch_end);
+    return *queue;
+}
+
+static void send_packet(NetQueue *queue)
+{
+    static uint8_t frame[64];
+
+    qemu_net_queue_send(queue, NULL, QEMU_NET_PACKET_FLAG_NONE,
+                        frame, sizeof(frame), NULL);
+}
+
+static void append_packet(NetQueue *queue)
+{
+    static uint8_t frame[64];
+    struct iovec iov = {
+        .iov_base = frame,
+        .iov_len = sizeof(frame),
+    };
+
+    qemu_net_queue_append_iov(queue, NULL, QEMU_NET_PACKET_FLAG_NONE,
+                              &iov, 1, NULL);
+}
+
+static void test_batch(void)
+{
+    NetQueue *queue;
+    int i;
+
+    queue_new(&queue);
+
+    qemu_net_queue_batch_begin(queue);
+    for (i = 0; i < 3; i++) {
+        send_packet(queue);
+    }
+    g_assert_cmpint(n_delivered, ==, 3);
+    g_assert_cmpint(n_batch_ends, ==, 0);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_batch_ends, ==, 1);
+
+    /* the next burst is notified on its own */
+    qemu_net_queue_batch_begin(queue);
+    send_packet(queue);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_delivered, ==, 4);
+    g_assert_cmpint(n_batch_ends, ==, 2);
+
+    qemu_del_net_queue(queue);
+}
+
+static void test_nested(void)
+{
+    NetQueue *queue;
+
+    queue_new(&queue);
+
+    qemu_net_queue_batch_begin(queue);
+    qemu_net_queue_batch_begin(queue);
+    send_packet(queue);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_batch_ends, ==, 0);
+    g_assert(qemu_net_queue_batching(queue));
+
+    qemu_net_queue_batch_begin(queue);
+    send_packet(queue);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_batch_ends, ==, 0);
+
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_delivered, ==, 2);
+    g_assert_cmpint(n_batch_ends, ==, 1);
+    g_assert(!qemu_net_queue_batching(queue));
+
+    qemu_del_net_queue(queue);
+}
+
+static void test_empty(void)
+{
+    NetQueue *queue;
+
+    queue_new(&queue);
+
+    qemu_net_queue_batch_begin(queue);
+    qemu_net_queue_batch_end(queue);
+
+    qemu_net_queue_batch_begin(queue);
+    qemu_net_queue_batch_begin(queue);
+    qemu_net_queue_batch_end(queue);
+    qemu_net_queue_batch_end(queue);
+
+    /* flushing an empty queue is an empty burst too */
+    g_assert(qemu_net_queue_flush(queue));
+
+    g_assert_cmpint(n_batch_ends, ==, 0);
+
+    qemu_del_net_queue(queue);
+}
+
+static void test_flush(void)
+{
+    NetQueue *queue;
+    int i;
+
+    queue_new(&queue);
+
+    /* a flush is a burst of its own */
+    for (i = 0; i < 3; i++) {
+        append_packet(queue);
+    }
+    g_assert(qemu_net_queue_flush(queue));
+    g_assert_cmpint(n_delivered, ==, 3);
+    g_assert_cmpint(n_batch_ends, ==, 1);
+
+    /* and part of the enclosing burst if there is one */
+    append_packet(queue);
+    qemu_net_queue_batch_begin(queue);
+    g_assert(qemu_net_queue_flush(queue));
+    send_packet(queue);
+    g_assert_cmpint(n_batch_ends, ==, 1);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_delivered, ==, 5);
+    g_assert_cmpint(n_batch_ends, ==, 2);
+
+    qemu_del_net_queue(queue);
+}
+
+static void test_queued(void)
+{
+    NetQueue *queue;
+
+    queue_new(&queue);
+
+    /*
+     * Nothing reaches the receiver while it cannot take packets, so that
+     * burst is empty; they are delivered by the flush.
+     */
+    receive_disabled = true;
+    qemu_net_queue_batch_begin(queue);
+    send_packet(queue);
+    send_packet(queue);
+    qemu_net_queue_batch_end(queue);
+    g_assert_cmpint(n_delivered, ==, 0);
+    g_assert_cmpint(n_batch_ends, ==, 0);
+
+    receive_disabled = false;
+    g_assert(qemu_net_queue_flush(queue));
+    g_assert_cmpint(n_delivered, ==, 2);
+    g_assert_cmpint(n_batch_ends, ==, 1);
+
+    qemu_del_net_queue(queue);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/queue/batch", test_batch);
+    g_test_add_func("/net/queue/nested", test_nested);
+    g_test_add_func("/net/queue/empty", test_empty);
+    g_test_add_func("/net/queue/flush", test_flush);
+    g_test_add_func("/net/queue/queued", test_queued);
+
+    return g_test_run();
+}
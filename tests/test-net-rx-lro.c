@@ -0,0 +1,344 @@
+/*
+ * Software LRO unit tests
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "net/checksum.h"
+#include "../hw/net/net_rx_lro.h"
+
+#define SEG_HLEN (ETH_HLEN + sizeof(struct ip_header) + \
+                  sizeof(struct tcp_header))
+#define SEQ_BASE 0xfffff000      /* wraps around during the tests */
+#define MAX_FRAMES 8
+
+static struct {
+    uint8_t *buf;
+    size_t size;
+} frames[MAX_FRAMES];
+static int n_frames;
+
+static void indicate(void *opaque, const uint8_t *buf, size_t size)
+{
+    g_assert_cmpint(n_frames, <, MAX_FRAMES);
+    frames[n_frames].buf = g_memdup(buf, size);
+    frames[n_frames].size = size;
+    n_frames++;
+}
+
+static void frames_reset(void)
+{
+    int i;
+
+    for (i = 0; i < n_frames; i++) {
+        g_free(frames[i].buf);
+    }
+    n_frames = 0;
+}
+
+/* Fill in the checksums of a segment built by build_seg() */
+static void seg_csum(uint8_t *buf)
+{
+    struct ip_header *ip = (struct ip_header *)(buf + ETH_HLEN);
+    uint8_t *tcp = (uint8_t *)(ip + 1);
+    size_t ip_len = lduw_be_p(&ip->ip_len);
+    uint32_t sum, cso;
+
+    ip->ip_sum = 0;
+    ip->ip_sum = cpu_to_be16(net_raw_checksum((uint8_t *)ip, sizeof(*ip)));
+
+    stw_be_p(tcp + 16, 0);
+    sum = eth_calc_ip4_pseudo_hdr_csum(ip, ip_len - sizeof(*ip), &cso) +
+          net_checksum_add(ip_len - sizeof(*ip), tcp);
+    stw_be_p(tcp + 16, net_checksum_finish(sum));
+}
+
+/*
+ * Build a TCP segment with valid checksums.  Payload bytes depend on
+ * their sequence number, so that coalesced segments are identical to one
+ * segment carrying the whole payload.
+ */
+static size_t build_seg(uint8_t *buf, uint16_t sport, uint32_t seq,
+                        size_t payload_len, uint8_t flags)
+{
+    struct ip_header *ip = (struct ip_header *)(buf + ETH_HLEN);
+    uint8_t *tcp = (uint8_t *)(ip + 1);
+    uint8_t *payload = tcp + sizeof(struct tcp_header);
+    size_t ip_len = sizeof(*ip) + sizeof(struct tcp_header) + payload_len;
+    size_t i;
+
+    memset(buf, 0, SEG_HLEN);
+    memset(buf, 0x52, ETH_ALEN);
+    memset(buf + ETH_ALEN, 0x54, ETH_ALEN);
+    stw_be_p(buf + 2 * ETH_ALEN, ETH_P_IP);
+
+    ip->ip_ver_len = 0x45;
+    stw_be_p(&ip->ip_len, ip_len);
+    stw_be_p(&ip->ip_id, 0x1234);
+    ip->ip_ttl = 64;
+    ip->ip_p = IP_PROTO_TCP;
+    stl_be_p(&ip->ip_src, 0x0a000001);
+    stl_be_p(&ip->ip_dst, 0x0a000002);
+
+    stw_be_p(tcp, sport);
+    stw_be_p(tcp + 2, 80);
+    stl_be_p(tcp + 4, seq);
+    stl_be_p(tcp + 8, 0xabcd);
+    tcp[12] = (sizeof(struct tcp_header) / 4) << 4;
+    tcp[13] = flags;
+    stw_be_p(tcp + 14, 512);
+
+    for (i = 0; i < payload_len; i++) {
+        payload[i] = (seq + i) * 7;
+    }
+    seg_csum(buf);
+
+    return ETH_HLEN + ip_len;
+}
+
+static void check_csums(const uint8_t *buf, size_t size)
+{
+    struct ip_header *ip = (struct ip_header *)(buf + ETH_HLEN);
+    size_t ip_len = lduw_be_p(&ip->ip_len);
+    uint32_t sum, cso;
+
+    g_assert_cmpint(ETH_HLEN + ip_len, ==, size);
+    g_assert_cmpint(net_raw_checksum((uint8_t *)ip, sizeof(*ip)), ==, 0);
+    sum = eth_calc_ip4_pseudo_hdr_csum(ip, ip_len - sizeof(*ip), &cso) +
+          net_checksum_add(ip_len - sizeof(*ip), (uint8_t *)(ip + 1));
+    g_assert_cmpint(net_checksum_finish(sum), ==, 0);
+}
+
+/* Check frames[i] against one segment built from the arguments */
+static void check_frame(int i, uint16_t sport, uint32_t seq,
+                        size_t payload_len, uint8_t flags)
+{
+    uint8_t *ref = g_malloc(NET_RX_LRO_MAX_LEN);
+    size_t size = build_seg(ref, sport, seq, payload_len, flags);
+
+    g_assert_cmpint(i, <, n_frames);
+    g_assert_cmpint(frames[i].size, ==, size);
+    g_assert(!memcmp(frames[i].buf, ref, size));
+    check_csums(frames[i].buf, frames[i].size);
+    g_free(ref);
+}
+
+static void test_single(void)
+{
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    size_t size;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    size = build_seg(buf, 1000, SEQ_BASE, 1000, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    g_assert_cmpint(n_frames, ==, 0);
+    g_assert_cmpint(net_rx_lro_pending_len(lro), ==, size);
+
+    net_rx_lro_flush(lro);
+    g_assert_cmpint(n_frames, ==, 1);
+    g_assert_cmpint(net_rx_lro_pending_len(lro), ==, 0);
+    check_frame(0, 1000, SEQ_BASE, 1000, TCP_FLAG_ACK);
+
+    /* nothing pending anymore */
+    net_rx_lro_flush(lro);
+    g_assert_cmpint(n_frames, ==, 1);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+static void test_merge(void)
+{
+    /* odd lengths put the later payloads at odd checksum offsets */
+    static const size_t lens[] = { 1001, 1448, 37, 500 };
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    uint32_t seq = SEQ_BASE;
+    size_t size, total = 0;
+    int i;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    for (i = 0; i < ARRAY_SIZE(lens); i++) {
+        size = build_seg(buf, 1000, seq, lens[i], TCP_FLAG_ACK);
+        g_assert(net_rx_lro_add(lro, buf, size));
+        seq += lens[i];
+        total += lens[i];
+    }
+    g_assert_cmpint(n_frames, ==, 0);
+    g_assert_cmpint(net_rx_lro_pending_len(lro), ==, SEG_HLEN + total);
+
+    net_rx_lro_flush(lro);
+    g_assert_cmpint(n_frames, ==, 1);
+    check_frame(0, 1000, SEQ_BASE, total, TCP_FLAG_ACK);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+static void test_push(void)
+{
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    size_t size;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    size = build_seg(buf, 1000, SEQ_BASE, 100, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 101,
+                     TCP_FLAG_ACK | TCP_FLAG_PSH);
+    g_assert(net_rx_lro_add(lro, buf, size));
+
+    /* PSH ends the run without waiting for the flush */
+    g_assert_cmpint(n_frames, ==, 1);
+    check_frame(0, 1000, SEQ_BASE, 201, TCP_FLAG_ACK | TCP_FLAG_PSH);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+static void test_no_merge(void)
+{
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    size_t size;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    /* sequence gap */
+    size = build_seg(buf, 1000, SEQ_BASE, 100, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    size = build_seg(buf, 1000, SEQ_BASE + 200, 100, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    g_assert_cmpint(n_frames, ==, 1);
+    check_frame(0, 1000, SEQ_BASE, 100, TCP_FLAG_ACK);
+
+    /* another flow */
+    size = build_seg(buf, 1001, SEQ_BASE + 300, 100, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    g_assert_cmpint(n_frames, ==, 2);
+    check_frame(1, 1000, SEQ_BASE + 200, 100, TCP_FLAG_ACK);
+
+    /* different window */
+    size = build_seg(buf, 1001, SEQ_BASE + 400, 100, TCP_FLAG_ACK);
+    stw_be_p(buf + ETH_HLEN + sizeof(struct ip_header) + 14, 1024);
+    seg_csum(buf);
+    g_assert(net_rx_lro_add(lro, buf, size));
+    g_assert_cmpint(n_frames, ==, 3);
+    check_frame(2, 1001, SEQ_BASE + 300, 100, TCP_FLAG_ACK);
+
+    net_rx_lro_flush(lro);
+    g_assert_cmpint(n_frames, ==, 4);
+    check_csums(frames[3].buf, frames[3].size);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+static void test_rejected(void)
+{
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    size_t size;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    /* each rejected frame first pushes out the pending one */
+    size = build_seg(buf, 1000, SEQ_BASE, 100, TCP_FLAG_ACK);
+    g_assert(net_rx_lro_add(lro, buf, size));
+
+    /* bad TCP checksum */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK);
+    buf[size - 1] ^= 1;
+    g_assert(!net_rx_lro_add(lro, buf, size));
+    g_assert_cmpint(n_frames, ==, 1);
+    check_frame(0, 1000, SEQ_BASE, 100, TCP_FLAG_ACK);
+
+    /* bad IP checksum */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK);
+    buf[ETH_HLEN + 8]--;
+    g_assert(!net_rx_lro_add(lro, buf, size));
+
+    /* no payload */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 0, TCP_FLAG_ACK);
+    g_assert(!net_rx_lro_add(lro, buf, size));
+
+    /* control flags */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK | 0x01);
+    g_assert(!net_rx_lro_add(lro, buf, size));
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, 0x02);
+    g_assert(!net_rx_lro_add(lro, buf, size));
+
+    /* not TCP */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK);
+    buf[ETH_HLEN + 9] = IP_PROTO_UDP;
+    seg_csum(buf);
+    g_assert(!net_rx_lro_add(lro, buf, size));
+
+    /* fragment */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK);
+    stw_be_p(buf + ETH_HLEN + 6, IP_MF);
+    seg_csum(buf);
+    g_assert(!net_rx_lro_add(lro, buf, size));
+
+    /* truncated */
+    size = build_seg(buf, 1000, SEQ_BASE + 100, 100, TCP_FLAG_ACK);
+    g_assert(!net_rx_lro_add(lro, buf, size - 1));
+
+    g_assert_cmpint(n_frames, ==, 1);
+    net_rx_lro_flush(lro);
+    g_assert_cmpint(n_frames, ==, 1);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+static void test_max_len(void)
+{
+    struct NetRxLro *lro;
+    uint8_t buf[2048];
+    uint32_t seq = SEQ_BASE;
+    size_t size, total = 0;
+    int i;
+
+    net_rx_lro_init(&lro, indicate, NULL);
+
+    /* 50 * 1448 bytes do not fit in one IP packet */
+    for (i = 0; i < 50; i++) {
+        size = build_seg(buf, 1000, seq, 1448, TCP_FLAG_ACK);
+        g_assert(net_rx_lro_add(lro, buf, size));
+        seq += 1448;
+    }
+    net_rx_lro_flush(lro);
+
+    g_assert_cmpint(n_frames, ==, 2);
+    for (i = 0; i < n_frames; i++) {
+        g_assert_cmpint(frames[i].size, <=, NET_RX_LRO_MAX_LEN);
+        check_csums(frames[i].buf, frames[i].size);
+        total += frames[i].size - SEG_HLEN;
+    }
+    g_assert_cmpint(total, ==, 50 * 1448);
+    check_frame(0, 1000, SEQ_BASE, frames[0].size - SEG_HLEN, TCP_FLAG_ACK);
+
+    net_rx_lro_uninit(lro);
+    frames_reset();
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/rx-lro/single", test_single);
+    g_test_add_func("/net/rx-lro/merge", test_merge);
+    g_test_add_func("/net/rx-lro/push", test_push);
+    g_test_add_func("/net/rx-lro/no-merge", test_no_merge);
+    g_test_add_func("/net/rx-lro/rejected", test_rejected);
+    g_test_add_func("/net/rx-lro/max-len", test_max_len);
+
+    return g_test_run();
+}
@@ -0,0 +1,198 @@
+/*
+ * RSS hash and indirection unit tests
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ */
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "net/eth.h"
+#include "../hw/net/net_rx_pkt.h"
+
+#define FRAME_LEN 128
+
+/*
+ * Key and expected results from the "Verifying the RSS Hash Calculation"
+ * section of Microsoft's RSS specification.
+ */
+static uint8_t rss_key[] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+typedef struct {
+    const char *src, *dst;
+    uint16_t sport, dport;
+    uint32_t hash_ip, hash_l4;
+} RssVector;
+
+static const RssVector ip4_vectors[] = {
+    { "66.9.149.187", "161.142.100.80", 2794, 1766,
+      0x323e8fc2, 0x51ccc178 },
+    { "199.92.111.2", "65.69.140.83", 14230, 4739,
+      0xd718262a, 0xc626b0ea },
+    { "24.19.198.95", "12.22.207.184", 12898, 38024,
+      0xd2d0a5de, 0x5c2b394a },
+    { "38.27.205.30", "209.142.163.6", 48228, 2217,
+      0x82989176, 0xafc7327f },
+    { "153.39.163.191", "202.188.127.2", 44251, 1303,
+      0x5d1809c5, 0x10e828a2 },
+};
+
+static const RssVector ip6_vectors[] = {
+    { "3ffe:2501:200:1fff::7", "3ffe:2501:200:3::1", 2794, 1766,
+      0x2cc18cd5, 0x40207d3d },
+    { "3ffe:501:8::260:97ff:fe40:efab", "ff02::1", 14230, 4739,
+      0x0f0c461c, 0xdde51bbf },
+    { "3ffe:1900:4545:3:200:f8ff:fe21:67cf", "fe80::200:f8ff:fe21:67cf",
+      44251, 38024, 0x4b61e985, 0x02d1feef },
+};
+
+/* Build an Ethernet frame carrying an empty TCP or UDP segment */
+static size_t build_frame(uint8_t *buf, const RssVector *v, bool ip6,
+                          uint8_t l4proto)
+{
+    struct eth_header *eth = (struct eth_header *)buf;
+    uint8_t *l3 = buf + sizeof(*eth);
+    uint8_t *l4;
+    size_t l4len = l4proto == IP_PROTO_TCP ? sizeof(struct tcp_header)
+                                           : sizeof(struct udp_header);
+
+    memset(buf, 0, FRAME_LEN);
+    if (ip6) {
+        struct ip6_header *ip = (struct ip6_header *)l3;
+
+        stw_be_p(&eth->h_proto, ETH_P_IPV6);
+        stl_be_p(&ip->ip6_ctlun.ip6_un1.ip6_un1_flow, 0x60000000);
+        stw_be_p(&ip->ip6_ctlun.ip6_un1.ip6_un1_plen, l4len);
+        ip->ip6_ctlun.ip6_un1.ip6_un1_nxt = l4proto;
+        ip->ip6_ctlun.ip6_un1.ip6_un1_hlim = 64;
+        g_assert(inet_pton(AF_INET6, v->src, &ip->ip6_src) == 1);
+        g_assert(inet_pton(AF_INET6, v->dst, &ip->ip6_dst) == 1);
+        l4 = (uint8_t *)(ip + 1);
+    } else {
+        struct ip_header *ip = (struct ip_header *)l3;
+
+        stw_be_p(&eth->h_proto, ETH_P_IP);
+        ip->ip_ver_len = 0x45;
+        stw_be_p(&ip->ip_len, sizeof(*ip) + l4len);
+        ip->ip_ttl = 64;
+        ip->ip_p = l4proto;
+        g_assert(inet_pton(AF_INET, v->src, &ip->ip_src) == 1);
+        g_assert(inet_pton(AF_INET, v->dst, &ip->ip_dst) == 1);
+        l4 = (uint8_t *)(ip + 1);
+    }
+
+    /* source and destination ports come first in both headers */
+    stw_be_p(l4, v->sport);
+    stw_be_p(l4 + 2, v->dport);
+    if (l4proto == IP_PROTO_TCP) {
+        l4[12] = (sizeof(struct tcp_header) / 4) << 4;
+    } else {
+        stw_be_p(l4 + 4, l4len);
+    }
+    return l4 + l4len - buf;
+}
+
+static uint32_t vector_hash(const RssVector *v, bool ip6, uint8_t l4proto,
+                            NetRxPktRssType type)
+{
+    uint8_t buf[FRAME_LEN];
+    struct NetRxPkt *pkt;
+    bool isip4, isip6, isudp, istcp;
+    uint32_t hash;
+    size_t size;
+
+    size = build_frame(buf, v, ip6, l4proto);
+    net_rx_pkt_init(&pkt, false);
+    net_rx_pkt_set_protocols(pkt, buf, size);
+    net_rx_pkt_get_protocols(pkt, &isip4, &isip6, &isudp, &istcp);
+    g_assert(isip4 == !ip6);
+    g_assert(isip6 == ip6);
+    g_assert(istcp == (l4proto == IP_PROTO_TCP));
+    g_assert(isudp == (l4proto == IP_PROTO_UDP));
+
+    hash = net_rx_pkt_calc_rss_hash(pkt, type, rss_key);
+    net_rx_pkt_uninit(pkt);
+    return hash;
+}
+
+static void test_hash_ip4(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(ip4_vectors); i++) {
+        const RssVector *v = &ip4_vectors[i];
+
+        g_assert_cmphex(vector_hash(v, false, IP_PROTO_TCP, NetPktRssIpV4),
+                        ==, v->hash_ip);
+        g_assert_cmphex(vector_hash(v, false, IP_PROTO_TCP,
+                                    NetPktRssIpV4Tcp), ==, v->hash_l4);
+        /* the UDP tuple is hashed exactly like the TCP one */
+        g_assert_cmphex(vector_hash(v, false, IP_PROTO_UDP,
+                                    NetPktRssIpV4Udp), ==, v->hash_l4);
+    }
+}
+
+static void test_hash_ip6(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(ip6_vectors); i++) {
+        const RssVector *v = &ip6_vectors[i];
+
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_TCP, NetPktRssIpV6),
+                        ==, v->hash_ip);
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_TCP, NetPktRssIpV6Tcp),
+                        ==, v->hash_l4);
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_UDP, NetPktRssIpV6Udp),
+                        ==, v->hash_l4);
+        /* without extension headers the _EX types hash the same fields */
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_TCP, NetPktRssIpV6Ex),
+                        ==, v->hash_ip);
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_TCP,
+                                    NetPktRssIpV6TcpEx), ==, v->hash_l4);
+        g_assert_cmphex(vector_hash(v, true, IP_PROTO_UDP,
+                                    NetPktRssIpV6UdpEx), ==, v->hash_l4);
+    }
+}
+
+static void test_indirection(void)
+{
+    uint16_t table[128];
+    uint32_t hash;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(table); i++) {
+        table[i] = i % 4;
+    }
+
+    /* the low bits of the hash select the entry */
+    for (i = 0; i < ARRAY_SIZE(ip4_vectors); i++) {
+        hash = ip4_vectors[i].hash_l4;
+        g_assert_cmpint(net_rx_pkt_rss_lookup(table, ARRAY_SIZE(table), hash),
+                        ==, (hash & 127) % 4);
+    }
+    g_assert_cmpint(net_rx_pkt_rss_lookup(table, ARRAY_SIZE(table),
+                                          0xffffff80), ==, 0);
+    g_assert_cmpint(net_rx_pkt_rss_lookup(table, ARRAY_SIZE(table),
+                                          0x0000007f), ==, 3);
+
+    /* a single-entry table sends everything to one queue */
+    table[0] = 2;
+    g_assert_cmpint(net_rx_pkt_rss_lookup(table, 1, 0x51ccc178), ==, 2);
+    g_assert_cmpint(net_rx_pkt_rss_lookup(table, 1, 0xffffffff), ==, 2);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/rx-rss/hash-ip4", test_hash_ip4);
+    g_test_add_func("/net/rx-rss/hash-ip6", test_hash_ip6);
+    g_test_add_func("/net/rx-rss/indirection", test_indirection);
+    return g_test_run();
+}
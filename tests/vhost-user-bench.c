@@ -0,0 +1,492 @@
+/*
+ * Throughput of a null libvhost-user backend, with and without
+ * per-queue worker threads
+ *
+ * The benchmark plays the vhost-user master itself: it shares a memfd
+ * as guest memory, sets the virtqueues up over a socket pair and keeps
+ * every queue full of one-descriptor requests from its own driver
+ * thread.  The backend completes requests without looking at them, so
+ * the numbers measure vring processing and notifications alone.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include <sys/eventfd.h>
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/memfd.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "standard-headers/linux/virtio_config.h"
+#include "contrib/libvhost-user/libvhost-user.h"
+
+#define MAX_QUEUES 16
+#define QUEUE_SIZE 256
+#define REQ_SIZE 64
+#define MAX_WATCHES (MAX_QUEUES + 2)
+
+/* Per-queue layout of guest memory */
+#define QUEUE_STRIDE 0x10000
+#define DESC_OFFSET 0
+#define AVAIL_OFFSET 0x1000
+#define USED_OFFSET 0x2000
+#define BUF_OFFSET 0x4000
+
+static unsigned int max_queues = 4;
+static unsigned int duration_ms = 1000;
+
+typedef struct BenchQueue {
+    unsigned int idx;
+    struct vring_desc *desc;
+    struct vring_avail *avail;
+    struct vring_used *used;
+    int kick_fd;
+    int call_fd;
+    uint64_t completed;
+    QemuThread thread;
+} BenchQueue;
+
+typedef struct BenchWatch {
+    int fd;
+    vu_watch_cb cb;
+    void *data;
+} BenchWatch;
+
+typedef struct BenchBackend {
+    VuDev dev;
+    BenchWatch watches[MAX_WATCHES];
+    int stop_fd;
+    bool stop;
+    QemuThread thread;
+} BenchBackend;
+
+static uint8_t *mem;
+static size_t mem_size;
+static int mem_fd;
+static BenchQueue queues[MAX_QUEUES];
+static bool stop_drivers;
+
+static const char commands_string[] =
+    " -q = largest number of queues to try\n"
+    " -t = duration of each run in milliseconds";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/* Backend */
+
+static void bench_panic(VuDev *dev, const char *err)
+{
+    fprintf(stderr, "vhost-user backend panic: %s\n", err);
+    abort();
+}
+
+static void bench_set_watch(VuDev *dev, int fd, int condition,
+                            vu_watch_cb cb, void *data)
+{
+    BenchBackend *be = container_of(dev, BenchBackend, dev);
+    BenchWatch *free_watch = NULL;
+    int i;
+
+    for (i = 0; i < MAX_WATCHES; i++) {
+        if (be->watches[i].fd == fd) {
+            free_watch = &be->watches[i];
+            break;
+        }
+        if (!free_watch && be->watches[i].fd == -1) {
+            free_watch = &be->watches[i];
+        }
+    }
+    g_assert(free_watch);
+    free_watch->fd = fd;
+    free_watch->cb = cb;
+    free_watch->data = data;
+}
+
+static void bench_remove_watch(VuDev *dev, int fd)
+{
+    BenchBackend *be = container_of(dev, BenchBackend, dev);
+    int i;
+
+    for (i = 0; i < MAX_WATCHES; i++) {
+        if (be->watches[i].fd == fd) {
+            be->watches[i].fd = -1;
+        }
+    }
+}
+
+static void bench_handle_vq(VuDev *dev, int qidx)
+{
+    VuVirtq *vq = vu_get_queue(dev, qidx);
+    VuVirtqElement *elem;
+
+    while ((elem = vu_queue_pop(dev, vq, sizeof(*elem)))) {
+        vu_queue_push(dev, vq, elem, 0);
+        free(elem);
+    }
+    vu_queue_notify(dev, vq);
+}
+
+static uint64_t bench_get_features(VuDev *dev)
+{
+    return 1ULL << VIRTIO_F_VERSION_1;
+}
+
+static void bench_queue_set_started(VuDev *dev, int qidx, bool started)
+{
+    vu_set_queue_handler(dev, vu_get_queue(dev, qidx),
+                         started ? bench_handle_vq : NULL);
+}
+
+static const VuDevIface bench_iface = {
+    .get_features = bench_get_features,
+    .queue_set_started = bench_queue_set_started,
+};
+
+static void *bench_backend_run(void *opaque)
+{
+    BenchBackend *be = opaque;
+    struct pollfd pfd[MAX_WATCHES + 2];
+    int i, n;
+
+    while (!atomic_read(&be->stop)) {
+        pfd[0] = (struct pollfd) { .fd = be->dev.sock, .events = POLLIN };
+        pfd[1] = (struct pollfd) { .fd = be->stop_fd, .events = POLLIN };
+        n = 2;
+        for (i = 0; i < MAX_WATCHES; i++) {
+            if (be->watches[i].fd != -1) {
+                pfd[n++] = (struct pollfd) {
+                    .fd = be->watches[i].fd, .events = POLLIN,
+                };
+            }
+        }
+
+        if (poll(pfd, n, -1) < 0) {
+            g_assert(errno == EINTR);
+            continue;
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            g_assert(vu_dispatch(&be->dev));
+        }
+        for (i = 2; i < n; i++) {
+            if (pfd[i].revents & POLLIN) {
+                int j;
+
+                /* The watch may have been changed by vu_dispatch() */
+                for (j = 0; j < MAX_WATCHES; j++) {
+                    if (be->watches[j].fd == pfd[i].fd) {
+                        be->watches[j].cb(&be->dev, VU_WATCH_IN,
+                                          be->watches[j].data);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    vu_deinit(&be->dev);
+    return NULL;
+}
+
+/* Master */
+
+static void master_send(int sock, VhostUserMsg *msg, int fd)
+{
+    char control[CMSG_SPACE(sizeof(int))] = { };
+    struct iovec iov = {
+        .iov_base = msg,
+        .iov_len = offsetof(VhostUserMsg, payload) + msg->size,
+    };
+    struct msghdr mh = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    struct cmsghdr *cmsg;
+
+    msg->flags = 1; /* VHOST_USER_VERSION */
+    if (fd >= 0) {
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    g_assert(sendmsg(sock, &mh, 0) == iov.iov_len);
+}
+
+static void master_recv(int sock, VhostUserMsg *msg)
+{
+    size_t hdr = offsetof(VhostUserMsg, payload);
+
+    g_assert(read(sock, msg, hdr) == hdr);
+    g_assert(msg->size <= sizeof(msg->payload));
+    g_assert(read(sock, &msg->payload, msg->size) == msg->size);
+}
+
+static void master_setup(int sock, unsigned int n_queues)
+{
+    VhostUserMsg msg;
+    unsigned int i;
+
+    msg = (VhostUserMsg) { .request = VHOST_USER_SET_OWNER };
+    master_send(sock, &msg, -1);
+
+    msg = (VhostUserMsg) {
+        .request = VHOST_USER_SET_FEATURES,
+        .size = sizeof(msg.payload.u64),
+        .payload.u64 = 1ULL << VIRTIO_F_VERSION_1,
+    };
+    master_send(sock, &msg, -1);
+
+    msg = (VhostUserMsg) {
+        .request = VHOST_USER_SET_MEM_TABLE,
+        .size = offsetof(VhostUserMemory, regions[1]),
+        .payload.memory = {
+            .nregions = 1,
+            .regions[0] = {
+                .guest_phys_addr = 0,
+                .memory_size = mem_size,
+                .userspace_addr = (uintptr_t)mem,
+            },
+        },
+    };
+    master_send(sock, &msg, mem_fd);
+
+    for (i = 0; i < n_queues; i++) {
+        BenchQueue *q = &queues[i];
+
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_SET_VRING_NUM,
+            .size = sizeof(msg.payload.state),
+            .payload.state = { .index = i, .num = QUEUE_SIZE },
+        };
+        master_send(sock, &msg, -1);
+
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_SET_VRING_BASE,
+            .size = sizeof(msg.payload.state),
+            .payload.state = { .index = i, .num = 0 },
+        };
+        master_send(sock, &msg, -1);
+
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_SET_VRING_ADDR,
+            .size = sizeof(msg.payload.addr),
+            .payload.addr = {
+                .index = i,
+                .desc_user_addr = (uintptr_t)q->desc,
+                .avail_user_addr = (uintptr_t)q->avail,
+                .used_user_addr = (uintptr_t)q->used,
+            },
+        };
+        master_send(sock, &msg, -1);
+
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_SET_VRING_CALL,
+            .size = sizeof(msg.payload.u64),
+            .payload.u64 = i,
+        };
+        master_send(sock, &msg, q->call_fd);
+
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_SET_VRING_KICK,
+            .size = sizeof(msg.payload.u64),
+            .payload.u64 = i,
+        };
+        master_send(sock, &msg, q->kick_fd);
+    }
+}
+
+static void master_stop_queues(int sock, unsigned int n_queues)
+{
+    VhostUserMsg msg;
+    unsigned int i;
+
+    for (i = 0; i < n_queues; i++) {
+        msg = (VhostUserMsg) {
+            .request = VHOST_USER_GET_VRING_BASE,
+            .size = sizeof(msg.payload.state),
+            .payload.state = { .index = i },
+        };
+        master_send(sock, &msg, -1);
+        master_recv(sock, &msg);
+    }
+}
+
+/* Driver: keep the queue full, recycle every completed request */
+static void *bench_driver_run(void *opaque)
+{
+    BenchQueue *q = opaque;
+    uint16_t avail_idx = 0, last_used = 0, used_idx;
+    struct pollfd pfd = { .fd = q->call_fd, .events = POLLIN };
+    eventfd_t data;
+    unsigned int i;
+
+    for (i = 0; i < QUEUE_SIZE; i++) {
+        q->avail->ring[i] = i;
+    }
+    avail_idx = QUEUE_SIZE;
+    /* Publish the ring entries before the index */
+    smp_wmb();
+    atomic_set(&q->avail->idx, avail_idx);
+    eventfd_write(q->kick_fd, 1);
+
+    while (!atomic_read(&stop_drivers)) {
+        if (poll(&pfd, 1, 10) <= 0) {
+            continue;
+        }
+        eventfd_read(q->call_fd, &data);
+
+        used_idx = atomic_read(&q->used->idx);
+        /* Read the index before the entries it covers */
+        smp_rmb();
+        while (last_used != used_idx) {
+            q->avail->ring[avail_idx % QUEUE_SIZE] =
+                q->used->ring[last_used % QUEUE_SIZE].id;
+            avail_idx++;
+            last_used++;
+            q->completed++;
+        }
+        /* Publish the ring entries before the index */
+        smp_wmb();
+        atomic_set(&q->avail->idx, avail_idx);
+        eventfd_write(q->kick_fd, 1);
+    }
+
+    return NULL;
+}
+
+static void setup(void)
+{
+    unsigned int i, j;
+
+    mem_size = (size_t)MAX_QUEUES * QUEUE_STRIDE;
+    mem = qemu_memfd_alloc("vhost-user-bench", mem_size, 0, &mem_fd,
+                           &error_abort);
+
+    for (i = 0; i < MAX_QUEUES; i++) {
+        uint64_t base = (uint64_t)i * QUEUE_STRIDE;
+        BenchQueue *q = &queues[i];
+
+        q->idx = i;
+        q->desc = (struct vring_desc *)(mem + base + DESC_OFFSET);
+        q->avail = (struct vring_avail *)(mem + base + AVAIL_OFFSET);
+        q->used = (struct vring_used *)(mem + base + USED_OFFSET);
+        for (j = 0; j < QUEUE_SIZE; j++) {
+            q->desc[j] = (struct vring_desc) {
+                .addr = base + BUF_OFFSET + j * REQ_SIZE,
+                .len = REQ_SIZE,
+            };
+        }
+    }
+}
+
+static double run(unsigned int n_queues, bool threaded)
+{
+    BenchBackend *be = g_new0(BenchBackend, 1);
+    uint64_t completed = 0;
+    int64_t start, elapsed;
+    unsigned int i;
+    int sv[2];
+
+    g_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    for (i = 0; i < MAX_WATCHES; i++) {
+        be->watches[i].fd = -1;
+    }
+    be->stop_fd = eventfd(0, EFD_CLOEXEC);
+    g_assert(vu_init(&be->dev, n_queues, sv[1], bench_panic,
+                     bench_set_watch, bench_remove_watch, &bench_iface));
+    vu_set_threaded(&be->dev, threaded);
+    qemu_thread_create(&be->thread, "vu-backend", bench_backend_run, be,
+                       QEMU_THREAD_JOINABLE);
+
+    for (i = 0; i < n_queues; i++) {
+        BenchQueue *q = &queues[i];
+
+        memset(q->avail, 0, USED_OFFSET - AVAIL_OFFSET);
+        memset(q->used, 0, BUF_OFFSET - USED_OFFSET);
+        q->kick_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        q->call_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        q->completed = 0;
+    }
+    master_setup(sv[0], n_queues);
+
+    atomic_set(&stop_drivers, false);
+    start = get_clock();
+    for (i = 0; i < n_queues; i++) {
+        qemu_thread_create(&queues[i].thread, "vu-driver", bench_driver_run,
+                           &queues[i], QEMU_THREAD_JOINABLE);
+    }
+    g_usleep(duration_ms * 1000);
+    atomic_set(&stop_drivers, true);
+    for (i = 0; i < n_queues; i++) {
+        qemu_thread_join(&queues[i].thread);
+        completed += queues[i].completed;
+    }
+    elapsed = get_clock() - start;
+
+    master_stop_queues(sv[0], n_queues);
+    atomic_set(&be->stop, true);
+    eventfd_write(be->stop_fd, 1);
+    qemu_thread_join(&be->thread);
+
+    close(sv[0]);
+    close(be->stop_fd);
+    g_free(be);
+    for (i = 0; i < n_queues; i++) {
+        close(queues[i].kick_fd);
+        close(queues[i].call_fd);
+    }
+
+    return (double)completed * NANOSECONDS_PER_SECOND / elapsed;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hq:t:");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'q':
+            max_queues = MIN(MAX(atoi(optarg), 1), MAX_QUEUES);
+            break;
+        case 't':
+            duration_ms = MAX(atoi(optarg), 1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int n;
+
+    parse_args(argc, argv);
+    setup();
+
+    printf("queue size:            %u\n", QUEUE_SIZE);
+    printf("queues   dispatch loop, req/s   worker threads, req/s\n");
+    for (n = 1; n <= max_queues; n *= 2) {
+        double single = run(n, false);
+        double threaded = run(n, true);
+
+        printf("%-8u %22.0f %23.0f\n", n, single, threaded);
+    }
+
+    qemu_memfd_free(mem, mem_size, mem_fd);
+    return 0;
+}
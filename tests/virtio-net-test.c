@@ -25,6 +25,8 @@
 #define PCI_SLOT                0x04
 
 #define QVIRTIO_NET_TIMEOUT_US (30 * 1000 * 1000)
+#define RX_COALESCE_USECS       1000
+#define RX_COALESCE_PACKETS     4
 #define VNET_HDR_SIZE sizeof(struct virtio_net_hdr_mrg_rxbuf)
 
 #ifndef _WIN32
@@ -166,6 +168,100 @@ static void stop_cont_test(void *obj, void *data, QGuestAllocator *t_alloc)
     rx_stop_cont_test(dev, t_alloc, rx, sv[0]);
 }
 
+static void rx_coalesce_send(int socket)
+{
+    char test[] = "TEST";
+    int len = htonl(sizeof(test));
+    struct iovec iov[] = {
+        {
+            .iov_base = &len,
+            .iov_len = sizeof(len),
+        }, {
+            .iov_base = test,
+            .iov_len = sizeof(test),
+        },
+    };
+    int ret;
+
+    ret = iov_send(socket, iov, 2, 0, sizeof(len) + sizeof(test));
+    g_assert_cmpint(ret, ==, sizeof(test) + sizeof(len));
+}
+
+/*
+ * Wait for the device to use a buffer without moving the virtual clock,
+ * so that a coalesced notification cannot be sent meanwhile.
+ */
+static void rx_coalesce_wait_used(QTestState *qts, QVirtQueue *vq,
+                                  uint16_t idx)
+{
+    gint64 start_time = g_get_monotonic_time();
+
+    while (qtest_readw(qts, vq->used + offsetof(struct vring_used, idx)) !=
+           idx) {
+        g_usleep(1000);
+        g_assert(g_get_monotonic_time() - start_time <=
+                 QVIRTIO_NET_TIMEOUT_US);
+    }
+}
+
+static void rx_coalesce_test(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtioNet *net_if = obj;
+    QVirtioDevice *dev = net_if->vdev;
+    QVirtQueue *vq = net_if->queues[0];
+    QTestState *qts = global_qtest;
+    uint64_t req_addr[RX_COALESCE_PACKETS + 1];
+    uint32_t free_head[RX_COALESCE_PACKETS + 1];
+    uint32_t desc_idx;
+    char buffer[64];
+    int *sv = data;
+    QDict *rsp;
+    int i;
+
+    for (i = 0; i < RX_COALESCE_PACKETS + 1; i++) {
+        req_addr[i] = guest_alloc(t_alloc, 64);
+        free_head[i] = qvirtqueue_add(qts, vq, req_addr[i], 64, true, false);
+        qvirtqueue_kick(qts, dev, vq, free_head[i]);
+    }
+
+    /* The packets are received right away, but nobody is interrupted */
+    for (i = 0; i < RX_COALESCE_PACKETS; i++) {
+        rx_coalesce_send(sv[0]);
+        rx_coalesce_wait_used(qts, vq, i + 1);
+        g_assert(!dev->bus->get_queue_isr_status(dev, vq));
+    }
+
+    /* One interrupt covers all of them, exactly when the timer expires */
+    qtest_clock_step(qts, RX_COALESCE_USECS * 1000 - 1);
+    g_assert(!dev->bus->get_queue_isr_status(dev, vq));
+    qtest_clock_step(qts, 1);
+    g_assert(dev->bus->get_queue_isr_status(dev, vq));
+    g_assert(!dev->bus->get_queue_isr_status(dev, vq));
+
+    for (i = 0; i < RX_COALESCE_PACKETS; i++) {
+        g_assert(qvirtqueue_get_buf(qts, vq, &desc_idx, NULL));
+        g_assert_cmpint(desc_idx, ==, free_head[i]);
+        memread(req_addr[i] + VNET_HDR_SIZE, buffer, sizeof("TEST"));
+        g_assert_cmpstr(buffer, ==, "TEST");
+    }
+
+    /* Without coalescing, every packet interrupts the guest again */
+    rsp = qmp("{ 'execute': 'qom-set',"
+              "  'arguments': { 'path': 'vnet0',"
+              "                 'property': 'rx-coalesce-usecs',"
+              "                 'value': 0 } }");
+    g_assert(qdict_haskey(rsp, "return"));
+    qobject_unref(rsp);
+
+    rx_coalesce_send(sv[0]);
+    rx_coalesce_wait_used(qts, vq, RX_COALESCE_PACKETS + 1);
+    g_assert(dev->bus->get_queue_isr_status(dev, vq));
+
+    for (i = 0; i < RX_COALESCE_PACKETS + 1; i++) {
+        guest_free(t_alloc, req_addr[i]);
+    }
+}
+
 #endif
 
 static void hotplug(void *obj, void *data, QGuestAllocator *t_alloc)
@@ -323,6 +419,10 @@ static void register_virtio_net_test(void)
 #ifndef _WIN32
     qos_add_test("basic", "virtio-net", send_recv_test, &opts);
     qos_add_test("rx_stop_cont", "virtio-net", stop_cont_test, &opts);
+    opts.edge.extra_device_opts = "id=vnet0,rx-coalesce-usecs="
+                                  stringify(RX_COALESCE_USECS);
+    qos_add_test("rx_coalesce", "virtio-net", rx_coalesce_test, &opts);
+    opts.edge.extra_device_opts = NULL;
 #endif
     qos_add_test("announce-self", "virtio-net", announce_self, &opts);
 
@@ -14,6 +14,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qapi/error.h"
 #include "block/block.h"
 #include "qemu/rcu_queue.h"
 #include "qemu/sockets.h"
@@ -35,6 +36,12 @@ struct AioHandler
     void *opaque;
     bool is_external;
     QLIST_ENTRY(AioHandler) node;
+
+    /* Arrival of events, for adaptive polling */
+    int64_t poll_last_ns;       /* time of the last event */
+    int64_t poll_interval_ns;   /* average time between events */
+    int64_t poll_dev_ns;        /* mean deviation of poll_interval_ns */
+    bool poll_progress;         /* event already seen by io_poll */
 };
 
 #ifdef CONFIG_EPOLL_CREATE1
@@ -509,7 +516,111 @@ static void add_pollfd(AioHandler *node)
     npfd++;
 }
 
-static bool run_poll_handlers_once(AioContext *ctx, int64_t *timeout)
+/* Length of the periods over which the CPU budget is enforced */
+#define AIO_POLL_PERIOD_NS (100 * SCALE_MS)
+
+static bool aio_poll_adaptive(AioContext *ctx)
+{
+    return ctx->poll_latency_ns || ctx->poll_cpu_budget;
+}
+
+/*
+ * Update the statistics of the time between events of @node, in the same
+ * way as TCP estimates round-trip times: the average is used to predict
+ * the next event and the mean deviation gives the margin around it.
+ */
+static void aio_handler_event(AioContext *ctx, AioHandler *node, int64_t now)
+{
+    int64_t sample, err;
+
+    if (!aio_poll_adaptive(ctx) || node->opaque == &ctx->notifier) {
+        return;
+    }
+
+    if (node->poll_last_ns) {
+        sample = now - node->poll_last_ns;
+        if (!node->poll_interval_ns) {
+            node->poll_interval_ns = sample;
+            node->poll_dev_ns = sample / 2;
+        } else {
+            err = sample - node->poll_interval_ns;
+            node->poll_interval_ns += err / 8;
+            node->poll_dev_ns += (ABS(err) - node->poll_dev_ns) / 4;
+        }
+    }
+    node->poll_last_ns = now;
+}
+
+/*
+ * Choose how long to poll for in adaptive mode.  Handlers whose events
+ * are further apart than the latency target are left to the blocking
+ * wait.  For the others, poll until shortly after their next predicted
+ * event; if that is already well in the past, the stream has paused and
+ * the handler does not count either.  This way an idle context stops
+ * polling by itself.
+ */
+static int64_t aio_compute_poll_window(AioContext *ctx, int64_t now)
+{
+    int64_t target = ctx->poll_latency_ns ?: ctx->poll_max_ns;
+    int64_t window = 0;
+    AioHandler *node;
+
+    if (now - ctx->poll_period_start >= AIO_POLL_PERIOD_NS) {
+        ctx->poll_period_start = now;
+        ctx->poll_period_ns = 0;
+    }
+    if (ctx->poll_cpu_budget &&
+        ctx->poll_period_ns * 100 >=
+        ctx->poll_cpu_budget * AIO_POLL_PERIOD_NS) {
+        return 0;
+    }
+
+    QLIST_FOREACH_RCU(node, &ctx->aio_handlers, node) {
+        int64_t next;
+
+        if (node->deleted || !node->io_poll || !node->poll_interval_ns ||
+            node->poll_interval_ns > target ||
+            !aio_node_check(ctx, node->is_external)) {
+            continue;
+        }
+
+        next = node->poll_last_ns + node->poll_interval_ns +
+               2 * node->poll_dev_ns;
+        window = MAX(window, next - now);
+    }
+
+    return MIN(window, ctx->poll_max_ns);
+}
+
+/*
+ * Events that were not caught by polling count for adaptive polling too.
+ * If io_poll already made progress in this iteration, the file descriptor
+ * is usually still readable for the same event; counting it again would
+ * add a bogus, near-zero sample.
+ */
+static void aio_record_fd_events(AioContext *ctx, bool have_revents)
+{
+    int64_t now = 0;
+    AioHandler *node;
+
+    QLIST_FOREACH_RCU(node, &ctx->aio_handlers, node) {
+        if (node->poll_progress) {
+            node->poll_progress = false;
+            continue;
+        }
+        if (have_revents && !node->deleted && node->io_poll &&
+            (node->pfd.revents & node->pfd.events &
+             (G_IO_IN | G_IO_HUP | G_IO_ERR))) {
+            if (!now) {
+                now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+            }
+            aio_handler_event(ctx, node, now);
+        }
+    }
+}
+
+static bool run_poll_handlers_once(AioContext *ctx, int64_t now,
+                                   int64_t *timeout)
 {
     bool progress = false;
     AioHandler *node;
@@ -526,6 +637,10 @@ static bool run_poll_handlers_once(AioContext *ctx, int64_t *timeout)
             if (node->opaque != &ctx->notifier) {
                 progress = true;
             }
+            if (aio_poll_adaptive(ctx)) {
+                node->poll_progress = true;
+                aio_handler_event(ctx, node, now);
+            }
         }
 
         /* Caller handles freeing deleted nodes.  Don't do it here. */
@@ -550,21 +665,30 @@ static bool run_poll_handlers_once(AioContext *ctx, int64_t *timeout)
 static bool run_poll_handlers(AioContext *ctx, int64_t max_ns, int64_t *timeout)
 {
     bool progress;
-    int64_t start_time, elapsed_time;
+    int64_t start_time, elapsed_time, now;
 
     assert(ctx->notify_me);
     assert(qemu_lockcnt_count(&ctx->list_lock) > 0);
 
     trace_run_poll_handlers_begin(ctx, max_ns, *timeout);
 
-    start_time = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    start_time = now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
     do {
-        progress = run_poll_handlers_once(ctx, timeout);
-        elapsed_time = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start_time;
+        progress = run_poll_handlers_once(ctx, now, timeout);
+        now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        elapsed_time = now - start_time;
         max_ns = qemu_soonest_timeout(*timeout, max_ns);
         assert(!(max_ns && progress));
     } while (elapsed_time < max_ns && !atomic_read(&ctx->poll_disable_cnt));
 
+    if (progress) {
+        ctx->poll_stats.hits++;
+    } else {
+        ctx->poll_stats.misses++;
+    }
+    ctx->poll_stats.time_ns += elapsed_time;
+    ctx->poll_period_ns += elapsed_time;
+
     /* If time has passed with no successful polling, adjust *timeout to
      * keep the same ending time.
      */
@@ -589,7 +713,17 @@ static bool run_poll_handlers(AioContext *ctx, int64_t max_ns, int64_t *timeout)
  */
 static bool try_poll_mode(AioContext *ctx, int64_t *timeout)
 {
-    int64_t max_ns = qemu_soonest_timeout(*timeout, ctx->poll_ns);
+    int64_t now = 0;
+    int64_t max_ns;
+
+    if (aio_poll_adaptive(ctx)) {
+        now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+        max_ns = *timeout ? aio_compute_poll_window(ctx, now) : 0;
+        trace_poll_adaptive_window(ctx, max_ns);
+    } else {
+        max_ns = ctx->poll_ns;
+    }
+    max_ns = qemu_soonest_timeout(*timeout, max_ns);
 
     if (max_ns && !atomic_read(&ctx->poll_disable_cnt)) {
         poll_set_started(ctx, true);
@@ -604,7 +738,7 @@ static bool try_poll_mode(AioContext *ctx, int64_t *timeout)
     /* Even if we don't run busy polling, try polling once in case it can make
      * progress and the caller will be able to avoid ppoll(2)/epoll_wait(2).
      */
-    return run_poll_handlers_once(ctx, timeout);
+    return run_poll_handlers_once(ctx, now, timeout);
 }
 
 bool aio_poll(AioContext *ctx, bool blocking)
@@ -675,8 +809,8 @@ bool aio_poll(AioContext *ctx, bool blocking)
         aio_notify_accept(ctx);
     }
 
-    /* Adjust polling time */
-    if (ctx->poll_max_ns) {
+    /* Adjust polling time; adaptive mode recomputes it every time */
+    if (ctx->poll_max_ns && !aio_poll_adaptive(ctx)) {
         int64_t block_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - start;
 
         if (block_ns <= ctx->poll_ns) {
@@ -722,6 +856,9 @@ bool aio_poll(AioContext *ctx, bool blocking)
             nodes[i]->pfd.revents = pollfds[i].revents;
         }
     }
+    if (aio_poll_adaptive(ctx)) {
+        aio_record_fd_events(ctx, ret > 0);
+    }
 
     npfd = 0;
 
@@ -772,3 +909,19 @@ void aio_context_set_poll_params(AioContext *ctx, int64_t max_ns,
 
     aio_notify(ctx);
 }
+
+void aio_context_set_poll_target(AioContext *ctx, int64_t latency_ns,
+                                 int64_t cpu_budget, Error **errp)
+{
+    if (cpu_budget > 100) {
+        error_setg(errp, "CPU budget must be a percentage");
+        return;
+    }
+
+    /* No thread synchronization here, as in aio_context_set_poll_params */
+    ctx->poll_latency_ns = latency_ns;
+    ctx->poll_cpu_budget = cpu_budget;
+    ctx->poll_ns = 0;
+
+    aio_notify(ctx);
+}
@@ -410,3 +410,11 @@ void aio_context_set_poll_params(AioContext *ctx, int64_t max_ns,
         error_setg(errp, "AioContext polling is not implemented on Windows");
     }
 }
+
+void aio_context_set_poll_target(AioContext *ctx, int64_t latency_ns,
+                                 int64_t cpu_budget, Error **errp)
+{
+    if (latency_ns || cpu_budget) {
+        error_setg(errp, "AioContext polling is not implemented on Windows");
+    }
+}